@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <vector>
+#include <algorithm>
 #include <utility>
 #include <functional>
 #include <string>
@@ -15,6 +16,7 @@ Author: Leonardo de Moura
 #include "util/name_map.h"
 #include "util/name_set.h"
 #include "kernel/environment.h"
+#include "kernel/for_each_fn.h"
 #include "kernel/expr_maps.h"
 #include "kernel/expr_sets.h"
 #include "kernel/kernel.h"
@@ -84,6 +86,9 @@ struct lean_extension : public environment_extension {
     coercion_map          m_coercion_map; // mapping from (given_type, expected_type) -> coercion
     coercion_set          m_coercion_set; // Set of coercions
     expr_to_coercions     m_type_coercions; // mapping type -> list (to-type, function)
+    // signatures (see get_coercion_signature) of the 'from' types and of the coercions added to this extension
+    std::vector<uint64>   m_coercion_type_signatures;
+    std::vector<uint64>   m_coercion_signatures;
     name_set              m_explicit_names; // set of explicit version of constants with implicit parameters
     name_map<expr>        m_aliases;
     inv_aliases           m_inv_aliases;  // inverse map for m_aliases
@@ -436,6 +441,37 @@ struct lean_extension : public environment_extension {
         }
     }
 
+    /**
+        \brief Return the signature of the names of the constants occurring in \c e (see get_const_signature).
+        The types of the constants are ignored since the structural equality used by the coercion tables ignores them.
+    */
+    static uint64 get_coercion_signature(expr const & e) {
+        uint64 r = 0;
+        for_each(e, [&](expr const & c, unsigned) {
+                if (is_constant(c)) {
+                    r |= get_name_signature(const_name(c));
+                    return false;
+                }
+                return true;
+            });
+        return r;
+    }
+
+    static void add_coercion_signature(std::vector<uint64> & sigs, expr const & e) {
+        uint64 s = get_coercion_signature(e);
+        if (std::find(sigs.begin(), sigs.end(), s) == sigs.end())
+            sigs.push_back(s);
+    }
+
+    /**
+        \brief Return false if \c e is not structurally equal to any expression whose signature is in \c sigs.
+        It is used to skip the coercion tables of this extension without computing any hash code.
+    */
+    static bool may_be_in(std::vector<uint64> const & sigs, expr const & e) {
+        uint64 s = get_const_signature(e);
+        return std::any_of(sigs.begin(), sigs.end(), [&](uint64 c) { return (s & c) == c; });
+    }
+
     void add_coercion(expr const & f, environment const & env) {
         expr type      = env->type_check(f);
         expr norm_type = env->normalize(type);
@@ -451,14 +487,18 @@ struct lean_extension : public environment_extension {
         m_coercion_set.insert(f);
         list<expr_pair> l = get_coercions_core(from);
         insert(m_type_coercions, from, cons(expr_pair(to, f), l));
+        add_coercion_signature(m_coercion_type_signatures, from);
+        add_coercion_signature(m_coercion_signatures, f);
         env->add_neutral_object(new coercion_declaration(f));
     }
 
     optional<expr> get_coercion_core(expr const & from_type, expr const & to_type) const {
-        expr_pair p(from_type, to_type);
-        auto it = m_coercion_map.find(p);
-        if (it != m_coercion_map.end())
-            return some_expr(it->second);
+        if (may_be_in(m_coercion_type_signatures, from_type)) {
+            expr_pair p(from_type, to_type);
+            auto it = m_coercion_map.find(p);
+            if (it != m_coercion_map.end())
+                return some_expr(it->second);
+        }
         lean_extension const * parent = get_parent();
         if (parent)
             return parent->get_coercion_core(from_type, to_type);
@@ -472,9 +512,11 @@ struct lean_extension : public environment_extension {
     }
 
     list<expr_pair> get_coercions_core(expr const & from_type) const {
-        auto r = m_type_coercions.find(from_type);
-        if (r != m_type_coercions.end())
-            return r->second;
+        if (may_be_in(m_coercion_type_signatures, from_type)) {
+            auto r = m_type_coercions.find(from_type);
+            if (r != m_type_coercions.end())
+                return r->second;
+        }
         lean_extension const * parent = get_parent();
         if (parent)
             return parent->get_coercions_core(from_type);
@@ -487,7 +529,7 @@ struct lean_extension : public environment_extension {
     }
 
     bool is_coercion(expr const & f) const {
-        if (m_coercion_set.find(f) != m_coercion_set.end())
+        if (may_be_in(m_coercion_signatures, f) && m_coercion_set.find(f) != m_coercion_set.end())
             return true;
         lean_extension const * parent = get_parent();
         return parent && parent->is_coercion(f);
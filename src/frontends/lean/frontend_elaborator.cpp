@@ -23,8 +23,29 @@ Author: Leonardo de Moura
 #include "frontends/lean/frontend.h"
 #include "frontends/lean/frontend_elaborator.h"
 
+#ifndef LEAN_DEFAULT_ELABORATOR_PROFILE
+#define LEAN_DEFAULT_ELABORATOR_PROFILE false
+#endif
+
+#ifndef LEAN_DEFAULT_ELABORATOR_PROFILE_JSON
+#define LEAN_DEFAULT_ELABORATOR_PROFILE_JSON false
+#endif
+
 namespace lean {
 static name g_x_name("x");
+
+static name g_elaborator_profile      {"elaborator", "profile"};
+static name g_elaborator_profile_json {"elaborator", "profile_json"};
+RegisterBoolOption(g_elaborator_profile, LEAN_DEFAULT_ELABORATOR_PROFILE,
+                   "(elaborator) display counters and the time spent elaborating each declaration");
+RegisterBoolOption(g_elaborator_profile_json, LEAN_DEFAULT_ELABORATOR_PROFILE_JSON,
+                   "(elaborator) display the elaborator profile in JSON format (one object per declaration)");
+bool get_elaborator_profile(options const & opts) {
+    return opts.get_bool(g_elaborator_profile, LEAN_DEFAULT_ELABORATOR_PROFILE);
+}
+bool get_elaborator_profile_json(options const & opts) {
+    return opts.get_bool(g_elaborator_profile_json, LEAN_DEFAULT_ELABORATOR_PROFILE_JSON);
+}
 static format g_assignment_fmt  = format(":=");
 static format g_unification_u_fmt = format("\u2248");
 static format g_unification_fmt = format("=?=");
@@ -136,6 +157,8 @@ class frontend_elaborator::imp {
     // We need that because a frontend may associate line number information
     // with the original non-elaborated expressions.
     expr_map<expr>                      m_trace;
+    options                             m_options;
+    elaborator_stats                    m_stats; // statistics of the last elaboration
 
     /**
        \brief Replace placeholders and choices with metavariables.
@@ -168,6 +191,7 @@ class frontend_elaborator::imp {
         */
         optional<expr> get_type(expr const & e, context const & ctx) {
             try {
+                m_ref.m_stats.m_num_type_checker_calls++;
                 return some_expr(m_ref.m_type_checker.infer_type(e, ctx));
             } catch (exception &) {
                 return none_expr();
@@ -176,6 +200,7 @@ class frontend_elaborator::imp {
 
         bool is_convertible(expr const & from, expr const & to) {
             try {
+                m_ref.m_stats.m_num_type_checker_calls++;
                 return m_ref.m_type_checker.is_convertible(from, to);
             } catch (exception &) {
                 return false;
@@ -189,6 +214,7 @@ class frontend_elaborator::imp {
             if (!f_t || is_pi(*f_t)) {
                 return f_t;
             } else {
+                m_ref.m_stats.m_num_normalizer_calls++;
                 expr r = m_ref.m_normalizer(*f_t, ctx, m_ref.m_menv);
                 if (is_pi(r))
                     return some_expr(r);
@@ -250,6 +276,7 @@ class frontend_elaborator::imp {
                             num_skipped_args++;
                         } else {
                             if (!has_metavar(expected) && !has_metavar(*given)) {
+                                m_ref.m_stats.m_num_type_checker_calls++;
                                 if (m_ref.m_type_checker.is_convertible(*given, expected, ctx)) {
                                     // compatible
                                 } else if (get_coercion(env(), *given, expected)) {
@@ -431,8 +458,13 @@ class frontend_elaborator::imp {
         //                 [](unification_constraint const & c1, unification_constraint const & c2) {
         //                     return !is_choice(c1) && is_choice(c2);
         //                 });
-        elaborator elb(m_env, m_menv, m_ucs.size(), m_ucs.data());
-        return elb.next();
+        elaborator elb(m_env, m_menv, m_ucs.size(), m_ucs.data(), m_options);
+        metavar_env r = elb.next();
+        // Remark: the time spent by the elaborator is included in the time of the whole elaboration
+        double t = m_stats.m_time;
+        m_stats += elb.get_stats();
+        m_stats.m_time = t;
+        return r;
     }
 
 public:
@@ -445,9 +477,11 @@ public:
     std::pair<expr, metavar_env> elaborate(expr const & e) {
         // std::cout << "Elaborate " << e << "\n";
         clear();
+        scoped_elaborator_timer timer(m_stats);
         expr new_e = preprocessor(*this)(e);
         // std::cout << "After preprocessing\n" << new_e << "\n";
         if (has_metavar(new_e)) {
+            m_stats.m_num_type_checker_calls++;
             m_type_checker.check(new_e, context(), m_menv, m_ucs);
             // for (auto c : m_ucs) {
             //     formatter fmt = mk_simple_formatter();
@@ -463,10 +497,12 @@ public:
     std::tuple<expr, expr, metavar_env> elaborate(name const & n, expr const & t, expr const & e) {
         // std::cout << "Elaborate " << t << " : " << e << "\n";
         clear();
+        scoped_elaborator_timer timer(m_stats);
         expr new_t = preprocessor(*this)(t);
         expr new_e = preprocessor(*this)(e);
         // std::cout << "After preprocessing\n" << new_t << "\n" << new_e << "\n";
         if (has_metavar(new_e) || has_metavar(new_t)) {
+            m_stats.m_num_type_checker_calls += 2;
             m_type_checker.check(new_t, context(), m_menv, m_ucs);
             expr new_e_t = m_type_checker.check(new_e, context(), m_menv, m_ucs);
             m_ucs.push_back(mk_convertible_constraint(context(), new_e_t, new_t,
@@ -502,11 +538,26 @@ public:
         m_trace.clear();
         m_type_checker.clear();
         m_normalizer.clear();
+        m_stats = elaborator_stats();
     }
 
     environment const & get_environment() const {
         return m_env;
     }
+
+    options const & get_options() const { return m_options; }
+    void set_options(options const & opts) { m_options = opts; }
+
+    elaborator_stats const & get_stats() const { return m_stats; }
+
+    void display_profile(std::ostream & out, name const & n) const {
+        if (!get_elaborator_profile(m_options))
+            return;
+        if (get_elaborator_profile_json(m_options))
+            display_json(out, n, m_stats);
+        else
+            display(out, n, m_stats);
+    }
 };
 
 frontend_elaborator::frontend_elaborator(environment const & env):m_ptr(std::make_shared<imp>(env)) {}
@@ -517,6 +568,13 @@ std::tuple<expr, expr, metavar_env> frontend_elaborator::operator()(name const &
 }
 expr const & frontend_elaborator::get_original(expr const & e) const { return m_ptr->get_original(e); }
 void frontend_elaborator::clear() { m_ptr->clear(); }
-void frontend_elaborator::reset(environment const & env) { m_ptr.reset(new imp(env)); }
+void frontend_elaborator::reset(environment const & env) {
+    options opts = m_ptr->get_options();
+    m_ptr.reset(new imp(env));
+    m_ptr->set_options(opts);
+}
+void frontend_elaborator::set_options(options const & opts) { m_ptr->set_options(opts); }
+elaborator_stats const & frontend_elaborator::get_stats() const { return m_ptr->get_stats(); }
+void frontend_elaborator::display_profile(std::ostream & out, name const & n) const { m_ptr->display_profile(out, n); }
 environment const & frontend_elaborator::get_environment() const { return m_ptr->get_environment(); }
 }
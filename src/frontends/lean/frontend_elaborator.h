@@ -7,8 +7,10 @@ Author: Leonardo de Moura
 #pragma once
 #include <memory>
 #include <utility>
+#include "util/sexpr/options.h"
 #include "kernel/environment.h"
 #include "kernel/formatter.h"
+#include "library/elaborator/elaborator_stats.h"
 
 namespace lean {
 class frontend;
@@ -48,6 +50,16 @@ public:
 
     void clear();
     void reset(environment const & env);
+    /** \brief Set the options used to configure the elaborator (e.g., <tt>elaborator::parallel_case_splits</tt>). */
+    void set_options(options const & opts);
+
+    /** \brief Return the statistics (e.g., number of constraints and case-splits) of the last elaboration. */
+    elaborator_stats const & get_stats() const;
+    /**
+       \brief Display the statistics of the last elaboration, i.e., the one of the declaration \c n,
+       if the option <tt>elaborator::profile</tt> is set.
+    */
+    void display_profile(std::ostream & out, name const & n) const;
 };
 
 /**
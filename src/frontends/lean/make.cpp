@@ -0,0 +1,388 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdio>
+#if defined(LEAN_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+#include "util/thread.h"
+#include "util/interrupt.h"
+#include "util/exception.h"
+#include "util/optional.h"
+#include "util/sstream.h"
+#include "util/hash.h"
+#include "util/realpath.h"
+#include "util/lean_path.h"
+#include "frontends/lean/parser.h"
+#include "frontends/lean/make.h"
+
+namespace lean {
+#if defined(LEAN_WINDOWS)
+static char g_sep = '\\';
+#else
+static char g_sep = '/';
+#endif
+
+static bool is_directory(std::string const & path) {
+#if defined(LEAN_WINDOWS)
+    DWORD attrs = GetFileAttributesA(path.c_str());
+    return attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+static bool file_exists(std::string const & path) {
+    std::ifstream in(path);
+    return static_cast<bool>(in);
+}
+
+/** \brief Store in \c r the entries of the directory \c dir, hidden entries are ignored. */
+static void read_directory(std::string const & dir, std::vector<std::string> & r) {
+#if defined(LEAN_WINDOWS)
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (h == INVALID_HANDLE_VALUE)
+        throw exception(sstream() << "failed to read directory '" << dir << "'");
+    do {
+        if (data.cFileName[0] != '.')
+            r.push_back(data.cFileName);
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    DIR * d = opendir(dir.c_str());
+    if (d == nullptr)
+        throw exception(sstream() << "failed to read directory '" << dir << "'");
+    while (dirent * e = readdir(d)) { // NOLINT
+        if (e->d_name[0] != '.')
+            r.push_back(e->d_name);
+    }
+    closedir(d);
+#endif
+    std::sort(r.begin(), r.end());
+}
+
+static std::string join(std::string const & dir, std::string const & fname) {
+    return dir == "." ? fname : dir + g_sep + fname;
+}
+
+static std::string remove_extension(std::string const & fname, char const * ext) {
+    std::string e(ext);
+    if (fname.size() > e.size() && fname.compare(fname.size() - e.size(), e.size(), e) == 0)
+        return fname.substr(0, fname.size() - e.size());
+    else
+        return fname;
+}
+
+/** \brief Return the hash code of the contents of the given file, using \c h as the initial value. */
+static unsigned hash_file(std::string const & fname, unsigned h) {
+    std::ifstream in(fname, std::ios_base::binary);
+    if (!in)
+        return hash(h, 0u);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return hash_str(contents.size(), contents.data(), h);
+}
+
+/**
+   \brief Build the modules in a set of directories.
+
+   The modules are discovered by following the \c import commands of the given Lean files.
+   A module becomes ready when all modules it imports were built. Ready modules are built by a pool
+   of worker threads, and each one of them uses \c m_compile (i.e., the compilation itself is performed
+   by another process or by a fresh environment).
+*/
+class module_builder {
+    struct module {
+        std::string           m_source;
+        std::string           m_olean;
+        std::vector<unsigned> m_deps;        // imported modules in the directories being built
+        std::vector<unsigned> m_dependents;
+        std::vector<std::string> m_external; // other imported files
+        unsigned              m_num_pending;
+        bool                  m_done;
+        optional<unsigned>    m_failed_dep;  // a dependency that could not be built
+        module(std::string const & src):
+            m_source(src), m_olean(remove_extension(src, ".lean") + ".olean"), m_num_pending(0), m_done(false) {}
+    };
+    std::vector<std::string>                  m_roots;
+    std::vector<std::unique_ptr<module>>      m_modules;
+    std::unordered_map<std::string, unsigned> m_module_idx; // real path of the source -> index
+    compile_fn                                m_compile;
+    std::string                               m_build_id;
+    std::ostream &                            m_out;
+    bool                                      m_verbose;
+    mutex                                     m_out_mutex;
+
+    unsigned add_module(std::string const & src) {
+        std::string key = realpath(src.c_str());
+        auto it = m_module_idx.find(key);
+        if (it != m_module_idx.end())
+            return it->second;
+        unsigned idx = m_modules.size();
+        m_modules.emplace_back(new module(src));
+        m_module_idx[key] = idx;
+        std::ifstream in(src);
+        if (!in)
+            throw exception(sstream() << "failed to open file '" << src << "'");
+        for (std::string const & fname : scan_imports(in, src.c_str())) {
+            if (auto dep = find_module(fname)) {
+                unsigned d = add_module(*dep);
+                std::vector<unsigned> & deps = m_modules[idx]->m_deps;
+                if (d != idx && std::find(deps.begin(), deps.end(), d) == deps.end())
+                    deps.push_back(d);
+            } else {
+                try {
+                    m_modules[idx]->m_external.push_back(find_file(fname));
+                } catch (exception &) {
+                    // the error is reported when the module is compiled
+                }
+            }
+        }
+        return idx;
+    }
+
+    /** \brief Return the Lean file of the imported file \c fname if it is in one of the directories being built. */
+    optional<std::string> find_module(std::string const & fname) {
+        std::string base = remove_extension(remove_extension(fname, ".olean"), ".lean");
+        // the last root is the first one in the LEAN_PATH (see add_root)
+        for (auto it = m_roots.rbegin(); it != m_roots.rend(); ++it) {
+            std::string src = join(*it, base + ".lean");
+            if (file_exists(src))
+                return optional<std::string>(src);
+        }
+        return optional<std::string>();
+    }
+
+    void add_directory(std::string const & dir) {
+        std::vector<std::string> entries;
+        read_directory(dir, entries);
+        for (std::string const & e : entries) {
+            std::string path = join(dir, e);
+            if (is_directory(path))
+                add_directory(path);
+            else if (is_lean_file(path))
+                add_module(path);
+        }
+    }
+
+    void add_root(std::string const & dir) {
+        if (std::find(m_roots.begin(), m_roots.end(), dir) == m_roots.end()) {
+            m_roots.push_back(dir);
+            add_lean_path(dir);
+        }
+    }
+
+    void report(sstream const & msg) {
+        lock_guard<mutex> lock(m_out_mutex);
+        m_out << msg.str() << std::endl;
+    }
+
+    /** \brief Return the hash code of the given module, and of the files it imports. */
+    unsigned get_build_hash(module const & m) {
+        unsigned h = hash_str(m_build_id.size(), m_build_id.data(), 17);
+        h = hash_file(m.m_source, h);
+        for (unsigned d : m.m_deps)
+            h = hash_file(m_modules[d]->m_olean, h);
+        for (std::string const & f : m.m_external)
+            h = hash_file(f, h);
+        return h;
+    }
+
+    /** \brief Build the given module. Return true iff it succeeded or the .olean file was up to date. */
+    bool build(unsigned idx) {
+        module & m = *m_modules[idx];
+        if (m.m_failed_dep) {
+            report(sstream() << "Skipping '" << m.m_source << "', failed to build '"
+                   << m_modules[*m.m_failed_dep]->m_source << "'");
+            return false;
+        }
+        unsigned h = get_build_hash(m);
+        std::string stamp = m.m_olean + ".hash";
+        {
+            std::ifstream in(stamp);
+            unsigned old_h;
+            if (in >> old_h && old_h == h && file_exists(m.m_olean))
+                return true;
+        }
+        if (m_verbose)
+            report(sstream() << "Compiling '" << m.m_source << "'");
+        std::remove(stamp.c_str());
+        if (!m_compile(m.m_source, m.m_olean))
+            return false;
+        // Remark: the compiler replaces the .olean file atomically (see environment_cell::export_objects),
+        // and the stamp is also written to a temporary file. So, an incomplete stamp is never used.
+        std::string tmp_stamp = stamp + ".tmp";
+        bool ok;
+        {
+            std::ofstream out(tmp_stamp);
+            out << h << "\n";
+            out.flush();
+            ok = out.good();
+        }
+        if (!ok || std::rename(tmp_stamp.c_str(), stamp.c_str()) != 0) {
+            std::remove(tmp_stamp.c_str());
+            report(sstream() << "Failed to write '" << stamp << "'");
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief Update the dependents of the module \c idx, and store the ones that are ready in \c ready. */
+    void finished(unsigned idx, bool ok, std::deque<unsigned> & ready) {
+        module & m = *m_modules[idx];
+        m.m_done = true;
+        for (unsigned d : m.m_dependents) {
+            module & dm = *m_modules[d];
+            if (!ok && !dm.m_failed_dep)
+                dm.m_failed_dep = idx;
+            dm.m_num_pending--;
+            if (dm.m_num_pending == 0)
+                ready.push_back(d);
+        }
+    }
+
+    /** \brief Return true iff the module \c idx imports itself through modules that were not built. */
+    bool is_on_cycle(unsigned idx) {
+        std::vector<bool>     visited(m_modules.size(), false);
+        std::vector<unsigned> todo(m_modules[idx]->m_deps);
+        while (!todo.empty()) {
+            unsigned i = todo.back();
+            todo.pop_back();
+            if (i == idx)
+                return true;
+            if (visited[i] || m_modules[i]->m_done)
+                continue;
+            visited[i] = true;
+            todo.insert(todo.end(), m_modules[i]->m_deps.begin(), m_modules[i]->m_deps.end());
+        }
+        return false;
+    }
+
+public:
+    module_builder(compile_fn const & compile, std::string const & build_id, std::ostream & out, bool verbose):
+        m_compile(compile), m_build_id(build_id), m_out(out), m_verbose(verbose) {}
+
+    void add_path(std::string path) {
+        while (path.size() > 1 && (path.back() == '/' || path.back() == g_sep))
+            path.pop_back();
+        if (is_directory(path)) {
+            add_root(path);
+            add_directory(path);
+        } else if (is_lean_file(path) && file_exists(path)) {
+            auto pos = path.find_last_of("/\\");
+            add_root(pos == std::string::npos ? std::string(".") : path.substr(0, pos));
+            add_module(path);
+        } else {
+            throw exception(sstream() << "Lean file or directory '" << path << "' not found");
+        }
+    }
+
+    /** \brief Build the ready modules, and the modules that become ready. Set \c ok to false if one of them fails. */
+    void build_all(unsigned num_jobs, std::deque<unsigned> & ready, bool & ok) {
+        unsigned num_threads = std::min(num_jobs, static_cast<unsigned>(m_modules.size()));
+#if defined(LEAN_MULTI_THREAD)
+        if (num_threads > 1) {
+            mutex              mtx;
+            condition_variable cv;
+            unsigned           num_running = 0;
+            auto worker = [&]() {
+                unique_lock<mutex> lock(mtx);
+                while (true) {
+                    while (ready.empty() && num_running > 0)
+                        cv.wait(lock);
+                    if (ready.empty()) {
+                        cv.notify_all();
+                        return;
+                    }
+                    unsigned i = ready.front();
+                    ready.pop_front();
+                    num_running++;
+                    lock.unlock();
+                    bool r = build(i);
+                    lock.lock();
+                    num_running--;
+                    ok = ok && r;
+                    finished(i, r, ready);
+                    cv.notify_all();
+                }
+            };
+            std::vector<std::unique_ptr<interruptible_thread>> threads;
+            for (unsigned i = 0; i < num_threads; i++)
+                threads.emplace_back(new interruptible_thread([&]() { worker(); }));
+            for (auto & t : threads)
+                t->join();
+            return;
+        }
+#endif
+        while (!ready.empty()) {
+            check_interrupted();
+            unsigned i = ready.front();
+            ready.pop_front();
+            bool r = build(i);
+            ok = ok && r;
+            finished(i, r, ready);
+        }
+    }
+
+    bool operator()(unsigned num_jobs) {
+        std::deque<unsigned> ready;
+        for (unsigned i = 0; i < m_modules.size(); i++) {
+            module & m = *m_modules[i];
+            m.m_num_pending = m.m_deps.size();
+            for (unsigned d : m.m_deps)
+                m_modules[d]->m_dependents.push_back(i);
+            if (m.m_num_pending == 0)
+                ready.push_back(i);
+        }
+        bool ok = true;
+        build_all(num_jobs, ready, ok);
+        // The modules that were not built are on a cycle of imports, or import (indirectly) a module on a cycle.
+        std::vector<bool> on_cycle(m_modules.size(), false);
+        for (unsigned i = 0; i < m_modules.size(); i++) {
+            if (!m_modules[i]->m_done && is_on_cycle(i)) {
+                on_cycle[i] = true;
+                report(sstream() << "Failed to build '" << m_modules[i]->m_source << "', circular dependency");
+                ok = false;
+            }
+        }
+        for (unsigned i = 0; i < m_modules.size(); i++) {
+            if (!m_modules[i]->m_done && !on_cycle[i]) {
+                // Remark: a module that was not built imports a module that was not built.
+                // So, we eventually reach a module on a cycle.
+                unsigned j = i;
+                while (!on_cycle[j])
+                    j = *std::find_if(m_modules[j]->m_deps.begin(), m_modules[j]->m_deps.end(),
+                                      [&](unsigned d) { return !m_modules[d]->m_done; });
+                report(sstream() << "Skipping '" << m_modules[i]->m_source << "', failed to build '"
+                       << m_modules[j]->m_source << "'");
+                ok = false;
+            }
+        }
+        return ok;
+    }
+};
+
+bool make(std::vector<std::string> const & paths, unsigned num_jobs, compile_fn const & compile, std::string const & build_id,
+          std::ostream & out, bool verbose) {
+    module_builder builder(compile, build_id, out, verbose);
+    for (std::string const & p : paths)
+        builder.add_path(p);
+    return builder(num_jobs);
+}
+}
@@ -0,0 +1,36 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <iostream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace lean {
+/**
+   \brief Function used by \c make for compiling the Lean file \c src into the .olean file \c olean.
+   It must return true iff the file was successfully compiled.
+*/
+typedef std::function<bool(std::string const & src, std::string const & olean)> compile_fn; // NOLINT
+
+/**
+   \brief Compile the Lean files in \c paths, and the Lean files they import, into .olean files.
+
+   Each element of \c paths is a Lean file or a directory. All Lean files in a directory (and in its
+   subdirectories) are compiled. The directories, and the directories containing the given files, are added
+   to the LEAN_PATH, and an imported module is compiled if its Lean file is in one of them.
+
+   A module is compiled after the modules it imports, and at most \c num_jobs modules are compiled in parallel.
+   The hash code of the Lean file, of the files it imports, and of \c build_id is stored in a <tt>.olean.hash</tt>
+   file next to the .olean file. The module is not compiled again if this hash code did not change.
+   Thus, \c build_id should identify the compiler.
+
+   Return true iff all modules were successfully compiled (or were up to date).
+*/
+bool make(std::vector<std::string> const & paths, unsigned num_jobs, compile_fn const & compile, std::string const & build_id,
+          std::ostream & out, bool verbose);
+}
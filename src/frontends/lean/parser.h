@@ -6,6 +6,8 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <iostream>
+#include <string>
+#include <vector>
 #include "util/lua.h"
 #include "kernel/environment.h"
 #include "kernel/io_state.h"
@@ -33,5 +35,10 @@ public:
 bool parse_commands(environment const & env, io_state & st, std::istream & in, char const * strm_name, script_state * S = nullptr, bool use_exceptions = true, bool interactive = false);
 bool parse_commands(environment const & env, io_state & st, char const * fname, script_state * S = nullptr, bool use_exceptions = true, bool interactive = false);
 expr parse_expr(environment const & env, io_state & st, std::istream & in, char const * strm_name, script_state * S = nullptr, bool use_exceptions = true);
+/**
+   \brief Return the files imported by the \c import commands in the given stream.
+   Identifiers are converted into file names using \c name_to_file.
+*/
+std::vector<std::string> scan_imports(std::istream & in, char const * strm_name);
 void open_macros(lua_State * L);
 }
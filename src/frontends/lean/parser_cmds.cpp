@@ -4,9 +4,11 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <string>
+#include <vector>
 #include "util/sstream.h"
 #include "util/lean_path.h"
 #include "util/sexpr/option_declarations.h"
@@ -169,6 +171,7 @@ void parser_imp::parse_def_core(bool is_definition) {
         if (m_verbose)
             regular(m_io_state) << "  Proved: " << full_id << endl;
     }
+    m_elaborator.display_profile(regular(m_io_state).get_stream(), full_id);
     register_implicit_arguments(full_id, parameters);
 }
 
@@ -221,6 +224,7 @@ void parser_imp::parse_variable_core(bool is_var) {
         m_env->add_axiom(full_id, type);
     if (m_verbose)
         regular(m_io_state) << "  Assumed: " << full_id << endl;
+    m_elaborator.display_profile(regular(m_io_state).get_stream(), full_id);
     register_implicit_arguments(full_id, parameters);
 }
 
@@ -572,25 +576,72 @@ optional<std::string> parser_imp::find_lua_file(std::string const & fname) {
 
 void parser_imp::parse_import() {
     next();
-    std::string fname;
-    if (curr_is_identifier()) {
-        fname = name_to_file(curr_name());
-        next();
-    } else {
-        fname  = check_string_next("invalid import command, string (i.e., file name) or identifier expected");
-    }
-    bool r = false;
-    if (auto lua_fname = find_lua_file(fname)) {
-        if (!m_script_state)
-            throw parser_error(sstream() << "failed to import Lua file '" << *lua_fname << "', parser does not have an intepreter",
-                               m_last_cmd_pos);
-        r = m_script_state->import_explicit(lua_fname->c_str());
-    } else {
-        r = m_env->import(fname, m_io_state);
+    std::vector<std::string> fnames;
+    do {
+        if (curr_is_identifier()) {
+            fnames.push_back(name_to_file(curr_name()));
+            next();
+        } else {
+            fnames.push_back(check_string_next("invalid import command, string (i.e., file name) or identifier expected"));
+        }
+    } while (curr_is_identifier() || curr() == scanner::token::StringVal);
+    // consecutive Lean modules are imported together, then their .olean files are read in parallel
+    std::vector<std::string> modules;
+    auto import_modules = [&]() {
+        if (modules.empty())
+            return;
+        std::vector<std::string> new_modules;
+        if (m_verbose) {
+            for (std::string const & m : modules) {
+                if (!m_env->imported(m) && std::find(new_modules.begin(), new_modules.end(), m) == new_modules.end())
+                    new_modules.push_back(m);
+            }
+        }
+        m_env->import(modules, m_io_state);
+        for (std::string const & m : new_modules)
+            regular(m_io_state) << "  Imported '" << m << "'" << endl;
+        modules.clear();
+    };
+    for (std::string const & fname : fnames) {
+        if (auto lua_fname = find_lua_file(fname)) {
+            import_modules();
+            if (!m_script_state)
+                throw parser_error(sstream() << "failed to import Lua file '" << *lua_fname << "', parser does not have an intepreter",
+                                   m_last_cmd_pos);
+            bool r = m_script_state->import_explicit(lua_fname->c_str());
+            if (m_verbose && r)
+                regular(m_io_state) << "  Imported '" << fname << "'" << endl;
+        } else {
+            modules.push_back(fname);
+        }
     }
-    if (m_verbose && r) {
-        regular(m_io_state) << "  Imported '" << fname << "'" << endl;
+    import_modules();
+}
+
+std::vector<std::string> scan_imports(std::istream & in, char const * strm_name) {
+    std::vector<std::string> r;
+    scanner s(in, strm_name);
+    s.set_command_keywords(g_command_keywords);
+    try {
+        bool in_import = false;
+        while (true) {
+            scanner::token t = s.scan();
+            if (t == scanner::token::Eof) {
+                break;
+            } else if (t == scanner::token::CommandId) {
+                in_import = s.get_name_val() == g_import_kwd;
+            } else if (in_import && t == scanner::token::Id) {
+                r.push_back(name_to_file(s.get_name_val()));
+            } else if (in_import && t == scanner::token::StringVal) {
+                r.push_back(s.get_str_val());
+            } else {
+                in_import = false;
+            }
+        }
+    } catch (exception &) {
+        // syntax errors are reported when the file is parsed
     }
+    return r;
 }
 
 void parser_imp::parse_help() {
@@ -620,7 +671,7 @@ void parser_imp::parse_help() {
                             << "  help                     display this message" << endl
                             << "  help options             display available options" << endl
                             << "  help notation            describe commands for defining infix, mixfix, postfix operators" << endl
-                            << "  import [string]          load the given file" << endl
+                            << "  import [string]+         load the given files" << endl
                             << "  pop::scope               discard the current scope" << endl
                             << "  print [expr]             pretty print the given expression" << endl
                             << "  print Options            print current the set of assigned options" << endl
@@ -104,6 +104,7 @@ double parser_imp::parse_double() {
 void parser_imp::updt_options() {
     m_verbose = get_verbose(m_io_state.get_options());
     m_show_errors = get_parser_show_errors(m_io_state.get_options());
+    m_elaborator.set_options(m_io_state.get_options());
 }
 
 /**
@@ -5,20 +5,31 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <cstdlib>
+#include <cstdio>
 #include <algorithm>
 #include <vector>
+#include <set>
 #include <tuple>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <limits>
+#include <functional>
+#include <unordered_map>
 #include <utility>
 #include "util/thread.h"
+#include "util/buffer.h"
+#include "util/mapped_file.h"
 #include "util/safe_arith.h"
 #include "util/realpath.h"
 #include "util/sstream.h"
 #include "util/lean_path.h"
 #include "util/flet.h"
+#include "util/hash.h"
+#include "util/interrupt.h"
 #include "kernel/for_each_fn.h"
 #include "kernel/find_fn.h"
+#include "kernel/max_sharing.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/environment.h"
 #include "kernel/threadsafe_environment.h"
@@ -140,6 +151,46 @@ unsigned environment_cell::register_extension(mk_extension mk) {
     return get_extension_factory().register_extension(mk);
 }
 
+/**
+   \brief Normal forms of definitions.
+   The normalized value of a definition depends on the opaque flag of other definitions.
+   The flag is stored in the object cell, and it is shared by ancestor and descendant environments.
+   So, we use a global counter to discard the entries stored before the last \c set_opaque.
+*/
+static atomic<unsigned> g_set_opaque_counter(0);
+
+class environment_cell::normal_form_cache {
+    mutex           m_mutex;
+    unsigned        m_counter;
+    name_map<expr>  m_values[2]; // m_values[1] contains the values produced when opaque definitions are unfolded
+
+    void check_counter() {
+        unsigned c = atomic_load(&g_set_opaque_counter);
+        if (m_counter != c) {
+            m_values[0].clear();
+            m_values[1].clear();
+            m_counter = c;
+        }
+    }
+public:
+    normal_form_cache():m_counter(atomic_load(&g_set_opaque_counter)) {}
+
+    optional<expr> find(name const & n, bool unfold_opaque) {
+        lock_guard<mutex> lock(m_mutex);
+        check_counter();
+        auto it = m_values[unfold_opaque].find(n);
+        if (it == m_values[unfold_opaque].end())
+            return none_expr();
+        return some_expr(it->second);
+    }
+
+    void insert(name const & n, bool unfold_opaque, expr const & v) {
+        lock_guard<mutex> lock(m_mutex);
+        check_counter();
+        m_values[unfold_opaque].insert(mk_pair(n, v));
+    }
+};
+
 environment environment_cell::env() const {
     lean_assert(!m_this.expired()); // it is not possible to expire since it is a reference to this object
     lean_assert(this == m_this.lock().get());
@@ -174,6 +225,8 @@ environment_extension const & environment_cell::get_extension_core(unsigned exti
 unsigned environment_cell::get_max_weight(expr const & e) {
     unsigned w = 0;
     auto proc = [&](expr const & c, unsigned) {
+        if (get_const_signature(c) == 0)
+            return false; // there are no constants in c
         if (is_constant(c)) {
             optional<object> obj = get_object_core(const_name(c));
             if (obj)
@@ -188,9 +241,7 @@ unsigned environment_cell::get_max_weight(expr const & e) {
 
 /** \brief Throw exception if environment or its ancestors already have an object with the given name. */
 void environment_cell::check_name_core(name const & n) {
-    if (has_parent())
-        m_parent->check_name_core(n);
-    if (m_object_dictionary.find(n) != m_object_dictionary.end())
+    if (m_object_dictionary.contains(n))
         throw already_declared_exception(env(), n);
 }
 
@@ -203,7 +254,7 @@ void environment_cell::check_name(name const & n) {
 /** \brief Store new named object inside internal data-structures */
 void environment_cell::register_named_object(object const & new_obj) {
     m_objects.push_back(new_obj);
-    m_object_dictionary.insert(std::make_pair(new_obj.get_name(), new_obj));
+    m_object_dictionary.insert(new_obj.get_name(), object_entry(new_obj, this));
 }
 
 /**
@@ -212,15 +263,32 @@ void environment_cell::register_named_object(object const & new_obj) {
    given name.
 */
 optional<object> environment_cell::get_object_core(name const & n) const {
-    auto it = m_object_dictionary.find(n);
-    if (it == m_object_dictionary.end()) {
-        if (has_parent())
-            return m_parent->get_object_core(n);
-        else
-            return none_object();
-    } else {
-        return some_object(it->second);
-    }
+    if (object_entry const * e = m_object_dictionary.find(n))
+        return some_object(e->m_object);
+    else
+        return none_object();
+}
+
+/** \brief Return the environment (this one or an ancestor) where the object named \c n was declared. */
+environment_cell const * environment_cell::get_owner(name const & n) const {
+    if (object_entry const * e = m_object_dictionary.find(n))
+        return e->m_owner;
+    else
+        return nullptr;
+}
+
+optional<expr> environment_cell::get_cached_normal_form(name const & n, bool unfold_opaque) const {
+    environment_cell const * owner = get_owner(n);
+    if (owner)
+        return owner->m_normal_forms->find(n, unfold_opaque);
+    else
+        return none_expr();
+}
+
+void environment_cell::set_cached_normal_form(name const & n, bool unfold_opaque, expr const & v) const {
+    environment_cell const * owner = get_owner(n);
+    if (owner)
+        owner->m_normal_forms->insert(n, unfold_opaque, v);
 }
 
 object environment_cell::get_object(name const & n) const {
@@ -473,6 +541,7 @@ void environment_cell::set_opaque(name const & n, bool opaque) {
     if (!obj || !obj->is_definition())
         throw kernel_exception(env(), sstream() << "set_opaque failed, '" << n << "' is not a definition");
     obj->set_opaque(opaque);
+    g_set_opaque_counter++;
     add_neutral_object(new set_opaque_command(n, opaque));
 }
 
@@ -543,6 +612,22 @@ bool environment_cell::already_imported(name const & n) const {
         return false;
 }
 
+/** \brief Store in \c r the expressions exported by the modules imported in this environment and its ancestors. */
+void environment_cell::get_module_exprs(std::vector<module_exprs const *> & r) const {
+    if (has_parent())
+        m_parent->get_module_exprs(r);
+    for (module_exprs const & m : m_module_exprs)
+        r.push_back(&m);
+}
+
+environment_cell::module_exprs const * environment_cell::find_module_exprs(name const & file) const {
+    for (module_exprs const & m : m_module_exprs) {
+        if (m.m_file == file)
+            return &m;
+    }
+    return has_parent() ? m_parent->find_module_exprs(file) : nullptr;
+}
+
 bool environment_cell::mark_imported_core(name n) {
     if (already_imported(n)) {
         return false;
@@ -573,12 +658,126 @@ void environment_cell::set_trusted_imported(bool flag) {
     m_trust_imported = flag;
 }
 
-static char const * g_olean_header   = "oleanfile";
-static char const * g_olean_end_file = "EndFile";
+static char const * g_olean_header = "oleanindex";
+/**
+   \brief Version of the .olean format. It must be incremented whenever the format changes:
+   files created using a different version are rejected, since they cannot be read.
+
+   1- Index and sections read on demand.
+   2- Varint-encoded serializer.
+   3- Expressions shared across modules.
+*/
+static unsigned const g_olean_version = 3;
+
+/**
+   \brief Kinds of entries in the index of a .olean file.
+
+   The type and value of definitions, theorems, axioms and variable declarations are stored in
+   separate sections, and they can be read on demand. Any other object is stored in a single section
+   containing the data produced by \c object::write.
+*/
+enum class olean_entry_kind : char { Object, Definition, Theorem, Axiom, VarDecl };
+
+static olean_entry_kind get_entry_kind(object const & obj) {
+    if (obj.is_builtin() || obj.is_builtin_set() || !obj.has_name() || !obj.has_type())
+        return olean_entry_kind::Object;
+    else if (obj.is_theorem())
+        return olean_entry_kind::Theorem;
+    else if (obj.is_definition())
+        return olean_entry_kind::Definition;
+    else if (obj.is_axiom())
+        return olean_entry_kind::Axiom;
+    else if (obj.is_var_decl())
+        return olean_entry_kind::VarDecl;
+    else
+        return olean_entry_kind::Object;
+}
+
+static unsigned get_num_sections(olean_entry_kind k) {
+    return k == olean_entry_kind::Definition || k == olean_entry_kind::Theorem ? 2 : 1;
+}
+
+/**
+   \brief Store in \c r the subexpressions that occur in more than one element of \c es.
+   The subexpressions of an element of \c r are not included in \c r.
+
+   The cells in \c imported are exported by imported modules, and they are not included in \c r.
+   If a cell of the module at position \c j is used, then <tt>used[j]</tt> is set to true.
+
+   \pre The elements of \c es are maximally shared.
+*/
+static void collect_shared(buffer<expr> const & es, std::unordered_map<expr_cell *, unsigned> const & imported,
+                           std::vector<bool> & used, buffer<expr> & r) {
+    unsigned const shared = std::numeric_limits<unsigned>::max();
+    std::unordered_map<expr_cell *, unsigned> first; // position of the first element containing a cell
+    buffer<expr> todo;
+    for (unsigned i = 0; i < es.size(); i++) {
+        todo.push_back(es[i]);
+        while (!todo.empty()) {
+            expr e = todo.back();
+            todo.pop_back();
+            auto it_imp = imported.find(e.raw());
+            if (it_imp != imported.end()) {
+                used[it_imp->second] = true;
+                continue;
+            }
+            auto it = first.find(e.raw());
+            if (it != first.end()) {
+                if (it->second != i && it->second != shared) {
+                    it->second = shared;
+                    r.push_back(e);
+                }
+                continue; // the subexpressions were already visited
+            }
+            first.insert(std::make_pair(e.raw(), i));
+            switch (e.kind()) {
+            case expr_kind::Var: case expr_kind::Type: case expr_kind::Value: case expr_kind::MetaVar:
+                break;
+            case expr_kind::Constant:
+                if (const_type(e))
+                    todo.push_back(*const_type(e));
+                break;
+            case expr_kind::App:
+                for (expr const & a : args(e))
+                    todo.push_back(a);
+                break;
+            case expr_kind::Lambda: case expr_kind::Pi:
+                todo.push_back(abst_domain(e));
+                todo.push_back(abst_body(e));
+                break;
+            case expr_kind::Let:
+                if (let_type(e))
+                    todo.push_back(*let_type(e));
+                todo.push_back(let_value(e));
+                todo.push_back(let_body(e));
+                break;
+            }
+        }
+    }
+}
+
+/**
+   \brief Export the objects declared in this environment (and not imported) to a .olean file.
+
+   The file contains:
+   1- The header, the version of the format, Lean version, and the hash code of items 2-6.
+   2- The modules this one depends on: the modules it imports, and the imported modules whose exported
+      expressions are used in this file. For each one, its name, hash code, and whether its expressions are used.
+   3- The expressions that are shared by different sections. They are the expressions exported by this module.
+   4- The index: the kind of each object, and its name and weight when its type and value are stored in separate sections.
+   5- The offset and size of each section.
+   6- The sections.
+
+   Items 2-5 are written using the same serializer, and the sections are written using children of it.
+   Thus, a section can refer to the names and expressions in 2-4, and it can be read independently of
+   the other sections. This is how \c load_core reads objects on demand.
+
+   The expressions exported by the used modules in item 2 are added to the table of the serializer before
+   they are used. So, they are written as references, and \c load_core reuses the expressions of the
+   imported modules instead of creating copies.
+*/
 void environment_cell::export_objects(std::string const & fname) {
-    std::ofstream out(fname, std::ofstream::binary);
-    serializer s(out);
-    s << g_olean_header << LEAN_VERSION_MAJOR << LEAN_VERSION_MINOR;
+    buffer<object> objs;
     auto it  = begin_objects();
     auto end = end_objects();
     unsigned num_imports = 0;
@@ -586,7 +785,7 @@ void environment_cell::export_objects(std::string const & fname) {
         object const & obj = *it;
         if (dynamic_cast<import_command const*>(obj.cell())) {
             if (num_imports == 0)
-                obj.write(s);
+                objs.push_back(obj);
             num_imports++;
         } else if (dynamic_cast<end_import_mark const*>(obj.cell())) {
             lean_assert(num_imports > 0);
@@ -594,55 +793,537 @@ void environment_cell::export_objects(std::string const & fname) {
         } else if (dynamic_cast<begin_import_mark const*>(obj.cell())) {
             num_imports++;
         } else if (num_imports == 0) {
-            obj.write(s);
+            objs.push_back(obj);
         }
     }
-    s << g_olean_end_file;
+    std::vector<module_exprs const *> modules;
+    get_module_exprs(modules);
+    max_sharing_fn max_sharing;
+    std::unordered_map<expr_cell *, unsigned> imported; // cell -> position of the module exporting it
+    for (unsigned j = 0; j < modules.size(); j++) {
+        for (expr const & e : modules[j]->m_exprs) {
+            max_sharing(e); // subexpressions structurally equal to e will be replaced with it
+            imported.insert(std::make_pair(e.raw(), j));
+        }
+    }
+    buffer<expr> exprs; // types and values stored in separate sections
+    for (object const & obj : objs) {
+        olean_entry_kind k = get_entry_kind(obj);
+        if (k != olean_entry_kind::Object)
+            exprs.push_back(max_sharing(obj.get_type()));
+        if (get_num_sections(k) == 2)
+            exprs.push_back(max_sharing(obj.get_value()));
+    }
+    std::vector<bool> used(modules.size(), false);
+    buffer<expr> shared;
+    collect_shared(exprs, imported, used, shared);
+    std::set<name> direct; // modules imported by this one
+    for (object const & obj : objs) {
+        if (auto m = get_imported_module(obj))
+            direct.insert(name(realpath(find_file(*m, {".olean"}).c_str())));
+    }
+    std::vector<bool> deps(modules.size(), false);
+    for (unsigned j = 0; j < modules.size(); j++)
+        deps[j] = used[j] || direct.find(modules[j]->m_file) != direct.end();
+
+    std::ostringstream index_out;
+    serializer s(index_out);
+    s << static_cast<unsigned>(std::count(deps.begin(), deps.end(), true));
+    for (unsigned j = 0; j < modules.size(); j++) {
+        if (deps[j]) {
+            s << modules[j]->m_name << modules[j]->m_hash << static_cast<bool>(used[j]);
+            if (used[j])
+                add_exprs(s, modules[j]->m_exprs.size(), modules[j]->m_exprs.data());
+        }
+    }
+    s << shared.size();
+    for (expr const & e : shared)
+        s << e;
+    s << objs.size();
+    for (object const & obj : objs) {
+        olean_entry_kind k = get_entry_kind(obj);
+        s << static_cast<char>(k);
+        if (k != olean_entry_kind::Object)
+            s << obj.get_name();
+        if (k == olean_entry_kind::Definition)
+            s << obj.get_weight();
+    }
+
+    std::ostringstream sections_out;
+    buffer<std::pair<unsigned, unsigned>> sections;
+    auto write_section = [&](std::function<void(serializer &)> const & fn) {
+        unsigned offset = sections_out.tellp();
+        serializer sd(sections_out);
+        sd.set_parent(s);
+        fn(sd);
+        sections.emplace_back(offset, static_cast<unsigned>(sections_out.tellp()) - offset);
+    };
+    unsigned i = 0;
+    for (object const & obj : objs) {
+        olean_entry_kind k = get_entry_kind(obj);
+        if (k == olean_entry_kind::Object) {
+            write_section([&](serializer & sd) { obj.write(sd); });
+        } else {
+            for (unsigned j = 0; j < get_num_sections(k); j++, i++)
+                write_section([&](serializer & sd) { sd << exprs[i]; });
+        }
+    }
+    s << sections.size();
+    for (auto const & p : sections)
+        s << p.first << p.second;
+
+    std::string index_str    = index_out.str();
+    std::string sections_str = sections_out.str();
+    unsigned h = hash_str(index_str.size(), index_str.data(), 17);
+    h = hash_str(sections_str.size(), sections_str.data(), h);
+    // Remark: the file is written to a temporary file that is then renamed. Thus, the processes that mapped
+    // the old file in memory (see mapped_file) keep reading it, and a failure does not leave a truncated file.
+    std::string tmp_fname = fname + ".tmp";
+    bool ok;
+    {
+        std::ofstream out(tmp_fname, std::ofstream::binary);
+        {
+            serializer header(out);
+            header << g_olean_header << g_olean_version << LEAN_VERSION_MAJOR << LEAN_VERSION_MINOR << h;
+        }
+        out << index_str << sections_str;
+        out.flush();
+        ok = out.good();
+    }
+#if defined(LEAN_WINDOWS)
+    if (ok)
+        std::remove(fname.c_str()); // rename does not replace existing files on Windows
+#endif
+    if (!ok || std::rename(tmp_fname.c_str(), fname.c_str()) != 0) {
+        std::remove(tmp_fname.c_str());
+        throw exception(sstream() << "failed to write file '" << fname << "'");
+    }
 }
 
-bool environment_cell::load_core(std::string const & fname, io_state const & ios, optional<std::string> const & mod_name) {
-    if (!mod_name || mark_imported_core(fname)) {
-        std::ifstream in(fname, std::ifstream::binary);
-        if (!in.good())
-            throw exception(sstream() << "failed to open file '" << fname << "'");
-        deserializer d(in);
+/**
+   \brief Contents of a .olean file. It is also the source of the types and values of the objects read on demand.
+
+   The header and the dependencies are read by the constructor. The rest of the index is read by \c read_index.
+   It does not modify the environment, and different files can be read in parallel.
+*/
+class olean_file : public lazy_expr_source {
+public:
+    struct dependency {
+        std::string m_name;
+        unsigned    m_hash;
+        bool        m_uses_exprs; // true if the file uses the expressions exported by the module
+    };
+    struct entry {
+        olean_entry_kind m_kind;
+        name             m_name;
+        unsigned         m_weight;
+        entry(olean_entry_kind k, name const & n, unsigned w):m_kind(k), m_name(n), m_weight(w) {}
+    };
+private:
+    mapped_file                                m_file;
+    deserializer                               m_deserializer; // header, shared expressions and index
+    unsigned                                   m_hash;
+    std::vector<dependency>                    m_dependencies;
+    std::vector<expr>                          m_exprs;        // expressions exported by the module
+    std::vector<entry>                         m_entries;
+    char const *                               m_sections_begin;
+    std::vector<std::pair<unsigned, unsigned>> m_sections;
+    std::vector<expr>                          m_section_exprs; // see read_index
+
+    template<typename F>
+    typename std::result_of<F(deserializer &)>::type read_section(unsigned i, F && f) {
+        if (i >= m_sections.size())
+            throw_corrupted_file();
+        char const * begin = m_sections_begin + m_sections[i].first;
+        deserializer d(begin, begin + m_sections[i].second);
+        d.set_parent(m_deserializer);
+        return f(d);
+    }
+
+    /** \brief Read the offset and size of each section. They are stored after the index. */
+    void read_sections() {
+        unsigned num = m_deserializer.read_unsigned();
+        for (unsigned i = 0; i < num; i++) {
+            unsigned offset = m_deserializer.read_unsigned();
+            unsigned size   = m_deserializer.read_unsigned();
+            m_sections.emplace_back(offset, size);
+        }
+        m_sections_begin = m_file.data() + m_deserializer.get_position();
+        size_t available = m_file.size() - m_deserializer.get_position();
+        for (auto const & p : m_sections) {
+            if (p.first > available || p.second > available - p.first)
+                throw_corrupted_file();
+        }
+    }
+public:
+    olean_file(std::string const & fname):
+        m_file(fname), m_deserializer(m_file.data(), m_file.data() + m_file.size()), m_sections_begin(nullptr) {
         std::string header;
-        d >> header;
+        m_deserializer >> header;
         if (header != g_olean_header)
             throw exception(sstream() << "file '" << fname << "' does not seem to be a valid object Lean file");
+        unsigned version = m_deserializer.read_unsigned();
+        if (version != g_olean_version)
+            throw exception(sstream() << "file '" << fname << "' was created using an incompatible version of the .olean format "
+                            << "(version " << version << ", expected " << g_olean_version << "), it must be recompiled");
         unsigned major, minor;
-        // Perhaps we should enforce the right version number
-        d >> major >> minor;
-        try {
-            if (mod_name)
-                add_neutral_object(new import_command(*mod_name));
-            while (true) {
+        // Remark: the format version is enforced, files created by different versions of Lean using the same format are accepted
+        m_deserializer >> major >> minor >> m_hash;
+        unsigned num = m_deserializer.read_unsigned();
+        for (unsigned i = 0; i < num; i++) {
+            dependency dep;
+            m_deserializer >> dep.m_name >> dep.m_hash >> dep.m_uses_exprs;
+            m_dependencies.push_back(dep);
+        }
+    }
+
+    unsigned get_hash() const { return m_hash; }
+    std::vector<dependency> const & get_dependencies() const { return m_dependencies; }
+    std::vector<expr> const & get_exprs() const { return m_exprs; }
+    std::vector<entry> const & get_entries() const { return m_entries; }
+
+    /**
+       \brief Read the shared expressions, the index, and the offset and size of each section.
+       \c tables contains the expressions exported by the dependencies whose expressions are used.
+       When \c prefetch is true, the types and values of the named objects are also read (see \c get_section_expr).
+    */
+    void read_index(std::vector<std::vector<expr> const *> const & tables, bool prefetch) {
+        deserializer & d = m_deserializer;
+        for (std::vector<expr> const * t : tables)
+            add_exprs(d, t->size(), t->data());
+        unsigned num_imported = get_num_exprs(d);
+        unsigned num_shared = d.read_unsigned();
+        for (unsigned i = 0; i < num_shared; i++)
+            read_expr(d);
+        for (unsigned i = num_imported; i < get_num_exprs(d); i++)
+            m_exprs.push_back(get_expr(d, i));
+        unsigned num_entries = d.read_unsigned();
+        for (unsigned i = 0; i < num_entries; i++) {
+            char c = d.read_char();
+            if (c < static_cast<char>(olean_entry_kind::Object) || c > static_cast<char>(olean_entry_kind::VarDecl))
+                throw_corrupted_file();
+            olean_entry_kind k = static_cast<olean_entry_kind>(c);
+            name n;
+            unsigned w = 0;
+            if (k != olean_entry_kind::Object)
+                n = read_name(d);
+            if (k == olean_entry_kind::Definition)
+                w = d.read_unsigned();
+            m_entries.emplace_back(k, n, w);
+        }
+        read_sections();
+        if (prefetch) {
+            unsigned i = 0;
+            for (entry const & e : m_entries) {
+                unsigned num = get_num_sections(e.m_kind);
+                for (unsigned j = 0; j < num; j++, i++)
+                    m_section_exprs.push_back(e.m_kind == olean_entry_kind::Object ? expr() : read(i));
+            }
+        }
+    }
+
+    virtual expr read(unsigned i) {
+        return read_section(i, [](deserializer & d) { return read_expr(d); });
+    }
+
+    /** \brief Return the expression stored in the given section. It is only read once if it was prefetched. */
+    expr get_section_expr(unsigned i) {
+        return i < m_section_exprs.size() ? m_section_exprs[i] : read(i);
+    }
+
+    /** \brief Return the module imported by the object stored in the given section if it is an import command. */
+    optional<std::string> get_import(unsigned i) {
+        return read_section(i, [](deserializer & d) {
+                std::string k;
+                d >> k;
+                return k == "import" ? optional<std::string>(d.read_string()) : optional<std::string>();
+            });
+    }
+
+    void read_object(unsigned i, environment const & env, io_state const & ios) {
+        read_section(i, [&](deserializer & d) {
                 std::string k;
                 d >> k;
-                if (k == g_olean_end_file) {
-                    if (mod_name)
-                        add_neutral_object(new end_import_mark());
-                    return true;
+                ::lean::read_object(env, ios, k, d);
+            });
+    }
+};
+
+/**
+   \brief Import scheduler: it loads a set of .olean files and their dependencies.
+
+   1- The headers of all .olean files are read, and the dependency graph is built (see \c add_module).
+   2- The shared expressions and the index of each file are read using up to \c m_import_threads threads.
+      A file is read after the dependencies whose exported expressions it uses.
+   3- The objects are added to the environment. The order is the one produced by importing the modules
+      one by one, i.e., the objects of an imported module are added at the position of its import command.
+
+   When imported modules are not type checked, the types and values of definitions, theorems, axioms and variables are only read
+   when they are needed (see \c mk_lazy_definition). Otherwise, they are read in the step 2.
+*/
+class olean_loader {
+    struct module {
+        std::string                          m_fname;
+        optional<std::string>                m_name;         // none if the file is loaded without being imported
+        std::shared_ptr<olean_file>          m_file;
+        std::vector<unsigned>                m_deps;         // dependencies that are also being loaded
+        std::vector<std::vector<expr> const *> m_tables;     // expressions exported by the dependencies whose expressions are used
+        std::vector<unsigned>                m_dependents;   // modules that use the expressions exported by this one
+        unsigned                             m_num_pending;  // dependencies in m_deps whose expressions must be read before this module
+        bool                                 m_visiting;
+        bool                                 m_skip;         // true if the index of a dependency could not be read
+        std::unique_ptr<exception>           m_error;
+        module(std::string const & fname, optional<std::string> const & n):
+            m_fname(fname), m_name(n), m_file(std::make_shared<olean_file>(fname)), m_num_pending(0),
+            m_visiting(true), m_skip(false) {}
+    };
+    environment_cell &                   m_env;
+    io_state const &                     m_ios;
+    std::vector<std::unique_ptr<module>> m_modules;
+    std::unordered_map<name, unsigned, name_hash, name_eq> m_file_to_module;
+    std::vector<unsigned>                m_roots;    // modules requested by the user
+    std::vector<unsigned>                m_order;    // a module occurs after the dependencies whose expressions it uses
+
+    /**
+       \brief Report that the file \c fname uses the expressions exported by the module \c dep, but \c dep was modified.
+       The hash code of the dependencies whose expressions are not used is not checked, since their objects are
+       referenced by name (and type checked again, unless imported modules are trusted).
+    */
+    [[ noreturn ]] static void throw_version_mismatch(std::string const & fname, std::string const & dep) {
+        throw exception(sstream() << "file '" << fname << "' was created using a different version of the module '" << dep
+                        << "', it must be recompiled");
+    }
+
+    optional<unsigned> visit(std::string const & fname, optional<std::string> const & mod_name) {
+        name file(fname);
+        if (mod_name) {
+            if (m_env.already_imported(file))
+                return optional<unsigned>();
+            auto it = m_file_to_module.find(file);
+            if (it != m_file_to_module.end())
+                return optional<unsigned>(it->second);
+        }
+        unsigned idx = m_modules.size();
+        m_modules.emplace_back(new module(fname, mod_name));
+        if (mod_name)
+            m_file_to_module.insert(std::make_pair(file, idx));
+        for (auto const & dep : m_modules[idx]->m_file->get_dependencies()) {
+            std::string dep_fname = realpath(find_file(dep.m_name, {".olean"}).c_str());
+            name dep_file(dep_fname);
+            if (m_env.already_imported(dep_file)) {
+                if (dep.m_uses_exprs) {
+                    auto info = m_env.find_module_exprs(dep_file);
+                    if (!info || info->m_hash != dep.m_hash)
+                        throw_version_mismatch(fname, dep.m_name);
+                    m_modules[idx]->m_tables.push_back(&info->m_exprs);
+                }
+            } else {
+                unsigned j = *visit(dep_fname, optional<std::string>(dep.m_name));
+                module & d = *m_modules[j];
+                if (dep.m_uses_exprs && d.m_file->get_hash() != dep.m_hash)
+                    throw_version_mismatch(fname, dep.m_name);
+                if (d.m_visiting) {
+                    // circular dependency, the module is ignored as in nested imports of a module being imported
+                    if (dep.m_uses_exprs)
+                        throw exception(sstream() << "file '" << fname << "' uses the module '" << dep.m_name << "' that depends on it");
+                    continue;
+                }
+                m_modules[idx]->m_deps.push_back(j);
+                if (dep.m_uses_exprs) {
+                    m_modules[idx]->m_tables.push_back(&d.m_file->get_exprs());
+                    m_modules[idx]->m_num_pending++;
+                    d.m_dependents.push_back(idx);
                 }
-                read_object(env(), ios, k, d);
             }
+        }
+        m_modules[idx]->m_visiting = false;
+        m_order.push_back(idx);
+        return optional<unsigned>(idx);
+    }
+
+    void read_index(unsigned i, bool prefetch) {
+        module & m = *m_modules[i];
+        if (m.m_skip)
+            return;
+        try {
+            m.m_file->read_index(m.m_tables, prefetch);
+        } catch (exception & ex) {
+            m.m_error.reset(ex.clone());
+        } catch (std::exception & ex) {
+            m.m_error.reset(new exception(ex.what()));
+        }
+    }
+
+    /** \brief Update the modules that use the expressions exported by \c i, and store in \c ready the ones that can be read. */
+    void finished(unsigned i, std::vector<unsigned> & ready) {
+        module const & m = *m_modules[i];
+        for (unsigned j : m.m_dependents) {
+            if (m.m_error || m.m_skip)
+                m_modules[j]->m_skip = true;
+            if (--m_modules[j]->m_num_pending == 0)
+                ready.push_back(j);
+        }
+    }
+
+    void read_indices(bool prefetch) {
+        unsigned num_threads = std::min(m_env.m_import_threads, static_cast<unsigned>(m_modules.size()));
+#if defined(LEAN_MULTI_THREAD)
+        if (num_threads > 1) {
+            mutex                 mtx;
+            condition_variable    cv;
+            std::vector<unsigned> ready;
+            unsigned              num_done = 0;
+            for (unsigned i : m_order) {
+                if (m_modules[i]->m_num_pending == 0)
+                    ready.push_back(i);
+            }
+            auto worker = [&]() {
+                unique_lock<mutex> lock(mtx);
+                while (true) {
+                    while (ready.empty() && num_done < m_modules.size())
+                        cv.wait(lock);
+                    if (ready.empty())
+                        return;
+                    unsigned i = ready.back();
+                    ready.pop_back();
+                    lock.unlock();
+                    read_index(i, prefetch);
+                    lock.lock();
+                    num_done++;
+                    finished(i, ready);
+                    cv.notify_all();
+                }
+            };
+            std::vector<std::unique_ptr<interruptible_thread>> threads;
+            for (unsigned i = 0; i < num_threads; i++)
+                threads.emplace_back(new interruptible_thread([&]() { worker(); }));
+            for (auto & t : threads)
+                t->join();
+            return;
+        }
+#endif
+        std::vector<unsigned> ready;
+        for (unsigned i : m_order) {
+            read_index(i, prefetch);
+            finished(i, ready);
+        }
+    }
+
+    /** \brief Return the dependency of the module \c idx named \c mod_name, if it is being loaded. */
+    optional<unsigned> find_dep(unsigned idx, std::string const & mod_name) const {
+        for (unsigned j : m_modules[idx]->m_deps) {
+            if (m_modules[j]->m_name && *m_modules[j]->m_name == mod_name)
+                return optional<unsigned>(j);
+        }
+        return optional<unsigned>();
+    }
+
+    /**
+       \brief Add the objects of the given module (and its dependencies) to the environment.
+       A module imported by \c idx is added at the position of the import command, as in importing the file directly.
+       Thus, the objects declared before an import command precede the objects of the imported module.
+    */
+    void commit(unsigned idx, bool lazy) {
+        module & m = *m_modules[idx];
+        if (m.m_name && !m_env.mark_imported_core(name(m.m_fname)))
+            return;
+        if (m.m_name)
+            m_env.add_neutral_object(new import_command(*m.m_name));
+        try {
+            olean_file & file = *m.m_file;
+            if (m.m_name)
+                m_env.m_module_exprs.push_back(environment_cell::module_exprs{name(m.m_fname), *m.m_name, file.get_hash(), file.get_exprs()});
+            unsigned i = 0;
+            for (auto const & e : file.get_entries()) {
+                olean_entry_kind k = e.m_kind;
+                name const & n     = e.m_name;
+                if (k == olean_entry_kind::Object) {
+                    optional<std::string> mod_name = file.get_import(i);
+                    optional<unsigned> dep = mod_name ? find_dep(idx, *mod_name) : optional<unsigned>();
+                    if (dep)
+                        commit(*dep, lazy);
+                    else
+                        file.read_object(i, m_env.env(), m_ios);
+                } else if (lazy) {
+                    m_env.check_name(n);
+                    switch (k) {
+                    case olean_entry_kind::Definition: m_env.register_named_object(mk_lazy_definition(n, e.m_weight, m.m_file, i, i+1)); break;
+                    case olean_entry_kind::Theorem:    m_env.register_named_object(mk_lazy_theorem(n, m.m_file, i, i+1)); break;
+                    case olean_entry_kind::Axiom:      m_env.register_named_object(mk_lazy_axiom(n, m.m_file, i)); break;
+                    case olean_entry_kind::VarDecl:    m_env.register_named_object(mk_lazy_var_decl(n, m.m_file, i)); break;
+                    case olean_entry_kind::Object:     lean_unreachable(); // LCOV_EXCL_LINE
+                    }
+                } else {
+                    switch (k) {
+                    case olean_entry_kind::Definition: m_env.add_definition(n, file.get_section_expr(i), file.get_section_expr(i+1)); break;
+                    case olean_entry_kind::Theorem:    m_env.add_theorem(n, file.get_section_expr(i), file.get_section_expr(i+1)); break;
+                    case olean_entry_kind::Axiom:      m_env.add_axiom(n, file.get_section_expr(i)); break;
+                    case olean_entry_kind::VarDecl:    m_env.add_var(n, file.get_section_expr(i)); break;
+                    case olean_entry_kind::Object:     lean_unreachable(); // LCOV_EXCL_LINE
+                    }
+                }
+                i += get_num_sections(k);
+            }
+            // the dependencies that are not imported by the module itself (e.g., modules whose expressions are used)
+            for (unsigned j : m.m_deps)
+                commit(j, lazy);
+            if (m.m_name)
+                m_env.add_neutral_object(new end_import_mark());
         } catch (...) {
-            if (mod_name)
-                add_neutral_object(new end_import_mark());
+            if (m.m_name)
+                m_env.add_neutral_object(new end_import_mark());
             throw;
         }
-    } else {
-        return false;
     }
+
+public:
+    olean_loader(environment_cell & env, io_state const & ios):m_env(env), m_ios(ios) {}
+
+    /** \brief Add the given module and its dependencies. */
+    void add_module(std::string const & mod_name) {
+        if (auto i = visit(realpath(find_file(mod_name, {".olean"}).c_str()), optional<std::string>(mod_name)))
+            m_roots.push_back(*i);
+    }
+
+    /** \brief Add the given file and its dependencies. The objects in the file are not marked as imported. */
+    void add_file(std::string const & fname) {
+        m_roots.push_back(*visit(fname, optional<std::string>()));
+    }
+
+    /** \brief Load the modules and files added to the loader. Return true iff there is at least one. */
+    bool operator()() {
+        bool lazy = !m_env.m_type_check;
+        read_indices(!lazy);
+        for (unsigned i : m_order) {
+            if (m_modules[i]->m_error)
+                m_modules[i]->m_error->rethrow();
+        }
+        for (unsigned i : m_roots)
+            commit(i, lazy);
+        return !m_roots.empty();
+    }
+};
+
+bool environment_cell::import(std::vector<std::string> const & fnames, io_state const & ios) {
+    flet<bool> set(m_type_check, !m_trust_imported);
+    olean_loader loader(*this, ios);
+    for (std::string const & fname : fnames)
+        loader.add_module(fname);
+    return loader();
 }
 
 bool environment_cell::import(std::string const & fname, io_state const & ios) {
-    flet<bool> set(m_type_check, !m_trust_imported);
-    return load_core(realpath(find_file(fname, {".olean"}).c_str()), ios, optional<std::string>(fname));
+    return import(std::vector<std::string>({fname}), ios);
 }
 
 void environment_cell::load(std::string const & fname, io_state const & ios) {
-    load_core(fname, ios, optional<std::string>());
+    olean_loader loader(*this, ios);
+    loader.add_file(fname);
+    loader();
+}
+
+void environment_cell::set_import_threads(unsigned n) {
+    m_import_threads = std::max(n, 1u);
 }
 
 bool environment_cell::imported(std::string const & n) const {
@@ -650,17 +1331,22 @@ bool environment_cell::imported(std::string const & n) const {
 }
 
 environment_cell::environment_cell():
-    m_num_children(0) {
+    m_num_children(0),
+    m_normal_forms(new normal_form_cache()) {
     m_trust_imported = false;
     m_type_check     = true;
+    m_import_threads = hardware_concurrency();
     init_uvars();
 }
 
 environment_cell::environment_cell(std::shared_ptr<environment_cell> const & parent):
     m_num_children(0),
-    m_parent(parent) {
+    m_parent(parent),
+    m_object_dictionary(parent->m_object_dictionary),
+    m_normal_forms(new normal_form_cache()) {
     m_trust_imported = false;
     m_type_check     = true;
+    m_import_threads = hardware_concurrency();
     parent->inc_children();
 }
 
@@ -14,6 +14,7 @@ Author: Leonardo de Moura
 #include "util/lua.h"
 #include "util/shared_mutex.h"
 #include "util/name_map.h"
+#include "util/hamt.h"
 #include "kernel/context.h"
 #include "kernel/object.h"
 #include "kernel/level.h"
@@ -32,7 +33,16 @@ class environment_cell {
     friend class read_write_shared_environment;
     friend class read_only_shared_environment;
     // Remark: only named objects are stored in the dictionary.
-    typedef name_map<object> object_dictionary;
+    struct object_entry {
+        object                   m_object;
+        environment_cell const * m_owner; // environment where the object was declared
+        object_entry(object const & obj, environment_cell const * owner):m_object(obj), m_owner(owner) {}
+    };
+    // Remark: the dictionary of a child environment is a copy of the dictionary of its parent
+    // extended with the objects declared in the child. Since the parent is read-only while it
+    // has children, and the dictionary is a persistent map, the copy is O(1) and lookups do not
+    // depend on the number of ancestors.
+    typedef hamt<name, object_entry, name_hash, name_eq> object_dictionary;
     typedef std::tuple<level, level, int> constraint;
     std::weak_ptr<environment_cell>         m_this;
     // Universe variable management
@@ -45,10 +55,23 @@ class environment_cell {
     object_dictionary                       m_object_dictionary;
     std::unique_ptr<type_checker>           m_type_checker;
     std::set<name>                          m_imported_modules;   // set of imported files and builtin modules
+    // Expressions exported by a module imported from a .olean file. The .olean files of the modules
+    // that import it refer to them instead of storing copies.
+    struct module_exprs {
+        name              m_file; // real path of the .olean file
+        std::string       m_name; // name used to import the module
+        unsigned          m_hash; // hash code of the contents of the .olean file
+        std::vector<expr> m_exprs;
+    };
+    std::vector<module_exprs>               m_module_exprs;
     bool                                    m_trust_imported; // if true, then imported modules are not type checked.
     bool                                    m_type_check;     // auxiliary flag used to implement m_trust_imported.
+    unsigned                                m_import_threads; // number of threads used to read .olean files
     std::vector<std::unique_ptr<environment_extension>> m_extensions;
     friend class environment_extension;
+    // Normalized values of the definitions declared in this environment
+    class normal_form_cache;
+    std::unique_ptr<normal_form_cache>      m_normal_forms;
 
     // This mutex is only used to implement threadsafe environment objects
     // in the external APIs
@@ -68,6 +91,7 @@ class environment_cell {
 
     void register_named_object(object const & new_obj);
     optional<object> get_object_core(name const & n) const;
+    environment_cell const * get_owner(name const & n) const;
 
     universes & get_rw_universes();
     universes const & get_ro_universes() const;
@@ -83,9 +107,11 @@ class environment_cell {
     void check_type(name const & n, expr const & t, expr const & v);
     void check_new_definition(name const & n, expr const & t, expr const & v);
 
+    friend class olean_loader;
     bool mark_imported_core(name n);
-    bool load_core(std::string const & fname, io_state const & ios, optional<std::string> const & mod_name);
     bool already_imported(name const & n) const;
+    void get_module_exprs(std::vector<module_exprs const *> & r) const;
+    module_exprs const * find_module_exprs(name const & file) const;
     /** \brief Return true iff the given file was not already marked as imported. It will also mark the file as imported. */
     bool mark_imported(char const * fname);
 
@@ -230,6 +256,19 @@ public:
     */
     expr normalize(expr const & e, context const & ctx = context(), bool unfold_opaque = false) const;
 
+    /**
+       \brief Return the normal form of the definition \c n stored using \c set_cached_normal_form.
+       The cache is shared by all normalizers (and type checkers) built on this environment and its children.
+       All entries are discarded when \c set_opaque is used.
+    */
+    optional<expr> get_cached_normal_form(name const & n, bool unfold_opaque) const;
+    /**
+       \brief Store the normal form \c v of the definition \c n. It must be a closed expression in normal form
+       (i.e., it must not contain transient values created by a normalizer such as closures).
+       The cache is stored in the environment (or ancestor) where \c n was declared.
+    */
+    void set_cached_normal_form(name const & n, bool unfold_opaque, expr const & v) const;
+
     /**
        \brief Return true iff \c e is a proposition.
     */
@@ -330,6 +369,14 @@ public:
 
     void export_objects(std::string const & fname);
     bool import(std::string const & fname, io_state const & ios);
+    /**
+       \brief Import the given modules. Return true iff at least one of them was not already imported.
+
+       The .olean files of the modules and of their dependencies are read in parallel (see \c set_import_threads).
+       Then, their objects are added to the environment in the same order they are added by importing
+       the modules one by one.
+    */
+    bool import(std::vector<std::string> const & fnames, io_state const & ios);
     void load(std::string const & fname, io_state const & ios);
     /** \brief Return true iff module \c n has already been imported */
     bool imported(std::string const & n) const;
@@ -340,6 +387,9 @@ public:
     */
     void set_trusted_imported(bool flag);
 
+    /** \brief Set the maximum number of threads used to read .olean files. The default is the number of hardware threads. */
+    void set_import_threads(unsigned n);
+
     /**
        \brief Execute function \c fn. Any object created by \c fn
        is not exported by the environment.
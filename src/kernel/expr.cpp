@@ -9,7 +9,13 @@ Author: Leonardo de Moura
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <limits>
+#include <unordered_set>
+#include <unordered_map>
+#include <utility>
 #include "util/hash.h"
+#include "util/pair.h"
+#include "util/exception.h"
 #include "util/buffer.h"
 #include "util/object_serializer.h"
 #include "kernel/expr.h"
@@ -18,6 +24,10 @@ Author: Leonardo de Moura
 #include "kernel/metavar.h"
 #include "kernel/max_sharing.h"
 
+#ifndef LEAN_INTERN_TABLE_NUM_SHARDS
+#define LEAN_INTERN_TABLE_NUM_SHARDS 64
+#endif
+
 namespace lean {
 static expr g_dummy(mk_var(0));
 expr::expr():expr(g_dummy) {}
@@ -39,8 +49,9 @@ unsigned hash_args(unsigned size, expr const * args) {
 }
 
 expr_cell::expr_cell(expr_kind k, unsigned h, bool has_mv):
-    m_kind(static_cast<unsigned>(k)),
-    m_flags(has_mv ? 4 : 0),
+    m_kind(static_cast<unsigned char>(k)),
+    m_flags(has_mv ? 2 : 0),
+    m_depth(1),
     m_hash(h),
     m_rc(0) {
     // m_hash_alloc does not need to be a unique identifier.
@@ -69,8 +80,8 @@ void expr_cell::dec_ref(optional<expr> & c, buffer<expr_cell*> & todelete) {
 }
 
 optional<bool> expr_cell::is_arrow() const {
-    // it is stored in bits 3-4
-    unsigned r = (m_flags & (8+16)) >> 3;
+    // it is stored in bits 2-3
+    unsigned r = (m_flags & (4+8)) >> 2;
     if (r == 0) {
         return optional<bool>();
     } else if (r == 1) {
@@ -82,7 +93,7 @@ optional<bool> expr_cell::is_arrow() const {
 }
 
 void expr_cell::set_is_arrow(bool flag) {
-    unsigned mask = flag ? 8 : 16;
+    unsigned char mask = flag ? 4 : 8;
     m_flags |= mask;
     lean_assert(is_arrow() && *is_arrow() == flag);
 }
@@ -100,6 +111,164 @@ void expr_const::dealloc(buffer<expr_cell*> & todelete) {
     delete(this);
 }
 
+#ifndef LEAN_BINDER_NAME_TABLE_MIN_RECLAIM_SIZE
+#define LEAN_BINDER_NAME_TABLE_MIN_RECLAIM_SIZE 1024
+#endif
+
+constexpr unsigned g_binder_chunk_bits = 12;
+constexpr unsigned g_binder_chunk_size = 1u << g_binder_chunk_bits;
+constexpr unsigned g_max_binder_chunks = 1u << 16;
+/**
+   \brief Entry of the table of binder names. The reference counter is the number of cells
+   (and thread local cache entries, see intern_binder_name) using the entry.
+*/
+struct binder_name_entry {
+    name             m_name;
+    atomic<unsigned> m_rc;
+    binder_name_entry():m_rc(0) {}
+};
+/**
+   \brief The binder names are stored in chunks that are never moved or deleted.
+   An entry is only reused after its reference counter is zero. So, get_binder_name does not need any synchronization.
+*/
+static binder_name_entry * g_binder_chunks[g_max_binder_chunks];
+
+static binder_name_entry & get_binder_name_entry(unsigned idx) {
+    return g_binder_chunks[idx >> g_binder_chunk_bits][idx & (g_binder_chunk_size - 1)];
+}
+
+/**
+   \brief Mapping from binder names to their indices.
+   The entries that are not used anymore are reclaimed when the number of entries reaches
+   twice the number of live entries after the previous reclamation.
+*/
+struct binder_name_table {
+    mutex                                                  m_mutex;
+    std::unordered_map<name, unsigned, name_hash, name_eq> m_index;
+    std::vector<unsigned>                                  m_free;    // reclaimed entries
+    unsigned                                               m_size;
+    unsigned                                               m_reclaim_size;
+    binder_name_table():m_size(0), m_reclaim_size(LEAN_BINDER_NAME_TABLE_MIN_RECLAIM_SIZE) {}
+
+    void reclaim() {
+        // Remark: the anonymous name at position 0 is never reclaimed.
+        for (unsigned idx = 1; idx < m_size; idx++) {
+            binder_name_entry & e = get_binder_name_entry(idx);
+            if (e.m_rc == 0 && !e.m_name.is_anonymous()) {
+                m_index.erase(e.m_name);
+                e.m_name = name();
+                m_free.push_back(idx);
+            }
+        }
+        m_reclaim_size = std::max(static_cast<unsigned>(LEAN_BINDER_NAME_TABLE_MIN_RECLAIM_SIZE),
+                                  2 * static_cast<unsigned>(m_index.size()));
+    }
+
+    /** \brief Return the index of \c n, and increment the reference counter of its entry. */
+    unsigned intern(name const & n) {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_index.find(n);
+        if (it != m_index.end()) {
+            get_binder_name_entry(it->second).m_rc++;
+            return it->second;
+        }
+        if (m_free.empty() && m_size >= m_reclaim_size)
+            reclaim();
+        unsigned idx;
+        if (!m_free.empty()) {
+            idx = m_free.back();
+            m_free.pop_back();
+        } else {
+            idx = m_size;
+            unsigned c = idx >> g_binder_chunk_bits;
+            if (c >= g_max_binder_chunks)
+                throw exception("too many binder names");
+            if (!g_binder_chunks[c])
+                g_binder_chunks[c] = new binder_name_entry[g_binder_chunk_size];
+            m_size++;
+        }
+        binder_name_entry & e = get_binder_name_entry(idx);
+        e.m_name = n;
+        e.m_rc++;
+        m_index.insert(mk_pair(n, idx));
+        return idx;
+    }
+};
+
+static binder_name_table * mk_binder_name_table() {
+    binder_name_table * t = new binder_name_table();
+    // The anonymous name has index 0, see intern_binder_name
+    t->intern(name());
+    return t;
+}
+
+static binder_name_table & get_binder_name_table() {
+    static binder_name_table * t = mk_binder_name_table();
+    return *t;
+}
+
+void release_binder_name(unsigned idx) {
+    if (idx != 0)
+        get_binder_name_entry(idx).m_rc--;
+}
+
+/**
+   \brief Small thread local cache for avoiding the mutex in the binder_name_table.
+   Each entry owns a reference to its binder name. So, a cached index cannot be reclaimed.
+   The empty entries contain the anonymous name, and it is stored at position 0.
+*/
+struct binder_name_cache_entry {
+    name     m_name;
+    unsigned m_idx = 0;
+    ~binder_name_cache_entry() { release_binder_name(m_idx); }
+};
+
+unsigned intern_binder_name(name const & n) {
+    if (n.is_anonymous())
+        return 0;
+    static LEAN_THREAD_LOCAL binder_name_cache_entry g_cache[256];
+    binder_name_cache_entry & e = g_cache[n.hash() & 255];
+    if (name::ptr_eq()(e.m_name, n)) {
+        get_binder_name_entry(e.m_idx).m_rc++;
+        return e.m_idx;
+    }
+    unsigned idx = get_binder_name_table().intern(n);
+    get_binder_name_entry(idx).m_rc++;
+    release_binder_name(e.m_idx);
+    e.m_name = n;
+    e.m_idx  = idx;
+    return idx;
+}
+
+name const & get_binder_name(unsigned idx) {
+    return get_binder_name_entry(idx).m_name;
+}
+
+unsigned get_binder_name_table_size() {
+    binder_name_table & t = get_binder_name_table();
+    lock_guard<mutex> lock(t.m_mutex);
+    return t.m_index.size();
+}
+
+/** \brief Decrement the free variable range \c r when moving to the outside of a binder. */
+static unsigned dec_range(unsigned r) { return r == 0 || r == std::numeric_limits<unsigned>::max() ? r : r - 1; }
+
+static char * alloc_app(unsigned num_args) {
+#if defined(LEAN_SMALL_OBJECT_ALLOCATOR)
+    return static_cast<char*>(alloc_small_object(sizeof(expr_app) + num_args*sizeof(expr)));
+#else
+    return new char[sizeof(expr_app) + num_args*sizeof(expr)];
+#endif
+}
+static void dealloc_app(expr_app * a, unsigned num_args) {
+#if defined(LEAN_SMALL_OBJECT_ALLOCATOR)
+    dealloc_small_object(a, sizeof(expr_app) + num_args*sizeof(expr));
+#else
+    static_cast<void>(num_args);
+    delete[] reinterpret_cast<char*>(a);
+#endif
+}
+
 expr_app::expr_app(unsigned num_args, bool has_mv):
     expr_cell(expr_kind::App, 0, has_mv),
     m_num_args(num_args) {
@@ -110,7 +279,7 @@ void expr_app::dealloc(buffer<expr_cell*> & todelete) {
         --i;
         dec_ref(m_args[i], todelete);
     }
-    delete[] reinterpret_cast<char*>(this);
+    dealloc_app(this, m_num_args);
 }
 expr mk_app(unsigned n, expr const * as) {
     lean_assert(n > 1);
@@ -125,16 +294,20 @@ expr mk_app(unsigned n, expr const * as) {
     } else {
         new_n = n;
     }
-    char * mem   = new char[sizeof(expr_app) + new_n*sizeof(expr)];
+    char * mem   = alloc_app(new_n);
     expr r(new (mem) expr_app(new_n, has_mv));
     expr * m_args = to_app(r)->m_args;
     unsigned i = 0;
     unsigned j = 0;
     unsigned depth = 0;
+    unsigned range = 0;
+    uint64   sig   = 0;
     if (new_n != n) {
         for (; i < n0; ++i) {
             new (m_args+i) expr(arg(arg0, i));
             depth = std::max(depth, get_depth(m_args[i]));
+            range = std::max(range, get_free_var_range(m_args[i]));
+            sig  |= get_const_signature(m_args[i]);
         }
         j++;
     }
@@ -142,21 +315,28 @@ expr mk_app(unsigned n, expr const * as) {
         lean_assert(j < n);
         new (m_args+i) expr(as[j]);
         depth = std::max(depth, get_depth(m_args[i]));
+        range = std::max(range, get_free_var_range(m_args[i]));
+        sig  |= get_const_signature(m_args[i]);
     }
     to_app(r)->m_hash  = hash_args(new_n, m_args);
-    to_app(r)->m_depth = depth + 1;
-    return r;
+    to_app(r)->set_depth(depth + 1);
+    to_app(r)->m_free_var_range  = range;
+    to_app(r)->m_const_signature = sig;
+    return hash_cons(std::move(r));
 }
 expr_abstraction::expr_abstraction(expr_kind k, name const & n, expr const & t, expr const & b):
     expr_cell(k, ::lean::hash(t.hash(), b.hash()), t.has_metavar() || b.has_metavar()),
-    m_name(n),
+    m_name(intern_binder_name(n)),
     m_domain(t),
     m_body(b) {
-    m_depth = 1 + std::max(get_depth(m_domain), get_depth(m_body));
+    set_depth(1 + std::max(get_depth(m_domain), get_depth(m_body)));
+    m_free_var_range  = std::max(get_free_var_range(m_domain), dec_range(get_free_var_range(m_body)));
+    m_const_signature = get_const_signature(m_domain) | get_const_signature(m_body);
 }
 void expr_abstraction::dealloc(buffer<expr_cell*> & todelete) {
     dec_ref(m_body, todelete);
     dec_ref(m_domain, todelete);
+    release_binder_name(m_name);
     delete(this);
 }
 expr_lambda::expr_lambda(name const & n, expr const & t, expr const & e):expr_abstraction(expr_kind::Lambda, n, t, e) {}
@@ -168,19 +348,27 @@ expr_type::expr_type(level const & l):
 expr_type::~expr_type() {}
 expr_let::expr_let(name const & n, optional<expr> const & t, expr const & v, expr const & b):
     expr_cell(expr_kind::Let, ::lean::hash(v.hash(), b.hash()), v.has_metavar() || b.has_metavar() || (t && t->has_metavar())),
-    m_name(n),
+    m_name(intern_binder_name(n)),
     m_type(t),
     m_value(v),
     m_body(b) {
     unsigned depth = std::max(get_depth(m_value), get_depth(m_body));
-    if (m_type)
+    unsigned range = std::max(get_free_var_range(m_value), dec_range(get_free_var_range(m_body)));
+    uint64   sig   = get_const_signature(m_value) | get_const_signature(m_body);
+    if (m_type) {
         depth = std::max(depth, get_depth(*m_type));
-    m_depth = 1 + depth;
+        range = std::max(range, get_free_var_range(*m_type));
+        sig  |= get_const_signature(*m_type);
+    }
+    set_depth(1 + depth);
+    m_free_var_range  = range;
+    m_const_signature = sig;
 }
 void expr_let::dealloc(buffer<expr_cell*> & todelete) {
     dec_ref(m_body, todelete);
     dec_ref(m_value, todelete);
     dec_ref(m_type, todelete);
+    release_binder_name(m_name);
     delete(this);
 }
 expr_let::~expr_let() {}
@@ -239,6 +427,8 @@ void expr_cell::dealloc() {
             expr_cell * it = todo.back();
             todo.pop_back();
             lean_assert(it->get_rc() == 0);
+            if (it->interned())
+                remove_interned(it);
             switch (it->kind()) {
             case expr_kind::Var:        delete static_cast<expr_var*>(it); break;
             case expr_kind::Value:      delete static_cast<expr_value*>(it); break;
@@ -257,13 +447,164 @@ void expr_cell::dealloc() {
     }
 }
 
+/**
+   \brief Equality test used to implement hash-consing.
+   The children are compared using pointer equality, and binder names are taken into account.
+*/
+struct expr_shallow_eq {
+    bool operator()(expr_cell * a, expr_cell * b) const {
+        if (a == b)
+            return true;
+        if (a->kind() != b->kind() || a->hash() != b->hash())
+            return false;
+        switch (a->kind()) {
+        case expr_kind::Var:      return var_idx(a) == var_idx(b);
+        case expr_kind::Constant: return const_name(a) == const_name(b) && is_eqp(const_type(a), const_type(b));
+        case expr_kind::Type:     return ty_level(a) == ty_level(b);
+        case expr_kind::App:
+            if (num_args(a) != num_args(b))
+                return false;
+            for (unsigned i = 0; i < num_args(a); i++)
+                if (!is_eqp(to_app(a)->get_arg(i), to_app(b)->get_arg(i)))
+                    return false;
+            return true;
+        case expr_kind::Lambda: case expr_kind::Pi:
+            return
+                is_eqp(abst_domain(a), abst_domain(b)) && is_eqp(abst_body(a), abst_body(b)) &&
+                abst_name(a) == abst_name(b);
+        case expr_kind::Let:
+            return
+                is_eqp(let_type(a), let_type(b)) && is_eqp(let_value(a), let_value(b)) && is_eqp(let_body(a), let_body(b)) &&
+                let_name(a) == let_name(b);
+        case expr_kind::Value: case expr_kind::MetaVar:
+            return false; // they are not hash-consed
+        }
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+};
+
+struct expr_cell_struct_hash { unsigned operator()(expr_cell * e) const { return e->hash(); } };
+
+/**
+   \brief Shard of the (process-wide) intern table.
+   The table does not reference its cells. A cell is removed from it when it is deleted (see expr_cell::dealloc).
+*/
+struct intern_table_shard {
+    mutex                                                                  m_mutex;
+    std::unordered_set<expr_cell *, expr_cell_struct_hash, expr_shallow_eq> m_cells;
+};
+
+static intern_table_shard & get_intern_table_shard(unsigned h) {
+    // Remark: the shards are never deleted since cells may be deleted after the static objects are destroyed.
+    static intern_table_shard * g_shards = new intern_table_shard[LEAN_INTERN_TABLE_NUM_SHARDS];
+    return g_shards[h % LEAN_INTERN_TABLE_NUM_SHARDS];
+}
+
+static atomic<unsigned> g_hash_consing_scopes(0); // number of active scopes that enabled hash-consing
+static LEAN_THREAD_LOCAL unsigned g_hash_consing_disabled = 0; // number of active scopes that disabled it in this thread
+
+bool expr_cell::try_inc_ref() {
+#if defined(LEAN_MULTI_THREAD)
+    unsigned rc = m_rc.load();
+    while (rc != 0) {
+        if (m_rc.compare_exchange_weak(rc, rc + 1))
+            return true;
+    }
+    return false;
+#else
+    if (m_rc == 0)
+        return false;
+    m_rc++;
+    return true;
+#endif
+}
+
+void expr_cell::remove_interned(expr_cell * c) {
+    intern_table_shard & s = get_intern_table_shard(c->hash());
+    lock_guard<mutex> lock(s.m_mutex);
+    auto it = s.m_cells.find(c);
+    // Remark: the entry may be a structurally equal cell that replaced \c c (see hash_cons).
+    if (it != s.m_cells.end() && *it == c)
+        s.m_cells.erase(it);
+}
+
+static bool is_max_shared(expr const & e) { return e.raw()->max_shared(); }
+static bool is_max_shared(optional<expr> const & e) { return !e || is_max_shared(*e); }
+
+/** \brief Return true iff all children of \c e are maximally shared. */
+static bool max_shared_children(expr const & e) {
+    switch (e.kind()) {
+    case expr_kind::Var: case expr_kind::Type:
+        return true;
+    case expr_kind::Constant:
+        return is_max_shared(const_type(e));
+    case expr_kind::App:
+        return std::all_of(begin_args(e), end_args(e), [](expr const & c) { return is_max_shared(c); });
+    case expr_kind::Lambda: case expr_kind::Pi:
+        return is_max_shared(abst_domain(e)) && is_max_shared(abst_body(e));
+    case expr_kind::Let:
+        return is_max_shared(let_type(e)) && is_max_shared(let_value(e)) && is_max_shared(let_body(e));
+    case expr_kind::Value: case expr_kind::MetaVar:
+        return false;
+    }
+    lean_unreachable(); // LCOV_EXCL_LINE
+}
+
+expr hash_cons(expr && e) {
+    if (!is_hash_consing_enabled() || is_value(e) || e.has_metavar())
+        return std::move(e);
+    intern_table_shard & s = get_intern_table_shard(e.hash());
+    lock_guard<mutex> lock(s.m_mutex);
+    auto it = s.m_cells.find(e.raw());
+    if (it != s.m_cells.end()) {
+        expr_cell * c = *it;
+        if (c->try_inc_ref()) {
+            expr r(c);
+            c->dec_ref_core();
+            return r;
+        }
+        // c is being deleted by another thread
+        s.m_cells.erase(it);
+    }
+    if (max_shared_children(e))
+        e.raw()->set_max_shared();
+    e.raw()->set_interned();
+    s.m_cells.insert(e.raw());
+    return std::move(e);
+}
+
+scoped_hash_consing::scoped_hash_consing(bool flag):m_flag(flag) {
+    if (m_flag)
+        g_hash_consing_scopes++;
+    else
+        g_hash_consing_disabled++;
+}
+
+scoped_hash_consing::~scoped_hash_consing() {
+    if (m_flag)
+        g_hash_consing_scopes--;
+    else
+        g_hash_consing_disabled--;
+}
+
+bool is_hash_consing_enabled() { return g_hash_consing_scopes.load() > 0 && g_hash_consing_disabled == 0; }
+unsigned get_hash_consing_table_size() {
+    unsigned r = 0;
+    for (unsigned i = 0; i < LEAN_INTERN_TABLE_NUM_SHARDS; i++) {
+        intern_table_shard & s = get_intern_table_shard(i);
+        lock_guard<mutex> lock(s.m_mutex);
+        r += s.m_cells.size();
+    }
+    return r;
+}
+
 expr mk_type() {
     static LEAN_THREAD_LOCAL expr r = mk_type(level());
     return r;
 }
 
 bool operator==(expr const & a, expr const & b) {
-    return expr_eq_fn<>()(a, b);
+    return expr_eq_fn<>(id_expr_fn(), get_expr_eq_memo())(a, b);
 }
 
 bool is_arrow(expr const & t) {
@@ -277,17 +618,38 @@ bool is_arrow(expr const & t) {
     }
 }
 
-unsigned get_depth(expr const & e) {
+unsigned get_free_var_range(expr const & e) {
     switch (e.kind()) {
-    case expr_kind::Var:   case expr_kind::Constant:  case expr_kind::Type:
-    case expr_kind::Value: case expr_kind::MetaVar:
-        return 1;
+    case expr_kind::Var:
+        return var_idx(e) + 1;
+    case expr_kind::Constant:
+        return const_type(e) ? get_free_var_range(*const_type(e)) : 0;
+    case expr_kind::Type: case expr_kind::Value:
+        return 0;
+    case expr_kind::MetaVar:
+        return std::numeric_limits<unsigned>::max();
+    case expr_kind::App:
+        return to_app(e)->m_free_var_range;
+    case expr_kind::Pi: case expr_kind::Lambda:
+        return to_abstraction(e)->m_free_var_range;
+    case expr_kind::Let:
+        return to_let(e)->m_free_var_range;
+    }
+    lean_unreachable(); // LCOV_EXCL_LINE
+}
+
+uint64 get_const_signature(expr const & e) {
+    switch (e.kind()) {
+    case expr_kind::Constant:
+        return const_type(e) ? get_name_signature(const_name(e)) | get_const_signature(*const_type(e)) : get_name_signature(const_name(e));
+    case expr_kind::Var: case expr_kind::Type: case expr_kind::Value: case expr_kind::MetaVar:
+        return 0;
     case expr_kind::App:
-        return to_app(e)->m_depth;
+        return to_app(e)->m_const_signature;
     case expr_kind::Pi: case expr_kind::Lambda:
-        return to_abstraction(e)->m_depth;
+        return to_abstraction(e)->m_const_signature;
     case expr_kind::Let:
-        return to_let(e)->m_depth;
+        return to_let(e)->m_const_signature;
     }
     lean_unreachable(); // LCOV_EXCL_LINE
 }
@@ -397,6 +759,15 @@ public:
     void write(expr const & a) {
         write_core(m_max_sharing_fn(a));
     }
+
+    /**
+        \brief Add \c a to the table as an external expression.
+        It is also added to the maximal sharing cache. Thus, structurally equal expressions are written as references to it.
+    */
+    void add(expr const & a) {
+        m_max_sharing_fn(a);
+        add_external(a);
+    }
 };
 
 class expr_deserializer : public object_deserializer<expr> {
@@ -485,4 +856,24 @@ serializer & operator<<(serializer & s, expr const & n) {
 expr read_expr(deserializer & d) {
     return d.get_extension<expr_deserializer>(g_expr_sd.m_d_extid).read();
 }
+
+void add_exprs(serializer & s, unsigned num, expr const * es) {
+    expr_serializer & ext = s.get_extension<expr_serializer>(g_expr_sd.m_s_extid);
+    for (unsigned i = 0; i < num; i++)
+        ext.add(es[i]);
+}
+
+void add_exprs(deserializer & d, unsigned num, expr const * es) {
+    expr_deserializer & ext = d.get_extension<expr_deserializer>(g_expr_sd.m_d_extid);
+    for (unsigned i = 0; i < num; i++)
+        ext.add_external(es[i]);
+}
+
+unsigned get_num_exprs(deserializer & d) {
+    return d.get_extension<expr_deserializer>(g_expr_sd.m_d_extid).size();
+}
+
+expr const & get_expr(deserializer & d, unsigned i) {
+    return d.get_extension<expr_deserializer>(g_expr_sd.m_d_extid).get(i);
+}
 }
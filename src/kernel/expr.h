@@ -12,6 +12,7 @@ Author: Leonardo de Moura
 #include <tuple>
 #include <string>
 #include "util/thread.h"
+#include "util/int64.h"
 #include "util/lua.h"
 #include "util/rc.h"
 #include "util/name.h"
@@ -21,6 +22,7 @@ Author: Leonardo de Moura
 #include "util/optional.h"
 #include "util/serializer.h"
 #include "util/sexpr/format.h"
+#include "util/small_object_allocator.h"
 #include "kernel/level.h"
 
 namespace lean {
@@ -52,6 +54,25 @@ The main API is divided in the following sections
 ======================================= */
 class expr;
 enum class expr_kind { Value, Var, Constant, App, Lambda, Pi, Type, Let, MetaVar };
+
+#ifndef LEAN_MAX_EXPR_DEPTH
+#define LEAN_MAX_EXPR_DEPTH 65535
+#endif
+
+/**
+   \brief Return a small integer identifying the binder name \c n.
+   The binder names of abstractions and let-expressions are stored in a global table,
+   and the cells only store the index.
+   The entries of the table are reference counted, and the caller owns a reference to the
+   entry of \c n. It must be released using \c release_binder_name.
+*/
+unsigned intern_binder_name(name const & n);
+/** \brief Release a reference to the entry \c idx of the table of binder names. \see intern_binder_name */
+void release_binder_name(unsigned idx);
+/** \brief Return the binder name associated with the given index. \see intern_binder_name */
+name const & get_binder_name(unsigned idx);
+/** \brief Return the number of binder names in the global table (for testing purposes). */
+unsigned get_binder_name_table_size();
 class local_entry;
 /**
    \brief A metavariable local context is just a list of local_entries.
@@ -68,30 +89,36 @@ typedef list<local_entry> local_context;
 */
 class expr_cell {
 protected:
-    unsigned short     m_kind;
+    // Remark: kind, flags and depth are packed in a single word.
+    unsigned char         m_kind;
     // The bits of the following field mean:
     //    0    - term is maximally shared
-    //    1    - term is closed
-    //    2    - term contains metavariables
-    //    3-4  - term is an arrow (0 - not initialized, 1 - is arrow, 2 - is not arrow)
-    atomic_ushort      m_flags;
+    //    1    - term contains metavariables
+    //    2-3  - term is an arrow (0 - not initialized, 1 - is arrow, 2 - is not arrow)
+    //    4    - term is in the intern table (see hash_cons)
+    //    5-7  - (not used)
+    atomic<unsigned char> m_flags;
+    unsigned short        m_depth; // depth of the expression, it is saturated at LEAN_MAX_EXPR_DEPTH
     unsigned m_hash;       // hash based on the structure of the expression (this is a good hash for structural equality)
     unsigned m_hash_alloc; // hash based on 'time' of allocation (this is a good hash for pointer-based equality)
     MK_LEAN_RC(); // Declare m_rc counter
     void dealloc();
+    void set_depth(unsigned d) { m_depth = d < LEAN_MAX_EXPR_DEPTH ? d : LEAN_MAX_EXPR_DEPTH; }
 
     bool max_shared() const { return (m_flags & 1) != 0; }
     void set_max_shared() { m_flags |= 1; }
     friend class max_sharing_fn;
-
-    bool is_closed() const { return (m_flags & 2) != 0; }
-    void set_closed() { m_flags |= 2; }
+    bool interned() const { return (m_flags & 16) != 0; }
+    void set_interned() { m_flags |= 16; }
+    /** \brief Increment the reference counter unless it is zero, i.e., the cell is being deleted. */
+    bool try_inc_ref();
+    static void remove_interned(expr_cell * c);
+    friend expr hash_cons(expr && e);
 
     optional<bool> is_arrow() const;
     void set_is_arrow(bool flag);
     friend bool is_arrow(expr const & e);
 
-    friend class has_free_var_fn;
     static void dec_ref(expr & c, buffer<expr_cell*> & todelete);
     static void dec_ref(optional<expr> & c, buffer<expr_cell*> & todelete);
 public:
@@ -99,7 +126,15 @@ public:
     expr_kind kind() const { return static_cast<expr_kind>(m_kind); }
     unsigned  hash() const { return m_hash; }
     unsigned  hash_alloc() const { return m_hash_alloc; }
-    bool has_metavar() const { return (m_flags & 4) != 0; }
+    unsigned  depth() const { return m_depth; }
+    bool has_metavar() const { return (m_flags & 2) != 0; }
+#if defined(LEAN_SMALL_OBJECT_ALLOCATOR)
+    // Expression cells are allocated using the thread-caching small object allocator.
+    static void * operator new(size_t sz) { return alloc_small_object(sz); }
+    static void * operator new(size_t, void * mem) { return mem; }
+    static void operator delete(void * ptr, size_t sz) { dealloc_small_object(ptr, sz); }
+    static void operator delete(void *, void *) {}
+#endif
 };
 /**
    \brief Exprs for encoding formulas/expressions, types and proofs.
@@ -111,6 +146,7 @@ private:
     friend class expr_cell;
     expr_cell * steal_ptr() { expr_cell * r = m_ptr; m_ptr = nullptr; return r; }
     friend class optional<expr>;
+    friend expr hash_cons(expr && e);
 public:
     /**
       \brief The default constructor creates a reference to a "dummy"
@@ -197,15 +233,21 @@ public:
     name const & get_name() const { return m_name; }
     optional<expr> const & get_type() const { return m_type; }
 };
-/** \brief Function Applications */
+/**
+   \brief Function Applications
+
+   \remark The arguments are stored in the cell, which is allocated with space for exactly \c m_num_args expressions.
+*/
 class expr_app : public expr_cell {
-    unsigned m_depth;
+    unsigned m_free_var_range;
     unsigned m_num_args;
+    uint64   m_const_signature;
     expr     m_args[0];
     friend expr mk_app(unsigned num_args, expr const * args);
     friend expr_cell;
     void dealloc(buffer<expr_cell*> & todelete);
-    friend unsigned get_depth(expr const & e);
+    friend unsigned get_free_var_range(expr const & e);
+    friend uint64 get_const_signature(expr const & e);
 public:
     expr_app(unsigned size, bool has_mv);
     unsigned     get_num_args() const        { return m_num_args; }
@@ -215,16 +257,18 @@ public:
 };
 /** \brief Super class for lambda abstraction and pi (functional spaces). */
 class expr_abstraction : public expr_cell {
-    unsigned m_depth;
-    name     m_name;
+    unsigned m_free_var_range;
+    unsigned m_name;   // index in the table of binder names
+    uint64   m_const_signature;
     expr     m_domain;
     expr     m_body;
     friend class expr_cell;
     void dealloc(buffer<expr_cell*> & todelete);
-    friend unsigned get_depth(expr const & e);
+    friend unsigned get_free_var_range(expr const & e);
+    friend uint64 get_const_signature(expr const & e);
 public:
     expr_abstraction(expr_kind k, name const & n, expr const & t, expr const & e);
-    name const & get_name() const   { return m_name; }
+    name const & get_name() const   { return get_binder_name(m_name); }
     expr const & get_domain() const { return m_domain; }
     expr const & get_body() const   { return m_body; }
 };
@@ -240,18 +284,20 @@ public:
 };
 /** \brief Let expressions */
 class expr_let : public expr_cell {
-    unsigned       m_depth;
-    name           m_name;
+    unsigned       m_free_var_range;
+    unsigned       m_name;   // index in the table of binder names
+    uint64         m_const_signature;
     optional<expr> m_type;
     expr           m_value;
     expr           m_body;
     friend class expr_cell;
     void dealloc(buffer<expr_cell*> & todelete);
-    friend unsigned get_depth(expr const & e);
+    friend unsigned get_free_var_range(expr const & e);
+    friend uint64 get_const_signature(expr const & e);
 public:
     expr_let(name const & n, optional<expr> const & t, expr const & v, expr const & b);
     ~expr_let();
-    name const & get_name() const           { return m_name; }
+    name const & get_name() const           { return get_binder_name(m_name); }
     optional<expr> const & get_type() const { return m_type; }
     expr const & get_value() const          { return m_value; }
     expr const & get_body() const           { return m_body; }
@@ -403,11 +449,52 @@ inline bool is_metavar(expr const & e)     { return e.kind() == expr_kind::MetaV
 inline bool is_abstraction(expr const & e) { return is_lambda(e) || is_pi(e); }
 // =======================================
 
+// =======================================
+// Hash-consing
+/**
+   \brief If hash-consing is enabled in the current thread, then return a live cell that
+   is identical to \c e (modulo pointer equality of its children), if there is one.
+   Otherwise, return \c e.
+
+   \remark Binder names are taken into account, so alpha-equivalent terms are not
+   collapsed, and pretty printing is not affected.
+   \remark Semantic attachments (i.e., values), metavariables and expressions containing them
+   are not hash-consed.
+*/
+expr hash_cons(expr && e);
+/**
+   \brief If \c flag is true, enable hash-consing in all threads while this object is alive.
+   Otherwise, disable it in the current thread.
+
+   When hash-consing is enabled, the constructors \c mk_var, \c mk_constant, \c mk_app,
+   \c mk_lambda, \c mk_pi, \c mk_let and \c mk_type look up an identical cell in a
+   process-wide intern table, and return it instead of the new one. So, identical
+   expressions built in this mode are pointer equal, and
+   <tt>operator==</tt> succeeds on its \c is_eqp fast path.
+   Cells whose children are all maximally shared are marked as maximally shared.
+   Remark: \c max_sharing_fn does not visit these cells, so hash-consed terms that are
+   only equal modulo binder names are not merged by it.
+
+   The intern table does not keep its cells alive: a cell is removed from it when it is deleted.
+   The table is split in shards protected by their own mutexes.
+*/
+class scoped_hash_consing {
+    bool m_flag;
+public:
+    scoped_hash_consing(bool flag = true);
+    ~scoped_hash_consing();
+};
+/** \brief Return true iff hash-consing is enabled in the current thread. */
+bool is_hash_consing_enabled();
+/** \brief Return the number of expressions in the intern table. */
+unsigned get_hash_consing_table_size();
+// =======================================
+
 // =======================================
 // Constructors
-inline expr mk_var(unsigned idx) { return expr(new expr_var(idx)); }
+inline expr mk_var(unsigned idx) { return hash_cons(expr(new expr_var(idx))); }
 inline expr Var(unsigned idx) { return mk_var(idx); }
-inline expr mk_constant(name const & n, optional<expr> const & t) { return expr(new expr_const(n, t)); }
+inline expr mk_constant(name const & n, optional<expr> const & t) { return hash_cons(expr(new expr_const(n, t))); }
 inline expr mk_constant(name const & n, expr const & t) { return mk_constant(n, some_expr(t)); }
 inline expr mk_constant(name const & n) { return mk_constant(n, none_expr()); }
 inline expr Const(name const & n) { return mk_constant(n); }
@@ -420,15 +507,17 @@ inline expr mk_app(expr const & e1, expr const & e2) { return mk_app({e1, e2});
 inline expr mk_app(expr const & e1, expr const & e2, expr const & e3) { return mk_app({e1, e2, e3}); }
 inline expr mk_app(expr const & e1, expr const & e2, expr const & e3, expr const & e4) { return mk_app({e1, e2, e3, e4}); }
 inline expr mk_app(expr const & e1, expr const & e2, expr const & e3, expr const & e4, expr const & e5) { return mk_app({e1, e2, e3, e4, e5}); }
-inline expr mk_lambda(name const & n, expr const & t, expr const & e) { return expr(new expr_lambda(n, t, e)); }
-inline expr mk_pi(name const & n, expr const & t, expr const & e) { return expr(new expr_pi(n, t, e)); }
+inline expr mk_lambda(name const & n, expr const & t, expr const & e) { return hash_cons(expr(new expr_lambda(n, t, e))); }
+inline expr mk_pi(name const & n, expr const & t, expr const & e) { return hash_cons(expr(new expr_pi(n, t, e))); }
 inline bool is_default_arrow_var_name(name const & n) { return n == "a"; }
 inline expr mk_arrow(expr const & t, expr const & e) { return mk_pi(name("a"), t, e); }
 inline expr operator>>(expr const & t, expr const & e) { return mk_arrow(t, e); }
-inline expr mk_let(name const & n, optional<expr> const & t, expr const & v, expr const & e) { return expr(new expr_let(n, t, v, e)); }
+inline expr mk_let(name const & n, optional<expr> const & t, expr const & v, expr const & e) {
+    return hash_cons(expr(new expr_let(n, t, v, e)));
+}
 inline expr mk_let(name const & n, expr const & t, expr const & v, expr const & e) { return mk_let(n, some_expr(t), v, e); }
 inline expr mk_let(name const & n, expr const & v, expr const & e) { return mk_let(n, none_expr(), v, e); }
-inline expr mk_type(level const & l) { return expr(new expr_type(l)); }
+inline expr mk_type(level const & l) { return hash_cons(expr(new expr_type(l))); }
        expr mk_type();
 inline expr Type(level const & l) { return mk_type(l); }
 inline expr Type() { return mk_type(); }
@@ -523,8 +612,39 @@ inline expr const &  let_value(expr const & e)            { return to_let(e)->ge
 inline expr const &  let_body(expr const & e)             { return to_let(e)->get_body(); }
 inline name const &  metavar_name(expr const & e)         { return to_metavar(e)->get_name(); }
 inline local_context const & metavar_lctx(expr const & e) { return to_metavar(e)->get_lctx(); }
-/** \brief Return the depth of the given expression */
-unsigned get_depth(expr const & e);
+/**
+   \brief Return the depth of the given expression.
+
+   \remark The depth is saturated at LEAN_MAX_EXPR_DEPTH.
+*/
+inline unsigned get_depth(expr const & e) { return e.raw()->depth(); }
+/**
+   \brief Return \c R s.t. the de Bruijn index of all loose (aka free) variables
+   occurring in \c e is in the interval <tt>[0, R)</tt>.
+   The value is computed when the expression is created.
+
+   \remark We assume that a metavariable may contain any free variable.
+   So, the result is meaningless (a very big number) when \c e contains metavariables.
+*/
+unsigned get_free_var_range(expr const & e);
+/** \brief Return the bits used to represent the constant name \c n in the (64 bit) signature of an expression. */
+inline uint64 get_name_signature(name const & n) {
+    unsigned h = n.hash();
+    return (static_cast<uint64>(1) << (h & 63)) | (static_cast<uint64>(1) << ((h >> 6) & 63));
+}
+/**
+   \brief Return a (Bloom filter) signature of the names of the constants occurring in \c e.
+   If there is a constant named \c n in \c e, then all bits of <tt>get_name_signature(n)</tt> are set.
+   The value is computed when the expression is created.
+
+   \remark The constants occurring in the local context of metavariables are not taken into account.
+*/
+uint64 get_const_signature(expr const & e);
+/** \brief Return false if there is no constant named \c n in \c e. If the result is true, \c n may occur in \c e. */
+inline bool may_contain_const(expr const & e, name const & n) {
+    uint64 s = get_name_signature(n);
+    return (get_const_signature(e) & s) == s;
+}
 
 inline bool has_metavar(expr const & e) { return e.has_metavar(); }
 // =======================================
@@ -681,6 +801,17 @@ inline expr update_const(expr const & e, optional<expr> const & t) {
 serializer & operator<<(serializer & s, expr const & e);
 expr read_expr(deserializer & d);
 inline deserializer & operator>>(deserializer & d, expr & e) { e = read_expr(d); return d; }
+/**
+   \brief Add the expressions <tt>es[0], ..., es[num-1]</tt> to the table of expressions of \c s without writing them.
+   The expressions written by \c s are then written as references to them (and to their subexpressions in \c es).
+   The same expressions must be added in the same order to the deserializer.
+*/
+void add_exprs(serializer & s, unsigned num, expr const * es);
+void add_exprs(deserializer & d, unsigned num, expr const * es);
+/** \brief Return the number of expressions in the table of expressions of \c d. */
+unsigned get_num_exprs(deserializer & d);
+/** \brief Return the expression with index \c i in the table of expressions of \c d. \pre i < get_num_exprs(d) */
+expr const & get_expr(deserializer & d, unsigned i);
 // =======================================
 
 std::ostream & operator<<(std::ostream & out, expr const & e);
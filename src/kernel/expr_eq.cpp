@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <algorithm>
+#include <utility>
+#include "util/pair.h"
+#include "kernel/expr_eq.h"
+
+namespace lean {
+expr_eq_memo::expr_eq_memo(unsigned max_size):
+    m_max_size(max_size), m_eq_hits(0), m_diff_hits(0), m_misses(0) {}
+
+optional<unsigned> expr_eq_memo::get_index(expr const & e) const {
+    auto it = m_index.find(e);
+    if (it == m_index.end())
+        return optional<unsigned>();
+    else
+        return optional<unsigned>(it->second);
+}
+
+unsigned expr_eq_memo::mk_index(expr const & e) {
+    auto it = m_index.find(e);
+    if (it != m_index.end())
+        return it->second;
+    unsigned r = m_parent.size();
+    m_parent.push_back(r);
+    m_index.insert(mk_pair(e, r));
+    return r;
+}
+
+unsigned expr_eq_memo::find(unsigned i) {
+    while (m_parent[i] != i) {
+        m_parent[i] = m_parent[m_parent[i]];
+        i = m_parent[i];
+    }
+    return i;
+}
+
+uint64_t expr_eq_memo::mk_key(unsigned i1, unsigned i2) {
+    if (i1 > i2)
+        std::swap(i1, i2);
+    return (static_cast<uint64_t>(i1) << 32) | i2;
+}
+
+optional<bool> expr_eq_memo::check(expr const & a, expr const & b) {
+    auto i1 = get_index(a);
+    auto i2 = i1 ? get_index(b) : optional<unsigned>();
+    if (i1 && i2) {
+        unsigned r1 = find(*i1);
+        unsigned r2 = find(*i2);
+        if (r1 == r2) {
+            m_eq_hits++;
+            return optional<bool>(true);
+        }
+        if (m_different.find(mk_key(r1, r2)) != m_different.end() ||
+            m_different.find(mk_key(*i1, *i2)) != m_different.end()) {
+            m_diff_hits++;
+            return optional<bool>(false);
+        }
+    }
+    m_misses++;
+    return optional<bool>();
+}
+
+void expr_eq_memo::add(expr const & a, expr const & b, bool eq) {
+    if (m_parent.size() + 2 > m_max_size || m_different.size() >= m_max_size)
+        clear();
+    unsigned r1 = find(mk_index(a));
+    unsigned r2 = find(mk_index(b));
+    if (eq) {
+        // Remark: the facts in m_different remain valid after the union
+        m_parent[r2] = r1;
+    } else {
+        m_different.insert(mk_key(r1, r2));
+    }
+}
+
+void expr_eq_memo::clear() {
+    m_index.clear();
+    m_parent.clear();
+    m_different.clear();
+}
+
+static LEAN_THREAD_LOCAL expr_eq_memo * g_expr_eq_memo = nullptr;
+
+expr_eq_memo * get_expr_eq_memo() {
+    return g_expr_eq_memo;
+}
+
+scoped_expr_eq_memo::scoped_expr_eq_memo(expr_eq_memo & m):m_old(g_expr_eq_memo) {
+    g_expr_eq_memo = &m;
+}
+
+scoped_expr_eq_memo::~scoped_expr_eq_memo() {
+    g_expr_eq_memo = m_old;
+}
+}
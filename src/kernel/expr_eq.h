@@ -5,12 +5,71 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <vector>
+#include <unordered_set>
 #include "util/interrupt.h"
+#include "util/optional.h"
 #include "kernel/expr.h"
 #include "kernel/expr_sets.h"
+#include "kernel/expr_maps.h"
+
+#ifndef LEAN_DEFAULT_EXPR_EQ_MEMO_SIZE
+#define LEAN_DEFAULT_EXPR_EQ_MEMO_SIZE 1024*16
+#endif
 
 namespace lean {
+/**
+   \brief Memo for structural equality that is preserved between calls.
+
+   The expressions known to be equal are merged using union-find over their cells,
+   and the pairs known to be different are stored in a negative cache. The memo
+   keeps the expressions alive, so pointer equality is meaningful. It is reset when it
+   contains more than \c max_size expressions or more than \c max_size pairs of different expressions.
+*/
+class expr_eq_memo {
+    expr_map<unsigned>           m_index;       // expression -> position in m_parent
+    std::vector<unsigned>        m_parent;
+    std::unordered_set<uint64_t> m_different;   // pairs of positions of expressions that are known to be different
+    unsigned                     m_max_size;
+    unsigned                     m_eq_hits;
+    unsigned                     m_diff_hits;
+    unsigned                     m_misses;
+    optional<unsigned> get_index(expr const & e) const;
+    unsigned mk_index(expr const & e);
+    unsigned find(unsigned i);
+    static uint64_t mk_key(unsigned i1, unsigned i2);
+public:
+    expr_eq_memo(unsigned max_size = LEAN_DEFAULT_EXPR_EQ_MEMO_SIZE);
+    /**
+        \brief Return <tt>some(true)</tt> if \c a and \c b are known to be equal,
+        <tt>some(false)</tt> if they are known to be different, and none otherwise.
+    */
+    optional<bool> check(expr const & a, expr const & b);
+    /** \brief Store the fact that \c a and \c b are equal (different) when \c eq is true (false). */
+    void add(expr const & a, expr const & b, bool eq);
+    void clear();
+    unsigned size() const { return m_parent.size(); }
+    unsigned get_num_different() const { return m_different.size(); }
+    unsigned get_num_eq_hits() const { return m_eq_hits; }
+    unsigned get_num_diff_hits() const { return m_diff_hits; }
+    unsigned get_num_misses() const { return m_misses; }
+};
+
+/** \brief Return the equality memo used by <tt>operator==</tt> in the current thread, or nullptr if there is none. */
+expr_eq_memo * get_expr_eq_memo();
+/**
+   \brief Use the given memo in <tt>operator==</tt> while this object is alive.
+   The previous memo (if any) is restored when it is destroyed.
+*/
+class scoped_expr_eq_memo {
+    expr_eq_memo * m_old;
+public:
+    scoped_expr_eq_memo(expr_eq_memo & m);
+    ~scoped_expr_eq_memo();
+};
+
 /** \brief Identity function for expressions. */
 struct id_expr_fn {
     expr const & operator()(expr const & e) const { return e; }
@@ -23,11 +82,32 @@ struct id_expr_fn {
    The hashcode of expressions is used to optimize the comparison when
    parameter UseHash == true. We should set UseHash to false when N
    is not the identity function.
+
+   An expr_eq_memo can be provided when N is the identity function. It is
+   used for the given pair of expressions, and for the shared subterms.
 */
 template<typename N = id_expr_fn, bool UseHash = true>
 class expr_eq_fn {
     std::unique_ptr<expr_cell_pair_set> m_eq_visited;
     N                                   m_norm;
+    expr_eq_memo *                      m_memo;
+
+    static bool use_memo(expr const & a) {
+        switch (a.kind()) {
+        case expr_kind::App: case expr_kind::Lambda: case expr_kind::Pi: case expr_kind::Let: case expr_kind::MetaVar:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool apply_memo(expr const & a, expr const & b) {
+        if (auto r = m_memo->check(a, b))
+            return *r;
+        bool r = apply_core(a, b);
+        m_memo->add(a, b, r);
+        return r;
+    }
 
     bool apply(optional<expr> const & a0, optional<expr> const & b0) {
         if (is_eqp(a0, b0))
@@ -47,13 +127,26 @@ class expr_eq_fn {
         if (a.kind() != b.kind())            return false;
         if (is_var(a))                       return var_idx(a) == var_idx(b);
         if (is_shared(a) && is_shared(b)) {
+            if (m_memo && use_memo(a)) {
+                if (auto r = m_memo->check(a, b))
+                    return *r;
+            }
             auto p = std::make_pair(a.raw(), b.raw());
             if (!m_eq_visited)
                 m_eq_visited.reset(new expr_cell_pair_set);
             if (m_eq_visited->find(p) != m_eq_visited->end())
                 return true;
             m_eq_visited->insert(p);
+            if (m_memo && use_memo(a)) {
+                bool r = apply_core(a, b);
+                m_memo->add(a, b, r);
+                return r;
+            }
         }
+        return apply_core(a, b);
+    }
+
+    bool apply_core(expr const & a, expr const & b) {
         switch (a.kind()) {
         case expr_kind::Var:      lean_unreachable(); // LCOV_EXCL_LINE
         case expr_kind::Constant: return const_name(a) == const_name(b);
@@ -84,13 +177,18 @@ class expr_eq_fn {
         lean_unreachable(); // LCOV_EXCL_LINE
     }
 public:
-    expr_eq_fn(N const & norm = N()):m_norm(norm) {
+    expr_eq_fn(N const & norm = N(), expr_eq_memo * memo = nullptr):m_norm(norm), m_memo(memo) {
         // the return type of N()(e) should be expr const &
         static_assert(std::is_same<typename std::result_of<decltype(std::declval<N>())(expr const &)>::type,
                       expr const &>::value,
                       "The return type of CMP()(k1, k2) is not int.");
     }
     bool operator()(expr const & a, expr const & b) {
+        if (m_memo && !is_eqp(a, b) && a.hash() == b.hash() && a.kind() == b.kind() && use_memo(a)) {
+            // The top-level expressions are stored in the memo even when they are not shared.
+            check_system("expression equality test");
+            return apply_memo(a, b);
+        }
         return apply(a, b);
     }
     void clear() { m_eq_visited.reset(); }
@@ -13,98 +13,6 @@ Author: Leonardo de Moura
 #include "kernel/metavar.h"
 
 namespace lean {
-/**
-    \brief Functional object for checking whether a kernel expression has free variables or not.
-
-    \remark We assume that a metavariable contains free variables.
-    This is an approximation, since we don't know how the metavariable will be instantiated.
-*/
-class has_free_vars_fn {
-protected:
-    expr_cell_offset_set m_cached;
-
-    bool apply(optional<expr> const & e, unsigned offset) {
-        return e && apply(*e, offset);
-    }
-
-    bool apply(expr const & e, unsigned offset) {
-        // handle easy cases
-        switch (e.kind()) {
-        case expr_kind::Constant:
-            if (!const_type(e))
-                return false;
-            break;
-        case expr_kind::Type: case expr_kind::Value:
-            return false;
-        case expr_kind::MetaVar:
-            return true;
-        case expr_kind::Var:
-            return var_idx(e) >= offset;
-        case expr_kind::App: case expr_kind::Lambda: case expr_kind::Pi: case expr_kind::Let:
-            break;
-        }
-
-        if (e.raw()->is_closed())
-            return false;
-
-        if (offset == 0) {
-            return apply_core(e, 0);
-        } else {
-            // The apply_core(e, 0) may seem redundant, but it allows us to
-            // mark nested closed expressions.
-            return apply_core(e, 0) && apply_core(e, offset);
-        }
-    }
-
-    bool apply_core(expr const & e, unsigned offset) {
-        bool shared = false;
-        if (is_shared(e)) {
-            shared = true;
-            expr_cell_offset p(e.raw(), offset);
-            if (m_cached.find(p) != m_cached.end())
-                return false;
-        }
-
-        bool result = false;
-
-        switch (e.kind()) {
-        case expr_kind::Constant:
-            lean_assert(const_type(e));
-            result = apply(const_type(e), offset);
-            break;
-        case expr_kind::Type: case expr_kind::Value: case expr_kind::Var: case expr_kind::MetaVar:
-            // easy cases were already handled
-            lean_unreachable(); // LCOV_EXCL_LINE
-        case expr_kind::App:
-            result = std::any_of(begin_args(e), end_args(e), [=](expr const & arg){ return apply(arg, offset); });
-            break;
-        case expr_kind::Lambda:
-        case expr_kind::Pi:
-            result = apply(abst_domain(e), offset) || apply(abst_body(e), offset + 1);
-            break;
-        case expr_kind::Let:
-            result = apply(let_type(e), offset) || apply(let_value(e), offset) || apply(let_body(e), offset + 1);
-            break;
-        }
-
-        if (!result) {
-            if (offset == 0)
-                e.raw()->set_closed();
-            if (shared)
-                m_cached.insert(expr_cell_offset(e.raw(), offset));
-        }
-
-        return result;
-    }
-public:
-    has_free_vars_fn() {}
-    bool operator()(expr const & e) { return apply(e, 0); }
-};
-
-bool has_free_vars(expr const & e) {
-    return has_free_vars_fn()(e);
-}
-
 /**
    \brief Functional object for computing the range [0, R) of free variables occurring
    in an expression.
@@ -172,8 +80,8 @@ class free_var_range_fn {
             break;
         }
 
-        if (e.raw()->is_closed())
-            return 0;
+        if (!has_metavar(e))
+            return get_free_var_range(e);
 
         bool shared = false;
         if (is_shared(e)) {
@@ -227,7 +135,7 @@ unsigned free_var_range(expr const & e, ro_metavar_env const & menv) {
 }
 
 unsigned free_var_range(expr const & e) {
-    return free_var_range_fn(none_ro_menv())(e);
+    return get_free_var_range(e);
 }
 
 /**
@@ -288,8 +196,11 @@ protected:
             break;
         }
 
-        if (e.raw()->is_closed())
-            return false;
+        if (!has_metavar(e)) {
+            unsigned R = get_free_var_range(e);
+            if (R == 0 || !ge_lower(R - 1, offset))
+                return false; // all free variables occurring in \c e are smaller than m_low + offset
+        }
 
         bool shared = false;
         if (is_shared(e)) {
@@ -378,7 +289,7 @@ expr lower_free_vars(expr const & e, unsigned s, unsigned d, optional<ro_metavar
         return e;
     lean_assert(s >= d);
     lean_assert(!has_free_var(e, s-d, s, menv));
-    return replace(e, [=](expr const & e, unsigned offset) -> expr {
+    return replace_free_vars(e, s, [=](expr const & e, unsigned offset) -> expr {
             if (is_var(e) && var_idx(e) >= s + offset) {
                 lean_assert(var_idx(e) >= offset + d);
                 return mk_var(var_idx(e) - d);
@@ -407,7 +318,7 @@ context_entry lower_free_vars(context_entry const & e, unsigned s, unsigned d, r
 expr lift_free_vars(expr const & e, unsigned s, unsigned d, optional<ro_metavar_env> const & menv) {
     if (d == 0 || closed(e))
         return e;
-    return replace(e, [=](expr const & e, unsigned offset) -> expr {
+    return replace_free_vars(e, s, [=](expr const & e, unsigned offset) -> expr {
             if (is_var(e) && var_idx(e) >= s + offset) {
                 return mk_var(var_idx(e) + d);
             } else if (is_metavar(e)) {
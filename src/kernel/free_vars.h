@@ -10,8 +10,11 @@ Author: Leonardo de Moura
 namespace lean {
 /**
    \brief Return true iff the given expression has free variables.
+
+   \remark We assume that a metavariable contains free variables.
+   This is an approximation, since we don't know how the metavariable will be instantiated.
 */
-bool has_free_vars(expr const & a);
+inline bool has_free_vars(expr const & a) { return has_metavar(a) || get_free_var_range(a) > 0; }
 /**
    \brief Return true iff the given expression does not have free variables.
 */
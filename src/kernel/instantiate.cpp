@@ -6,15 +6,97 @@ Author: Leonardo de Moura
 */
 #include <algorithm>
 #include <limits>
+#include "util/hash.h"
+#include "util/thread.h"
 #include "kernel/free_vars.h"
 #include "kernel/replace_fn.h"
 #include "kernel/metavar.h"
 #include "kernel/instantiate.h"
 
 namespace lean {
+instantiate_memo::key::key(expr const & e, unsigned s, unsigned n, expr const * args):
+    m_body(e), m_offset(s), m_args(args, args + n) {
+    m_hash = hash(e.hash_alloc(), s);
+    for (unsigned i = 0; i < n; i++)
+        m_hash = hash(m_hash, args[i].hash_alloc());
+}
+
+bool instantiate_memo::key_eq::operator()(key const * k1, key const * k2) const {
+    if (!is_eqp(k1->m_body, k2->m_body) || k1->m_offset != k2->m_offset || k1->m_args.size() != k2->m_args.size())
+        return false;
+    for (unsigned i = 0; i < k1->m_args.size(); i++) {
+        if (!is_eqp(k1->m_args[i], k2->m_args[i]))
+            return false;
+    }
+    return true;
+}
+
+instantiate_memo::instantiate_memo(unsigned max_size):
+    m_max_size(max_size), m_hits(0), m_misses(0), m_evictions(0) {}
+
+optional<expr> instantiate_memo::find(expr const & e, unsigned s, unsigned n, expr const * args) {
+    key k(e, s, n, args);
+    auto it = m_index.find(&k);
+    if (it == m_index.end()) {
+        m_misses++;
+        return none_expr();
+    }
+    m_hits++;
+    // move the entry to the beginning of the list
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return some_expr(it->second->second);
+}
+
+void instantiate_memo::insert(expr const & e, unsigned s, unsigned n, expr const * args, expr const & r) {
+    m_entries.emplace_front(key(e, s, n, args), r);
+    auto p = m_index.insert(std::make_pair(&m_entries.front().first, m_entries.begin()));
+    if (!p.second) {
+        // it is already in the memo
+        m_entries.pop_front();
+        return;
+    }
+    if (m_entries.size() > m_max_size) {
+        m_index.erase(&m_entries.back().first);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
+
+void instantiate_memo::clear() {
+    m_index.clear();
+    m_entries.clear();
+}
+
+static LEAN_THREAD_LOCAL instantiate_memo * g_instantiate_memo = nullptr;
+
+instantiate_memo * get_instantiate_memo() {
+    return g_instantiate_memo;
+}
+
+scoped_instantiate_memo::scoped_instantiate_memo(instantiate_memo & m):m_old(g_instantiate_memo) {
+    g_instantiate_memo = &m;
+}
+
+scoped_instantiate_memo::~scoped_instantiate_memo() {
+    g_instantiate_memo = m_old;
+}
+
+/**
+   \brief Return true if the memo can be used for instantiating \c e with \c subst[n].
+   Cheap instantiations (small or closed terms) are not stored. Moreover, when \c menv is provided and metavariables
+   occur in \c e or \c subst, the result depends on the metavariable environment.
+*/
+static bool use_memo(expr const & e, unsigned s, unsigned n, expr const * subst, optional<ro_metavar_env> const & menv) {
+    if (get_depth(e) < LEAN_INSTANTIATE_MEMO_MIN_DEPTH || (!has_metavar(e) && get_free_var_range(e) <= s))
+        return false;
+    if (menv)
+        return !has_metavar(e) && std::none_of(subst, subst + n, [](expr const & a) { return has_metavar(a); });
+    return true;
+}
+
 template<bool ClosedSubst>
 expr instantiate_core(expr const & a, unsigned s, unsigned n, expr const * subst, optional<ro_metavar_env> const & menv) {
-    return replace(a, [=](expr const & m, unsigned offset) -> expr {
+    return replace_free_vars(a, s, [=](expr const & m, unsigned offset) -> expr {
             if (is_var(m)) {
                 unsigned vidx = var_idx(m);
                 if (vidx >= offset + s) {
@@ -42,9 +124,21 @@ expr instantiate_core(expr const & a, unsigned s, unsigned n, expr const * subst
         });
 }
 
+template<bool ClosedSubst>
+expr instantiate_memoized(expr const & a, unsigned s, unsigned n, expr const * subst, optional<ro_metavar_env> const & menv) {
+    instantiate_memo * memo = get_instantiate_memo();
+    if (!memo || !use_memo(a, s, n, subst, menv))
+        return instantiate_core<ClosedSubst>(a, s, n, subst, menv);
+    if (auto r = memo->find(a, s, n, subst))
+        return *r;
+    expr r = instantiate_core<ClosedSubst>(a, s, n, subst, menv);
+    memo->insert(a, s, n, subst, r);
+    return r;
+}
+
 expr instantiate_with_closed(expr const & a, unsigned n, expr const * s, optional<ro_metavar_env> const & menv) {
     lean_assert(std::all_of(s, s+n, [&](expr const & e) { return !has_free_var(e, 0, std::numeric_limits<unsigned>::max(), menv); }));
-    return instantiate_core<true>(a, 0, n, s, menv);
+    return instantiate_memoized<true>(a, 0, n, s, menv);
 }
 expr instantiate_with_closed(expr const & e, unsigned n, expr const * s, ro_metavar_env const & menv) { return instantiate_with_closed(e, n, s, some_ro_menv(menv)); }
 expr instantiate_with_closed(expr const & e, unsigned n, expr const * s) { return instantiate_with_closed(e, n, s, none_ro_menv()); }
@@ -54,7 +148,7 @@ expr instantiate_with_closed(expr const & e, expr const & s) { return instantiat
 expr instantiate_with_closed(expr const & e, expr const & s, ro_metavar_env const & menv) { return instantiate_with_closed(e, s, some_ro_menv(menv)); }
 
 expr instantiate(expr const & a, unsigned s, unsigned n, expr const * subst, optional<ro_metavar_env> const & menv) {
-    return instantiate_core<false>(a, s, n, subst, menv);
+    return instantiate_memoized<false>(a, s, n, subst, menv);
 }
 expr instantiate(expr const & e, unsigned n, expr const * s, optional<ro_metavar_env> const & menv) { return instantiate(e, 0, n, s, menv); }
 expr instantiate(expr const & e, unsigned n, expr const * s, ro_metavar_env const & menv) { return instantiate(e, n, s, some_ro_menv(menv)); }
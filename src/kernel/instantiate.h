@@ -5,10 +5,76 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <list>
+#include <utility>
+#include <vector>
+#include <unordered_map>
 #include "kernel/expr.h"
 
+#ifndef LEAN_DEFAULT_INSTANTIATE_MEMO_SIZE
+#define LEAN_DEFAULT_INSTANTIATE_MEMO_SIZE 1024*8
+#endif
+
+#ifndef LEAN_INSTANTIATE_MEMO_MIN_DEPTH
+#define LEAN_INSTANTIATE_MEMO_MIN_DEPTH 4
+#endif
+
 namespace lean {
 class ro_metavar_env;
+/**
+   \brief Memo for instantiate (and consequently apply_beta and head_beta_reduce) that is preserved between calls.
+
+   The entries are keyed on the cells of the body, the arguments, and the offset.
+   The memo keeps these expressions alive, so pointer equality is meaningful.
+   When it contains more than \c max_size entries, the least recently used one is evicted.
+
+   \remark The memo is only used when the result does not depend on the metavariable environment.
+*/
+class instantiate_memo {
+    struct key {
+        expr              m_body;
+        unsigned          m_offset;
+        std::vector<expr> m_args;
+        unsigned          m_hash;
+        key(expr const & e, unsigned s, unsigned n, expr const * args);
+    };
+    struct key_hash { unsigned operator()(key const * k) const { return k->m_hash; } };
+    struct key_eq { bool operator()(key const * k1, key const * k2) const; };
+    typedef std::pair<key, expr> entry;
+    typedef std::list<entry> entries;
+    // The most recently used entries are at the beginning of m_entries
+    entries                                                                  m_entries;
+    std::unordered_map<key const *, entries::iterator, key_hash, key_eq>     m_index;
+    unsigned                                                                 m_max_size;
+    unsigned                                                                 m_hits;
+    unsigned                                                                 m_misses;
+    unsigned                                                                 m_evictions;
+public:
+    instantiate_memo(unsigned max_size = LEAN_DEFAULT_INSTANTIATE_MEMO_SIZE);
+    /** \brief Return the result of <tt>instantiate(e, s, n, args)</tt> if it is in the memo. */
+    optional<expr> find(expr const & e, unsigned s, unsigned n, expr const * args);
+    /** \brief Store \c r as the result of <tt>instantiate(e, s, n, args)</tt>. */
+    void insert(expr const & e, unsigned s, unsigned n, expr const * args, expr const & r);
+    void clear();
+    unsigned size() const { return m_entries.size(); }
+    unsigned get_num_hits() const { return m_hits; }
+    unsigned get_num_misses() const { return m_misses; }
+    unsigned get_num_evictions() const { return m_evictions; }
+};
+
+/** \brief Return the memo used by instantiate in the current thread, or nullptr if there is none. */
+instantiate_memo * get_instantiate_memo();
+/**
+   \brief Use the given memo in instantiate while this object is alive.
+   The previous memo (if any) is restored when it is destroyed.
+*/
+class scoped_instantiate_memo {
+    instantiate_memo * m_old;
+public:
+    scoped_instantiate_memo(instantiate_memo & m);
+    ~scoped_instantiate_memo();
+};
+
 /**
    \brief Replace the free variables with indices 0, ..., n-1 with s[n-1], ..., s[0] in e.
 
@@ -120,7 +120,9 @@ expr metavar_env_cell::get_type(name const & m) {
         return *(it->m_type);
     } else {
         expr t = mk_metavar(get_context(m));
-        it->m_type = t;
+        data d(*m_metavar_data.find(m));
+        d.m_type = t;
+        m_metavar_data.insert(m, d);
         return t;
     }
 }
@@ -188,7 +190,9 @@ bool metavar_env_cell::assign(name const & m, expr const & t, justification cons
                             if (e_ctx_size < extra) {
                                 failed = true;
                             } else {
-                                it2->m_context = it2->m_context.truncate(e_ctx_size - extra);
+                                data d(*it2);
+                                d.m_context = d.m_context.truncate(e_ctx_size - extra);
+                                m_metavar_data.insert(metavar_name(e), d);
                                 lean_assert_le(free_var_range(e, metavar_env(this)), ctx_size + offset);
                             }
                         }
@@ -203,8 +207,10 @@ bool metavar_env_cell::assign(name const & m, expr const & t, justification cons
         return false;
     auto it = m_metavar_data.find(m);
     lean_assert(it);
-    it->m_subst         = t2;
-    it->m_justification = jst2;
+    data d(*it);
+    d.m_subst         = t2;
+    d.m_justification = jst2;
+    m_metavar_data.insert(m, d);
     return true;
 }
 
@@ -258,20 +264,23 @@ optional<std::pair<expr, justification>> metavar_env_cell::get_subst_jst(expr co
 }
 
 optional<std::pair<expr, justification>> metavar_env_cell::get_subst_jst(name const & m) const {
-    auto it = const_cast<metavar_env_cell*>(this)->m_metavar_data.find(m);
-    if (it->m_subst) {
-        expr s = *(it->m_subst);
+    auto it = m_metavar_data.find(m);
+    if (it && it->m_subst) {
+        expr s            = *(it->m_subst);
+        justification jst = it->m_justification;
+        context ctx       = it->m_context;
         if (has_assigned_metavar(s)) {
             buffer<justification> jsts;
             expr new_subst = instantiate_metavars(s, jsts);
             if (!jsts.empty()) {
-                justification new_jst(new normalize_assignment_justification(it->m_context, s, it->m_justification,
+                // Remark: the normalized substitution is not stored. So, lookups never modify the environment,
+                // and different threads can read the same environment.
+                justification new_jst(new normalize_assignment_justification(ctx, s, jst,
                                                                              jsts.size(), jsts.data()));
-                it->m_justification = new_jst;
-                it->m_subst         = new_subst;
+                return optional<std::pair<expr, justification>>(std::pair<expr, justification>(new_subst, new_jst));
             }
         }
-        return optional<std::pair<expr, justification>>(std::pair<expr, justification>(*(it->m_subst), it->m_justification));
+        return optional<std::pair<expr, justification>>(std::pair<expr, justification>(s, jst));
     } else {
         return optional<std::pair<expr, justification>>();
     }
@@ -5,10 +5,12 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <algorithm>
 #include <utility>
 #include "util/rc.h"
 #include "util/pair.h"
-#include "util/splay_map.h"
+#include "util/hamt.h"
+#include "util/buffer.h"
 #include "util/name_generator.h"
 #include "kernel/expr.h"
 #include "kernel/context.h"
@@ -32,7 +34,11 @@ class metavar_env_cell {
         justification  m_justification; // justification for assigned metavariables.
         data(optional<expr> const & t = none_expr(), context const & ctx = context()):m_type(t), m_context(ctx) {}
     };
-    typedef splay_map<name, data, name_quick_cmp> name2data;
+    /**
+        \brief The metavariable data is stored in a persistent hash map. Thus, copying a metavariable
+        environment (e.g., for backtracking) is O(1), and lookups do not modify the map.
+    */
+    typedef hamt<name, data, name_hash, name_eq> name2data;
 
     name_generator     m_name_generator;
     name2data          m_metavar_data;
@@ -162,13 +168,20 @@ public:
 
     /**
        \brief Apply f to each substitution in the metavariable environment.
+       The substitutions are visited in the order of the metavariable names (\c name_quick_cmp).
     */
     template<typename F>
     void for_each_subst(F f) const {
+        buffer<std::pair<name, expr>> substs;
         m_metavar_data.for_each([&](name const & k, data const & d) {
                 if (d.m_subst)
-                    f(k, *(d.m_subst));
+                    substs.emplace_back(k, *(d.m_subst));
+            });
+        std::sort(substs.begin(), substs.end(), [](std::pair<name, expr> const & p1, std::pair<name, expr> const & p2) {
+                return name_quick_cmp()(p1.first, p2.first) < 0;
             });
+        for (auto const & p : substs)
+            f(p.first, p.second);
     }
 
     /**
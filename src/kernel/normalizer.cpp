@@ -13,6 +13,7 @@ Author: Leonardo de Moura
 #include "util/interrupt.h"
 #include "util/sexpr/options.h"
 #include "kernel/normalizer.h"
+#include "kernel/normalizer_machine.h"
 #include "kernel/expr.h"
 #include "kernel/expr_maps.h"
 #include "kernel/context.h"
@@ -20,6 +21,7 @@ Author: Leonardo de Moura
 #include "kernel/kernel.h"
 #include "kernel/metavar.h"
 #include "kernel/free_vars.h"
+#include "kernel/find_fn.h"
 #include "kernel/instantiate.h"
 #include "kernel/kernel_exception.h"
 
@@ -27,12 +29,22 @@ Author: Leonardo de Moura
 #define LEAN_KERNEL_NORMALIZER_MAX_DEPTH std::numeric_limits<unsigned>::max()
 #endif
 
+#ifndef LEAN_KERNEL_NORMALIZER_MACHINE
+#define LEAN_KERNEL_NORMALIZER_MACHINE true
+#endif
+
 namespace lean {
 static name g_kernel_normalizer_max_depth       {"kernel", "normalizer", "max_depth"};
 RegisterUnsignedOption(g_kernel_normalizer_max_depth, LEAN_KERNEL_NORMALIZER_MAX_DEPTH, "(kernel) maximum recursion depth for expression normalizer");
+static name g_kernel_normalizer_machine         {"kernel", "normalizer", "machine"};
+RegisterBoolOption(g_kernel_normalizer_machine, LEAN_KERNEL_NORMALIZER_MACHINE,
+                   "(kernel) use an abstract machine (with explicit environments and stacks) for normalizing expressions");
 unsigned get_normalizer_max_depth(options const & opts) {
     return opts.get_unsigned(g_kernel_normalizer_max_depth, LEAN_KERNEL_NORMALIZER_MAX_DEPTH);
 }
+bool get_normalizer_machine(options const & opts) {
+    return opts.get_bool(g_kernel_normalizer_machine, LEAN_KERNEL_NORMALIZER_MACHINE);
+}
 
 typedef list<expr> value_stack;
 value_stack extend(value_stack const & s, expr const & v) {
@@ -83,6 +95,7 @@ class normalizer::imp {
     bool                     m_unfold_opaque;
     unsigned                 m_max_depth;
     unsigned                 m_depth;
+    std::unique_ptr<normalizer_machine> m_machine; // engine used when the option kernel::normalizer::machine is true (default)
 
     ro_environment env() const { return ro_environment(m_env); }
 
@@ -216,6 +229,26 @@ class normalizer::imp {
         }
     }
 
+    /**
+        \brief Return the value of the definition \c obj.
+        The value of a definition is closed. So, it does not depend on the current context and stack.
+        If it does not contain closures, then it is also the normal form of the definition, and it is stored
+        in the environment cache of normal forms. Values containing closures are not stored: closures are
+        transient values of this normalizer, and reifying them would normalize the bodies of all lambdas eagerly.
+    */
+    expr unfold(object const & obj) {
+        ro_environment env = this->env();
+        name const & n     = obj.get_name();
+        if (optional<expr> r = env->get_cached_normal_form(n, m_unfold_opaque))
+            return *r;
+        freset<cache> reset(m_cache);
+        flet<context> set(m_ctx, context());
+        expr r = normalize(obj.get_value(), value_stack(), 0);
+        if (!find(r, [](expr const & e) { return is_closure(e); }))
+            env->set_cached_normal_form(n, m_unfold_opaque, r);
+        return r;
+    }
+
     /** \brief Normalize the expression \c a in a context composed of stack \c s and \c k binders. */
     expr normalize(expr const & a, value_stack const & s, unsigned k) {
         flet<unsigned> l(m_depth, m_depth+1);
@@ -256,8 +289,7 @@ class normalizer::imp {
         case expr_kind::Constant: {
             optional<object> obj = env()->find_object(const_name(a));
             if (obj && should_unfold(*obj, m_unfold_opaque)) {
-                freset<cache> reset(m_cache);
-                r = normalize(obj->get_value(), value_stack(), 0);
+                r = unfold(*obj);
             } else {
                 r = a;
             }
@@ -331,14 +363,18 @@ class normalizer::imp {
     }
 
 public:
-    imp(ro_environment const & env, unsigned max_depth):
+    imp(ro_environment const & env, unsigned max_depth, bool use_machine):
         m_env(env) {
         m_max_depth      = max_depth;
         m_depth          = 0;
         m_unfold_opaque  = false;
+        if (use_machine)
+            m_machine.reset(new normalizer_machine(env, max_depth));
     }
 
     expr operator()(expr const & e, context const & ctx, optional<ro_metavar_env> const & menv, bool unfold_opaque) {
+        if (m_machine)
+            return (*m_machine)(e, ctx, menv, unfold_opaque);
         if (m_unfold_opaque != unfold_opaque)
             m_cache.clear();
         m_unfold_opaque = unfold_opaque;
@@ -352,9 +388,11 @@ public:
     void clear() { m_ctx = context(); m_cache.clear(); m_menv.clear(); }
 };
 
-normalizer::normalizer(ro_environment const & env, unsigned max_depth):m_ptr(new imp(env, max_depth)) {}
+normalizer::normalizer(ro_environment const & env, unsigned max_depth, bool use_machine):m_ptr(new imp(env, max_depth, use_machine)) {}
+normalizer::normalizer(ro_environment const & env, unsigned max_depth):normalizer(env, max_depth, LEAN_KERNEL_NORMALIZER_MACHINE) {}
 normalizer::normalizer(ro_environment const & env):normalizer(env, std::numeric_limits<unsigned>::max()) {}
-normalizer::normalizer(ro_environment const & env, options const & opts):normalizer(env, get_normalizer_max_depth(opts)) {}
+normalizer::normalizer(ro_environment const & env, options const & opts):
+    normalizer(env, get_normalizer_max_depth(opts), get_normalizer_machine(opts)) {}
 normalizer::~normalizer() {}
 expr normalizer::operator()(expr const & e, context const & ctx, optional<ro_metavar_env> const & menv, bool unfold_opaque) {
     return (*m_ptr)(e, ctx, menv, unfold_opaque);
@@ -21,6 +21,8 @@ class normalizer {
 public:
     normalizer(ro_environment const & env);
     normalizer(ro_environment const & env, unsigned max_depth);
+    /** \brief If \c use_machine is true, then the abstract machine engine is used, otherwise the recursive one. \see normalizer_machine */
+    normalizer(ro_environment const & env, unsigned max_depth, bool use_machine);
     normalizer(ro_environment const & env, options const & opts);
     ~normalizer();
 
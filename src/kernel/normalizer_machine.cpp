@@ -0,0 +1,607 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "util/buffer.h"
+#include "util/interrupt.h"
+#include "util/name_map.h"
+#include "kernel/normalizer_machine.h"
+#include "kernel/kernel.h"
+#include "kernel/free_vars.h"
+#include "kernel/metavar.h"
+#include "kernel/instantiate.h"
+#include "kernel/update_expr.h"
+#include "kernel/kernel_exception.h"
+
+#ifndef LEAN_NORMALIZER_MACHINE_CHUNK_SIZE
+#define LEAN_NORMALIZER_MACHINE_CHUNK_SIZE 1024
+#endif
+
+namespace lean {
+struct thunk;
+struct whnf;
+
+/**
+   \brief Environment of the machine. It is an array of thunks, and the last element
+   is the value of the variable with de Bruijn index 0.
+*/
+struct machine_env {
+    thunk ** m_data;
+    unsigned m_size;
+    machine_env():m_data(nullptr), m_size(0) {}
+    machine_env(thunk ** d, unsigned sz):m_data(d), m_size(sz) {}
+    thunk * operator[](unsigned vidx) const { lean_assert(vidx < m_size); return m_data[m_size - vidx - 1]; }
+};
+
+/**
+   \brief Weak head normal form.
+
+   - Closure: \c m_expr is a lambda, pi or metavariable that is evaluated in \c m_env and \c m_ctx.
+   - Neutral: \c m_expr is a variable, constant, type or value applied to \c m_args. Variables are
+     represented using de Bruijn levels. If \c m_head is not nullptr, then it is the closure in the
+     head of the application (e.g., a metavariable applied to arguments), and \c m_expr is not used.
+*/
+struct whnf {
+    bool        m_closure;
+    expr        m_expr;
+    machine_env m_env;
+    context     m_ctx;
+    whnf *      m_head;
+    unsigned    m_num_args;
+    thunk **    m_args;
+    whnf(expr const & e, machine_env const & env, context const & ctx):
+        m_closure(true), m_expr(e), m_env(env), m_ctx(ctx), m_head(nullptr), m_num_args(0), m_args(nullptr) {}
+    whnf(expr const & e, whnf * h, unsigned num_args, thunk ** args):
+        m_closure(false), m_expr(e), m_head(h), m_num_args(num_args), m_args(args) {}
+};
+
+/** \brief Suspended computation. It is evaluated at most once. */
+struct thunk {
+    expr        m_expr;
+    machine_env m_env;
+    context     m_ctx;
+    whnf *      m_value;
+    name        m_definition; // if not anonymous, then the thunk is the value of this definition (see mk_constant_thunk)
+    thunk(expr const & e, machine_env const & env, context const & ctx):m_expr(e), m_env(env), m_ctx(ctx), m_value(nullptr) {}
+    explicit thunk(whnf * v):m_value(v) {}
+};
+
+class normalizer_machine::imp {
+    ro_environment::weak_ref m_env;
+    context                  m_ctx;
+    cached_ro_metavar_env    m_menv;
+    bool                     m_unfold_opaque;
+    unsigned                 m_max_depth;
+    // Region for the machine objects. It is reset after each call.
+    std::deque<thunk>        m_thunks;
+    std::deque<whnf>         m_values;
+    std::vector<thunk**>     m_chunks;
+    thunk **                 m_next;
+    thunk **                 m_end;
+    std::vector<whnf*>       m_vars;   // m_vars[i] is the neutral term for the variable with de Bruijn level i
+    name_map<thunk*>         m_constants; // definitions unfolded in the current call
+
+    ro_environment env() const { return ro_environment(m_env); }
+
+    thunk ** alloc_array(unsigned n) {
+        if (n > LEAN_NORMALIZER_MACHINE_CHUNK_SIZE) {
+            thunk ** r = new thunk*[n];
+            m_chunks.push_back(r);
+            return r;
+        }
+        if (m_next + n > m_end) {
+            m_next = new thunk*[LEAN_NORMALIZER_MACHINE_CHUNK_SIZE];
+            m_end  = m_next + LEAN_NORMALIZER_MACHINE_CHUNK_SIZE;
+            m_chunks.push_back(m_next);
+        }
+        thunk ** r = m_next;
+        m_next += n;
+        return r;
+    }
+
+    void reset() {
+        m_thunks.clear();
+        m_values.clear();
+        for (thunk ** c : m_chunks)
+            delete[] c;
+        m_chunks.clear();
+        m_vars.clear();
+        m_constants.clear();
+        m_states.clear();
+        m_next = nullptr;
+        m_end  = nullptr;
+    }
+
+    /** \brief Auxiliary object for resetting the region when the normalizer is done (or an exception is thrown). */
+    struct region_scope {
+        imp & m_ref;
+        region_scope(imp & r):m_ref(r) {}
+        ~region_scope() { m_ref.reset(); }
+    };
+
+    thunk * mk_thunk(expr const & e, machine_env const & env, context const & ctx) {
+        m_thunks.emplace_back(e, env, ctx);
+        return &m_thunks.back();
+    }
+
+    thunk * mk_thunk(whnf * v) {
+        m_thunks.emplace_back(v);
+        return &m_thunks.back();
+    }
+
+    whnf * mk_closure(expr const & e, machine_env const & env, context const & ctx) {
+        m_values.emplace_back(e, env, ctx);
+        return &m_values.back();
+    }
+
+    whnf * mk_neutral(expr const & e, whnf * h = nullptr, unsigned num_args = 0, thunk ** args = nullptr) {
+        m_values.emplace_back(e, h, num_args, args);
+        return &m_values.back();
+    }
+
+    whnf * mk_var_value(unsigned level) {
+        while (m_vars.size() <= level)
+            m_vars.push_back(nullptr);
+        if (!m_vars[level])
+            m_vars[level] = mk_neutral(mk_var(level));
+        return m_vars[level];
+    }
+
+    machine_env extend(machine_env const & env, thunk * v) {
+        thunk ** data = alloc_array(env.m_size + 1);
+        std::copy(env.m_data, env.m_data + env.m_size, data);
+        data[env.m_size] = v;
+        return machine_env(data, env.m_size + 1);
+    }
+
+    /**
+        \brief Return an environment that maps the variables bound in a context containing \c k binders
+        to themselves. The variables that are not bound by binders are looked up in the main context.
+    */
+    machine_env mk_identity_env(unsigned k) {
+        unsigned n = k - m_ctx.size();
+        thunk ** data = alloc_array(n);
+        for (unsigned i = 0; i < n; i++)
+            data[i] = mk_thunk(mk_var_value(m_ctx.size() + i));
+        return machine_env(data, n);
+    }
+
+    /**
+        \brief Return the thunk for the value of the definition \c obj. The value of a definition is closed,
+        so all occurrences of \c obj share the same thunk, and it is evaluated (lazily) at most once per call.
+        If the environment cache contains the normal form of \c obj, then the thunk evaluates it instead.
+    */
+    thunk * mk_constant_thunk(object const & obj) {
+        name n = obj.get_name();
+        auto it = m_constants.find(n);
+        if (it != m_constants.end())
+            return it->second;
+        thunk * t;
+        if (optional<expr> nf = env()->get_cached_normal_form(n, m_unfold_opaque)) {
+            t = mk_thunk(*nf, machine_env(), context());
+        } else {
+            t = mk_thunk(obj.get_value(), machine_env(), context());
+            t->m_definition = n;
+        }
+        m_constants.insert(mk_pair(n, t));
+        return t;
+    }
+
+    /**
+        \brief Store \c v, the weak head normal form of the value of the definition \c n, in the environment cache
+        if it is also its normal form, and it is available without further evaluation (e.g., a numeral).
+        Other values are not stored since computing their normal forms would evaluate the definition eagerly.
+    */
+    void cache_definition_value(name const & n, whnf const * v) {
+        if (!v->m_closure && !v->m_head && v->m_num_args == 0 && !is_var(v->m_expr))
+            env()->set_cached_normal_form(n, m_unfold_opaque, v->m_expr);
+    }
+
+    void check_depth(unsigned d) {
+        if (d > m_max_depth)
+            throw kernel_exception(env(), "normalizer maximum recursion depth exceeded");
+    }
+
+    /** \brief Update frame: thunk to be updated, number of pending arguments and nesting depth when the frame was created. */
+    struct update_frame {
+        thunk *  m_thunk;
+        unsigned m_num_args;
+        unsigned m_depth;
+        update_frame(thunk * t, unsigned n, unsigned d):m_thunk(t), m_num_args(n), m_depth(d) {}
+    };
+
+    static bool is_lambda_closure(whnf const * v) { return v->m_closure && is_lambda(v->m_expr); }
+
+    /** \brief Return true iff \c v is a value applied to arguments. A semantic attachment may be applicable. */
+    static bool is_value_app(whnf const * v) { return !v->m_closure && !v->m_head && v->m_num_args > 0 && is_value(v->m_expr); }
+
+    /**
+        \brief Apply the weak head normal form \c v to the arguments <tt>S[base], ..., S[S.size() - 1]</tt>.
+        The first argument is at the top of the stack. The arguments are removed from \c S.
+        \pre \c v is not a lambda closure.
+    */
+    whnf * apply_neutral(whnf * v, buffer<thunk*> & S, unsigned base) {
+        unsigned n = S.size() - base;
+        unsigned old_n = v->m_closure ? 0 : v->m_num_args;
+        thunk ** args = alloc_array(old_n + n);
+        if (old_n > 0)
+            std::copy(v->m_args, v->m_args + old_n, args);
+        for (unsigned i = 0; i < n; i++)
+            args[old_n + i] = S[S.size() - i - 1];
+        S.shrink(base);
+        if (v->m_closure)
+            return mk_neutral(expr(), v, n, args);
+        else
+            return mk_neutral(v->m_expr, v->m_head, old_n + n, args);
+    }
+
+    /**
+        \brief State of the evaluation of a thunk to weak head normal form.
+        The evaluation is suspended when a semantic attachment may be applicable, since attachments are applied
+        to normalized arguments. The arguments are normalized by the main loop (see \c normalize), and then the
+        evaluation is resumed (see \c apply_attachment).
+    */
+    struct eval_state {
+        buffer<update_frame> m_K;     // update frames
+        buffer<thunk*>       m_S;     // pending arguments, the first argument is at the top
+        expr                 m_expr;  // expression being evaluated in m_env and m_ctx
+        machine_env          m_env;
+        context              m_ctx;
+        whnf *               m_value; // if not nullptr, then the evaluation resumes with this weak head normal form
+        unsigned             m_k;     // number of binders in the context
+        unsigned             m_depth; // nesting depth of the evaluation
+        eval_state(thunk * t, unsigned k, unsigned d):
+            m_expr(t->m_expr), m_env(t->m_env), m_ctx(t->m_ctx), m_value(nullptr), m_k(k), m_depth(d) {
+            m_K.emplace_back(t, 0, d);
+        }
+    };
+    std::deque<eval_state> m_states; // evaluations in progress, they are suspended except for the last one
+
+    /**
+        \brief Increment the nesting depth of the evaluation \c s. The depth has the meaning it has in the recursive
+        engine: it is incremented when the evaluation of a thunk starts and when a beta reduction is performed, and it
+        is restored when the thunk is updated. So, only the reductions that are still pending count.
+    */
+    void inc_depth(eval_state & s) {
+        s.m_depth++;
+        check_depth(s.m_depth);
+    }
+
+    /**
+        \brief Continue the evaluation \c s. Return the weak head normal form of the thunk being evaluated, or nullptr
+        if the evaluation was suspended. In this case, <tt>s.m_value</tt> is a value applied to arguments.
+    */
+    whnf * eval(eval_state & s) {
+        buffer<update_frame> & K = s.m_K;
+        buffer<thunk*> &       S = s.m_S;
+        expr &                 e = s.m_expr;
+        machine_env &          E = s.m_env;
+        context &              C = s.m_ctx;
+        while (true) {
+            check_system("normalizer");
+            whnf * r = s.m_value;
+            s.m_value = nullptr;
+            if (!r) {
+                unsigned base = K.empty() ? 0 : K.back().m_num_args;
+                switch (e.kind()) {
+                case expr_kind::App: {
+                    for (unsigned i = num_args(e) - 1; i >= 1; i--)
+                        S.push_back(mk_thunk(arg(e, i), E, C));
+                    expr f = arg(e, 0);
+                    e = f;
+                    continue;
+                }
+                case expr_kind::Lambda:
+                    if (S.size() > base) {
+                        unsigned m = 0;
+                        expr b = e;
+                        while (is_lambda(b) && S.size() - m > base) {
+                            m++;
+                            b = abst_body(b);
+                        }
+                        thunk ** data = alloc_array(E.m_size + m);
+                        std::copy(E.m_data, E.m_data + E.m_size, data);
+                        for (unsigned i = 0; i < m; i++)
+                            data[E.m_size + i] = S[S.size() - i - 1];
+                        S.shrink(S.size() - m);
+                        inc_depth(s);
+                        E = machine_env(data, E.m_size + m);
+                        e = b;
+                        continue;
+                    }
+                    r = mk_closure(e, E, C);
+                    break;
+                case expr_kind::Pi: case expr_kind::MetaVar:
+                    r = mk_closure(e, E, C);
+                    break;
+                case expr_kind::Var: {
+                    unsigned vidx = var_idx(e);
+                    if (vidx < E.m_size) {
+                        thunk * t2 = E[vidx];
+                        if (t2->m_value) {
+                            r = t2->m_value;
+                            break;
+                        }
+                        K.emplace_back(t2, S.size(), s.m_depth);
+                        inc_depth(s);
+                        e = t2->m_expr;
+                        E = t2->m_env;
+                        C = t2->m_ctx;
+                        continue;
+                    }
+                    auto p = lookup_ext(C, vidx - E.m_size);
+                    context_entry const & entry = p.first;
+                    if (entry.get_body()) {
+                        e = *entry.get_body();
+                        E = machine_env();
+                        C = p.second;
+                        continue;
+                    }
+                    r = mk_var_value(p.second.size());
+                    break;
+                }
+                case expr_kind::Constant: {
+                    optional<object> obj = env()->find_object(const_name(e));
+                    if (should_unfold(obj, m_unfold_opaque)) {
+                        thunk * t2 = mk_constant_thunk(*obj);
+                        if (t2->m_value) {
+                            r = t2->m_value;
+                            break;
+                        }
+                        K.emplace_back(t2, S.size(), s.m_depth);
+                        inc_depth(s);
+                        e = t2->m_expr;
+                        E = t2->m_env;
+                        C = t2->m_ctx;
+                        continue;
+                    }
+                    r = mk_neutral(e);
+                    break;
+                }
+                case expr_kind::Type: case expr_kind::Value:
+                    r = mk_neutral(e);
+                    break;
+                case expr_kind::Let: {
+                    E = extend(E, mk_thunk(let_value(e), E, C));
+                    expr b = let_body(e);
+                    e = b;
+                    continue;
+                }}
+            }
+            // r is a weak head normal form. Apply it to the pending arguments, and update the thunks.
+            while (true) {
+                unsigned curr_base = K.empty() ? 0 : K.back().m_num_args;
+                if (S.size() > curr_base) {
+                    if (is_lambda_closure(r))
+                        break;
+                    r = apply_neutral(r, S, curr_base);
+                    if (is_value_app(r)) {
+                        s.m_value = r;
+                        return nullptr;
+                    }
+                }
+                thunk * u = K.back().m_thunk;
+                u->m_value = r;
+                if (!u->m_definition.is_anonymous())
+                    cache_definition_value(u->m_definition, r);
+                s.m_depth = K.back().m_depth;
+                K.pop_back();
+                if (K.empty()) {
+                    lean_assert(S.empty());
+                    return r;
+                }
+            }
+            // resume the evaluation of the body of the lambda closure r
+            e = r->m_expr;
+            E = r->m_env;
+            C = r->m_ctx;
+        }
+    }
+
+    /**
+        \brief Apply the semantic attachment of the suspended evaluation \c s to the normalized arguments \c args.
+        If the attachment is not applicable, then the evaluation resumes with the value applied to the arguments.
+    */
+    void apply_attachment(eval_state & s, expr const * args) {
+        whnf * v = s.m_value;
+        lean_assert(is_value_app(v));
+        buffer<expr> new_args;
+        new_args.push_back(v->m_expr);
+        new_args.append(v->m_num_args, args);
+        optional<expr> m = to_value(v->m_expr).normalize(new_args.size(), new_args.data());
+        if (m) {
+            s.m_value = nullptr;
+            s.m_expr  = *m;
+            s.m_env   = closed(*m) ? machine_env() : mk_identity_env(s.m_k);
+            s.m_ctx   = m_ctx;
+        }
+    }
+
+    /** \brief Tasks used to evaluate thunks and convert weak head normal forms back into expressions. */
+    struct task {
+        enum class kind { Visit, Force, Eval, Attach, App, Abst, MetaVar };
+        kind     m_kind;
+        whnf *   m_value;   // Visit
+        thunk *  m_thunk;   // Force
+        unsigned m_k;       // number of binders in the context of the term being processed
+        unsigned m_depth;   // nesting depth
+        unsigned m_num;     // Attach, App, MetaVar: number of results consumed
+        whnf *   m_closure; // Abst, MetaVar
+        task(kind k, whnf * v, thunk * t, unsigned n, unsigned d, unsigned num, whnf * c):
+            m_kind(k), m_value(v), m_thunk(t), m_k(n), m_depth(d), m_num(num), m_closure(c) {}
+    };
+
+    static task mk_visit(whnf * v, unsigned k, unsigned d) { return task(task::kind::Visit, v, nullptr, k, d, 0, nullptr); }
+    static task mk_force(thunk * t, unsigned k, unsigned d) { return task(task::kind::Force, nullptr, t, k, d, 0, nullptr); }
+    static task mk_build(task::kind kd, unsigned k, unsigned d, unsigned n, whnf * c) { return task(kd, nullptr, nullptr, k, d, n, c); }
+
+    /**
+        \brief Return true iff the environment of the metavariable closure \c c does not affect it.
+        That is, the environment and context of the closure contain \c k elements, and the i-th element of the
+        environment is the variable with de Bruijn level <tt>k - i - 1</tt>. \c args contains the normal forms
+        of the elements of the environment (see task::kind::MetaVar).
+    */
+    static bool is_identity_env(whnf const * c, unsigned k, expr const * args) {
+        unsigned n = c->m_env.m_size;
+        if (n + c->m_ctx.size() != k)
+            return false;
+        for (unsigned i = 0; i < n; i++) {
+            // args[i] is the normal form of the element n - i - 1, so it must be the variable with de Bruijn index n - i - 1
+            if (!is_var(args[i]) || var_idx(args[i]) != n - i - 1)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+        \brief Return the normal form of the thunk \c t0 in a context that contains \c k0 binders.
+        Thunks are evaluated to weak head normal form, and then converted back into expressions.
+        The pending work is stored in an explicit stack of tasks, and the suspended evaluations in \c m_states.
+    */
+    expr normalize(thunk * t0, unsigned k0) {
+        buffer<task> todo;
+        buffer<expr> results;
+        todo.push_back(mk_force(t0, k0, 0));
+        while (!todo.empty()) {
+            check_system("normalizer");
+            task t = todo.back();
+            todo.pop_back();
+            unsigned k = t.m_k;
+            unsigned d = t.m_depth;
+            check_depth(d);
+            switch (t.m_kind) {
+            case task::kind::Force:
+                if (whnf * v = t.m_thunk->m_value) {
+                    todo.push_back(mk_visit(v, k, d));
+                } else {
+                    m_states.emplace_back(t.m_thunk, k, d);
+                    inc_depth(m_states.back());
+                    todo.push_back(mk_build(task::kind::Eval, k, d, 0, nullptr));
+                }
+                break;
+            case task::kind::Eval: {
+                eval_state & s = m_states.back();
+                if (whnf * r = eval(s)) {
+                    m_states.pop_back();
+                    todo.push_back(mk_visit(r, k, d));
+                } else {
+                    // normalize the arguments of the semantic attachment, and resume the evaluation
+                    whnf * v = s.m_value;
+                    unsigned n = v->m_num_args;
+                    todo.push_back(mk_build(task::kind::Attach, k, d, n, nullptr));
+                    for (unsigned i = 0; i < n; i++)
+                        todo.push_back(mk_force(v->m_args[n - i - 1], k, s.m_depth + 1));
+                }
+                break;
+            }
+            case task::kind::Attach: {
+                unsigned n = t.m_num;
+                apply_attachment(m_states.back(), results.end() - n);
+                results.shrink(results.size() - n);
+                todo.push_back(mk_build(task::kind::Eval, k, d, 0, nullptr));
+                break;
+            }
+            case task::kind::Visit: {
+                whnf * v = t.m_value;
+                if (v->m_closure) {
+                    expr const & e = v->m_expr;
+                    if (is_metavar(e)) {
+                        unsigned n = v->m_env.m_size;
+                        todo.push_back(mk_build(task::kind::MetaVar, k, d, n, v));
+                        for (unsigned i = 0; i < n; i++)
+                            todo.push_back(mk_force(v->m_env.m_data[n - i - 1], k, d + 1));
+                    } else {
+                        lean_assert(is_abstraction(e));
+                        thunk * dom  = mk_thunk(abst_domain(e), v->m_env, v->m_ctx);
+                        thunk * body = mk_thunk(abst_body(e), extend(v->m_env, mk_thunk(mk_var_value(k))), v->m_ctx);
+                        todo.push_back(mk_build(task::kind::Abst, k, d, 2, v));
+                        todo.push_back(mk_force(body, k+1, d + 1));
+                        todo.push_back(mk_force(dom, k, d + 1));
+                    }
+                } else if (v->m_num_args == 0) {
+                    lean_assert(!v->m_head);
+                    if (is_var(v->m_expr))
+                        results.push_back(mk_var(k - var_idx(v->m_expr) - 1)); // de Bruijn level --> de Bruijn index
+                    else
+                        results.push_back(v->m_expr);
+                } else {
+                    unsigned n = v->m_num_args;
+                    todo.push_back(mk_build(task::kind::App, k, d, n + 1, nullptr));
+                    for (unsigned i = 0; i < n; i++)
+                        todo.push_back(mk_force(v->m_args[n - i - 1], k, d + 1));
+                    if (v->m_head)
+                        todo.push_back(mk_visit(v->m_head, k, d + 1));
+                    else
+                        todo.push_back(mk_visit(mk_neutral(v->m_expr), k, d + 1));
+                }
+                break;
+            }
+            case task::kind::App: {
+                unsigned n = t.m_num;
+                expr r = mk_app(n, results.end() - n);
+                results.shrink(results.size() - n);
+                results.push_back(r);
+                break;
+            }
+            case task::kind::Abst: {
+                expr const & e = t.m_closure->m_expr;
+                expr new_b = results.back(); results.pop_back();
+                expr new_d = results.back(); results.pop_back();
+                if (is_pi(e) && is_arrow(e) && is_bool_value(new_d) && is_bool_value(new_b))
+                    results.push_back(mk_bool_value(is_false(new_d) || is_true(new_b)));
+                else
+                    results.push_back(update_abst(e, new_d, new_b));
+                break;
+            }
+            case task::kind::MetaVar: {
+                // See comment at normalizer::imp::reify_closure
+                whnf * c = t.m_closure;
+                unsigned n = t.m_num;
+                expr r;
+                if (is_identity_env(c, k, results.end() - n)) {
+                    r = c->m_expr;
+                } else {
+                    unsigned m = c->m_ctx.size();
+                    buffer<expr> subst;
+                    for (unsigned i = 1; i <= m; i++)
+                        subst.push_back(mk_var(k - i));
+                    subst.append(n, results.end() - n);
+                    r = ::lean::instantiate(c->m_expr, subst.size(), subst.data(), m_menv.to_some_menv());
+                }
+                results.shrink(results.size() - n);
+                results.push_back(r);
+                break;
+            }}
+        }
+        lean_assert(results.size() == 1);
+        return results[0];
+    }
+
+public:
+    imp(ro_environment const & env, unsigned max_depth):
+        m_env(env), m_unfold_opaque(false), m_max_depth(max_depth), m_next(nullptr), m_end(nullptr) {}
+
+    ~imp() { reset(); }
+
+    expr operator()(expr const & e, context const & ctx, optional<ro_metavar_env> const & menv, bool unfold_opaque) {
+        region_scope scope(*this);
+        m_ctx           = ctx;
+        m_unfold_opaque = unfold_opaque;
+        m_menv.update(menv);
+        unsigned k = m_ctx.size();
+        return normalize(mk_thunk(e, machine_env(), m_ctx), k);
+    }
+};
+
+normalizer_machine::normalizer_machine(ro_environment const & env, unsigned max_depth):m_ptr(new imp(env, max_depth)) {}
+normalizer_machine::~normalizer_machine() {}
+expr normalizer_machine::operator()(expr const & e, context const & ctx, optional<ro_metavar_env> const & menv, bool unfold_opaque) {
+    return (*m_ptr)(e, ctx, menv, unfold_opaque);
+}
+}
@@ -0,0 +1,39 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <memory>
+#include "kernel/expr.h"
+#include "kernel/environment.h"
+#include "kernel/context.h"
+
+namespace lean {
+class ro_metavar_env;
+/**
+   \brief Strong reduction engine based on a lazy Krivine-style abstract machine.
+
+   Expressions are evaluated to weak head normal form using explicit environments
+   (arrays of suspended computations), an explicit stack of pending arguments, and an
+   explicit stack of update frames. Then, the weak head normal forms are converted
+   back into expressions using an explicit stack of tasks. Semantic attachments are applied
+   to normalized arguments, so an evaluation that reaches one is suspended on the same
+   stack until its arguments are normalized. So, the amount of C++ stack used does not
+   depend on the size of the expression being normalized.
+
+   The machine objects are stored in a region that is released after each call.
+
+   \remark It produces the same normal forms as the recursive engine in normalizer.cpp.
+   It is the default engine, the option <tt>kernel::normalizer::machine</tt> selects the recursive one when false.
+*/
+class normalizer_machine {
+    class imp;
+    std::unique_ptr<imp> m_ptr;
+public:
+    normalizer_machine(ro_environment const & env, unsigned max_depth);
+    ~normalizer_machine();
+    expr operator()(expr const & e, context const & ctx, optional<ro_metavar_env> const & menv, bool unfold_opaque);
+};
+}
@@ -233,6 +233,88 @@ static void read_theorem(environment const & env, io_state const &, deserializer
 }
 static object_cell::register_deserializer_fn theorem_ds("th", read_theorem);
 
+/**
+   \brief Expression that is read from a \c lazy_expr_source the first time it is needed.
+   The mutex of the source is only used for reading the expression. After that, \c get does not synchronize.
+*/
+class lazy_expr {
+    lazy_expr_source_ptr m_source;
+    unsigned             m_idx;
+    mutable atomic_bool  m_loaded; // true if m_expr was read, it is set after m_expr is stored
+    mutable expr         m_expr;
+public:
+    lazy_expr(lazy_expr_source_ptr const & src, unsigned idx):m_source(src), m_idx(idx), m_loaded(false) {}
+    lazy_expr(lazy_expr const & e):m_source(e.m_source), m_idx(e.m_idx), m_loaded(false) {
+        if (e.m_loaded.load()) {
+            m_expr = e.m_expr;
+            m_loaded.store(true);
+        }
+    }
+    expr get() const {
+        if (!m_loaded.load()) {
+            lock_guard<mutex> lock(m_source->get_mutex());
+            if (!m_loaded.load()) {
+                m_expr = m_source->read(m_idx);
+                m_loaded.store(true);
+            }
+        }
+        return m_expr;
+    }
+};
+
+/**
+   \brief Definitions, theorems, axioms and variable declarations whose type and value are read on demand.
+   They behave as the objects created by \c mk_definition, \c mk_theorem, \c mk_axiom and \c mk_var_decl.
+*/
+class lazy_object_cell : public named_object_cell {
+public:
+    enum class lazy_kind { Definition, Theorem, Axiom, VarDecl };
+private:
+    lazy_kind           m_lazy_kind;
+    lazy_expr           m_type;
+    optional<lazy_expr> m_value;
+    bool                m_opaque;
+    unsigned            m_weight;
+    static object_kind to_object_kind(lazy_kind k) {
+        return k == lazy_kind::Definition || k == lazy_kind::Theorem ? object_kind::Definition : object_kind::Postulate;
+    }
+public:
+    lazy_object_cell(lazy_kind k, name const & n, lazy_expr const & t, optional<lazy_expr> const & v, unsigned weight):
+        named_object_cell(to_object_kind(k), n), m_lazy_kind(k), m_type(t), m_value(v),
+        m_opaque(k == lazy_kind::Theorem), m_weight(weight) {
+        lean_assert(is_definition() == static_cast<bool>(m_value));
+    }
+    virtual ~lazy_object_cell() {}
+
+    virtual bool has_type() const        { return true; }
+    virtual expr get_type() const        { return m_type.get(); }
+    virtual bool is_definition() const   { return m_lazy_kind == lazy_kind::Definition || m_lazy_kind == lazy_kind::Theorem; }
+    virtual bool is_opaque() const       { return m_opaque; }
+    virtual void set_opaque(bool f)      { m_opaque = f; }
+    virtual expr get_value() const       { lean_assert(is_definition()); return m_value->get(); }
+    virtual unsigned get_weight() const  { return m_weight; }
+    virtual bool is_axiom() const        { return m_lazy_kind == lazy_kind::Axiom; }
+    virtual bool is_theorem() const      { return m_lazy_kind == lazy_kind::Theorem; }
+    virtual bool is_var_decl() const     { return m_lazy_kind == lazy_kind::VarDecl; }
+    virtual char const * keyword() const {
+        switch (m_lazy_kind) {
+        case lazy_kind::Definition: return "definition";
+        case lazy_kind::Theorem:    return "theorem";
+        case lazy_kind::Axiom:      return "axiom";
+        case lazy_kind::VarDecl:    return "variable";
+        }
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+    virtual void write(serializer & s) const {
+        switch (m_lazy_kind) {
+        case lazy_kind::Definition: s << "def" << get_name() << get_type() << get_value(); break;
+        case lazy_kind::Theorem:    s << "th"  << get_name() << get_type() << get_value(); break;
+        case lazy_kind::Axiom:      s << "ax"  << get_name() << get_type(); break;
+        case lazy_kind::VarDecl:    s << "var" << get_name() << get_type(); break;
+        }
+    }
+};
+
 object mk_uvar_cnstr(name const & n, level const & l) { return object(new uvar_constraint_object_cell(n, l)); }
 object mk_definition(name const & n, expr const & t, expr const & v, unsigned weight) { return object(new definition_object_cell(n, t, v, weight)); }
 object mk_theorem(name const & n, expr const & t, expr const & v) { return object(new theorem_object_cell(n, t, v)); }
@@ -240,4 +322,16 @@ object mk_axiom(name const & n, expr const & t) { return object(new axiom_object
 object mk_var_decl(name const & n, expr const & t) { return object(new variable_decl_object_cell(n, t)); }
 object mk_builtin(expr const & v) { return object(new builtin_object_cell(v)); }
 object mk_builtin_set(expr const & r) { return object(new builtin_set_object_cell(r)); }
+object mk_lazy_definition(name const & n, unsigned weight, lazy_expr_source_ptr const & src, unsigned t, unsigned v) {
+    return object(new lazy_object_cell(lazy_object_cell::lazy_kind::Definition, n, lazy_expr(src, t), optional<lazy_expr>(lazy_expr(src, v)), weight));
+}
+object mk_lazy_theorem(name const & n, lazy_expr_source_ptr const & src, unsigned t, unsigned v) {
+    return object(new lazy_object_cell(lazy_object_cell::lazy_kind::Theorem, n, lazy_expr(src, t), optional<lazy_expr>(lazy_expr(src, v)), 0));
+}
+object mk_lazy_axiom(name const & n, lazy_expr_source_ptr const & src, unsigned t) {
+    return object(new lazy_object_cell(lazy_object_cell::lazy_kind::Axiom, n, lazy_expr(src, t), optional<lazy_expr>(), 0));
+}
+object mk_lazy_var_decl(name const & n, lazy_expr_source_ptr const & src, unsigned t) {
+    return object(new lazy_object_cell(lazy_object_cell::lazy_kind::VarDecl, n, lazy_expr(src, t), optional<lazy_expr>(), 0));
+}
 }
@@ -6,8 +6,10 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <algorithm>
+#include <memory>
 #include <string>
 #include "util/rc.h"
+#include "util/thread.h"
 #include "kernel/expr.h"
 /*
   Kernel objects.
@@ -90,6 +92,22 @@ public:
     neutral_object_cell();
 };
 
+/**
+   \brief Source of expressions that are only read when they are needed.
+   It is used to implement objects whose type and value are read on demand
+   (e.g., the objects imported from .olean files).
+*/
+class lazy_expr_source {
+    mutex m_mutex;
+public:
+    virtual ~lazy_expr_source() {}
+    /** \brief Read the i-th expression of this source. */
+    virtual expr read(unsigned i) = 0;
+    /** \brief Mutex used to make sure each expression is read only once. */
+    mutex & get_mutex() { return m_mutex; }
+};
+typedef std::shared_ptr<lazy_expr_source> lazy_expr_source_ptr;
+
 /**
    \brief Environment objects: definitions, theorems, axioms, universe
    variable declarations, etc.
@@ -119,6 +137,10 @@ public:
     friend object mk_neutral(neutral_object_cell * c);
     friend object mk_builtin(expr const & v);
     friend object mk_builtin_set(expr const & r);
+    friend object mk_lazy_definition(name const & n, unsigned weight, lazy_expr_source_ptr const & src, unsigned t, unsigned v);
+    friend object mk_lazy_theorem(name const & n, lazy_expr_source_ptr const & src, unsigned t, unsigned v);
+    friend object mk_lazy_axiom(name const & n, lazy_expr_source_ptr const & src, unsigned t);
+    friend object mk_lazy_var_decl(name const & n, lazy_expr_source_ptr const & src, unsigned t);
 
     char const * keyword() const { return m_ptr->keyword(); }
     bool has_name() const { return m_ptr->has_name(); }
@@ -156,6 +178,17 @@ object mk_theorem(name const & n, expr const & t, expr const & v);
 object mk_axiom(name const & n, expr const & t);
 object mk_var_decl(name const & n, expr const & t);
 inline object mk_neutral(neutral_object_cell * c) { lean_assert(c->get_rc() == 1); return object(c); }
+/**
+   \brief Create definitions, theorems, axioms and variable declarations whose type (and value) are
+   the expressions \c t (and \c v) of \c src. The expressions are read the first time they are needed.
+   Thus, the proof of a theorem is usually never read.
+
+   \remark The weight of definitions must be provided because it is used without accessing the value.
+*/
+object mk_lazy_definition(name const & n, unsigned weight, lazy_expr_source_ptr const & src, unsigned t, unsigned v);
+object mk_lazy_theorem(name const & n, lazy_expr_source_ptr const & src, unsigned t, unsigned v);
+object mk_lazy_axiom(name const & n, lazy_expr_source_ptr const & src, unsigned t);
+object mk_lazy_var_decl(name const & n, lazy_expr_source_ptr const & src, unsigned t);
 
 void read_object(environment const & env, io_state const & ios, std::string const & k, deserializer & d);
 
@@ -8,8 +8,51 @@ Author: Leonardo de Moura
 #include "kernel/find_fn.h"
 
 namespace lean {
+/**
+   \brief Functional object for checking whether there is a constant named \c n in an expression.
+   It uses the constant signature of subexpressions to skip the ones that cannot contain \c n.
+*/
+class occurs_const_fn {
+    name const & m_name;
+    uint64       m_sig;
+    bool         m_found;
+    bool visit(expr const & e) {
+        if (m_found || (get_const_signature(e) & m_sig) != m_sig)
+            return false;
+        if (is_constant(e) && const_name(e) == m_name) {
+            m_found = true;
+            return false;
+        }
+        return true;
+    }
+public:
+    occurs_const_fn(name const & n):m_name(n), m_sig(get_name_signature(n)), m_found(false) {}
+    bool operator()(expr const & e) {
+        if (m_found)
+            return true;
+        if ((get_const_signature(e) & m_sig) != m_sig)
+            return false;
+        auto proc = [&](expr const & s, unsigned) { return visit(s); };
+        for_each_fn<decltype(proc)> visitor(proc);
+        visitor(e);
+        return m_found;
+    }
+};
+
 bool occurs(name const & n, context const * c, unsigned sz, expr const * es) {
-    return static_cast<bool>(find(c, sz, es, [&](expr const & e) { return is_constant(e) && const_name(e) == n; }));
+    occurs_const_fn proc(n);
+    if (c) {
+        for (auto const & e : *c) {
+            if ((e.get_domain() && proc(*e.get_domain())) ||
+                (e.get_body() && proc(*e.get_body())))
+                return true;
+        }
+    }
+    for (unsigned i = 0; i < sz; i++) {
+        if (proc(es[i]))
+            return true;
+    }
+    return false;
 }
 
 bool occurs(expr const & n, context const * c, unsigned sz, expr const * es) {
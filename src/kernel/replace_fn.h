@@ -22,6 +22,29 @@ public:
     void operator()(expr const &, expr const &) {}
 };
 
+/**
+   \brief Default replace_fn skip predicate. It does not skip any subexpression.
+*/
+class default_replace_skip {
+public:
+    bool operator()(expr const &, unsigned) const { return false; }
+};
+
+/**
+   \brief replace_fn skip predicate for functions that only modify free variables
+   <tt>(var i)</tt> s.t. <tt>i >= s + offset</tt>, and metavariables.
+   It skips subexpressions that do not contain metavariables, and whose free variables are
+   all smaller than <tt>s + offset</tt>.
+*/
+class replace_free_vars_skip {
+    unsigned m_s;
+public:
+    replace_free_vars_skip(unsigned s):m_s(s) {}
+    bool operator()(expr const & e, unsigned offset) const {
+        return !has_metavar(e) && get_free_var_range(e) <= m_s + offset;
+    }
+};
+
 /**
    \brief Functional for applying <tt>F</tt> to the subexpressions of a given expression.
 
@@ -34,8 +57,12 @@ public:
 
    P is a "post-processing" functional object that is applied to each
    pair (old, new)
+
+   S is a predicate with signature expr const &, unsigned -> bool.
+   When <tt>S(s, n)</tt> returns true, the subexpression \c s is not visited (F and P are not applied),
+   and it is kept in the result.
 */
-template<typename F, typename P = default_replace_postprocessor>
+template<typename F, typename P = default_replace_postprocessor, typename S = default_replace_skip>
 class replace_fn {
     static_assert(std::is_same<typename std::result_of<F(expr const &, unsigned)>::type, expr>::value,
                   "replace_fn: return type of F is not expr");
@@ -57,6 +84,7 @@ class replace_fn {
     expr_cell_offset_map<expr> m_cache;
     F                          m_f;
     P                          m_post;
+    S                          m_skip;
     frame_stack                m_fs;
     result_stack               m_rs;
 
@@ -83,6 +111,10 @@ class replace_fn {
        The idea is that after the frame is processed, the result will be on the result stack.
     */
     bool visit(expr const & e, unsigned offset) {
+        if (m_skip(e, offset)) {
+            m_rs.push_back(e);
+            return true;
+        }
         bool shared = false;
         if (is_shared(e)) {
             expr_cell_offset p(e.raw(), offset);
@@ -127,9 +159,10 @@ class replace_fn {
     }
 
 public:
-    replace_fn(F const & f, P const & p = P()):
+    replace_fn(F const & f, P const & p = P(), S const & s = S()):
         m_f(f),
-        m_post(p) {
+        m_post(p),
+        m_skip(s) {
     }
 
     expr operator()(expr const & e) {
@@ -205,4 +238,14 @@ template<typename F, typename P>
 expr replace(expr const & e, F f, P p) {
     return replace_fn<F, P>(f, p)(e);
 }
+
+/**
+   \brief Similar to \c replace, but subexpressions that do not contain metavariables nor
+   free variables <tt>(var i)</tt> s.t. <tt>i >= s + offset</tt> are not visited.
+*/
+template<typename F>
+expr replace_free_vars(expr const & e, unsigned s, F f) {
+    return replace_fn<F, default_replace_postprocessor, replace_free_vars_skip>(f, default_replace_postprocessor(),
+                                                                              replace_free_vars_skip(s))(e);
+}
 }
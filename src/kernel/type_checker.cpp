@@ -4,11 +4,18 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+#include <utility>
 #include "util/freset.h"
 #include "util/flet.h"
 #include "util/interrupt.h"
+#include "util/pair.h"
+#include "util/sexpr/options.h"
 #include "kernel/type_checker.h"
 #include "kernel/expr_maps.h"
+#include "kernel/expr_eq.h"
 #include "kernel/environment.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/normalizer.h"
@@ -17,7 +24,26 @@ Author: Leonardo de Moura
 #include "kernel/free_vars.h"
 #include "kernel/type_checker_justification.h"
 
+#ifndef LEAN_KERNEL_TYPE_CHECKER_LAZY_DELTA
+#define LEAN_KERNEL_TYPE_CHECKER_LAZY_DELTA true
+#endif
+
+#ifndef LEAN_TYPE_CHECKER_EQ_CACHE_SIZE
+#define LEAN_TYPE_CHECKER_EQ_CACHE_SIZE 1024*16
+#endif
+
+#ifndef LEAN_TYPE_CHECKER_CLOSED_CACHE_SIZE
+#define LEAN_TYPE_CHECKER_CLOSED_CACHE_SIZE 1024*16
+#endif
+
 namespace lean {
+static name g_kernel_type_checker_lazy_delta {"kernel", "type_checker", "lazy_delta"};
+RegisterBoolOption(g_kernel_type_checker_lazy_delta, LEAN_KERNEL_TYPE_CHECKER_LAZY_DELTA,
+                   "(kernel) use lazy delta-reduction (unfold one definition at a time) before normalizing terms in convertibility checks");
+bool get_type_checker_lazy_delta(options const & opts) {
+    return opts.get_bool(g_kernel_type_checker_lazy_delta, LEAN_KERNEL_TYPE_CHECKER_LAZY_DELTA);
+}
+
 expr pi_body_at(expr const & pi, expr const & a) {
     lean_assert(is_pi(pi));
     if (closed(abst_body(pi)))
@@ -32,15 +58,42 @@ static name g_x_name("x");
 /** \brief Auxiliary functional object used to implement infer_type. */
 class type_checker::imp {
     typedef expr_map<expr> cache;
+    /**
+        \brief Cache for closed terms that do not contain metavariables.
+        The type of these terms does not depend on the context nor on the
+        metavariable environment, so the entries survive context switches and binders.
+        The flag indicates whether the term was type checked or only had its type inferred.
+        It is reset when it contains LEAN_TYPE_CHECKER_CLOSED_CACHE_SIZE terms.
+    */
+    typedef expr_map<std::pair<expr, bool>> closed_cache;
     typedef buffer<unification_constraint> unification_constraints;
+    typedef std::pair<expr, expr> expr_pair;
+    struct expr_pair_hash_alloc {
+        unsigned operator()(expr_pair const & p) const { return hash(p.first.hash_alloc(), p.second.hash_alloc()); }
+    };
+    struct expr_pair_eqp {
+        bool operator()(expr_pair const & p1, expr_pair const & p2) const { return is_eqp(p1.first, p2.first) && is_eqp(p1.second, p2.second); }
+    };
+    /**
+        \brief Pairs of closed terms that are known to be definitionally equal.
+        It is reset when it contains LEAN_TYPE_CHECKER_EQ_CACHE_SIZE pairs.
+    */
+    typedef std::unordered_set<expr_pair, expr_pair_hash_alloc, expr_pair_eqp> eq_cache;
 
     ro_environment::weak_ref  m_env;
     cache                     m_cache;
+    closed_cache              m_closed_cache;
+    eq_cache                  m_eq_cache;
+    expr_eq_memo              m_eq_memo;
+    instantiate_memo          m_instantiate_memo;
     normalizer                m_normalizer;
     context                   m_ctx;
     cached_metavar_env        m_menv;
     unification_constraints * m_uc;
     bool                      m_infer_only;
+    bool                      m_lazy_delta;
+    unsigned                  m_cache_hits;
+    unsigned                  m_cache_misses;
 
     ro_environment env() const { return ro_environment(m_env); }
     expr lift_free_vars(expr const & e, unsigned s, unsigned d) { return ::lean::lift_free_vars(e, s, d, m_menv.to_some_ro_menv()); }
@@ -48,6 +101,7 @@ class type_checker::imp {
     expr lower_free_vars(expr const & e, unsigned s, unsigned n) { return ::lean::lower_free_vars(e, s, n, m_menv.to_some_ro_menv()); }
     expr instantiate_with_closed(expr const & e, expr const & v) { return ::lean::instantiate_with_closed(e, v, m_menv.to_some_ro_menv()); }
     expr instantiate(expr const & e, expr const & v) { return ::lean::instantiate(e, v, m_menv.to_some_ro_menv()); }
+    expr apply_beta(expr const & f, unsigned num, expr const * args) { return ::lean::apply_beta(f, num, args, m_menv.to_some_ro_menv()); }
     expr normalize(expr const & e, context const & ctx, bool unfold_opaque) { return m_normalizer(e, ctx, m_menv.to_some_ro_menv(), unfold_opaque); }
 
     expr check_type(expr const & e, expr const & s, context const & ctx) {
@@ -134,155 +188,303 @@ class type_checker::imp {
     }
 
     expr save_result(expr const & e, expr const & r, bool shared) {
-        if (shared)
-            m_cache[e] = r;
+        if (shared) {
+            if (!has_metavar(e) && closed(e)) {
+                auto it = m_closed_cache.find(e);
+                if (it == m_closed_cache.end()) {
+                    if (m_closed_cache.size() >= LEAN_TYPE_CHECKER_CLOSED_CACHE_SIZE)
+                        m_closed_cache.clear();
+                    m_closed_cache.insert(mk_pair(e, mk_pair(r, !m_infer_only)));
+                } else if (!m_infer_only) {
+                    it->second = mk_pair(r, true);
+                }
+            } else {
+                m_cache[e] = r;
+            }
+        }
         return r;
     }
 
-    expr infer_type_core(expr const & e, context const & ctx) {
-        check_system("type checker");
-        // cheap cases, we do not cache results
+    /**
+        \brief Return the cached type of \c e if available.
+        \remark A term that only had its type inferred is not considered type checked.
+    */
+    optional<expr> find_cached(expr const & e) {
+        auto it1 = m_closed_cache.find(e);
+        if (it1 != m_closed_cache.end() && (m_infer_only || it1->second.second)) {
+            m_cache_hits++;
+            return some_expr(it1->second.first);
+        }
+        auto it2 = m_cache.find(e);
+        if (it2 != m_cache.end()) {
+            m_cache_hits++;
+            return some_expr(it2->second);
+        }
+        m_cache_misses++;
+        return none_expr();
+    }
+
+    /**
+        \brief Return the type of \c e if it can be computed without visiting subterms.
+        The results for these cases are not cached.
+    */
+    optional<expr> infer_type_cheap(expr const & e, context const & ctx) {
         switch (e.kind()) {
         case expr_kind::MetaVar:
             if (m_menv) {
                 if (m_menv->is_assigned(e))
-                    return infer_type_core(*(m_menv->get_subst(e)), ctx);
+                    return none_expr(); // the type of the substitution is inferred
                 else
-                    return m_menv->get_type(e);
+                    return some_expr(m_menv->get_type(e));
             } else {
                 throw unexpected_metavar_occurrence(env(), e);
             }
         case expr_kind::Constant: {
             if (const_type(e)) {
-                return *const_type(e);
+                return const_type(e);
             } else {
                 object const & obj = env()->get_object(const_name(e));
                 if (obj.has_type())
-                    return obj.get_type();
+                    return some_expr(obj.get_type());
                 else
                     throw has_no_type_exception(env(), e);
             }
-            break;
         }
         case expr_kind::Var: {
             auto const & entry = lookup(ctx, var_idx(e));
             if (entry.get_domain())
-                return lift_free_vars(*(entry.get_domain()), var_idx(e) + 1);
+                return some_expr(lift_free_vars(*(entry.get_domain()), var_idx(e) + 1));
             // Remark: the case where ce.get_domain() is not
             // available is not considered cheap.
-            break;
+            return none_expr();
         }
         case expr_kind::Value:
             if (m_infer_only) {
-                return to_value(e).get_type();
+                return some_expr(to_value(e).get_type());
             } else {
                 name const & n = to_value(e).get_name();
                 object obj = env()->get_object(n);
                 if ((obj.is_builtin() && obj.get_value() == e) || (obj.is_builtin_set() && obj.in_builtin_set(e))) {
-                    return to_value(e).get_type();
+                    return some_expr(to_value(e).get_type());
                 } else {
                     throw invalid_builtin_value_reference(env(), e);
                 }
             }
         case expr_kind::Type:
-            return mk_type(ty_level(e) + 1);
+            return some_expr(mk_type(ty_level(e) + 1));
         case expr_kind::App: case expr_kind::Lambda:
         case expr_kind::Pi:  case expr_kind::Let:
-            break; // expensive cases
+            return none_expr(); // expensive cases
         }
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+
+    /**
+        \brief Tasks used by infer_type_core. The types of the visited terms are stored in a stack of results,
+        and the remaining tasks consume them.
+
+        - Visit: push the type of \c m_expr in \c m_ctx.
+        - Var: the type of the body of the context entry is on the stack, lift it.
+        - App: the types of the function and arguments (or only the function if m_infer_only) are on the stack.
+        - CheckType: the type of \c m_expr is on the stack, check whether it is really a type and drop it.
+        - Binder: the type of the domain of \c m_expr was processed, visit the body in a new cache scope.
+        - Lambda, Pi, Let: the type of the body is on the stack, close the cache scope.
+        - LetValue: the types of the value (and type) of the let-expression are on the stack.
+    */
+    enum class task_kind { Visit, Var, App, CheckType, Binder, Lambda, Pi, LetValue, Let };
+    struct task {
+        task_kind      m_kind;
+        expr           m_expr;
+        context        m_ctx;
+        bool           m_shared;
+        task(task_kind k, expr const & e, context const & ctx, bool shared = false):
+            m_kind(k), m_expr(e), m_ctx(ctx), m_shared(shared) {}
+    };
 
-        bool shared = false;
-        if (is_shared(e)) {
-            shared = true;
-            auto it = m_cache.find(e);
-            if (it != m_cache.end())
-                return it->second;
+    /**
+        \brief Auxiliary object for implementing the cache scopes of binders (see freset).
+        If an exception is thrown, the cache of the outermost scope is restored.
+    */
+    struct cache_scopes {
+        cache &            m_cache;
+        std::vector<cache> m_saved;
+        cache_scopes(cache & c):m_cache(c) {}
+        ~cache_scopes() {
+            if (!m_saved.empty())
+                std::swap(m_cache, m_saved[0]);
         }
+        void push() {
+            m_saved.push_back(cache());
+            std::swap(m_cache, m_saved.back());
+        }
+        void pop() {
+            std::swap(m_cache, m_saved.back());
+            m_saved.pop_back();
+        }
+    };
 
-        switch (e.kind()) {
-        case expr_kind::MetaVar: case expr_kind::Constant: case expr_kind::Type: case expr_kind::Value:
-            lean_unreachable(); // LCOV_EXCL_LINE;
-        case expr_kind::Var: {
-            unsigned i = var_idx(e);
-            auto p = lookup_ext(ctx, i);
-            context_entry const & def = p.first;
-            context const & def_ctx   = p.second;
-            lean_assert(ctx.size() > def_ctx.size());
-            lean_assert(!def.get_domain()); // was handled as cheap
-            optional<expr> const & b = def.get_body();
-            lean_assert(b);
-            expr t = infer_type_core(*b, def_ctx);
-            return save_result(e, lift_free_vars(t, var_idx(e) + 1), shared);
-        }
-        case expr_kind::App:
-            if (m_infer_only) {
-                expr const & f = arg(e, 0);
-                expr f_t = infer_type_core(f, ctx);
-                return save_result(e, get_range(f_t, e, ctx), shared);
-            } else {
-                unsigned num = num_args(e);
-                lean_assert(num >= 2);
-                buffer<expr> arg_types;
-                for (unsigned i = 0; i < num; i++) {
-                    arg_types.push_back(infer_type_core(arg(e, i), ctx));
+    /**
+        \brief Infer the type of \c e in the context \c ctx. The terms are traversed using an explicit
+        stack of tasks. So, the depth of \c e is not limited by the size of the thread stack.
+    */
+    expr infer_type_core(expr const & e0, context const & ctx0) {
+        buffer<task> todo;
+        buffer<expr> results;
+        cache_scopes scopes(m_cache);
+        todo.emplace_back(task_kind::Visit, e0, ctx0);
+        while (!todo.empty()) {
+            task t = todo.back();
+            todo.pop_back();
+            expr const & e    = t.m_expr;
+            context const & ctx = t.m_ctx;
+            switch (t.m_kind) {
+            case task_kind::Visit: {
+                check_system("type checker");
+                if (optional<expr> r = infer_type_cheap(e, ctx)) {
+                    results.push_back(*r);
+                    break;
                 }
-                expr f_t     = check_pi(arg_types[0], e, ctx);
-                unsigned i   = 1;
-                while (true) {
-                    expr const & c   = arg(e, i);
-                    expr const & c_t = arg_types[i];
-                    // thunk for creating justification object if needed
-                    auto mk_justification = [&](){ return mk_app_type_match_justification(ctx, e, i); };
-                    if (!is_convertible(c_t, abst_domain(f_t), ctx, mk_justification))
-                        throw app_type_mismatch_exception(env(), ctx, e, i, arg_types.size(), arg_types.data());
-                    f_t = pi_body_at(f_t, c);
-                    i++;
-                    if (i == num)
-                        return save_result(e, f_t, shared);
-                    f_t = check_pi(f_t, e, ctx);
+                if (is_metavar(e)) {
+                    // assigned metavariable
+                    todo.emplace_back(task_kind::Visit, *(m_menv->get_subst(e)), ctx);
+                    break;
+                }
+                bool shared = false;
+                if (is_shared(e)) {
+                    shared = true;
+                    if (auto r = find_cached(e)) {
+                        results.push_back(*r);
+                        break;
+                    }
+                }
+                switch (e.kind()) {
+                case expr_kind::Var: {
+                    auto p = lookup_ext(ctx, var_idx(e));
+                    context_entry const & def = p.first;
+                    context const & def_ctx   = p.second;
+                    lean_assert(ctx.size() > def_ctx.size());
+                    lean_assert(!def.get_domain()); // was handled as cheap
+                    lean_assert(def.get_body());
+                    todo.emplace_back(task_kind::Var, e, ctx, shared);
+                    todo.emplace_back(task_kind::Visit, *def.get_body(), def_ctx);
+                    break;
                 }
+                case expr_kind::App: {
+                    todo.emplace_back(task_kind::App, e, ctx, shared);
+                    unsigned num = m_infer_only ? 1 : num_args(e);
+                    unsigned i   = num;
+                    while (i > 0) {
+                        --i;
+                        todo.emplace_back(task_kind::Visit, arg(e, i), ctx);
+                    }
+                    break;
+                }
+                case expr_kind::Lambda:
+                    todo.emplace_back(task_kind::Lambda, e, ctx, shared);
+                    todo.emplace_back(task_kind::Binder, e, ctx);
+                    if (!m_infer_only) {
+                        todo.emplace_back(task_kind::CheckType, abst_domain(e), ctx);
+                        todo.emplace_back(task_kind::Visit, abst_domain(e), ctx);
+                    }
+                    break;
+                case expr_kind::Pi:
+                    todo.emplace_back(task_kind::Pi, e, ctx, shared);
+                    todo.emplace_back(task_kind::Binder, e, ctx);
+                    todo.emplace_back(task_kind::Visit, abst_domain(e), ctx);
+                    break;
+                case expr_kind::Let:
+                    todo.emplace_back(task_kind::LetValue, e, ctx, shared);
+                    if (!m_infer_only) {
+                        if (let_type(e))
+                            todo.emplace_back(task_kind::Visit, *let_type(e), ctx);
+                        todo.emplace_back(task_kind::Visit, let_value(e), ctx);
+                    }
+                    break;
+                case expr_kind::MetaVar: case expr_kind::Constant: case expr_kind::Type: case expr_kind::Value:
+                    lean_unreachable(); // LCOV_EXCL_LINE
+                }
+                break;
             }
-        case expr_kind::Lambda:
-            if (!m_infer_only) {
-                expr d = infer_type_core(abst_domain(e), ctx);
-                check_type(d, abst_domain(e), ctx);
+            case task_kind::Var: {
+                expr r = results.back(); results.pop_back();
+                results.push_back(save_result(e, lift_free_vars(r, var_idx(e) + 1), t.m_shared));
+                break;
             }
-            {
-                freset<cache> reset(m_cache);
-                return save_result(e,
-                                   mk_pi(abst_name(e), abst_domain(e), infer_type_core(abst_body(e), extend(ctx, abst_name(e), abst_domain(e)))),
-                                   shared);
+            case task_kind::App:
+                if (m_infer_only) {
+                    expr f_t = results.back(); results.pop_back();
+                    results.push_back(save_result(e, get_range(f_t, e, ctx), t.m_shared));
+                } else {
+                    unsigned num = num_args(e);
+                    lean_assert(num >= 2);
+                    buffer<expr> arg_types;
+                    arg_types.append(num, results.end() - num);
+                    results.shrink(results.size() - num);
+                    expr f_t     = check_pi(arg_types[0], e, ctx);
+                    unsigned i   = 1;
+                    while (true) {
+                        expr const & c   = arg(e, i);
+                        expr const & c_t = arg_types[i];
+                        // thunk for creating justification object if needed
+                        auto mk_justification = [&](){ return mk_app_type_match_justification(ctx, e, i); };
+                        if (!is_convertible(c_t, abst_domain(f_t), ctx, mk_justification))
+                            throw app_type_mismatch_exception(env(), ctx, e, i, arg_types.size(), arg_types.data());
+                        f_t = pi_body_at(f_t, c);
+                        i++;
+                        if (i == num)
+                            break;
+                        f_t = check_pi(f_t, e, ctx);
+                    }
+                    results.push_back(save_result(e, f_t, t.m_shared));
+                }
+                break;
+            case task_kind::CheckType: {
+                expr d = results.back(); results.pop_back();
+                check_type(d, e, ctx);
+                break;
             }
-        case expr_kind::Pi: {
-            expr t1  = check_type(infer_type_core(abst_domain(e), ctx), abst_domain(e), ctx);
-            if (is_bool(t1))
-                t1 = Type();
-            expr t2;
-            context new_ctx = extend(ctx, abst_name(e), abst_domain(e));
-            {
-                freset<cache> reset(m_cache);
-                t2 = check_type(infer_type_core(abst_body(e), new_ctx), abst_body(e), new_ctx);
+            case task_kind::Binder: {
+                // The type of the domain is only on the stack for Pi-expressions, and it is used by the task Pi.
+                if (is_pi(e)) {
+                    expr t1 = check_type(results.back(), abst_domain(e), ctx);
+                    results.back() = is_bool(t1) ? Type() : t1;
+                }
+                scopes.push();
+                todo.emplace_back(task_kind::Visit, abst_body(e), extend(ctx, abst_name(e), abst_domain(e)));
+                break;
             }
-            if (is_bool(t2))
-                return t2;
-            if (is_type(t1) && is_type(t2)) {
-                return save_result(e, mk_type(max(ty_level(t1), ty_level(t2))), shared);
-            } else {
-                lean_assert(m_uc);
-                justification jst = mk_max_type_justification(ctx, e);
-                expr r = m_menv->mk_metavar(ctx);
-                m_uc->push_back(mk_max_constraint(new_ctx, lift_free_vars(t1, 0, 1), t2, r, jst));
-                return save_result(e, r, shared);
+            case task_kind::Lambda: {
+                scopes.pop();
+                expr b = results.back(); results.pop_back();
+                results.push_back(save_result(e, mk_pi(abst_name(e), abst_domain(e), b), t.m_shared));
+                break;
             }
-        }
-        case expr_kind::Let: {
-            optional<expr> lt;
-            if (m_infer_only) {
-                lt = let_type(e);
-            } else {
-                if (let_type(e)) {
-                    expr value_ty = infer_type_core(let_value(e), ctx);
-                    expr ty       = infer_type_core(*let_type(e), ctx);
+            case task_kind::Pi: {
+                context new_ctx = extend(ctx, abst_name(e), abst_domain(e));
+                expr t2 = results.back(); results.pop_back();
+                t2 = check_type(t2, abst_body(e), new_ctx);
+                scopes.pop();
+                expr t1 = results.back(); results.pop_back();
+                if (is_bool(t2)) {
+                    results.push_back(t2);
+                } else if (is_type(t1) && is_type(t2)) {
+                    results.push_back(save_result(e, mk_type(max(ty_level(t1), ty_level(t2))), t.m_shared));
+                } else {
+                    lean_assert(m_uc);
+                    justification jst = mk_max_type_justification(ctx, e);
+                    expr r = m_menv->mk_metavar(ctx);
+                    m_uc->push_back(mk_max_constraint(new_ctx, lift_free_vars(t1, 0, 1), t2, r, jst));
+                    results.push_back(save_result(e, r, t.m_shared));
+                }
+                break;
+            }
+            case task_kind::LetValue: {
+                optional<expr> lt;
+                if (m_infer_only) {
+                    lt = let_type(e);
+                } else if (let_type(e)) {
+                    expr ty       = results.back(); results.pop_back();
+                    expr value_ty = results.back(); results.pop_back();
                     check_type(ty, *let_type(e), ctx); // check if it is really a type
                     // thunk for creating justification object if needed
                     auto mk_justification = [&](){ return mk_def_type_match_justification(ctx, let_name(e), let_value(e)); };
@@ -290,16 +492,22 @@ class type_checker::imp {
                         throw def_type_mismatch_exception(env(), ctx, let_name(e), *let_type(e), let_value(e), value_ty);
                     lt = let_type(e);
                 } else {
-                    lt = infer_type_core(let_value(e), ctx);
+                    lt = results.back(); results.pop_back();
                 }
+                scopes.push();
+                todo.emplace_back(task_kind::Let, e, ctx, t.m_shared);
+                todo.emplace_back(task_kind::Visit, let_body(e), extend(ctx, let_name(e), lt, let_value(e)));
+                break;
             }
-            {
-                freset<cache> reset(m_cache);
-                expr t = infer_type_core(let_body(e), extend(ctx, let_name(e), lt, let_value(e)));
-                return save_result(e, instantiate(t, let_value(e)), shared);
-            }
-        }}
-        lean_unreachable(); // LCOV_EXCL_LINE
+            case task_kind::Let: {
+                scopes.pop();
+                expr b = results.back(); results.pop_back();
+                results.push_back(save_result(e, instantiate(b, let_value(e)), t.m_shared));
+                break;
+            }}
+        }
+        lean_assert(results.size() == 1);
+        return results[0];
     }
 
     bool is_convertible_core(expr const & given, expr const & expected) {
@@ -327,10 +535,246 @@ class type_checker::imp {
         }
     }
 
+    /**
+       \brief Return the weak head normal form of \c e. Beta, let and context definitions are reduced,
+       but constants defined in the environment are \em not unfolded.
+    */
+    expr whnf_core(expr e, context const & ctx) {
+        while (true) {
+            switch (e.kind()) {
+            case expr_kind::Var: {
+                optional<context_entry> entry = ctx.find(var_idx(e));
+                if (entry && entry->get_body()) {
+                    e = lift_free_vars(*(entry->get_body()), var_idx(e) + 1);
+                    break;
+                }
+                return e;
+            }
+            case expr_kind::Let:
+                e = instantiate(let_body(e), let_value(e));
+                break;
+            case expr_kind::App: {
+                expr const & f = arg(e, 0);
+                expr new_f     = whnf_core(f, ctx);
+                if (is_lambda(new_f)) {
+                    e = apply_beta(new_f, num_args(e) - 1, &arg(e, 1));
+                    break;
+                } else if (is_eqp(f, new_f)) {
+                    return e;
+                } else {
+                    buffer<expr> new_args;
+                    new_args.push_back(new_f);
+                    new_args.append(num_args(e) - 1, &arg(e, 1));
+                    return mk_app(new_args);
+                }
+            }
+            case expr_kind::Constant: case expr_kind::Type:   case expr_kind::Value:
+            case expr_kind::Lambda:   case expr_kind::Pi:     case expr_kind::MetaVar:
+                return e;
+            }
+        }
+    }
+
+    /**
+       \brief Return the definition that must be unfolded to make progress on \c e, i.e.,
+       the definition of the constant \c e or of the function in the head of the application \c e.
+    */
+    optional<object> get_unfoldable(expr const & e, bool unfold_opaque) {
+        expr const & f = is_app(e) ? arg(e, 0) : e;
+        if (is_constant(f)) {
+            optional<object> obj = env()->find_object(const_name(f));
+            if (should_unfold(obj, unfold_opaque))
+                return obj;
+        }
+        return none_object();
+    }
+
+    /** \brief Replace the constant in the head of \c e with its definition \c obj, and put the result in weak head normal form. */
+    expr unfold(expr const & e, object const & obj, context const & ctx) {
+        if (is_app(e)) {
+            buffer<expr> new_args;
+            new_args.push_back(obj.get_value());
+            new_args.append(num_args(e) - 1, &arg(e, 1));
+            return whnf_core(mk_app(new_args), ctx);
+        } else {
+            return whnf_core(obj.get_value(), ctx);
+        }
+    }
+
+    /**
+       \brief Compare the arguments of two applications with the same head.
+       The result is false if a pair of arguments is known to be different, and none if it is unknown.
+    */
+    optional<bool> is_def_eq_args(expr const & t, expr const & s, context const & ctx, bool unfold_opaque) {
+        lean_assert(is_app(t) && is_app(s));
+        if (num_args(t) != num_args(s))
+            return optional<bool>(false);
+        optional<bool> r(true);
+        for (unsigned i = 1; i < num_args(t); i++) {
+            optional<bool> r_i = is_def_eq_lazy(arg(t, i), arg(s, i), ctx, unfold_opaque, false);
+            if (!r_i)
+                r = optional<bool>();
+            else if (!*r_i)
+                return r_i;
+        }
+        return r;
+    }
+
+    /** \brief Return true iff \c e is a metavariable or the application of a metavariable or semantic attachment. */
+    static bool is_flex(expr const & e) {
+        expr const & f = is_app(e) ? arg(e, 0) : e;
+        return is_metavar(f) || (is_app(e) && is_value(f));
+    }
+
+    /**
+       \brief Return true if the normalizer may reduce the Pi \c e to a Boolean value.
+       The normalizer reduces implications between Boolean values.
+    */
+    bool may_reduce_to_bool_value(expr const & e, context const & ctx, bool unfold_opaque) {
+        lean_assert(is_pi(e));
+        if (!is_arrow(e))
+            return false;
+        expr d = whnf_core(abst_domain(e), ctx);
+        while (optional<object> obj = get_unfoldable(d, unfold_opaque))
+            d = unfold(d, *obj, ctx);
+        return is_bool_value(d) || is_flex(d) || (is_pi(d) && may_reduce_to_bool_value(d, ctx, unfold_opaque));
+    }
+
+    /**
+       \brief Compare two terms in weak head normal form that cannot be delta-reduced anymore.
+       See \c is_def_eq_lazy.
+    */
+    optional<bool> is_def_eq_rigid(expr const & t, expr const & s, context const & ctx, bool unfold_opaque, bool conv) {
+        if (conv) {
+            if (is_type(s) && is_type(t) && env()->is_ge(ty_level(s), ty_level(t)))
+                return optional<bool>(true);
+            if (is_type(s) && is_bool(t))
+                return optional<bool>(true);
+        }
+        if (is_flex(t) || is_flex(s)) {
+            // The result depends on metavariable assignments or on the arguments of semantic attachments.
+            // So, we can only conclude that the terms are equal.
+            if (is_app(t) && is_app(s) && arg(t, 0) == arg(s, 0)) {
+                optional<bool> r = is_def_eq_args(t, s, ctx, unfold_opaque);
+                if (r && *r)
+                    return r;
+            }
+            return optional<bool>();
+        }
+        if (t.kind() != s.kind()) {
+            if ((is_pi(t) && is_value(s) && may_reduce_to_bool_value(t, ctx, unfold_opaque)) ||
+                (is_pi(s) && is_value(t) && may_reduce_to_bool_value(s, ctx, unfold_opaque)))
+                return optional<bool>();
+            return optional<bool>(false);
+        }
+        switch (t.kind()) {
+        case expr_kind::Var:
+            return optional<bool>(var_idx(t) == var_idx(s));
+        case expr_kind::Constant:
+            return optional<bool>(const_name(t) == const_name(s));
+        case expr_kind::Type:
+            return optional<bool>(conv ? env()->is_ge(ty_level(s), ty_level(t)) : ty_level(t) == ty_level(s));
+        case expr_kind::Value:
+            return optional<bool>(to_value(t) == to_value(s));
+        case expr_kind::App: {
+            optional<bool> r = is_def_eq_lazy(arg(t, 0), arg(s, 0), ctx, unfold_opaque, false);
+            if (!r || !*r)
+                return r;
+            return is_def_eq_args(t, s, ctx, unfold_opaque);
+        }
+        case expr_kind::Lambda: case expr_kind::Pi: {
+            optional<bool> r = is_def_eq_lazy(abst_domain(t), abst_domain(s), ctx, unfold_opaque, false);
+            if (r && *r) {
+                context new_ctx = extend(ctx, abst_name(t), abst_domain(t));
+                // Remark: the range of a Pi is covariant in convertibility checks.
+                r = is_def_eq_lazy(abst_body(t), abst_body(s), new_ctx, unfold_opaque, conv && is_pi(t));
+            }
+            if (r && !*r && is_pi(t) && (may_reduce_to_bool_value(t, ctx, unfold_opaque) || may_reduce_to_bool_value(s, ctx, unfold_opaque)))
+                return optional<bool>();
+            return r;
+        }
+        case expr_kind::Let: case expr_kind::MetaVar:
+            lean_unreachable(); // LCOV_EXCL_LINE
+        }
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+
+    /**
+       \brief Lazy delta-reduction convertibility check.
+
+       The terms \c t and \c s are put in weak head normal form, and definitions are unfolded
+       one layer at a time. When both heads can be unfolded, we unfold the one with the greater weight
+       (i.e., the one defined on top of the other). When both heads are the same constant,
+       we first try to compare the arguments.
+
+       If \c conv is true, then we check whether \c t is convertible to \c s, otherwise we check
+       whether they are definitionally equal.
+
+       The result is none if the answer depends on metavariables or on semantic attachments.
+       In this case, the caller should fall back to full normalization.
+    */
+    optional<bool> is_def_eq_lazy(expr const & t, expr const & s, context const & ctx, bool unfold_opaque, bool conv) {
+        check_system("type checker");
+        if (t == s)
+            return optional<bool>(true);
+        // Remark: the definitional equality of closed terms does not depend on the context.
+        bool use_cache = !conv && !has_metavar(t) && !has_metavar(s) && closed(t) && closed(s);
+        if (use_cache && m_eq_cache.find(expr_pair(t, s)) != m_eq_cache.end())
+            return optional<bool>(true);
+        optional<bool> r = is_def_eq_lazy_core(t, s, ctx, unfold_opaque, conv);
+        if (use_cache && r && *r) {
+            if (m_eq_cache.size() >= LEAN_TYPE_CHECKER_EQ_CACHE_SIZE)
+                m_eq_cache.clear();
+            m_eq_cache.insert(expr_pair(t, s));
+        }
+        return r;
+    }
+
+    optional<bool> is_def_eq_lazy_core(expr const & t, expr const & s, context const & ctx, bool unfold_opaque, bool conv) {
+        expr t_n = whnf_core(t, ctx);
+        expr s_n = whnf_core(s, ctx);
+        if ((!is_eqp(t_n, t) || !is_eqp(s_n, s)) && t_n == s_n)
+            return optional<bool>(true);
+        while (true) {
+            optional<object> d_t = get_unfoldable(t_n, unfold_opaque);
+            optional<object> d_s = get_unfoldable(s_n, unfold_opaque);
+            if (!d_t && !d_s) {
+                break;
+            } else if (d_t && (!d_s || d_t->get_weight() > d_s->get_weight())) {
+                t_n = unfold(t_n, *d_t, ctx);
+            } else if (d_s && (!d_t || d_s->get_weight() > d_t->get_weight())) {
+                s_n = unfold(s_n, *d_s, ctx);
+            } else {
+                if (is_app(t_n) && is_app(s_n) && d_t->cell() == d_s->cell()) {
+                    // Same definition in the head, try to avoid unfolding it.
+                    optional<bool> r = is_def_eq_args(t_n, s_n, ctx, unfold_opaque);
+                    if (r && *r)
+                        return r;
+                }
+                t_n = unfold(t_n, *d_t, ctx);
+                s_n = unfold(s_n, *d_s, ctx);
+            }
+            if (t_n == s_n)
+                return optional<bool>(true);
+        }
+        return is_def_eq_rigid(t_n, s_n, ctx, unfold_opaque, conv);
+    }
+
     template<typename MkJustification>
     bool is_convertible(expr const & given, expr const & expected, context const & ctx, MkJustification const & mk_justification) {
         if (is_convertible_core(given, expected))
             return true;
+        if (m_lazy_delta) {
+            optional<bool> r = is_def_eq_lazy(given, expected, ctx, false, true);
+            if (r && *r)
+                return true;
+            if (!m_uc) {
+                // No unification constraints can be produced, so a definite answer with opaque definitions is final.
+                r = is_def_eq_lazy(given, expected, ctx, true, true);
+                if (r)
+                    return *r;
+            }
+        }
         expr new_given    = normalize(given, ctx, false);
         expr new_expected = normalize(expected, ctx, false);
         if (is_convertible_core(new_given, new_expected))
@@ -348,7 +792,9 @@ class type_checker::imp {
 
     void set_ctx(context const & ctx) {
         if (!is_eqp(m_ctx, ctx)) {
-            clear();
+            // closed terms are not affected by the context
+            clear_cache();
+            m_menv.clear();
             m_ctx = ctx;
         }
     }
@@ -374,15 +820,20 @@ class type_checker::imp {
     };
 
 public:
-    imp(ro_environment const & env, bool infer_only):
+    imp(ro_environment const & env, bool infer_only, options const & opts):
         m_env(env),
-        m_normalizer(env) {
+        m_normalizer(env, opts) {
         m_uc              = nullptr;
         m_infer_only      = infer_only;
+        m_lazy_delta      = get_type_checker_lazy_delta(opts);
+        m_cache_hits      = 0;
+        m_cache_misses    = 0;
     }
 
     expr infer_check(expr const & e, context const & ctx, optional<metavar_env> const & menv, buffer<unification_constraint> * uc,
                      bool infer_only) {
+        scoped_expr_eq_memo set_memo(m_eq_memo);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         set_infer_only set(*this, infer_only);
         set_ctx(ctx);
         update_menv(menv);
@@ -399,6 +850,8 @@ public:
     }
 
     bool is_convertible(expr const & t1, expr const & t2, context const & ctx, optional<metavar_env> const & menv) {
+        scoped_expr_eq_memo set_memo(m_eq_memo);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         set_ctx(ctx);
         update_menv(menv);
         auto mk_justification = [](){
@@ -408,10 +861,20 @@ public:
     }
 
     bool is_definitionally_equal(expr const & t1, expr const & t2, context const & ctx, optional<metavar_env> const & menv) {
+        scoped_expr_eq_memo set_memo(m_eq_memo);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         set_ctx(ctx);
         update_menv(menv);
         if (t1 == t2)
             return true;
+        if (m_lazy_delta) {
+            optional<bool> r = is_def_eq_lazy(t1, t2, ctx, false, false);
+            if (r && *r)
+                return true;
+            r = is_def_eq_lazy(t1, t2, ctx, true, false);
+            if (r)
+                return *r;
+        }
         expr new_t1 = normalize(t1, ctx, false);
         expr new_t2 = normalize(t2, ctx, false);
         if (new_t1 == new_t2)
@@ -422,6 +885,8 @@ public:
     }
 
     void check_type(expr const & e, context const & ctx) {
+        scoped_expr_eq_memo set_memo(m_eq_memo);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         set_ctx(ctx);
         update_menv(none_menv());
         expr t = infer_type_core(e, ctx);
@@ -446,6 +911,8 @@ public:
     }
 
     expr ensure_pi(expr const & e, context const & ctx, optional<metavar_env> const & menv) {
+        scoped_expr_eq_memo set_memo(m_eq_memo);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         set_ctx(ctx);
         update_menv(menv);
         try {
@@ -457,21 +924,33 @@ public:
 
     void clear_cache() {
         m_cache.clear();
+        m_eq_cache.clear();
         m_normalizer.clear();
     }
 
     void clear() {
         clear_cache();
+        m_closed_cache.clear();
+        m_eq_memo.clear();
+        m_instantiate_memo.clear();
         m_menv.clear();
         m_ctx = context();
     }
 
+    unsigned get_num_cache_hits() const { return m_cache_hits; }
+    unsigned get_num_cache_misses() const { return m_cache_misses; }
+    expr_eq_memo const & get_eq_memo() const { return m_eq_memo; }
+    instantiate_memo const & get_instantiate_memo() const { return m_instantiate_memo; }
+
     normalizer & get_normalizer() {
         return m_normalizer;
     }
 };
 
-type_checker::type_checker(ro_environment const & env, bool infer_only):m_ptr(new imp(env, infer_only)) {}
+type_checker::type_checker(ro_environment const & env, bool infer_only):
+    m_ptr(new imp(env, infer_only, options())) {}
+type_checker::type_checker(ro_environment const & env, options const & opts, bool infer_only):
+    m_ptr(new imp(env, infer_only, opts)) {}
 type_checker::~type_checker() {}
 expr type_checker::infer_type(expr const & e, context const & ctx, optional<metavar_env> const & menv, buffer<unification_constraint> * uc) {
     return m_ptr->infer_type(e, ctx, menv, uc);
@@ -546,6 +1025,10 @@ bool type_checker::is_flex_proposition(expr const & e, context const & ctx) {
     return is_flex_proposition(e, ctx, none_ro_menv());
 }
 void type_checker::clear() { m_ptr->clear(); }
+unsigned type_checker::get_num_cache_hits() const { return m_ptr->get_num_cache_hits(); }
+unsigned type_checker::get_num_cache_misses() const { return m_ptr->get_num_cache_misses(); }
+expr_eq_memo const & type_checker::get_eq_memo() const { return m_ptr->get_eq_memo(); }
+instantiate_memo const & type_checker::get_instantiate_memo() const { return m_ptr->get_instantiate_memo(); }
 normalizer & type_checker::get_normalizer() { return m_ptr->get_normalizer(); }
 expr  type_check(expr const & e, ro_environment const & env, context const & ctx) {
     return type_checker(env).check(e, ctx);
@@ -14,6 +14,9 @@ Author: Leonardo de Moura
 namespace lean {
 class environment;
 class normalizer;
+class expr_eq_memo;
+class instantiate_memo;
+class options;
 
 /**
    \brief Given pi == (Pi x : A, B x), return (B a)
@@ -32,6 +35,12 @@ class type_checker {
     std::unique_ptr<imp> m_ptr;
 public:
     type_checker(ro_environment const & env, bool infer_only = false);
+    /**
+       \brief Create a type checker configured using \c opts.
+       The option <tt>kernel::type_checker::lazy_delta</tt> controls whether convertibility checks
+       unfold definitions lazily before normalizing terms.
+    */
+    type_checker(ro_environment const & env, options const & opts, bool infer_only = false);
     ~type_checker();
 
     /**
@@ -112,6 +121,26 @@ public:
     /** \brief Reset internal caches */
     void clear();
 
+    /**
+        \brief Return the number of hits and misses in the type inference cache.
+
+        \remark Closed terms without metavariables are cached independently of the context,
+        and survive context switches. The other terms are only cached while the context does not change.
+    */
+    unsigned get_num_cache_hits() const;
+    unsigned get_num_cache_misses() const;
+
+    /**
+        \brief Return the memo used by the structural equality tests performed by this type checker.
+        The memo survives context switches, and it is only reset by \c clear.
+    */
+    expr_eq_memo const & get_eq_memo() const;
+    /**
+        \brief Return the memo used by instantiate and apply_beta when invoked by this type checker (and its normalizer).
+        Its entries do not depend on the context, and it is only reset by \c clear.
+    */
+    instantiate_memo const & get_instantiate_memo() const;
+
     /** \brief Return reference to the normalizer used by this type checker. */
     normalizer & get_normalizer();
 };
@@ -22,13 +22,13 @@ expr const Int = mk_Int();
 expr mk_int_type() { return mk_Int(); }
 
 class int_value_value : public value {
-    mpz m_val;
+    small_mpz m_val;
 protected:
     virtual bool lt(value const & other) const {
         return m_val < static_cast<int_value_value const &>(other).m_val;
     }
 public:
-    int_value_value(mpz const & v):m_val(v) {}
+    int_value_value(small_mpz const & v):m_val(v) {}
     virtual ~int_value_value() {}
     virtual expr get_type() const { return Int; }
     virtual name get_name() const { return name{"Int", "numeral"}; }
@@ -39,28 +39,31 @@ public:
     virtual void display(std::ostream & out) const { out << m_val; }
     virtual format pp() const { return pp(false, false); }
     virtual format pp(bool unicode, bool coercion) const {
-        if (coercion && m_val >= 0)
-            return format{to_value(mk_nat_to_int_fn()).pp(unicode, coercion), space(), format(m_val)};
+        if (coercion && !m_val.is_neg())
+            return format{to_value(mk_nat_to_int_fn()).pp(unicode, coercion), space(), format(m_val.to_mpz())};
         else
-            return format(m_val);
+            return format(m_val.to_mpz());
     }
     virtual unsigned hash() const { return m_val.hash(); }
-    virtual int push_lua(lua_State * L) const { return push_mpz(L, m_val); }
-    mpz const & get_num() const { return m_val; }
+    virtual int push_lua(lua_State * L) const { return push_mpz(L, m_val.to_mpz()); }
+    small_mpz const & get_num() const { return m_val; }
     virtual void write(serializer & s) const { s << "int" << m_val; }
 };
 
-expr mk_int_value(mpz const & v) {
+expr mk_int_value(small_mpz const & v) {
     return mk_value(*(new int_value_value(v)));
 }
-static value::register_deserializer_fn int_value_ds("int", [](deserializer & d) { return mk_int_value(read_mpz(d)); });
-static register_builtin_fn int_value_blt(name({"Int", "numeral"}), []() { return mk_int_value(mpz(0)); }, true);
+expr mk_int_value(mpz const & v) {
+    return mk_int_value(small_mpz(v));
+}
+static value::register_deserializer_fn int_value_ds("int", [](deserializer & d) { return mk_int_value(read_small_mpz(d)); });
+static register_builtin_fn int_value_blt(name({"Int", "numeral"}), []() { return mk_int_value(0); }, true);
 
 bool is_int_value(expr const & e) {
     return is_value(e) && dynamic_cast<int_value_value const *>(&to_value(e)) != nullptr;
 }
 
-mpz const & int_value_numeral(expr const & e) {
+small_mpz const & int_value_numeral(expr const & e) {
     lean_assert(is_int_value(e));
     return static_cast<int_value_value const &>(to_value(e)).get_num();
 }
@@ -84,14 +87,14 @@ public:
 };
 
 constexpr char int_add_name[] = "add";
-struct int_add_eval { mpz operator()(mpz const & v1, mpz const & v2) { return v1 + v2; }; };
+struct int_add_eval { small_mpz operator()(small_mpz const & v1, small_mpz const & v2) { return v1 + v2; }; };
 typedef int_bin_op<int_add_name, int_add_eval> int_add_value;
 MK_BUILTIN(Int_add_fn, int_add_value);
 static value::register_deserializer_fn int_add_ds("int_add", [](deserializer & ) { return mk_Int_add_fn(); });
 static register_builtin_fn g_int_add_value(name({"Int", "add"}), []() { return mk_Int_add_fn(); });
 
 constexpr char int_mul_name[] = "mul";
-struct int_mul_eval { mpz operator()(mpz const & v1, mpz const & v2) { return v1 * v2; }; };
+struct int_mul_eval { small_mpz operator()(small_mpz const & v1, small_mpz const & v2) { return v1 * v2; }; };
 typedef int_bin_op<int_mul_name, int_mul_eval> int_mul_value;
 MK_BUILTIN(Int_mul_fn, int_mul_value);
 static value::register_deserializer_fn int_mul_ds("int_mul", [](deserializer & ) { return mk_Int_mul_fn(); });
@@ -99,7 +102,7 @@ static register_builtin_fn int_mul_blt(name({"Int", "mul"}), []() { return mk_In
 
 constexpr char int_div_name[] = "div";
 struct int_div_eval {
-    mpz operator()(mpz const & v1, mpz const & v2) {
+    small_mpz operator()(small_mpz const & v1, small_mpz const & v2) {
         if (v2.is_zero())
             return v2;
         else
@@ -6,7 +6,7 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include "util/lua.h"
-#include "util/numerics/mpz.h"
+#include "util/numerics/small_mpz.h"
 #include "kernel/expr.h"
 #include "kernel/kernel.h"
 #include "library/arith/Int_decls.h"
@@ -18,10 +18,15 @@ extern expr const Int;
 
 /** \brief Return the value of type Integer that represents \c v. */
 expr mk_int_value(mpz const & v);
-inline expr mk_int_value(int v) { return mk_int_value(mpz(v)); }
+expr mk_int_value(small_mpz const & v);
+inline expr mk_int_value(int v) { return mk_int_value(small_mpz(v)); }
 inline expr iVal(int v) { return mk_int_value(v); }
 bool is_int_value(expr const & e);
-mpz const & int_value_numeral(expr const & e);
+/**
+    \brief Return the numeral stored in the given value.
+    \remark Small numerals do not use GMP, \see small_mpz
+*/
+small_mpz const & int_value_numeral(expr const & e);
 
 expr mk_Int_add_fn();
 inline expr mk_Int_add(expr const & e1, expr const & e2) { return mk_app(mk_Int_add_fn(), e1, e2); }
@@ -19,13 +19,13 @@ expr const Nat = mk_Nat();
 expr mk_nat_type() { return mk_Nat(); }
 
 class nat_value_value : public value {
-    mpz m_val;
+    small_mpz m_val;
 protected:
     virtual bool lt(value const & other) const {
         return m_val < static_cast<nat_value_value const &>(other).m_val;
     }
 public:
-    nat_value_value(mpz const & v):m_val(v) { lean_assert(v >= 0); }
+    nat_value_value(small_mpz const & v):m_val(v) { lean_assert(!v.is_neg()); }
     virtual ~nat_value_value() {}
     virtual expr get_type() const { return Nat; }
     virtual name get_name() const { return name{"Nat", "numeral"}; }
@@ -34,24 +34,27 @@ public:
         return _other && _other->m_val == m_val;
     }
     virtual void display(std::ostream & out) const { out << m_val; }
-    virtual format pp() const { return format(m_val); }
+    virtual format pp() const { return format(m_val.to_mpz()); }
     virtual format pp(bool, bool) const { return pp(); }
     virtual unsigned hash() const { return m_val.hash(); }
-    virtual int push_lua(lua_State * L) const { return push_mpz(L, m_val); }
-    mpz const & get_num() const { return m_val; }
+    virtual int push_lua(lua_State * L) const { return push_mpz(L, m_val.to_mpz()); }
+    small_mpz const & get_num() const { return m_val; }
     virtual void write(serializer & s) const { s << "nat" << m_val; }
 };
-expr mk_nat_value(mpz const & v) {
+expr mk_nat_value(small_mpz const & v) {
     return mk_value(*(new nat_value_value(v)));
 }
-static value::register_deserializer_fn nat_value_ds("nat", [](deserializer & d) { return mk_nat_value(read_mpz(d)); });
-static register_builtin_fn nat_value_blt(name({"Nat", "numeral"}), []() { return mk_nat_value(mpz(0)); }, true);
+expr mk_nat_value(mpz const & v) {
+    return mk_nat_value(small_mpz(v));
+}
+static value::register_deserializer_fn nat_value_ds("nat", [](deserializer & d) { return mk_nat_value(read_small_mpz(d)); });
+static register_builtin_fn nat_value_blt(name({"Nat", "numeral"}), []() { return mk_nat_value(0u); }, true);
 
 bool is_nat_value(expr const & e) {
     return is_value(e) && dynamic_cast<nat_value_value const *>(&to_value(e)) != nullptr;
 }
 
-mpz const & nat_value_numeral(expr const & e) {
+small_mpz const & nat_value_numeral(expr const & e) {
     lean_assert(is_nat_value(e));
     return static_cast<nat_value_value const &>(to_value(e)).get_num();
 }
@@ -76,7 +79,7 @@ public:
 
 constexpr char nat_add_name[] = "add";
 /** \brief Evaluator for + : Nat -> Nat -> Nat */
-struct nat_add_eval { mpz operator()(mpz const & v1, mpz const & v2) { return v1 + v2; }; };
+struct nat_add_eval { small_mpz operator()(small_mpz const & v1, small_mpz const & v2) { return v1 + v2; }; };
 typedef nat_bin_op<nat_add_name, nat_add_eval> nat_add_value;
 MK_BUILTIN(Nat_add_fn, nat_add_value);
 static value::register_deserializer_fn nat_add_ds("nat_add", [](deserializer & ) { return mk_Nat_add_fn(); });
@@ -84,7 +87,7 @@ static register_builtin_fn nat_add_blt(name({"Nat", "add"}), []() { return mk_Na
 
 constexpr char nat_mul_name[] = "mul";
 /** \brief Evaluator for * : Nat -> Nat -> Nat */
-struct nat_mul_eval { mpz operator()(mpz const & v1, mpz const & v2) { return v1 * v2; }; };
+struct nat_mul_eval { small_mpz operator()(small_mpz const & v1, small_mpz const & v2) { return v1 * v2; }; };
 typedef nat_bin_op<nat_mul_name, nat_mul_eval> nat_mul_value;
 MK_BUILTIN(Nat_mul_fn, nat_mul_value);
 static value::register_deserializer_fn nat_mul_ds("nat_mul", [](deserializer & ) { return mk_Nat_mul_fn(); });
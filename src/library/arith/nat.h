@@ -8,7 +8,7 @@ Author: Leonardo de Moura
 #include "util/lua.h"
 #include "kernel/expr.h"
 #include "kernel/kernel.h"
-#include "util/numerics/mpz.h"
+#include "util/numerics/small_mpz.h"
 #include "library/arith/Nat_decls.h"
 
 namespace lean {
@@ -18,10 +18,15 @@ extern expr const Nat;
 
 /** \brief Return the value of type Natural number that represents \c v. */
 expr mk_nat_value(mpz const & v);
-inline expr mk_nat_value(unsigned v) { return mk_nat_value(mpz(v)); }
+expr mk_nat_value(small_mpz const & v);
+inline expr mk_nat_value(unsigned v) { return mk_nat_value(small_mpz(v)); }
 inline expr nVal(unsigned v) { return mk_nat_value(v); }
 bool is_nat_value(expr const & e);
-mpz const & nat_value_numeral(expr const & e);
+/**
+    \brief Return the numeral stored in the given value.
+    \remark Small numerals do not use GMP, \see small_mpz
+*/
+small_mpz const & nat_value_numeral(expr const & e);
 
 expr mk_Nat_add_fn();
 inline expr mk_Nat_add(expr const & e1, expr const & e2) { return mk_app(mk_Nat_add_fn(), e1, e2); }
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <memory>
 #include <string>
 #include "kernel/abstract.h"
 #include "kernel/environment.h"
@@ -24,44 +25,66 @@ expr mk_real_type() { return mk_Real(); }
    \brief Semantic attachment for "Real" values.
    It is actually for rational values. We should eventually rename it to
    rat_value_value
+
+   \remark Integral values are stored in a small_mpz, so arithmetic on them does not use GMP
+   when they are small. The other values are stored in a mpq.
 */
 class real_value_value : public value {
-    mpq m_val;
+    small_mpz            m_int;
+    std::unique_ptr<mpq> m_rat; // nullptr if the value is integral
 protected:
     virtual bool lt(value const & other) const {
-        return m_val < static_cast<real_value_value const &>(other).m_val;
+        return cmp(*this, static_cast<real_value_value const &>(other)) < 0;
     }
 public:
-    real_value_value(mpq const & v):m_val(v) {}
+    real_value_value(small_mpz const & v):m_int(v) {}
+    real_value_value(mpq const & v) {
+        if (v.is_integer())
+            m_int = small_mpz(v.get_numerator());
+        else
+            m_rat.reset(new mpq(v));
+    }
     virtual ~real_value_value() {}
     virtual expr get_type() const { return Real; }
     virtual name get_name() const { return name{"Real", "numeral"}; }
     virtual bool operator==(value const & other) const {
         real_value_value const * _other = dynamic_cast<real_value_value const*>(&other);
-        return _other && _other->m_val == m_val;
+        return _other && cmp(*this, *_other) == 0;
     }
-    virtual void display(std::ostream & out) const { out << m_val; }
+    virtual void display(std::ostream & out) const { out << get_num(); }
     virtual format pp() const { return pp(false, false); }
     virtual format pp(bool, bool coercion) const {
         if (coercion)
-            return format{format(const_name(mk_nat_to_real_fn())), space(), format(m_val)};
+            return format{format(const_name(mk_nat_to_real_fn())), space(), format(get_num())};
         else
-            return format(m_val);
+            return format(get_num());
+    }
+    virtual unsigned hash() const { return is_int() ? m_int.hash() : m_rat->hash(); }
+    virtual int push_lua(lua_State * L) const { return push_mpq(L, get_num()); }
+    bool is_int() const { return !m_rat; }
+    small_mpz const & get_int() const { lean_assert(is_int()); return m_int; }
+    mpq get_num() const { return is_int() ? mpq(m_int.to_mpz()) : *m_rat; }
+    virtual void write(serializer & s) const { s << "real" << get_num(); }
+    friend int cmp(real_value_value const & a, real_value_value const & b) {
+        if (a.is_int() && b.is_int())
+            return cmp(a.m_int, b.m_int);
+        else
+            return cmp(a.get_num(), b.get_num());
     }
-    virtual unsigned hash() const { return m_val.hash(); }
-    virtual int push_lua(lua_State * L) const { return push_mpq(L, m_val); }
-    mpq const & get_num() const { return m_val; }
-    virtual void write(serializer & s) const { s << "real" << m_val; }
 };
 
 expr mk_real_value(mpq const & v)  {  return mk_value(*(new real_value_value(v))); }
+expr mk_real_value(small_mpz const & v) { return mk_value(*(new real_value_value(v))); }
 bool is_real_value(expr const & e) { return is_value(e) && dynamic_cast<real_value_value const *>(&to_value(e)) != nullptr; }
-mpq const & real_value_numeral(expr const & e) {
+static real_value_value const & to_real_value(expr const & e) {
     lean_assert(is_real_value(e));
-    return static_cast<real_value_value const &>(to_value(e)).get_num();
+    return static_cast<real_value_value const &>(to_value(e));
+}
+mpq real_value_numeral(expr const & e) {
+    return to_real_value(e).get_num();
 }
 static value::register_deserializer_fn real_value_ds("real", [](deserializer & d) { return mk_real_value(read_mpq(d)); });
-static register_builtin_fn real_value_blt(name({"Real", "numeral"}), []() { return mk_real_value(mpq(0)); }, true);
+static register_builtin_fn real_value_blt(name({"Real", "numeral"}), []() { return mk_real_value(small_mpz(0)); }, true);
 
 /**
    \brief Template for semantic attachments that are binary operators of
@@ -73,7 +96,7 @@ public:
     real_bin_op():const_value(name("Real", Name), Real >> (Real >> Real)) {}
     virtual optional<expr> normalize(unsigned num_args, expr const * args) const {
         if (num_args == 3 && is_real_value(args[1]) && is_real_value(args[2])) {
-            return some_expr(mk_real_value(F()(real_value_numeral(args[1]), real_value_numeral(args[2]))));
+            return some_expr(F()(to_real_value(args[1]), to_real_value(args[2])));
         } else {
             return none_expr();
         }
@@ -83,7 +106,14 @@ public:
 
 constexpr char real_add_name[] = "add";
 /** \brief Evaluator for + : Real -> Real -> Real */
-struct real_add_eval { mpq operator()(mpq const & v1, mpq const & v2) { return v1 + v2; }; };
+struct real_add_eval {
+    expr operator()(real_value_value const & v1, real_value_value const & v2) {
+        if (v1.is_int() && v2.is_int())
+            return mk_real_value(v1.get_int() + v2.get_int());
+        else
+            return mk_real_value(v1.get_num() + v2.get_num());
+    };
+};
 typedef real_bin_op<real_add_name, real_add_eval> real_add_value;
 MK_BUILTIN(Real_add_fn, real_add_value);
 static value::register_deserializer_fn real_add_ds("real_add", [](deserializer & ) { return mk_Real_add_fn(); });
@@ -92,7 +122,14 @@ static register_builtin_fn real_add_blt(name({"Real", "add"}), []() { return mk_
 
 constexpr char real_mul_name[] = "mul";
 /** \brief Evaluator for * : Real -> Real -> Real */
-struct real_mul_eval { mpq operator()(mpq const & v1, mpq const & v2) { return v1 * v2; }; };
+struct real_mul_eval {
+    expr operator()(real_value_value const & v1, real_value_value const & v2) {
+        if (v1.is_int() && v2.is_int())
+            return mk_real_value(v1.get_int() * v2.get_int());
+        else
+            return mk_real_value(v1.get_num() * v2.get_num());
+    };
+};
 typedef real_bin_op<real_mul_name, real_mul_eval> real_mul_value;
 MK_BUILTIN(Real_mul_fn, real_mul_value);
 static value::register_deserializer_fn real_mul_ds("real_mul", [](deserializer & ) { return mk_Real_mul_fn(); });
@@ -101,11 +138,15 @@ static register_builtin_fn real_mul_blt(name({"Real", "mul"}), []() { return mk_
 constexpr char real_div_name[] = "div";
 /** \brief Evaluator for / : Real -> Real -> Real */
 struct real_div_eval {
-    mpq operator()(mpq const & v1, mpq const & v2) {
-        if (v2.is_zero())
-            return v2;
-        else
-            return v1 / v2;
+    expr operator()(real_value_value const & v1, real_value_value const & v2) {
+        if (v2.is_int() && v2.get_int().is_zero())
+            return mk_real_value(small_mpz(0));
+        if (v1.is_int() && v2.is_int()) {
+            small_mpz q = v1.get_int() / v2.get_int();
+            if (q * v2.get_int() == v1.get_int())
+                return mk_real_value(q);
+        }
+        return mk_real_value(v1.get_num() / v2.get_num());
     };
 };
 typedef real_bin_op<real_div_name, real_div_eval> real_div_value;
@@ -122,7 +163,7 @@ public:
     real_le_value():const_value(name{"Real", "le"}, Real >> (Real >> Bool)) {}
     virtual optional<expr> normalize(unsigned num_args, expr const * args) const {
         if (num_args == 3 && is_real_value(args[1]) && is_real_value(args[2])) {
-            return some_expr(mk_bool_value(real_value_numeral(args[1]) <= real_value_numeral(args[2])));
+            return some_expr(mk_bool_value(cmp(to_real_value(args[1]), to_real_value(args[2])) <= 0));
         } else {
             return none_expr();
         }
@@ -138,7 +179,7 @@ public:
     int_to_real_value():const_value("int_to_real", Int >> Real) {}
     virtual optional<expr> normalize(unsigned num_args, expr const * args) const {
         if (num_args == 2 && is_int_value(args[1])) {
-            return some_expr(mk_real_value(mpq(int_value_numeral(args[1]))));
+            return some_expr(mk_real_value(int_value_numeral(args[1])));
         } else {
             return none_expr();
         }
@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #pragma once
 #include "util/lua.h"
 #include "util/numerics/mpq.h"
+#include "util/numerics/small_mpz.h"
 #include "kernel/expr.h"
 #include "kernel/kernel.h"
 #include "library/arith/Real_decls.h"
@@ -18,10 +19,11 @@ extern expr const Real;
 
 /** \brief Return the value of type Real that represents \c v. */
 expr mk_real_value(mpq const & v);
-inline expr mk_real_value(int v) { return mk_real_value(mpq(v)); }
+expr mk_real_value(small_mpz const & v);
+inline expr mk_real_value(int v) { return mk_real_value(small_mpz(v)); }
 inline expr rVal(int v) { return mk_real_value(v); }
 bool is_real_value(expr const & e);
-mpq const & real_value_numeral(expr const & e);
+mpq real_value_numeral(expr const & e);
 
 expr mk_Real_add_fn();
 inline expr mk_Real_add(expr const & e1, expr const & e2) { return mk_app(mk_Real_add_fn(), e1, e2); }
@@ -6,11 +6,18 @@ Author: Leonardo de Moura
 */
 #include <memory>
 #include <vector>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <algorithm>
+#include <functional>
 #include "util/list.h"
 #include "util/splay_tree.h"
+#include "util/hamt.h"
 #include "util/interrupt.h"
+#include "util/thread.h"
 #include "kernel/for_each_fn.h"
 #include "kernel/formatter.h"
 #include "kernel/free_vars.h"
@@ -20,46 +27,252 @@ Author: Leonardo de Moura
 #include "kernel/kernel.h"
 #include "kernel/type_checker.h"
 #include "kernel/update_expr.h"
+#include "kernel/expr_maps.h"
 #include "library/printer.h"
 #include "library/equality.h"
 #include "library/elaborator/elaborator.h"
 #include "library/elaborator/elaborator_justification.h"
 
+#ifndef LEAN_DEFAULT_ELABORATOR_PARALLEL_CASE_SPLITS
+#define LEAN_DEFAULT_ELABORATOR_PARALLEL_CASE_SPLITS 1
+#endif
+
+#ifndef LEAN_DEFAULT_ELABORATOR_DETERMINISTIC
+#define LEAN_DEFAULT_ELABORATOR_DETERMINISTIC true
+#endif
+
 namespace lean {
 static name g_x_name("x");
 
+static name g_elaborator_parallel_case_splits {"elaborator", "parallel_case_splits"};
+static name g_elaborator_deterministic        {"elaborator", "deterministic"};
+RegisterUnsignedOption(g_elaborator_parallel_case_splits, LEAN_DEFAULT_ELABORATOR_PARALLEL_CASE_SPLITS,
+                       "(elaborator) number of alternatives of a case-split explored in parallel (0 and 1 mean sequential search), "
+                       "the nogoods learned while exploring an alternative are not shared with the other ones");
+RegisterBoolOption(g_elaborator_deterministic, LEAN_DEFAULT_ELABORATOR_DETERMINISTIC,
+                   "(elaborator) when alternatives are explored in parallel, use the first successful one in the sequential order");
+unsigned get_elaborator_parallel_case_splits(options const & opts) {
+    return opts.get_unsigned(g_elaborator_parallel_case_splits, LEAN_DEFAULT_ELABORATOR_PARALLEL_CASE_SPLITS);
+}
+bool get_elaborator_deterministic(options const & opts) {
+    return opts.get_bool(g_elaborator_deterministic, LEAN_DEFAULT_ELABORATOR_DETERMINISTIC);
+}
+
 class elaborator::imp {
     typedef splay_tree<name, name_cmp>                         name_set;
     typedef list<unification_constraint>                       cnstr_list;
     typedef list<name>                                         name_list;
-    typedef list<std::pair<unification_constraint, name_list>> delayed_cnstr_list;
+
+    /**
+       \brief Active and delayed constraints of a state.
+
+       Active constraints are processed in LIFO order. A delayed constraint is waiting for the assignment of one of
+       its metavariables. The delayed constraints are indexed by the metavariables they contain (watch lists), then
+       assigning a metavariable only wakes up the constraints containing it. The constraints of the form
+       <tt>max(L1, L2) == ?m</tt> and <tt>Type << ?m</tt> (see \c is_lower) are indexed by \c ?m.
+
+       All fields are persistent data structures, then copying a constraint store (e.g., at case splits) is O(1).
+    */
+    class cnstr_store {
+        typedef hamt<unsigned, unification_constraint, std::hash<unsigned>, std::equal_to<unsigned>> delayed_map;
+        typedef hamt<name, list<unsigned>, name_hash, name_eq>       watch_map;
+        typedef hamt<expr, unsigned, expr_hash, std::equal_to<expr>> bound_map;
+        cnstr_list     m_active;
+        delayed_map    m_delayed;          // id -> delayed constraint
+        list<unsigned> m_delayed_ids;      // ids of the delayed constraints, the most recent ones first (it may contain removed ids)
+        unsigned       m_delayed_ids_size;
+        unsigned       m_next_delayed_id;
+        watch_map      m_watches;          // metavariable -> ids of the delayed constraints containing it
+        bound_map      m_max_rhs;          // ?m -> number of constraints max(L1, L2) == ?m
+        bound_map      m_lower;            // ?m -> number of constraints (Type << ?m)
+
+        static void update_bound(bound_map & m, expr const & e, bool inc) {
+            unsigned const * n = m.find(e);
+            if (inc)
+                m.insert(e, n ? *n + 1 : 1);
+            else if (*n == 1)
+                m.erase(e);
+            else
+                m.insert(e, *n - 1);
+        }
+
+        void update_bounds(unification_constraint const & c, bool inc) {
+            if (is_max(c) && is_metavar(max_rhs(c)))
+                update_bound(m_max_rhs, max_rhs(c), inc);
+            else if (is_lower(c) && is_metavar(convertible_to(c)))
+                update_bound(m_lower, convertible_to(c), inc);
+        }
+
+        void remove_delayed(unsigned id) {
+            update_bounds(*m_delayed.find(id), false);
+            m_delayed.erase(id);
+        }
+
+        /** \brief Remove the ids of removed constraints from \c m_delayed_ids when they are the majority. */
+        void compact() {
+            if (m_delayed_ids_size <= 2 * m_delayed.size() + 16)
+                return;
+            buffer<unsigned> ids;
+            for (unsigned id : m_delayed_ids) {
+                if (m_delayed.contains(id))
+                    ids.push_back(id);
+            }
+            m_delayed_ids      = to_list(ids.begin(), ids.end());
+            m_delayed_ids_size = ids.size();
+        }
+
+    public:
+        cnstr_store():m_delayed_ids_size(0), m_next_delayed_id(0) {}
+
+        bool has_active() const { return !is_nil(m_active); }
+        bool has_delayed() const { return !m_delayed.empty(); }
+
+        void push_active(unification_constraint const & c) {
+            // std::cout << "PUSHING: "; display(std::cout, c); std::cout << "\n";
+            m_active = cons(c, m_active);
+            update_bounds(c, true);
+        }
+
+        unification_constraint pop_active() {
+            unification_constraint c = head(m_active);
+            m_active = tail(m_active);
+            update_bounds(c, false);
+            return c;
+        }
+
+        /** \brief Add a delayed constraint, \c mvars are the metavariables occurring in \c c. */
+        void push_delayed(unification_constraint const & c, name_list const & mvars) {
+            unsigned id = m_next_delayed_id++;
+            m_delayed.insert(id, c);
+            m_delayed_ids = cons(id, m_delayed_ids);
+            m_delayed_ids_size++;
+            for (name const & m : mvars) {
+                list<unsigned> const * ids = m_watches.find(m);
+                m_watches.insert(m, cons(id, ids ? *ids : list<unsigned>()));
+            }
+            update_bounds(c, true);
+        }
+
+        /**
+           \brief Move the delayed constraints containing metavariables in \c assigned to the active list.
+           The least recent ones are processed first. Return the number of constraints moved.
+        */
+        unsigned wake_up(name_set const & assigned) {
+            buffer<unsigned> ids;
+            assigned.for_each([&](name const & m) {
+                    if (list<unsigned> const * w = m_watches.find(m)) {
+                        for (unsigned id : *w) {
+                            if (m_delayed.contains(id))
+                                ids.push_back(id);
+                        }
+                        m_watches.erase(m);
+                    }
+                });
+            std::sort(ids.begin(), ids.end(), std::greater<unsigned>());
+            ids.shrink(std::unique(ids.begin(), ids.end()) - ids.begin());
+            for (unsigned id : ids) {
+                unification_constraint c = *m_delayed.find(id);
+                remove_delayed(id);
+                push_active(c);
+            }
+            compact();
+            return ids.size();
+        }
+
+        /**
+           \brief Remove the least recent delayed constraint that satisfies \c p.
+
+           \remark \c p may update the store (e.g., when it creates a case-split).
+           The delayed constraints visited are the ones before the first call to \c p.
+        */
+        template<typename P>
+        void remove_last_delayed(P && p) {
+            delayed_map delayed = m_delayed;
+            buffer<unsigned> ids;
+            to_buffer(m_delayed_ids, ids);
+            unsigned i = ids.size();
+            while (i > 0) {
+                --i;
+                if (unification_constraint const * c = delayed.find(ids[i])) {
+                    if (p(*c)) {
+                        if (m_delayed.contains(ids[i]))
+                            remove_delayed(ids[i]);
+                        compact();
+                        return;
+                    }
+                }
+            }
+        }
+
+        /** \brief Return true iff the store contains a constraint of the form <tt>max(L1, L2) == m</tt>. */
+        bool has_max_rhs(expr const & m) const { return m_max_rhs.contains(m); }
+        /** \brief Return true iff the store contains a constraint <tt>m' << m</tt> such that <tt>is_lower(m' << m)</tt>. */
+        bool has_lower(expr const & m) const { return m_lower.contains(m); }
+
+        template<typename F>
+        void for_each_active(F && f) const {
+            for (auto const & c : m_active)
+                f(c);
+        }
+
+        /** \brief Apply \c f to the delayed constraints, the most recent ones first. */
+        template<typename F>
+        void for_each_delayed(F && f) const {
+            for (unsigned id : m_delayed_ids) {
+                if (unification_constraint const * c = m_delayed.find(id))
+                    f(*c);
+            }
+        }
+    };
 
     struct state {
         metavar_env        m_menv;
-        cnstr_list         m_active_cnstrs;
-        delayed_cnstr_list m_delayed_cnstrs;
+        cnstr_store        m_cnstrs;
         name_set           m_recently_assigned; // recently assigned metavars
         state(metavar_env const & menv, unsigned num_cnstrs, unification_constraint const * cnstrs):
-            m_menv(menv.copy()),
-            m_active_cnstrs(to_list(cnstrs, cnstrs + num_cnstrs)) {
+            m_menv(menv.copy()) {
+            unsigned i = num_cnstrs;
+            while (i > 0) {
+                --i;
+                m_cnstrs.push_active(cnstrs[i]);
+            }
         }
 
         state(state const & other):
             m_menv(other.m_menv.copy()),
-            m_active_cnstrs(other.m_active_cnstrs),
-            m_delayed_cnstrs(other.m_delayed_cnstrs),
+            m_cnstrs(other.m_cnstrs),
             m_recently_assigned(other.m_recently_assigned) {
         }
 
         state & operator=(state const & other) {
             m_menv  = other.m_menv.copy();
-            m_active_cnstrs = other.m_active_cnstrs;
-            m_delayed_cnstrs = other.m_delayed_cnstrs;
+            m_cnstrs = other.m_cnstrs;
             m_recently_assigned = other.m_recently_assigned;
             return *this;
         }
     };
 
+    /**
+       \brief Case-splits (positions in \c m_case_splits) a conflict depends on.
+       If \c m_exact is false, then the conflict also depends on assumptions that are not the ones of the current case-splits.
+    */
+    struct conflict_levels {
+        std::set<unsigned> m_levels;
+        bool               m_exact;
+        conflict_levels():m_exact(true) {}
+        void merge(conflict_levels const & ls) {
+            m_levels.insert(ls.m_levels.begin(), ls.m_levels.end());
+            m_exact = m_exact && ls.m_exact;
+        }
+    };
+
+    /** \brief Branch of a case-split: the state, and the assumption used to justify it. */
+    struct branch {
+        state         m_state;
+        justification m_assumption;
+        branch(state const & s, justification const & a):m_state(s), m_assumption(a) {}
+    };
+
     /**
        \brief Base class for case splits performed by the elaborator.
     */
@@ -67,13 +280,24 @@ class elaborator::imp {
         justification              m_curr_assumption; // object used to justify current split
         state                      m_prev_state;
         std::vector<justification> m_failed_justifications; // justifications for failed branches
+        conflict_levels            m_failed_levels; // case-splits (below this one) the failed branches depend on
+        // The following fields are only used when branches are explored in parallel (see next_parallel_case)
+        std::deque<branch>         m_pending;       // branches whose exploration was cancelled
+        std::unique_ptr<imp>       m_delegate;      // elaborator that solved the current branch
 
         case_split(state const & prev_state):m_prev_state(prev_state) {}
         virtual ~case_split() {}
 
         virtual bool next(imp & owner) = 0;
+        /** \brief Return the constraint that generated the case split. */
+        virtual unification_constraint const & get_constraint() const = 0;
+        /** \brief Return the next branch, it is only used when branches are explored in parallel. */
+        virtual optional<branch> next_branch(imp &) { return optional<branch>(); }
     };
 
+    /** \brief Metavariable and alternative selected by a branch of a choice case-split. */
+    typedef std::pair<expr, expr> decision;
+
     /**
        \brief Case-split object for choice constraints.
     */
@@ -92,6 +316,18 @@ class elaborator::imp {
         virtual bool next(imp & owner) {
             return owner.next_choice_case(*this);
         }
+
+        virtual unification_constraint const & get_constraint() const { return m_choice; }
+
+        virtual optional<branch> next_branch(imp & owner) {
+            return owner.next_choice_branch(*this);
+        }
+
+        /** \brief Return the choice of the current branch. */
+        decision get_decision() const {
+            lean_assert(m_idx > 0);
+            return decision(choice_mvar(m_choice), choice_ith(m_choice, m_idx - 1));
+        }
     };
 
     /**
@@ -115,6 +351,18 @@ class elaborator::imp {
             return owner.next_generic_case(*this);
         }
 
+        virtual unification_constraint const & get_constraint() const { return m_constraint; }
+
+        virtual optional<branch> next_branch(imp &) {
+            unsigned sz = m_states.size();
+            if (m_idx < sz) {
+                m_idx++;
+                return optional<branch>(branch(m_states[sz - m_idx], m_assumptions[sz - m_idx]));
+            } else {
+                return optional<branch>();
+            }
+        }
+
         void push_back(state const & s, justification const & tr) {
             m_states.push_back(s);
             m_assumptions.push_back(tr);
@@ -136,44 +384,69 @@ class elaborator::imp {
         virtual bool next(imp & owner) {
             return owner.next_plugin_case(*this);
         }
+
+        virtual unification_constraint const & get_constraint() const { return m_constraint; }
     };
 
     ro_environment                           m_env;
     type_inferer                             m_type_inferer;
     normalizer                               m_normalizer;
+    instantiate_memo                         m_instantiate_memo;
     state                                    m_state;
     std::vector<std::unique_ptr<case_split>> m_case_splits;
+    /**
+       \brief A nogood is a combination of choices that was shown to fail (or whose solutions were already produced).
+       The branches of choice case-splits that would complete a nogood are skipped.
+    */
+    struct nogood {
+        std::vector<decision> m_decisions;
+        justification         m_conflict;  // failure used to learn the nogood
+        nogood(std::vector<decision> const & ds, justification const & c):m_decisions(ds), m_conflict(c) {}
+    };
+    std::vector<nogood>                      m_nogoods;
+    // target of choice constraint -> nogoods containing it
+    // Remark: the target is usually a metavariable, but it may be an arbitrary expression (see process_lower).
+    expr_struct_map<std::vector<unsigned>>   m_nogood_index;
     std::shared_ptr<elaborator_plugin>       m_plugin;
-    unsigned                                 m_next_id;
+    // Remark: the counter is shared with the elaborators exploring branches in parallel (see next_parallel_case)
+    std::shared_ptr<atomic<unsigned>>        m_next_id;
     justification                            m_conflict;
     bool                                     m_first;
     level                                    m_U; // universe U used for builtin kernel axioms
+    elaborator_stats                         m_stats;
 
     // options
     bool                                     m_use_justifications;
     bool                                     m_use_normalizer;
     bool                                     m_assume_injectivity;
+    unsigned                                 m_parallel_case_splits;
+    bool                                     m_deterministic;
 
-    void set_options(options const &) {
-        m_use_justifications = true;
-        m_use_normalizer     = true;
-        m_assume_injectivity = true;
+    void set_options(options const & opts) {
+        m_use_justifications   = true;
+        m_use_normalizer       = true;
+        m_assume_injectivity   = true;
+        m_parallel_case_splits = get_elaborator_parallel_case_splits(opts);
+        m_deterministic        = get_elaborator_deterministic(opts);
+#if !defined(LEAN_MULTI_THREAD)
+        m_parallel_case_splits = 1;
+#endif
+        if (m_plugin) {
+            // plugins are not assumed to be thread safe
+            m_parallel_case_splits = 1;
+        }
     }
 
+    bool parallel_case_splits() const { return m_parallel_case_splits > 1; }
+
     justification mk_assumption() {
-        unsigned id = m_next_id;
-        m_next_id++;
+        unsigned id = (*m_next_id)++;
         return mk_assumption_justification(id);
     }
 
-    void push_front(cnstr_list & clist, unification_constraint const & c) {
-        // std::cout << "PUSHING: "; display(std::cout, c); std::cout << "\n";
-        clist = cons(c, clist);
-    }
-
     /** \brief Add given constraint to active list */
     void push_active(unification_constraint const & c) {
-        push_front(m_state.m_active_cnstrs, c);
+        m_state.m_cnstrs.push_active(c);
     }
 
     /** \brief Push all contraints in the collection to the active list */
@@ -215,7 +488,7 @@ class elaborator::imp {
 
     /** \brief Add given constraint to the delayed list */
     void push_delayed(unification_constraint const & c) {
-        m_state.m_delayed_cnstrs.emplace_front(c, collect_mvars(c));
+        m_state.m_cnstrs.push_delayed(c, collect_mvars(c));
     }
 
     /** \brief Return true iff \c m is an assigned metavariable in the current state */
@@ -281,6 +554,7 @@ class elaborator::imp {
             return false;
         }
         try {
+            m_stats.m_num_type_checker_calls++;
             return m_type_inferer.is_proposition(a, ctx);
         } catch (...) {
             return false;
@@ -319,30 +593,30 @@ class elaborator::imp {
     }
 
     /**
-       \brief Push a new constraint to the active_cnstrs.
+       \brief Push a new constraint to the active constraints of \c cnstrs.
        If \c is_eq is true, then a equality constraint is created, otherwise a convertability constraint is created.
     */
-    void push_new_constraint(cnstr_list & active_cnstrs, bool is_eq,
+    void push_new_constraint(cnstr_store & cnstrs, bool is_eq,
                              context const & new_ctx, expr const & new_a, expr const & new_b, justification const & new_jst) {
         if (new_a == new_b)
             return; // trivial constraint
         if (is_eq)
-            push_front(active_cnstrs, mk_eq_constraint(new_ctx, new_a, new_b, new_jst));
+            cnstrs.push_active(mk_eq_constraint(new_ctx, new_a, new_b, new_jst));
         else
-            push_front(active_cnstrs, mk_convertible_constraint(new_ctx, new_a, new_b, new_jst));
+            cnstrs.push_active(mk_convertible_constraint(new_ctx, new_a, new_b, new_jst));
     }
 
     /**
-       \brief Push a new equality constraint <tt>new_ctx |- new_a == new_b</tt> into the active_cnstrs using
+       \brief Push a new equality constraint <tt>new_ctx |- new_a == new_b</tt> into the active constraints of \c cnstrs using
        justification \c new_jst.
     */
-    void push_new_eq_constraint(cnstr_list & active_cnstrs,
+    void push_new_eq_constraint(cnstr_store & cnstrs,
                                 context const & new_ctx, expr const & new_a, expr const & new_b, justification const & new_jst) {
-        push_new_constraint(active_cnstrs, true, new_ctx, new_a, new_b, new_jst);
+        push_new_constraint(cnstrs, true, new_ctx, new_a, new_b, new_jst);
     }
 
     void push_new_eq_constraint(context const & new_ctx, expr const & new_a, expr const & new_b, justification const & new_jst) {
-        push_new_eq_constraint(m_state.m_active_cnstrs, new_ctx, new_a, new_b, new_jst);
+        push_new_eq_constraint(m_state.m_cnstrs, new_ctx, new_a, new_b, new_jst);
     }
 
     /**
@@ -350,7 +624,7 @@ class elaborator::imp {
        If \c is_eq is true, then a equality constraint is created, otherwise a convertability constraint is created.
     */
     void push_new_constraint(bool is_eq, context const & new_ctx, expr const & new_a, expr const & new_b, justification const & new_jst) {
-        push_new_constraint(m_state.m_active_cnstrs, is_eq, new_ctx, new_a, new_b, new_jst);
+        push_new_constraint(m_state.m_cnstrs, is_eq, new_ctx, new_a, new_b, new_jst);
     }
 
     /**
@@ -359,7 +633,7 @@ class elaborator::imp {
        The update is justified by \c new_jst.
     */
     void push_updated_constraint(unification_constraint const & c, expr const & new_a, expr const & new_b, justification const & new_jst) {
-        push_new_constraint(m_state.m_active_cnstrs, is_eq(c), get_context(c), new_a, new_b, new_jst);
+        push_new_constraint(m_state.m_cnstrs, is_eq(c), get_context(c), new_a, new_b, new_jst);
     }
 
     /**
@@ -411,6 +685,7 @@ class elaborator::imp {
         }
         if (menv->has_type(m)) {
             buffer<unification_constraint> ucs;
+            m_stats.m_num_type_checker_calls++;
             expr tv = m_type_inferer(v, ctx, menv, ucs);
             push_active(ucs);
             justification new_jst(new typeof_mvar_justification(ctx, m, menv->get_type(m), tv, jst));
@@ -422,10 +697,10 @@ class elaborator::imp {
 
     bool process(unification_constraint const & c) {
         switch (c.kind()) {
-        case unification_constraint_kind::Eq:          return process_eq(c);
-        case unification_constraint_kind::Convertible: return process_convertible(c);
-        case unification_constraint_kind::Max:         return process_max(c);
-        case unification_constraint_kind::Choice:      return process_choice(c);
+        case unification_constraint_kind::Eq:          m_stats.m_num_eq++;          return process_eq(c);
+        case unification_constraint_kind::Convertible: m_stats.m_num_convertible++; return process_convertible(c);
+        case unification_constraint_kind::Max:         m_stats.m_num_max++;         return process_max(c);
+        case unification_constraint_kind::Choice:      m_stats.m_num_choice++;      return process_choice(c);
         }
         lean_unreachable(); // LCOV_EXCL_LINE
         return true;
@@ -577,6 +852,7 @@ class elaborator::imp {
     }
 
     expr normalize(context const & ctx, expr const & a) {
+        m_stats.m_num_normalizer_calls++;
         return m_normalizer(a, ctx, m_state.m_menv);
     }
 
@@ -723,6 +999,7 @@ class elaborator::imp {
 
     optional<expr> try_get_type(context const & ctx, expr const & e) {
         try {
+            m_stats.m_num_type_checker_calls++;
             return some_expr(m_type_inferer(e, ctx));
         } catch (...) {
             return none_expr();
@@ -852,19 +1129,20 @@ class elaborator::imp {
                     expr s = mk_lambda(types, mk_app_vars(lift_free_vars(f, 0, n), n));
                     state new_state(m_state);
                     justification new_assumption = mk_assumption();
-                    push_new_eq_constraint(new_state.m_active_cnstrs, ctx, m, s, new_assumption);
+                    push_new_eq_constraint(new_state.m_cnstrs, ctx, m, s, new_assumption);
                     new_cs->push_back(new_state, new_assumption);
                 }
                 {
                     // m = f
                     state new_state(m_state);
                     justification new_assumption = mk_assumption();
-                    push_new_eq_constraint(new_state.m_active_cnstrs, ctx, m, f, new_assumption);
+                    push_new_eq_constraint(new_state.m_cnstrs, ctx, m, f, new_assumption);
                     new_cs->push_back(new_state, new_assumption);
                 }
                 // add case split
                 bool r = new_cs->next(*this);
                 lean_assert(r);
+                m_stats.m_num_case_splits++;
                 m_case_splits.push_back(std::move(new_cs));
                 return r;
             }
@@ -887,6 +1165,7 @@ class elaborator::imp {
         buffer<expr> arg_types;
         buffer<unification_constraint> ucs;
         for (unsigned i = 1; i < num_a; i++) {
+            m_stats.m_num_type_checker_calls++;
             arg_types.push_back(m_type_inferer(arg(a, i), ctx, menv, ucs));
             push_active(ucs);
         }
@@ -900,8 +1179,8 @@ class elaborator::imp {
             expr new_b           = b;
             if (!is_lhs)
                 swap(new_a, new_b);
-            push_new_constraint(new_state.m_active_cnstrs, is_eq(c), ctx, new_a, new_b, new_assumption);
-            push_new_eq_constraint(new_state.m_active_cnstrs, ctx, f_a, proj, new_assumption);
+            push_new_constraint(new_state.m_cnstrs, is_eq(c), ctx, new_a, new_b, new_assumption);
+            push_new_eq_constraint(new_state.m_cnstrs, ctx, f_a, proj, new_assumption);
             new_cs->push_back(new_state, new_assumption);
         }
         // Add imitation
@@ -920,7 +1199,7 @@ class elaborator::imp {
             for (unsigned i = 1; i < num_b; i++) {
                 expr h_i = new_state.m_menv->mk_metavar(ctx);
                 imitation_args.push_back(mk_app_vars(add_lift(h_i, 0, num_a - 1), num_a - 1));
-                push_new_eq_constraint(new_state.m_active_cnstrs, ctx, update_app(a, 0, h_i), arg(b, i), new_assumption);
+                push_new_eq_constraint(new_state.m_cnstrs, ctx, update_app(a, 0, h_i), arg(b, i), new_assumption);
             }
             imitation = mk_lambda(arg_types, mk_app(imitation_args));
         } else if (is_abstraction(b)) {
@@ -932,13 +1211,13 @@ class elaborator::imp {
             expr h_1 = new_state.m_menv->mk_metavar(ctx);
             context new_ctx = extend(ctx, abst_name(b), abst_domain(b));
             expr h_2 = new_state.m_menv->mk_metavar(extend(ctx, abst_name(b), abst_domain(b)));
-            push_new_eq_constraint(new_state.m_active_cnstrs, ctx, update_app(a, 0, h_1), abst_domain(b), new_assumption);
+            push_new_eq_constraint(new_state.m_cnstrs, ctx, update_app(a, 0, h_1), abst_domain(b), new_assumption);
             if (is_arrow(b)) {
-                push_new_eq_constraint(new_state.m_active_cnstrs, new_ctx,
+                push_new_eq_constraint(new_state.m_cnstrs, new_ctx,
                                        update_app(lift_free_vars(a, 1), 0, h_2), abst_body(b), new_assumption);
                 imitation = mk_lambda(arg_types, update_abstraction(b, mk_app_vars(add_lift(h_1, 0, num_a - 1), num_a - 1), mk_app_vars(add_lift(h_2, 1, num_a - 1), num_a - 1, 1)));
             } else {
-                push_new_eq_constraint(new_state.m_active_cnstrs, new_ctx,
+                push_new_eq_constraint(new_state.m_cnstrs, new_ctx,
                                        mk_app(update_app(lift_free_vars(a, 1), 0, h_2), mk_var(0)), abst_body(b), new_assumption);
                 imitation = mk_lambda(arg_types, update_abstraction(b, mk_app_vars(add_lift(h_1, 0, num_a - 1), num_a - 1), mk_app_vars(add_lift(h_2, 1, num_a - 1), num_a)));
             }
@@ -947,7 +1226,7 @@ class elaborator::imp {
             // Assign f_a <- fun (x_1 : T_1) ... (x_{num_a} : T_{num_a}), b
             imitation = mk_lambda(arg_types, lift_free_vars(b, 0, num_a - 1, new_state.m_menv));
         }
-        push_new_eq_constraint(new_state.m_active_cnstrs, ctx, f_a, imitation, new_assumption);
+        push_new_eq_constraint(new_state.m_cnstrs, ctx, f_a, imitation, new_assumption);
         new_cs->push_back(new_state, new_assumption);
     }
 
@@ -976,6 +1255,7 @@ class elaborator::imp {
             process_meta_app_core(new_cs, b, a, !is_lhs, c);
         bool r = new_cs->next(*this);
         lean_assert(r);
+        m_stats.m_num_case_splits++;
         m_case_splits.push_back(std::move(new_cs));
         return r;
     }
@@ -1127,11 +1407,12 @@ class elaborator::imp {
                 expr imitation = mk_app(new_args);
                 state new_state(m_state);
                 justification new_assumption = mk_assumption();
-                push_front(new_state.m_active_cnstrs, c);
-                push_new_eq_constraint(new_state.m_active_cnstrs, ctx_m, m, imitation, new_assumption);
+                new_state.m_cnstrs.push_active(c);
+                push_new_eq_constraint(new_state.m_cnstrs, ctx_m, m, imitation, new_assumption);
                 new_cs->push_back(new_state, new_assumption);
             }
             lean_verify(new_cs->next(*this));
+            m_stats.m_num_case_splits++;
             m_case_splits.push_back(std::move(new_cs));
         }
     }
@@ -1179,12 +1460,13 @@ class elaborator::imp {
                         state new_state(m_state);
                         justification new_assumption = mk_assumption();
                         if (keep_c)
-                            push_front(new_state.m_active_cnstrs, c);
-                        push_new_eq_constraint(new_state.m_active_cnstrs, ctx_m, m, s, new_assumption);
+                            new_state.m_cnstrs.push_active(c);
+                        push_new_eq_constraint(new_state.m_cnstrs, ctx_m, m, s, new_assumption);
                         new_cs->push_back(new_state, new_assumption);
                     }
                     bool r = new_cs->next(*this);
                     lean_assert(r);
+                    m_stats.m_num_case_splits++;
                     m_case_splits.push_back(std::move(new_cs));
                     return r;
                 }
@@ -1218,7 +1500,7 @@ class elaborator::imp {
     /**
        \brief Return true iff c is a constraint of the form <tt>ctx |- a << ?m</tt>, where \c a is Type or Bool
      */
-    bool is_lower(unification_constraint const & c) {
+    static bool is_lower(unification_constraint const & c) {
         return
             is_convertible(c) &&
             (is_metavar(convertible_to(c)) || is_meta_app(convertible_to(c))) &&
@@ -1254,15 +1536,11 @@ class elaborator::imp {
     */
     template<typename P>
     bool has_constraint(P p) {
-        for (auto const & c : m_state.m_active_cnstrs) {
-            if (p(c))
-                return true;
-        }
-        for (auto const & c : m_state.m_delayed_cnstrs) {
-            if (p(c.first))
-                return true;
-        }
-        return false;
+        bool r = false;
+        auto check = [&](unification_constraint const & c) { r = r || p(c); };
+        m_state.m_cnstrs.for_each_active(check);
+        m_state.m_cnstrs.for_each_delayed(check);
+        return r;
     }
 
     /**
@@ -1272,7 +1550,9 @@ class elaborator::imp {
     */
     bool has_max_constraint(expr const & a) {
         lean_assert(is_metavar(a));
-        return has_constraint([&](unification_constraint const & c) { return is_max(c) && max_rhs(c) == a; });
+        bool r = m_state.m_cnstrs.has_max_rhs(a);
+        lean_assert(r == has_constraint([&](unification_constraint const & c) { return is_max(c) && max_rhs(c) == a; }));
+        return r;
     }
 
 
@@ -1282,7 +1562,9 @@ class elaborator::imp {
     */
     bool has_lower(expr const & a) {
         lean_assert(is_metavar(a));
-        return has_constraint([&](unification_constraint const & c) { return is_lower(c) && convertible_to(c) == a; });
+        bool r = m_state.m_cnstrs.has_lower(a);
+        lean_assert(r == has_constraint([&](unification_constraint const & c) { return is_lower(c) && convertible_to(c) == a; }));
+        return r;
     }
 
     /** \brief Process constraint of the form <tt>ctx |- ?m << b</tt>, where \c a is Type */
@@ -1423,6 +1705,7 @@ class elaborator::imp {
         if (a == b)
             return true;
         if (has_no_metavar(ctx, a) && has_no_metavar(ctx, b)) {
+            m_stats.m_num_type_checker_calls++;
             if (m_type_inferer.is_convertible(a, b, ctx)) {
                 return true;
             } else {
@@ -1668,55 +1951,416 @@ class elaborator::imp {
     }
 
     bool process_choice(unification_constraint const & c) {
-        std::unique_ptr<case_split> new_cs(new choice_case_split(c, m_state));
-        bool r = new_cs->next(*this);
-        lean_assert(r);
-        m_case_splits.push_back(std::move(new_cs));
+        m_stats.m_num_case_splits++;
+        m_case_splits.push_back(std::unique_ptr<case_split>(new choice_case_split(c, m_state)));
+        if (m_case_splits.back()->next(*this))
+            return true;
+        // all alternatives are in learned nogoods
+        m_case_splits.pop_back();
+        return false;
+    }
+
+    /** \brief Return the case-splits that the justification \c j depends on. */
+    conflict_levels get_levels(justification const & j) const {
+        conflict_levels r;
+        if (!j)
+            return r;
+        std::unordered_map<justification_cell *, unsigned> level_of;
+        for (unsigned i = 0; i < m_case_splits.size(); i++)
+            level_of[m_case_splits[i]->m_curr_assumption.raw()] = i;
+        std::unordered_set<justification_cell *> visited;
+        buffer<justification_cell *> todo;
+        buffer<justification_cell *> children;
+        todo.push_back(j.raw());
+        while (!todo.empty()) {
+            justification_cell * curr = todo.back();
+            todo.pop_back();
+            if (!visited.insert(curr).second)
+                continue;
+            if (dynamic_cast<assumption_justification *>(curr)) {
+                auto it = level_of.find(curr);
+                if (it != level_of.end())
+                    r.m_levels.insert(it->second);
+                else
+                    r.m_exact = false;
+            } else {
+                children.clear();
+                curr->get_children(children);
+                for (justification_cell * child : children) {
+                    if (child)
+                        todo.push_back(child);
+                }
+            }
+        }
+        return r;
+    }
+
+    /**
+       \brief Learn a nogood from the conflict \c m_conflict of the current branch of the top case-split.
+       \c levels are the other case-splits the conflict depends on. Nothing is learned unless all of them
+       (and the top one) are choice case-splits.
+    */
+    void learn_nogood(conflict_levels const & levels) {
+        if (!levels.m_exact || parallel_case_splits()) {
+            // Remark: when branches are explored in parallel, the current branch of a choice case-split is not
+            // the last one created (see get_decision). Moreover, this elaborator has only the top case-split since
+            // the rest of the search is delegated, and the nogoods are learned by the elaborators exploring the
+            // branches. They are not shared with the other branches.
+            return;
+        }
+        std::vector<decision> ds;
+        for (unsigned l : levels.m_levels) {
+            auto cs = dynamic_cast<choice_case_split const *>(m_case_splits[l].get());
+            if (!cs)
+                return;
+            ds.push_back(cs->get_decision());
+        }
+        auto top = dynamic_cast<choice_case_split const *>(m_case_splits.back().get());
+        if (!top)
+            return;
+        ds.push_back(top->get_decision());
+        unsigned idx = m_nogoods.size();
+        m_nogoods.emplace_back(ds, m_conflict);
+        for (decision const & d : ds) {
+            std::vector<unsigned> & ids = m_nogood_index[d.first];
+            if (ids.empty() || ids.back() != idx)
+                ids.push_back(idx);
+        }
+    }
+
+    /**
+       \brief Return a justification for skipping the alternative \c alt of the top (choice) case-split
+       when the choice <tt>m := alt</tt> completes a learned nogood. The case-splits containing the other
+       choices of the nogood are stored in \c levels.
+    */
+    optional<justification> find_nogood(expr const & m, expr const & alt, conflict_levels & levels) const {
+        auto it = m_nogood_index.find(m);
+        if (it == m_nogood_index.end())
+            return optional<justification>();
+        unsigned top = m_case_splits.size() - 1;
+        for (unsigned idx : it->second) {
+            nogood const & ng = m_nogoods[idx];
+            buffer<justification> as;
+            conflict_levels ls;
+            bool has_alt = false;
+            bool ok      = true;
+            for (decision const & d : ng.m_decisions) {
+                if (d.first == m && d.second == alt) {
+                    has_alt = true;
+                    continue;
+                }
+                ok = false;
+                for (unsigned l = 0; l < top; l++) {
+                    auto cs = dynamic_cast<choice_case_split const *>(m_case_splits[l].get());
+                    if (cs && cs->get_decision() == d) {
+                        as.push_back(cs->m_curr_assumption);
+                        ls.m_levels.insert(l);
+                        ok = true;
+                        break;
+                    }
+                }
+                if (!ok)
+                    break;
+            }
+            if (ok && has_alt) {
+                levels.merge(ls);
+                return optional<justification>(justification(new nogood_justification(ng.m_conflict, as.size(), as.data())));
+            }
+        }
+        return optional<justification>();
+    }
+
+    /**
+       \brief Record that the branch justified by the assumption \c a of the top case-split \c s failed, and
+       \c conflict is the reason. Return false iff the failure does not depend on \c a, i.e., the other branches fail too.
+    */
+    bool add_failed_branch(case_split & s, justification const & a, justification const & conflict) {
+        lean_assert(m_case_splits.back().get() == &s);
+        unsigned lvl = m_case_splits.size() - 1;
+        s.m_curr_assumption  = a;
+        conflict_levels levels = get_levels(conflict);
+        bool r = levels.m_levels.erase(lvl) > 0;
+        s.m_failed_justifications.push_back(conflict);
+        s.m_failed_levels.merge(levels);
         return r;
     }
 
+    enum class branch_status { Running, Solved, Failed, Exception, Cancelled };
+
+    /**
+       \brief Add the counters of the elaborator \c e (used for exploring a branch) to \c m_stats, and reset them.
+       The wall time is not added since it is already included in the time of this elaborator.
+    */
+    void collect_stats(imp & e) {
+        double t = m_stats.m_time;
+        m_stats += e.m_stats;
+        m_stats.m_time = t;
+        e.m_stats = elaborator_stats();
+    }
+
+    /**
+       \brief Move to the next branch of the top case-split \c s exploring (at most) \c m_parallel_case_splits
+       branches in parallel. Each branch is explored by a new elaborator in its own thread, and the one that solves
+       its branch becomes the delegate of \c s (i.e., it is used to produce the next solutions of the branch).
+       If \c m_deterministic is true, then the first branch (in the sequential order) that is solved is selected,
+       otherwise the first one to finish. The other threads are interrupted, and the branches they were exploring
+       are explored again if \c s is revisited.
+
+       Return false if all branches failed.
+    */
+    bool next_parallel_case(case_split & s) {
+        lean_assert(m_case_splits.back().get() == &s);
+        if (s.m_delegate) {
+            try {
+                s.m_delegate->next();
+                collect_stats(*s.m_delegate);
+                m_state = s.m_delegate->m_state;
+                return true;
+            } catch (elaborator_exception & ex) {
+                // The branch has no more solutions. Remark: the failure may not depend on s.m_curr_assumption
+                // since the delegate does not know about it, but the other branches may still have solutions.
+                collect_stats(*s.m_delegate);
+                s.m_delegate.reset();
+                add_failed_branch(s, s.m_curr_assumption, ex.get_justification());
+            }
+        }
+        while (true) {
+            std::vector<branch> bs;
+            while (bs.size() < m_parallel_case_splits && !s.m_pending.empty()) {
+                bs.push_back(s.m_pending.front());
+                s.m_pending.pop_front();
+            }
+            while (bs.size() < m_parallel_case_splits) {
+                if (auto b = s.next_branch(*this))
+                    bs.push_back(*b);
+                else
+                    break;
+            }
+            if (bs.empty()) {
+                return false;
+            } else if (bs.size() == 1) {
+                s.m_curr_assumption = bs[0].m_assumption;
+                m_state             = bs[0].m_state;
+                return true;
+            }
+            unsigned n = bs.size();
+            std::vector<std::unique_ptr<imp>> elbs;
+            for (branch const & b : bs)
+                elbs.emplace_back(new imp(*this, b.m_state));
+            std::vector<branch_status>      status(n, branch_status::Running);
+            std::vector<justification>      conflicts(n);
+            std::vector<std::exception_ptr> exs(n);
+            optional<unsigned>              winner;
+            explore_parallel(elbs, status, conflicts, exs, winner);
+            for (auto const & e : elbs)
+                collect_stats(*e);
+            std::vector<branch> cancelled;
+            for (unsigned i = 0; i < n; i++) {
+                if (winner && (i == *winner || (m_deterministic && i > *winner))) {
+                    if (i != *winner)
+                        cancelled.push_back(bs[i]);
+                    continue;
+                }
+                switch (status[i]) {
+                case branch_status::Failed:
+                    if (!add_failed_branch(s, bs[i].m_assumption, conflicts[i]) && (!winner || m_deterministic))
+                        return false;
+                    break;
+                case branch_status::Exception:
+                    if (!winner || m_deterministic)
+                        std::rethrow_exception(exs[i]);
+                    cancelled.push_back(bs[i]);
+                    break;
+                default:
+                    cancelled.push_back(bs[i]);
+                    break;
+                }
+            }
+            s.m_pending.insert(s.m_pending.begin(), cancelled.begin(), cancelled.end());
+            if (winner) {
+                s.m_curr_assumption = bs[*winner].m_assumption;
+                m_state             = elbs[*winner]->m_state;
+                s.m_delegate        = std::move(elbs[*winner]);
+                return true;
+            }
+        }
+    }
+
+    /**
+       \brief Execute <tt>elbs[i]->next()</tt> in parallel, and store the result in \c status, \c conflicts and \c exs.
+       Store in \c winner the branch that was selected (if any).
+    */
+    void explore_parallel(std::vector<std::unique_ptr<imp>> & elbs, std::vector<branch_status> & status,
+                          std::vector<justification> & conflicts, std::vector<std::exception_ptr> & exs,
+                          optional<unsigned> & winner) {
+#if defined(LEAN_MULTI_THREAD)
+        unsigned n = elbs.size();
+        mutex              mtx;
+        condition_variable cv;
+        std::vector<std::unique_ptr<interruptible_thread>> threads;
+        auto select = [&]() {
+            // return true if the exploration is finished
+            bool running = false;
+            for (unsigned i = 0; i < n; i++) {
+                if (status[i] == branch_status::Running) {
+                    running = true;
+                    if (m_deterministic)
+                        return false;
+                } else if (status[i] == branch_status::Solved) {
+                    winner = i;
+                    return true;
+                }
+            }
+            return !running;
+        };
+        auto stop = [&]() {
+            for (auto & th : threads)
+                th->request_interrupt();
+            for (auto & th : threads)
+                th->join();
+        };
+        for (unsigned i = 0; i < n; i++) {
+            threads.emplace_back(new interruptible_thread([&, i]() {
+                        branch_status r;
+                        justification c;
+                        std::exception_ptr ex;
+                        try {
+                            elbs[i]->next();
+                            r = branch_status::Solved;
+                        } catch (elaborator_exception & e) {
+                            r = branch_status::Failed;
+                            c = e.get_justification();
+                        } catch (interrupted &) {
+                            r = branch_status::Cancelled;
+                        } catch (...) {
+                            r = branch_status::Exception;
+                            ex = std::current_exception();
+                        }
+                        lock_guard<mutex> lock(mtx);
+                        status[i]    = r;
+                        conflicts[i] = c;
+                        exs[i]       = ex;
+                        cv.notify_all();
+                    }));
+        }
+        try {
+            unique_lock<mutex> lock(mtx);
+            chrono::milliseconds small(g_small_sleep);
+            while (!select()) {
+                cv.wait_for(lock, small);
+                lock.unlock();
+                check_interrupted();
+                lock.lock();
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+        stop();
+        for (unsigned i = 0; i < n; i++) {
+            if (status[i] == branch_status::Running)
+                status[i] = branch_status::Cancelled;
+        }
+#else
+        lean_unreachable();
+#endif
+    }
+
+    /**
+       \brief Backtrack to the last case-split the conflict \c m_conflict depends on (i.e., the case-splits above it are
+       discarded), and try its next branch. If it has no more branches, its failure becomes the new conflict.
+    */
     void resolve_conflict() {
         lean_assert(m_conflict);
+        m_stats.m_num_backtracks++;
 
         // std::cout << "Resolve conflict, num case_splits: " << m_case_splits.size() << "\n";
         // formatter fmt = mk_simple_formatter();
         // std::cout << m_conflict.pp(fmt, options(), nullptr, true) << "\n";
 
-        while (!m_case_splits.empty()) {
-            std::unique_ptr<case_split> & d = m_case_splits.back();
-            // std::cout << "Assumption " << d->m_curr_assumption.pp(fmt, options(), nullptr, true) << "\n";
-            if (depends_on(m_conflict, d->m_curr_assumption)) {
-                d->m_failed_justifications.push_back(m_conflict);
-                if (d->next(*this)) {
-                    m_conflict = justification();
-                    return;
-                }
+        conflict_levels levels = get_levels(m_conflict);
+        while (!levels.m_levels.empty()) {
+            unsigned lvl = *levels.m_levels.rbegin();
+            levels.m_levels.erase(lvl);
+            lean_assert(std::none_of(m_case_splits.begin() + lvl + 1, m_case_splits.end(),
+                                     [&](std::unique_ptr<case_split> const & d) { return depends_on(m_conflict, d->m_curr_assumption); }));
+            m_case_splits.resize(lvl + 1);
+            case_split & d = *(m_case_splits.back());
+            lean_assert(depends_on(m_conflict, d.m_curr_assumption));
+            learn_nogood(levels);
+            d.m_failed_justifications.push_back(m_conflict);
+            d.m_failed_levels.merge(levels);
+            if (d.next(*this)) {
+                m_conflict = justification();
+                return;
             }
+            levels = d.m_failed_levels;
+            levels.merge(get_levels(d.get_constraint().get_justification()));
             m_case_splits.pop_back();
         }
+        m_case_splits.clear();
         throw elaborator_exception(m_conflict);
     }
 
-    bool next_choice_case(choice_case_split & s) {
+    /** \brief Return the next branch of the choice case-split \c s that is not in a learned nogood. */
+    optional<branch> next_choice_branch(choice_case_split & s) {
         unification_constraint & choice = s.m_choice;
-        unsigned idx = s.m_idx;
-        if (idx < choice_size(choice)) {
+        while (s.m_idx < choice_size(choice)) {
+            expr const & alt = choice_ith(choice, s.m_idx);
             s.m_idx++;
-            s.m_curr_assumption = mk_assumption();
-            m_state = s.m_prev_state;
-            push_new_eq_constraint(get_context(choice), choice_mvar(choice), choice_ith(choice, idx), s.m_curr_assumption);
-            return true;
-        } else {
+            if (auto j = find_nogood(choice_mvar(choice), alt, s.m_failed_levels)) {
+                s.m_failed_justifications.push_back(*j);
+                continue;
+            }
+            justification a = mk_assumption();
+            state new_state(s.m_prev_state);
+            push_new_eq_constraint(new_state.m_cnstrs, get_context(choice), choice_mvar(choice), alt, a);
+            return optional<branch>(branch(new_state, a));
+        }
+        return optional<branch>();
+    }
+
+    bool next_choice_case(choice_case_split & s) {
+        unification_constraint & choice = s.m_choice;
+        if (parallel_case_splits()) {
+            if (next_parallel_case(s))
+                return true;
             m_conflict = justification(new unification_failure_by_cases_justification(choice, s.m_failed_justifications.size(),
                                                                                       s.m_failed_justifications.data(),
                                                                                       s.m_prev_state.m_menv));
             return false;
         }
+        while (s.m_idx < choice_size(choice)) {
+            expr const & alt = choice_ith(choice, s.m_idx);
+            s.m_idx++;
+            if (auto j = find_nogood(choice_mvar(choice), alt, s.m_failed_levels)) {
+                s.m_failed_justifications.push_back(*j);
+                continue;
+            }
+            s.m_curr_assumption = mk_assumption();
+            m_state = s.m_prev_state;
+            push_new_eq_constraint(get_context(choice), choice_mvar(choice), alt, s.m_curr_assumption);
+            return true;
+        }
+        m_conflict = justification(new unification_failure_by_cases_justification(choice, s.m_failed_justifications.size(),
+                                                                                  s.m_failed_justifications.data(),
+                                                                                  s.m_prev_state.m_menv));
+        return false;
     }
 
     bool next_generic_case(generic_case_split & s) {
         unsigned idx = s.m_idx;
         unsigned sz  = s.m_states.size();
+        if (parallel_case_splits() && idx > 0) {
+            // Remark: the first branch is not explored in parallel because generic case-splits are not expected to fail
+            // when they are created.
+            if (next_parallel_case(s))
+                return true;
+            m_conflict = justification(new unification_failure_by_cases_justification(s.m_constraint, s.m_failed_justifications.size(),
+                                                                                      s.m_failed_justifications.data(),
+                                                                                      s.m_prev_state.m_menv));
+            return false;
+        }
         if (idx < sz) {
             s.m_idx++;
             s.m_curr_assumption = s.m_assumptions[sz - idx - 1];
@@ -1733,9 +2377,9 @@ class elaborator::imp {
     bool next_plugin_case(plugin_case_split & s) {
         try {
             s.m_curr_assumption = mk_assumption();
+            m_stats.m_num_plugin_calls++;
             std::pair<metavar_env, list<unification_constraint>> r = s.m_alternatives->next(s.m_curr_assumption);
-            m_state.m_active_cnstrs     = s.m_prev_state.m_active_cnstrs;
-            m_state.m_delayed_cnstrs    = s.m_prev_state.m_delayed_cnstrs;
+            m_state.m_cnstrs            = s.m_prev_state.m_cnstrs;
             m_state.m_recently_assigned = s.m_prev_state.m_recently_assigned;
             m_state.m_menv              = r.first;
             for (auto c : r.second) {
@@ -1751,85 +2395,58 @@ class elaborator::imp {
     }
 
     bool process_delayed() {
-        name_set const & recently_assigned = m_state.m_recently_assigned;
-        m_state.m_delayed_cnstrs =
-            filter(m_state.m_delayed_cnstrs,
-                   [&](std::pair<unification_constraint, name_list> const & p) {
-                       bool found = false;
-                       for (auto const & m : p.second) {
-                           if (recently_assigned.contains(m)) {
-                               found = true;
-                               break;
-                           }
-                       }
-                       if (found) {
-                           push_active(p.first);
-                           return false;
-                       } else {
-                           return true;
-                       }
-                   });
-
+        m_stats.m_num_wakeups += m_state.m_cnstrs.wake_up(m_state.m_recently_assigned);
         m_state.m_recently_assigned = name_set(); // reset
         lean_assert(m_state.m_recently_assigned.empty());
-        if (!empty(m_state.m_active_cnstrs))
+        if (m_state.m_cnstrs.has_active())
             return true;
         // second pass trying to apply process_meta_app
-        m_state.m_delayed_cnstrs =
-            remove_last(m_state.m_delayed_cnstrs,
-                        [&](std::pair<unification_constraint, name_list> const & p) {
-                            unification_constraint const & c = p.first;
-                            if (is_eq(c) || is_convertible(c)) {
-                                expr const & a = is_eq(c) ? eq_lhs(c) : convertible_from(c);
-                                expr const & b = is_eq(c) ? eq_rhs(c) : convertible_to(c);
-                                if ((process_meta_app(a, b, true, c) || process_meta_app(b, a, false, c))) {
-                                    // std::cout << "META_APP: "; display(std::cout, c); std::cout << "\n";
-                                    return true;
-                                }
-                            }
-                            return false;
-                        });
-        if (!empty(m_state.m_active_cnstrs))
+        m_state.m_cnstrs.remove_last_delayed([&](unification_constraint const & c) {
+                if (is_eq(c) || is_convertible(c)) {
+                    expr const & a = is_eq(c) ? eq_lhs(c) : convertible_from(c);
+                    expr const & b = is_eq(c) ? eq_rhs(c) : convertible_to(c);
+                    if ((process_meta_app(a, b, true, c) || process_meta_app(b, a, false, c))) {
+                        // std::cout << "META_APP: "; display(std::cout, c); std::cout << "\n";
+                        return true;
+                    }
+                }
+                return false;
+            });
+        if (m_state.m_cnstrs.has_active())
             return true;
         // final pass trying expensive constraints
-        m_state.m_delayed_cnstrs =
-            remove_last(m_state.m_delayed_cnstrs,
-                        [&](std::pair<unification_constraint, name_list> const & p) {
-                            unification_constraint const & c = p.first;
-                            if (is_eq(c) || is_convertible(c)) {
-                                // std::cout << "EXPENSIVE: "; display(std::cout, c); std::cout << "\n";
-                                expr const & a = is_eq(c) ? eq_lhs(c) : convertible_from(c);
-                                expr const & b = is_eq(c) ? eq_rhs(c) : convertible_to(c);
-                                if (process_lower(a, b, c) ||
-                                    process_upper(a, b, c) ||
-                                    process_metavar_inst(a, b, true, c) ||
-                                    process_metavar_inst(b, a, false, c) ||
-                                    process_metavar_lift_abstraction(a, b, c) ||
-                                    process_metavar_lift_abstraction(b, a, c) ||
-                                    process_meta_app(a, b, true, c, false, true) ||
-                                    process_meta_app(b, a, false, c, false, true) ||
-                                    process_meta_app(a, b, true, c, true)) {
-                                    return true;
-                                }
-                            }
-                            return false;
-                        });
-        if (!empty(m_state.m_active_cnstrs))
+        m_state.m_cnstrs.remove_last_delayed([&](unification_constraint const & c) {
+                if (is_eq(c) || is_convertible(c)) {
+                    // std::cout << "EXPENSIVE: "; display(std::cout, c); std::cout << "\n";
+                    expr const & a = is_eq(c) ? eq_lhs(c) : convertible_from(c);
+                    expr const & b = is_eq(c) ? eq_rhs(c) : convertible_to(c);
+                    if (process_lower(a, b, c) ||
+                        process_upper(a, b, c) ||
+                        process_metavar_inst(a, b, true, c) ||
+                        process_metavar_inst(b, a, false, c) ||
+                        process_metavar_lift_abstraction(a, b, c) ||
+                        process_metavar_lift_abstraction(b, a, c) ||
+                        process_meta_app(a, b, true, c, false, true) ||
+                        process_meta_app(b, a, false, c, false, true) ||
+                        process_meta_app(a, b, true, c, true)) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        if (m_state.m_cnstrs.has_active())
             return true;
         // "approximated mode"
         // change convertability into equality constraint
-        m_state.m_delayed_cnstrs =
-            remove_last(m_state.m_delayed_cnstrs,
-                        [&](std::pair<unification_constraint, name_list> const & p) {
-                            if (is_convertible(p.first)) {
-                                unification_constraint const & c = p.first;
-                                // std::cout << "CONVERTABILITY: "; display(std::cout, c); std::cout << "\n";
-                                push_new_eq_constraint(get_context(c), convertible_from(c), convertible_to(c), get_justification(c));
-                                return true;
-                            }
-                            return false;
-                        });
-        return !empty(m_state.m_active_cnstrs);
+        m_state.m_cnstrs.remove_last_delayed([&](unification_constraint const & c) {
+                if (is_convertible(c)) {
+                    // std::cout << "CONVERTABILITY: "; display(std::cout, c); std::cout << "\n";
+                    push_new_eq_constraint(get_context(c), convertible_from(c), convertible_to(c), get_justification(c));
+                    return true;
+                }
+                return false;
+            });
+        return m_state.m_cnstrs.has_active();
     }
 
 public:
@@ -1839,15 +2456,37 @@ public:
         m_type_inferer(env),
         m_normalizer(env),
         m_state(menv, num_cnstrs, cnstrs),
-        m_plugin(p) {
+        m_plugin(p),
+        m_next_id(std::make_shared<atomic<unsigned>>(0)) {
         set_options(opts);
-        m_next_id     = 0;
         m_first       = true;
         m_U           = m_env->get_uvar("U");
         // display(std::cout);
     }
 
+    /**
+       \brief Create an elaborator for exploring (in another thread) a branch of a case-split of \c parent.
+       The branches of its case-splits are explored sequentially.
+    */
+    imp(imp const & parent, state const & s):
+        m_env(parent.m_env),
+        m_type_inferer(parent.m_env),
+        m_normalizer(parent.m_env),
+        m_state(s),
+        m_plugin(parent.m_plugin),
+        m_next_id(parent.m_next_id),
+        m_use_justifications(parent.m_use_justifications),
+        m_use_normalizer(parent.m_use_normalizer),
+        m_assume_injectivity(parent.m_assume_injectivity),
+        m_parallel_case_splits(1),
+        m_deterministic(parent.m_deterministic) {
+        m_first       = true;
+        m_U           = parent.m_U;
+    }
+
     metavar_env next() {
+        scoped_elaborator_timer timer(m_stats);
+        scoped_instantiate_memo set_inst_memo(m_instantiate_memo);
         check_interrupted();
         if (m_conflict)
             throw elaborator_exception(m_conflict);
@@ -1866,15 +2505,13 @@ public:
         }
         while (true) {
             check_interrupted();
-            cnstr_list & active_cnstrs = m_state.m_active_cnstrs;
-            if (!empty(active_cnstrs)) {
-                unification_constraint c = head(active_cnstrs);
-                m_state.m_active_cnstrs  = tail(active_cnstrs);
+            if (m_state.m_cnstrs.has_active()) {
+                unification_constraint c = m_state.m_cnstrs.pop_active();
                 // std::cout << "Processing, depth: " << m_case_splits.size() << " "; display(std::cout, c);
                 if (!process(c)) {
                     resolve_conflict();
                 }
-            } else if (!empty(m_state.m_delayed_cnstrs)) {
+            } else if (m_state.m_cnstrs.has_delayed()) {
                 // std::cout << "PROCESSING DELAYED\n"; display(std::cout); std::cout << "\n\n";
                 if (!process_delayed()) {
                     // std::cout << "FAILED to solve\n";
@@ -1887,6 +2524,8 @@ public:
         }
     }
 
+    elaborator_stats const & get_stats() const { return m_stats; }
+
     void display(std::ostream & out, unification_constraint const & c) const {
         formatter fmt = mk_simple_formatter();
         out << c.pp(fmt, options(), nullptr, false) << "\n";
@@ -1896,11 +2535,10 @@ public:
         m_state.m_menv->for_each_subst([&](name const & m, expr const & e) {
                 out << m << " <- " << e << "\n";
             });
-        for (auto c : m_state.m_active_cnstrs)
-            display(out, c);
+        auto display_cnstr = [&](unification_constraint const & c) { display(out, c); };
+        m_state.m_cnstrs.for_each_active(display_cnstr);
         out << "Delayed constraints:\n";
-        for (auto c : m_state.m_delayed_cnstrs)
-            display(out, c.first);
+        m_state.m_cnstrs.for_each_delayed(display_cnstr);
     }
 };
 
@@ -1925,4 +2563,8 @@ elaborator::~elaborator() {
 metavar_env elaborator::next() {
     return m_ptr->next();
 }
+
+elaborator_stats const & elaborator::get_stats() const {
+    return m_ptr->get_stats();
+}
 }
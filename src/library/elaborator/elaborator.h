@@ -12,6 +12,7 @@ Author: Leonardo de Moura
 #include "kernel/unification_constraint.h"
 #include "library/elaborator/elaborator_plugin.h"
 #include "library/elaborator/elaborator_exception.h"
+#include "library/elaborator/elaborator_stats.h"
 
 namespace lean {
 /**
@@ -57,5 +58,8 @@ public:
     ~elaborator();
 
     metavar_env next();
+
+    /** \brief Return the statistics collected by the previous calls to \c next. */
+    elaborator_stats const & get_stats() const;
 };
 }
@@ -116,6 +116,24 @@ optional<expr> next_solution_justification::get_main_expr() const {
     return none_expr();
 }
 
+// -------------------------
+// Nogood justification
+// -------------------------
+nogood_justification::nogood_justification(justification const & conflict, unsigned num, justification const * as):
+    m_conflict(conflict), m_assumptions(as, as + num) {
+}
+nogood_justification::~nogood_justification() {
+}
+format nogood_justification::pp_header(formatter const & fmt, options const & opts, optional<metavar_env> const & menv) const {
+    return format{format("Skipped (learned conflict)"), line(), m_conflict.pp(fmt, opts, nullptr, false, menv)};
+}
+void nogood_justification::get_children(buffer<justification_cell*> & r) const {
+    append(r, m_assumptions);
+}
+optional<expr> nogood_justification::get_main_expr() const {
+    return m_conflict.get_main_expr();
+}
+
 bool is_derived_constraint(unification_constraint const & uc) {
     auto j = uc.get_justification();
     return j && dynamic_cast<propagation_justification*>(j.raw());
@@ -152,6 +170,8 @@ justification remove_detail(justification const & j) {
         return remove_detail(p_cell->get_constraint().get_justification());
     } else if (auto t_cell = dynamic_cast<typeof_mvar_justification*>(jcell)) {
         return remove_detail(t_cell->get_justification());
+    } else if (auto n_cell = dynamic_cast<nogood_justification*>(jcell)) {
+        return remove_detail(n_cell->get_conflict());
     } else {
         return j;
     }
@@ -180,6 +180,24 @@ public:
     virtual optional<expr> get_main_expr() const;
 };
 
+/**
+    \brief Justification object used to justify that a case was skipped because it is in a learned nogood,
+    i.e., a combination of choices that was already shown to fail.
+    The children are the assumptions of the current case-splits that contain the other choices of the nogood.
+    The failure used to learn the nogood is only used for pretty printing (see \c remove_detail).
+*/
+class nogood_justification : public justification_cell {
+    justification              m_conflict;    // failure used to learn the nogood
+    std::vector<justification> m_assumptions; // assumptions for the other choices in the nogood
+public:
+    nogood_justification(justification const & conflict, unsigned num, justification const * as);
+    virtual ~nogood_justification();
+    virtual format pp_header(formatter const &, options const &, optional<metavar_env> const & menv) const;
+    virtual void get_children(buffer<justification_cell*> & r) const;
+    virtual optional<expr> get_main_expr() const;
+    justification const & get_conflict() const { return m_conflict; }
+};
+
 /**
    \brief Create a new justification object where we eliminate
    intermediate steps and assignment justifications. This function
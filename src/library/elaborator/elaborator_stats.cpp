@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iomanip>
+#include <string>
+#include "util/escaped.h"
+#include "library/elaborator/elaborator_stats.h"
+
+namespace lean {
+elaborator_stats::elaborator_stats():
+    m_num_eq(0), m_num_convertible(0), m_num_max(0), m_num_choice(0), m_num_case_splits(0), m_num_backtracks(0),
+    m_num_plugin_calls(0), m_num_wakeups(0), m_num_normalizer_calls(0), m_num_type_checker_calls(0), m_time(0.0) {}
+
+elaborator_stats & elaborator_stats::operator+=(elaborator_stats const & s) {
+    m_num_eq                 += s.m_num_eq;
+    m_num_convertible        += s.m_num_convertible;
+    m_num_max                += s.m_num_max;
+    m_num_choice             += s.m_num_choice;
+    m_num_case_splits        += s.m_num_case_splits;
+    m_num_backtracks         += s.m_num_backtracks;
+    m_num_plugin_calls       += s.m_num_plugin_calls;
+    m_num_wakeups            += s.m_num_wakeups;
+    m_num_normalizer_calls   += s.m_num_normalizer_calls;
+    m_num_type_checker_calls += s.m_num_type_checker_calls;
+    m_time                   += s.m_time;
+    return *this;
+}
+
+/** \brief Apply \c f to the label and value of each counter in \c s. */
+template<typename F>
+static void for_each_counter(elaborator_stats const & s, F && f) {
+    f("eq", s.m_num_eq);
+    f("convertible", s.m_num_convertible);
+    f("max", s.m_num_max);
+    f("choice", s.m_num_choice);
+    f("case_splits", s.m_num_case_splits);
+    f("backtracks", s.m_num_backtracks);
+    f("plugin_calls", s.m_num_plugin_calls);
+    f("wakeups", s.m_num_wakeups);
+    f("normalizer_calls", s.m_num_normalizer_calls);
+    f("type_checker_calls", s.m_num_type_checker_calls);
+}
+
+void display(std::ostream & out, name const & n, elaborator_stats const & s) {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize prec = out.precision();
+    out << "elaboration of " << n << "\n";
+    for_each_counter(s, [&](char const * label, unsigned v) {
+            out << "  " << std::left << std::setw(20) << label << std::right << std::setw(10) << v << "\n";
+        });
+    out << "  " << std::left << std::setw(20) << "time (secs)" << std::right << std::setw(10)
+        << std::fixed << std::setprecision(4) << s.m_time << "\n";
+    out.flags(flags);
+    out.precision(prec);
+}
+
+void display_json(std::ostream & out, name const & n, elaborator_stats const & s) {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize prec = out.precision();
+    std::string id = n.to_string();
+    out << "{\"declaration\": \"" << escaped(id.c_str()) << "\"";
+    for_each_counter(s, [&](char const * label, unsigned v) { out << ", \"" << label << "\": " << v; });
+    out << ", \"time\": " << std::fixed << std::setprecision(6) << s.m_time << "}\n";
+    out.flags(flags);
+    out.precision(prec);
+}
+}
@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <iostream>
+#include <chrono>
+#include "util/name.h"
+
+namespace lean {
+/**
+   \brief Counters and timers collected by the elaborator. They are used for finding where
+   the elaboration time goes (see the option <tt>elaborator::profile</tt>).
+*/
+struct elaborator_stats {
+    // number of constraints processed by kind
+    unsigned m_num_eq;
+    unsigned m_num_convertible;
+    unsigned m_num_max;
+    unsigned m_num_choice;
+    unsigned m_num_case_splits;         // case-splits created
+    unsigned m_num_backtracks;          // conflicts resolved by moving to another branch of a case-split
+    unsigned m_num_plugin_calls;
+    unsigned m_num_wakeups;             // delayed constraints moved back to the active list
+    unsigned m_num_normalizer_calls;
+    unsigned m_num_type_checker_calls;  // type inference and convertibility checks
+    double   m_time;                    // wall time in seconds
+    elaborator_stats();
+    unsigned get_num_constraints() const { return m_num_eq + m_num_convertible + m_num_max + m_num_choice; }
+    elaborator_stats & operator+=(elaborator_stats const & s);
+};
+
+/** \brief Add the wall time spent in its scope to the given statistics. */
+class scoped_elaborator_timer {
+    elaborator_stats &                    m_stats;
+    std::chrono::steady_clock::time_point m_start;
+public:
+    scoped_elaborator_timer(elaborator_stats & s):m_stats(s), m_start(std::chrono::steady_clock::now()) {}
+    ~scoped_elaborator_timer() {
+        m_stats.m_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+};
+
+/** \brief Display the statistics \c s of the elaboration of \c n as a table. */
+void display(std::ostream & out, name const & n, elaborator_stats const & s);
+/** \brief Display the statistics \c s of the elaboration of \c n as a (single line) JSON object. */
+void display_json(std::ostream & out, name const & n, elaborator_stats const & s);
+}
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iomanip>
+#include "util/buffer.h"
+#include "kernel/metavar.h"
+#include "library/expr_census.h"
+
+namespace lean {
+size_t get_cell_size(expr const & e) {
+    switch (e.kind()) {
+    case expr_kind::Var:      return sizeof(expr_var);
+    case expr_kind::Constant: return sizeof(expr_const);
+    case expr_kind::Value:    return sizeof(expr_value);
+    case expr_kind::Type:     return sizeof(expr_type);
+    case expr_kind::MetaVar:  return sizeof(expr_metavar);
+    case expr_kind::App:      return sizeof(expr_app) + num_args(e) * sizeof(expr);
+    case expr_kind::Lambda:   return sizeof(expr_lambda);
+    case expr_kind::Pi:       return sizeof(expr_pi);
+    case expr_kind::Let:      return sizeof(expr_let);
+    }
+    lean_unreachable(); // LCOV_EXCL_LINE
+}
+
+static char const * kind_name(expr_kind k) {
+    switch (k) {
+    case expr_kind::Var:      return "var";
+    case expr_kind::Constant: return "constant";
+    case expr_kind::Value:    return "value";
+    case expr_kind::Type:     return "type";
+    case expr_kind::MetaVar:  return "metavar";
+    case expr_kind::App:      return "app";
+    case expr_kind::Lambda:   return "lambda";
+    case expr_kind::Pi:       return "pi";
+    case expr_kind::Let:      return "let";
+    }
+    lean_unreachable(); // LCOV_EXCL_LINE
+}
+
+expr_census::expr_census() {
+    for (unsigned i = 0; i < g_num_kinds; i++) {
+        m_num_cells[i] = 0;
+        m_num_bytes[i] = 0;
+    }
+}
+
+void expr_census::add(expr const & e) {
+    buffer<expr> todo;
+    todo.push_back(e);
+    while (!todo.empty()) {
+        expr c = todo.back();
+        todo.pop_back();
+        if (!m_visited.insert(c.raw()).second)
+            continue;
+        unsigned k = static_cast<unsigned>(c.kind());
+        m_num_cells[k]++;
+        m_num_bytes[k] += get_cell_size(c);
+        switch (c.kind()) {
+        case expr_kind::Var: case expr_kind::Value: case expr_kind::Type: case expr_kind::MetaVar:
+            break;
+        case expr_kind::Constant:
+            if (const_type(c))
+                todo.push_back(*const_type(c));
+            break;
+        case expr_kind::App:
+            for (expr const & a : args(c))
+                todo.push_back(a);
+            break;
+        case expr_kind::Lambda: case expr_kind::Pi:
+            todo.push_back(abst_domain(c));
+            todo.push_back(abst_body(c));
+            break;
+        case expr_kind::Let:
+            if (let_type(c))
+                todo.push_back(*let_type(c));
+            todo.push_back(let_value(c));
+            todo.push_back(let_body(c));
+            break;
+        }
+    }
+}
+
+void expr_census::add(environment const & env) {
+    for (auto it = env->begin_objects(); it != env->end_objects(); ++it) {
+        object const & obj = *it;
+        if (obj.has_type())
+            add(obj.get_type());
+        if (obj.is_definition())
+            add(obj.get_value());
+    }
+}
+
+size_t expr_census::get_num_cells() const {
+    size_t r = 0;
+    for (unsigned i = 0; i < g_num_kinds; i++)
+        r += m_num_cells[i];
+    return r;
+}
+
+size_t expr_census::get_num_bytes() const {
+    size_t r = 0;
+    for (unsigned i = 0; i < g_num_kinds; i++)
+        r += m_num_bytes[i];
+    return r;
+}
+
+void expr_census::display(std::ostream & out) const {
+    out << std::left << std::setw(10) << "kind" << std::right << std::setw(12) << "cells" << std::setw(14) << "bytes" << "\n";
+    for (unsigned i = 0; i < g_num_kinds; i++) {
+        if (m_num_cells[i] > 0)
+            out << std::left << std::setw(10) << kind_name(static_cast<expr_kind>(i)) << std::right
+                << std::setw(12) << m_num_cells[i] << std::setw(14) << m_num_bytes[i] << "\n";
+    }
+    size_t n = get_num_cells();
+    size_t b = get_num_bytes();
+    out << std::left << std::setw(10) << "total" << std::right << std::setw(12) << n << std::setw(14) << b << "\n";
+    if (n > 0)
+        out << "bytes per cell: " << std::fixed << std::setprecision(2) << static_cast<double>(b) / n << "\n";
+}
+}
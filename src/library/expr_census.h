@@ -0,0 +1,41 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <iostream>
+#include <unordered_set>
+#include "kernel/expr.h"
+#include "kernel/environment.h"
+
+namespace lean {
+/** \brief Return the number of bytes used by the cell of the given expression (children are not included). */
+size_t get_cell_size(expr const & e);
+
+/**
+   \brief Memory census for expressions. It collects the number of cells, and the
+   number of bytes used by them, for each kind of expression.
+   A cell that is reachable from many expressions is counted only once.
+
+   \remark The memory used by names, universe levels and semantic attachments is not included.
+*/
+class expr_census {
+    static constexpr unsigned g_num_kinds = static_cast<unsigned>(expr_kind::MetaVar) + 1;
+    std::unordered_set<expr_cell const *> m_visited;
+    size_t                                m_num_cells[g_num_kinds];
+    size_t                                m_num_bytes[g_num_kinds];
+public:
+    expr_census();
+    /** \brief Add the cells reachable from \c e that were not visited yet. */
+    void add(expr const & e);
+    /** \brief Add the types and values of all objects in the given environment. */
+    void add(environment const & env);
+    size_t get_num_cells(expr_kind k) const { return m_num_cells[static_cast<unsigned>(k)]; }
+    size_t get_num_bytes(expr_kind k) const { return m_num_bytes[static_cast<unsigned>(k)]; }
+    size_t get_num_cells() const;
+    size_t get_num_bytes() const;
+    void display(std::ostream & out) const;
+};
+}
@@ -15,6 +15,9 @@ Author: Leonardo de Moura
 namespace lean {
 static name g_placeholder_name("_");
 expr mk_placeholder(optional<expr> const & t) {
+    // Each placeholder is replaced with a different metavariable,
+    // so they are identified by their cells, and must not be hash-consed.
+    scoped_hash_consing disable(false);
     return mk_constant(g_placeholder_name, t);
 }
 
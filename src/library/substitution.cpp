@@ -13,7 +13,7 @@ namespace lean {
 expr find(substitution & s, expr e) {
     while (true) {
         if (is_metavar(e)) {
-            expr * it = s.find(metavar_name(e));
+            expr const * it = s.find(metavar_name(e));
             if (it == nullptr)
                 return e;
             e = *it;
@@ -56,7 +56,7 @@ static int substitution_empty(lua_State * L) {
 
 static int substitution_find(lua_State * L) {
     substitution & s = to_substitution(L, 1);
-    expr * it;
+    expr const * it;
     if (is_expr(L, 2)) {
         expr const & e = to_expr(L, 2);
         if (is_metavar(e))
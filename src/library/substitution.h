@@ -6,7 +6,7 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include "util/lua.h"
-#include "util/splay_map.h"
+#include "util/hamt.h"
 #include "util/name.h"
 #include "kernel/expr.h"
 #include "kernel/metavar.h"
@@ -14,9 +14,10 @@ Author: Leonardo de Moura
 namespace lean {
 /**
    \brief Simpler version of metavar_env.
-   It is used in fo_unify
+   It is used in fo_unify. Like metavar_env, it is a persistent hash map: copies are O(1),
+   and lookups do not modify it.
 */
-typedef splay_map<name, expr, name_quick_cmp> substitution;
+typedef hamt<name, expr, name_hash, name_eq> substitution;
 /**
    \brief Apply substitution \c s to \c e
 */
@@ -8,8 +8,19 @@ Author: Leonardo de Moura
 #include <fstream>
 #include <signal.h>
 #include <cstdlib>
+#include <cstring>
 #include <getopt.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#if defined(LEAN_WINDOWS)
+#include <process.h>
+#else
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 #include "util/stackinfo.h"
 #include "util/debug.h"
 #include "util/interrupt.h"
@@ -23,11 +34,13 @@ Author: Leonardo de Moura
 #include "library/printer.h"
 #include "library/kernel_bindings.h"
 #include "library/io_state_stream.h"
+#include "library/expr_census.h"
 #include "library/error_handling/error_handling.h"
 #include "frontends/lean/parser.h"
 #include "frontends/lean/shell.h"
 #include "frontends/lean/frontend.h"
 #include "frontends/lean/register_module.h"
+#include "frontends/lean/make.h"
 #include "frontends/lua/register_modules.h"
 #include "version.h"
 #include "githash.h" // NOLINT
@@ -70,6 +83,13 @@ static void display_help(std::ostream & out) {
     std::cout << "                    0 means 'do not check'.\n";
     std::cout << "  --trust -t        trust imported modules\n";
     std::cout << "  --quiet -q        do not print verbose messages\n";
+    std::cout << "  --census -C       display the memory used by the expressions in the final environment\n";
+    std::cout << "  --profile -P      display counters and the time spent by the elaborator for each declaration\n";
+    std::cout << "                    (same as 'set_option elaborator::profile true'), --profile=json uses JSON format\n";
+    std::cout << "  --make -m         compile the Lean files in the given directories (default: current directory)\n";
+    std::cout << "                    and the files they import, files that did not change are not compiled again\n";
+    std::cout << "  --jobs=num -j     number of files compiled in parallel by --make,\n";
+    std::cout << "                    and number of threads used for reading .olean files\n";
 #if defined(LEAN_USE_BOOST)
     std::cout << "  --tstack=num -s   thread stack size in Kb\n";
 #endif
@@ -89,6 +109,91 @@ static char const * get_file_extension(char const * fname) {
     }
 }
 
+#if defined(LEAN_WINDOWS)
+/** \brief Quote \c s using the rules of the Microsoft C runtime for parsing command line arguments. */
+static std::string quote(std::string const & s) {
+    std::string r = "\"";
+    unsigned num_backslashes = 0;
+    for (char c : s) {
+        if (c == '\\') {
+            num_backslashes++;
+        } else {
+            if (c == '"')
+                r.append(num_backslashes + 1, '\\');
+            num_backslashes = 0;
+        }
+        r += c;
+    }
+    r.append(num_backslashes, '\\');
+    return r + "\"";
+}
+#endif
+
+/**
+   \brief Run the program \c args[0] with the arguments \c args (without using a shell),
+   and return true iff it terminated successfully.
+*/
+static bool run_process(std::vector<std::string> const & args) {
+#if defined(LEAN_WINDOWS)
+    // Remark: _spawnv joins the arguments using spaces, so they must be quoted.
+    std::vector<std::string> quoted;
+    for (std::string const & a : args)
+        quoted.push_back(quote(a));
+    std::vector<char const *> argv;
+    for (std::string const & a : quoted)
+        argv.push_back(a.c_str());
+    argv.push_back(nullptr);
+    return _spawnv(_P_WAIT, args[0].c_str(), argv.data()) == 0;
+#else
+    std::vector<char *> argv;
+    for (std::string const & a : args)
+        argv.push_back(const_cast<char *>(a.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+/** \brief Compile the Lean files in the given paths using a separate Lean process for each file (see \c lean::make). */
+static int make(std::vector<std::string> paths, unsigned num_jobs, bool trust_imported, bool no_kernel, bool quiet) {
+    if (paths.empty())
+        paths.push_back(".");
+    std::vector<std::string> cmd = {lean::get_exe_location(), "-q"};
+    if (trust_imported)
+        cmd.push_back("-t");
+    if (no_kernel)
+        cmd.push_back("-n");
+    if (num_jobs > 1) {
+        // the files are already compiled in parallel
+        cmd.push_back("-j");
+        cmd.push_back("1");
+    }
+    auto compile = [&](std::string const & src, std::string const & olean) {
+        std::vector<std::string> c(cmd);
+        c.push_back("-o");
+        c.push_back(olean);
+        c.push_back(src);
+        return run_process(c);
+    };
+    try {
+        return lean::make(paths, num_jobs, compile, g_githash, std::cout, !quiet) ? 0 : 1;
+    } catch (lean::exception & ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+}
+
 static struct option g_long_options[] = {
     {"version",    no_argument,       0, 'v'},
     {"help",       no_argument,       0, 'h'},
@@ -102,6 +207,10 @@ static struct option g_long_options[] = {
     {"output",     required_argument, 0, 'o'},
     {"trust",      no_argument,       0, 't'},
     {"quiet",      no_argument,       0, 'q'},
+    {"census",     no_argument,       0, 'C'},
+    {"profile",    optional_argument, 0, 'P'},
+    {"make",       no_argument,       0, 'm'},
+    {"jobs",       required_argument, 0, 'j'},
 #if defined(LEAN_USE_BOOST)
     {"tstack",     required_argument, 0, 's'},
 #endif
@@ -115,10 +224,15 @@ int main(int argc, char ** argv) {
     bool export_objects = false;
     bool trust_imported = false;
     bool quiet          = false;
+    bool census         = false;
+    bool profile        = false;
+    bool profile_json   = false;
+    bool make_mode      = false;
+    unsigned num_jobs   = 0;
     std::string output;
     input_kind default_k = input_kind::Lean; // default
     while (true) {
-        int c = getopt_long(argc, argv, "qtnlupgvhc:012s:012o:", g_long_options, NULL);
+        int c = getopt_long(argc, argv, "qtnlupgvhCmP::c:012s:012o:j:", g_long_options, NULL);
         if (c == -1)
             break; // end of command line
         switch (c) {
@@ -163,17 +277,44 @@ int main(int argc, char ** argv) {
         case 'q':
             quiet = true;
             break;
+        case 'C':
+            census = true;
+            break;
+        case 'P':
+            profile = true;
+            if (optarg && strcmp(optarg, "json") == 0) {
+                profile_json = true;
+            } else if (optarg) {
+                std::cerr << "Unknown profile format '" << optarg << "'\n";
+                return 1;
+            }
+            break;
+        case 'm':
+            make_mode = true;
+            break;
+        case 'j':
+            num_jobs = std::max(atoi(optarg), 1);
+            break;
         default:
             std::cerr << "Unknown command line option\n";
             display_help(std::cerr);
             return 1;
         }
     }
+    if (make_mode)
+        return make(std::vector<std::string>(argv + optind, argv + argc), num_jobs == 0 ? lean::hardware_concurrency() : num_jobs,
+                    trust_imported, no_kernel, quiet);
     environment env;
     env->set_trusted_imported(trust_imported);
+    if (num_jobs > 0)
+        env->set_import_threads(num_jobs);
     io_state ios = init_frontend(env, no_kernel);
     if (quiet)
         ios.set_option("verbose", false);
+    if (profile)
+        ios.set_option(lean::name{"elaborator", "profile"}, true);
+    if (profile_json)
+        ios.set_option(lean::name{"elaborator", "profile_json"}, true);
     script_state S;
     S.apply([&](lua_State * L) {
             set_global_environment(L, env);
@@ -234,6 +375,11 @@ int main(int argc, char ** argv) {
                     lean_unreachable(); // LCOV_EXCL_LINE
                 }
             }
+            if (census) {
+                lean::expr_census c;
+                c.add(env);
+                c.display(std::cout);
+            }
             if (export_objects)
                 env->export_objects(output);
             return ok ? 0 : 1;
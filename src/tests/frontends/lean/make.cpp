@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "util/test.h"
+#include "util/thread.h"
+#include "util/lean_path.h"
+#include "frontends/lean/parser.h"
+#include "frontends/lean/make.h"
+using namespace lean;
+
+static void check_imports(char const * str, std::vector<std::string> const & expected) {
+    std::istringstream in(str);
+    std::vector<std::string> r = scan_imports(in, "[string]");
+    lean_assert(r == expected);
+}
+
+static void tst1() {
+    check_imports("import A", {"A"});
+    check_imports("import A B::C \"d/e.lean\".\ndefinition x := 1\nimport F\ntheorem T : true := trivial",
+                  {"A", name_to_file(name({"B", "C"})), "d/e.lean", "F"});
+    check_imports("-- import A\nvariable x : Bool\n(* import(\"B\") *)\nimport C variable y : Bool", {"C"});
+    check_imports("variable import : Bool", {});
+}
+
+static void write_file(std::string const & fname, std::string const & contents) {
+    std::ofstream out(fname);
+    out << contents;
+}
+
+static std::string read_file(std::string const & fname) {
+    std::ifstream in(fname);
+    std::stringstream r;
+    r << in.rdbuf();
+    return r.str();
+}
+
+/**
+   \brief Fake compiler: the .olean file contains the Lean file up to the first comment.
+   Thus, modifying a comment does not modify the .olean file.
+*/
+class tst_compiler {
+    mutex                    m_mutex;
+    std::vector<std::string> m_compiled;
+    std::string              m_fail;
+public:
+    bool operator()(std::string const & src, std::string const & olean) {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_compiled.push_back(src.substr(src.find_last_of("/\\") + 1));
+        }
+        if (src.find(m_fail) != std::string::npos && !m_fail.empty())
+            return false;
+        std::string contents = read_file(src);
+        write_file(olean, contents.substr(0, contents.find("--")));
+        return true;
+    }
+    void set_fail(std::string const & s) { m_fail = s; }
+    std::vector<std::string> compiled() {
+        std::vector<std::string> r;
+        std::swap(r, m_compiled);
+        return r;
+    }
+};
+
+static bool compiled_before(std::vector<std::string> const & r, char const * f1, char const * f2) {
+    auto it1 = std::find(r.begin(), r.end(), f1);
+    auto it2 = std::find(r.begin(), r.end(), f2);
+    return it1 != r.end() && it2 != r.end() && it1 < it2;
+}
+
+static bool run_make(tst_compiler & c, std::vector<std::string> const & paths, unsigned num_jobs,
+                     std::ostream & out = std::cout) {
+    return make(paths, num_jobs, [&](std::string const & src, std::string const & olean) { return c(src, olean); },
+                "tst", out, true);
+}
+
+static void tst2(unsigned num_jobs) {
+    char const * files[] = {"make_tst_a", "make_tst_b", "make_tst_c", "make_tst_d"};
+    write_file("make_tst_a.lean", "variable a : Bool\n");
+    write_file("make_tst_b.lean", "import make_tst_a\nvariable b : Bool\n");
+    write_file("make_tst_c.lean", "import make_tst_b \"make_tst_a\"\nvariable c : Bool\n");
+    write_file("make_tst_d.lean", "variable d : Bool\n");
+    for (char const * f : files)
+        std::remove((std::string(f) + ".olean.hash").c_str());
+    tst_compiler c;
+    std::vector<std::string> paths = {"make_tst_c.lean", "make_tst_d.lean"};
+    lean_assert(run_make(c, paths, num_jobs));
+    std::vector<std::string> r = c.compiled();
+    lean_assert(r.size() == 4);
+    lean_assert(compiled_before(r, "make_tst_a.lean", "make_tst_b.lean"));
+    lean_assert(compiled_before(r, "make_tst_b.lean", "make_tst_c.lean"));
+    // nothing changed
+    lean_assert(run_make(c, paths, num_jobs));
+    lean_assert(c.compiled().empty());
+    // modified leaf
+    write_file("make_tst_c.lean", "import make_tst_b \"make_tst_a\"\nvariable c2 : Bool\n");
+    lean_assert(run_make(c, paths, num_jobs));
+    lean_assert(c.compiled() == std::vector<std::string>({"make_tst_c.lean"}));
+    // modified module imported by other modules
+    write_file("make_tst_a.lean", "variable a2 : Bool\n");
+    lean_assert(run_make(c, paths, num_jobs));
+    r = c.compiled();
+    lean_assert(r == std::vector<std::string>({"make_tst_a.lean", "make_tst_b.lean", "make_tst_c.lean"}));
+    // the .olean file of make_tst_a does not change, then the modules that import it are not compiled
+    write_file("make_tst_a.lean", "variable a2 : Bool\n-- comment\n");
+    lean_assert(run_make(c, paths, num_jobs));
+    lean_assert(c.compiled() == std::vector<std::string>({"make_tst_a.lean"}));
+    // failure
+    write_file("make_tst_b.lean", "import make_tst_a\nvariable b2 : Bool\n");
+    c.set_fail("make_tst_b");
+    lean_assert(!run_make(c, paths, num_jobs));
+    lean_assert(c.compiled() == std::vector<std::string>({"make_tst_b.lean"}));
+    c.set_fail("");
+    lean_assert(run_make(c, paths, num_jobs));
+    lean_assert(c.compiled() == std::vector<std::string>({"make_tst_b.lean", "make_tst_c.lean"}));
+    for (char const * f : files) {
+        std::string s(f);
+        std::remove((s + ".lean").c_str());
+        std::remove((s + ".olean").c_str());
+        std::remove((s + ".olean.hash").c_str());
+    }
+}
+
+static void tst3() {
+    write_file("make_tst_e.lean", "import make_tst_f\n");
+    write_file("make_tst_f.lean", "import make_tst_e\n");
+    write_file("make_tst_g.lean", "import make_tst_e\n");
+    tst_compiler c;
+    std::ostringstream out;
+    lean_assert(!run_make(c, {"make_tst_g.lean"}, 2, out));
+    std::cout << out.str();
+    lean_assert(c.compiled().empty());
+    // the modules that only import a cycle are skipped
+    lean_assert(out.str().find("Failed to build 'make_tst_e.lean', circular dependency") != std::string::npos);
+    lean_assert(out.str().find("Failed to build 'make_tst_f.lean', circular dependency") != std::string::npos);
+    lean_assert(out.str().find("Skipping 'make_tst_g.lean', failed to build 'make_tst_e.lean'") != std::string::npos);
+    std::remove("make_tst_e.lean");
+    std::remove("make_tst_f.lean");
+    std::remove("make_tst_g.lean");
+}
+
+int main() {
+    save_stack_info();
+    tst1();
+    tst2(1);
+    tst2(4);
+    tst3();
+    return has_violations() ? 1 : 0;
+}
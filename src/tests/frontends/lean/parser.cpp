@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #include <sstream>
 #include <memory>
+#include <string>
 #include "util/test.h"
 #include "util/exception.h"
 #include "util/numerics/mpq.h"
@@ -108,11 +109,45 @@ static void tst3() {
     parse_error(env, ios, "10 + 30");
 }
 
+static void tst4() {
+    // elaborator profile
+    environment env; io_state ios = init_test_frontend(env);
+    std::shared_ptr<string_output_channel> out = std::make_shared<string_output_channel>();
+    ios.set_regular_channel(out);
+    parse(env, ios, "variable f : Int -> Int. definition g x := f x + x.");
+    lean_assert(out->str().find("elaboration of") == std::string::npos);
+    parse(env, ios, "set_option elaborator::profile true. variable f : Int -> Int. definition g x := f x + x.");
+    std::string s = out->str();
+    std::cout << s;
+    lean_assert(s.find("elaboration of g") != std::string::npos);
+    lean_assert(s.find("type_checker_calls") != std::string::npos);
+    ios.set_regular_channel(out = std::make_shared<string_output_channel>());
+    parse(env, ios, "set_option elaborator::profile true. set_option elaborator::profile_json true.\n"
+          "variable f : Int -> Int. definition g x := f x + x.");
+    s = out->str();
+    std::cout << s;
+    lean_assert(s.find("{\"declaration\": \"f\", \"eq\": ") != std::string::npos);
+    lean_assert(s.find("{\"declaration\": \"g\", \"eq\": ") != std::string::npos);
+}
+
+static void tst5() {
+    // the import command reads module names until the next command
+    environment env; io_state ios = init_test_frontend(env);
+    environment child = env->mk_child();
+    std::istringstream in("import Int Real variable x : Real\nimport \"Int\"\nvariable y : Int\ncheck x");
+    lean_assert(parse_commands(child, ios, in, "[string]"));
+    lean_assert(child->imported("Real"));
+    lean_assert(child->find_object("x"));
+    lean_assert(child->find_object("y"));
+}
+
 int main() {
     save_stack_info();
     register_modules();
     tst1();
     tst2();
     tst3();
+    tst4();
+    tst5();
     return has_violations() ? 1 : 0;
 }
@@ -4,9 +4,18 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
 #include "util/test.h"
+#include "util/timeit.h"
 #include "util/exception.h"
 #include "util/trace.h"
+#include "util/lean_path.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/environment.h"
 #include "kernel/type_checker.h"
@@ -271,6 +280,308 @@ static void tst13() {
     } catch (exception &) {}
 }
 
+static void tst14() {
+    environment env;
+    env->add_var("a", Type());
+    {
+        environment child = env->mk_child();
+        child->add_var("b", Type());
+        lean_assert(child->find_object("a"));
+        lean_assert(!env->find_object("b"));
+        try {
+            child->add_var("a", Type());
+            lean_unreachable();
+        } catch (exception &) {}
+    }
+    // the objects declared after the children are deleted are visible in new children
+    env->add_var("c", Type());
+    environment child = env->mk_child();
+    lean_assert(child->find_object("c"));
+    lean_assert(!child->find_object("b"));
+}
+
+static void tst15() {
+    // lookup time does not depend on the number of ancestors
+    for (unsigned depth : {1, 10, 100, 1000}) {
+        std::vector<environment> envs;
+        envs.push_back(environment());
+        envs.back()->add_var("a", Type());
+        for (unsigned i = 0; i < depth; i++) {
+            envs.push_back(envs.back()->mk_child());
+            envs.back()->add_var(name("x", i), Type());
+        }
+        environment const & env = envs.back();
+        name a("a"), b("b");
+        unsigned found = 0;
+        {
+            std::string msg = "100000 lookups at depth " + std::to_string(depth);
+            timeit timer(std::cout, msg.c_str());
+            for (unsigned i = 0; i < 50000; i++) {
+                if (env->find_object(a)) found++;
+                if (env->find_object(b)) found++;
+            }
+        }
+        lean_assert_eq(found, 50000u);
+    }
+}
+
+static void tst16() {
+    // export objects to a .olean file, and load them back
+    environment env;
+    io_state ios(options(), mk_simple_formatter());
+    expr A = Const("A");
+    expr a = Const("a");
+    expr f = Const("f");
+    expr x = Const("x");
+    env->add_var("A", Type());
+    env->add_var("a", A);
+    env->add_axiom("ax", A);
+    env->add_definition("f", mk_arrow(A, A), Fun({x, A}, x));
+    env->add_definition("g", mk_arrow(A, A), Fun({x, A}, f(x)), true);
+    env->add_theorem("t", A, f(a));
+    std::string fname = "environment_tst16.olean";
+    env->export_objects(fname);
+    environment env2;
+    env2->load(fname, ios);
+    std::remove(fname.c_str());
+    for (char const * n : {"A", "a", "ax", "f", "g", "t"}) {
+        object obj1 = env->get_object(n);
+        object obj2 = env2->get_object(n);
+        lean_assert_eq(std::string(obj1.keyword()), std::string(obj2.keyword()));
+        lean_assert_eq(obj1.get_type(), obj2.get_type());
+        lean_assert_eq(obj1.is_definition(), obj2.is_definition());
+        if (obj1.is_definition()) {
+            lean_assert_eq(obj1.get_value(), obj2.get_value());
+            lean_assert_eq(obj1.is_opaque(), obj2.is_opaque());
+            lean_assert_eq(obj1.get_weight(), obj2.get_weight());
+        }
+    }
+    // expressions shared by different objects are still shared
+    lean_assert(is_eqp(env2->get_object("f").get_type(), env2->get_object("g").get_type()));
+    lean_assert(!is_eqp(env->get_object("f").get_type(), env->get_object("g").get_type()));
+}
+
+class counting_source : public lazy_expr_source {
+    std::vector<expr> m_exprs;
+    unsigned          m_num_reads;
+public:
+    counting_source(std::vector<expr> const & es):m_exprs(es), m_num_reads(0) {}
+    virtual expr read(unsigned i) { m_num_reads++; return m_exprs[i]; }
+    unsigned get_num_reads() const { return m_num_reads; }
+};
+
+static void tst17() {
+    // the type and value of lazy objects are read on demand, and only once
+    expr A = Const("A");
+    expr a = Const("a");
+    std::shared_ptr<counting_source> src = std::make_shared<counting_source>(std::vector<expr>{A, a, mk_arrow(A, A)});
+    object t = mk_lazy_theorem("t", src, 0, 1);
+    object d = mk_lazy_definition("d", 3, src, 2, 1);
+    object v = mk_lazy_var_decl("v", src, 0);
+    lean_assert(t.is_theorem() && t.is_definition() && t.is_opaque());
+    lean_assert(d.is_definition() && !d.is_theorem() && !d.is_opaque() && d.get_weight() == 3);
+    lean_assert(v.is_var_decl() && !v.is_definition() && v.kind() == object_kind::Postulate);
+    lean_assert_eq(src->get_num_reads(), 0u);
+    lean_assert_eq(t.get_type(), A);
+    lean_assert_eq(t.get_type(), A);
+    lean_assert_eq(src->get_num_reads(), 1u);
+    lean_assert_eq(t.get_value(), a);
+    lean_assert_eq(d.get_type(), mk_arrow(A, A));
+    lean_assert_eq(src->get_num_reads(), 3u);
+}
+
+static void tst18() {
+    // a .olean file refers to the expressions exported by the modules it imports
+    io_state ios(options(), mk_simple_formatter());
+    environment env;
+    env->set_trusted_imported(true);
+    env->import("kernel", ios);
+    expr bin = mk_arrow(Bool, mk_arrow(Bool, Bool));
+    env->add_var("h", bin);
+    env->add_var("h2", mk_arrow(bin, Bool));
+    std::string fname = "environment_tst18.olean";
+    env->export_objects(fname);
+    environment env2;
+    env2->set_trusted_imported(true);
+    env2->load(fname, ios);
+    lean_assert(env2->imported("kernel"));
+    expr and_type = env2->get_object("and").get_type();
+    lean_assert_eq(and_type, bin);
+    lean_assert(is_eqp(env2->get_object("h").get_type(), and_type));
+    lean_assert(is_eqp(abst_domain(env2->get_object("h2").get_type()), and_type));
+    // the file cannot be used with a different version of the kernel module
+    std::string contents;
+    {
+        std::ifstream in(fname, std::ifstream::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto pos = contents.find("kernel");
+    lean_assert(pos != std::string::npos);
+    contents[pos + 6] ^= 1; // first byte of the hash code of the kernel module
+    {
+        std::ofstream out(fname, std::ofstream::binary);
+        out << contents;
+    }
+    environment env3;
+    env3->set_trusted_imported(true);
+    try {
+        env3->load(fname, ios);
+        lean_unreachable();
+    } catch (exception & ex) {
+        std::cout << "expected error: " << ex.what() << "\n";
+    }
+    std::remove(fname.c_str());
+}
+
+static void tst21() {
+    // only the version of the imported modules whose expressions are used is checked
+    io_state ios(options(), mk_simple_formatter());
+    environment env;
+    env->set_trusted_imported(true);
+    env->import("kernel", ios); // the file does not contain expressions, so it does not use the ones exported by kernel
+    std::string fname = "environment_tst21.olean";
+    env->export_objects(fname);
+    std::string contents;
+    {
+        std::ifstream in(fname, std::ifstream::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto pos = contents.find("kernel");
+    lean_assert(pos != std::string::npos);
+    contents[pos + 6] ^= 1; // first byte of the hash code of the kernel module
+    {
+        std::ofstream out(fname, std::ofstream::binary);
+        out << contents;
+    }
+    environment env2;
+    env2->set_trusted_imported(true);
+    env2->load(fname, ios);
+    lean_assert(env2->imported("kernel"));
+    lean_assert(env2->find_object("and"));
+    std::remove(fname.c_str());
+}
+
+static void tst22() {
+    // the objects declared before an import command precede the objects of the imported module
+    io_state ios(options(), mk_simple_formatter());
+    add_lean_path(".");
+    auto mk_module = [&](char const * fname, std::function<void(environment const &)> const & fn) {
+        environment env;
+        fn(env);
+        env->export_objects(fname);
+    };
+    mk_module("environment_tst22_a.olean", [&](environment const & env) { env->add_var("a", Type()); });
+    mk_module("environment_tst22_b.olean", [&](environment const & env) { env->add_var("b", Type()); });
+    mk_module("environment_tst22_c.olean", [&](environment const & env) {
+            env->import("environment_tst22_a", ios);
+            env->add_var("c", Type());
+            env->import("environment_tst22_b", ios);
+            env->add_var("d", Type());
+        });
+    for (unsigned num_threads : {1, 4}) {
+        environment env;
+        env->set_import_threads(num_threads);
+        env->import("environment_tst22_c", ios);
+        std::vector<name> names;
+        for (auto it = env->begin_objects(); it != env->end_objects(); ++it) {
+            if (it->has_name())
+                names.push_back(it->get_name());
+        }
+        lean_assert(names == std::vector<name>({"a", "c", "b", "d"}));
+    }
+    for (char const * f : {"environment_tst22_a.olean", "environment_tst22_b.olean", "environment_tst22_c.olean"})
+        std::remove(f);
+}
+
+static void tst23() {
+    // .olean files are replaced atomically, and write failures are reported
+    io_state ios(options(), mk_simple_formatter());
+    environment env;
+    env->add_var("a", Type());
+    std::string fname = "environment_tst23.olean";
+    env->export_objects(fname);
+    environment env2;
+    env2->load(fname, ios);
+    env->add_var("b", Type());
+    env->export_objects(fname);
+    lean_assert(!std::ifstream(fname + ".tmp"));
+    // the old file is still used by env2
+    lean_assert_eq(env2->get_object("a").get_type(), Type());
+    environment env3;
+    env3->load(fname, ios);
+    lean_assert(env3->find_object("b"));
+    try {
+        env->export_objects("environment_tst23_no_such_dir/a.olean");
+        lean_unreachable();
+    } catch (exception & ex) {
+        std::cout << "expected error: " << ex.what() << "\n";
+    }
+    std::remove(fname.c_str());
+}
+
+static void check_same_objects(environment const & env1, environment const & env2) {
+    lean_assert_eq(env1->get_num_objects(false), env2->get_num_objects(false));
+    auto it1 = env1->begin_objects();
+    auto it2 = env2->begin_objects();
+    for (; it1 != env1->end_objects(); ++it1, ++it2) {
+        lean_assert_eq(std::string(it1->keyword()), std::string(it2->keyword()));
+        lean_assert_eq(it1->has_name(), it2->has_name());
+        if (it1->has_name())
+            lean_assert_eq(it1->get_name(), it2->get_name());
+        lean_assert(get_imported_module(*it1) == get_imported_module(*it2));
+    }
+}
+
+static void tst19() {
+    // importing modules together (and in parallel) produces the same objects as importing them one by one
+    io_state ios(options(), mk_simple_formatter());
+    for (bool trusted : {true, false}) {
+        environment env1;
+        env1->set_trusted_imported(trusted);
+        env1->set_import_threads(4);
+        lean_assert(env1->import(std::vector<std::string>{"cast", "specialfn", "Nat"}, ios));
+        lean_assert(!env1->import(std::vector<std::string>{"Real", "heq"}, ios));
+        environment env2;
+        env2->set_trusted_imported(trusted);
+        env2->set_import_threads(1);
+        lean_assert(env2->import("cast", ios));
+        lean_assert(env2->import("specialfn", ios));
+        lean_assert(!env2->import("Nat", ios));
+        check_same_objects(env1, env2);
+        lean_assert_eq(env1->get_object("exp").get_type(), env2->get_object("exp").get_type());
+    }
+}
+
+static void tst20() {
+    // .olean files created using a different version of the format are rejected
+    io_state ios(options(), mk_simple_formatter());
+    environment env;
+    env->add_var("A", Type());
+    std::string fname = "environment_tst20.olean";
+    env->export_objects(fname);
+    std::string contents;
+    {
+        std::ifstream in(fname, std::ifstream::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto pos = contents.find("oleanindex");
+    lean_assert(pos != std::string::npos);
+    contents[pos + 10]--; // version of the format
+    {
+        std::ofstream out(fname, std::ofstream::binary);
+        out << contents;
+    }
+    environment env2;
+    try {
+        env2->load(fname, ios);
+        lean_unreachable();
+    } catch (exception & ex) {
+        std::cout << "expected error: " << ex.what() << "\n";
+        lean_assert(std::string(ex.what()).find("incompatible version") != std::string::npos);
+    }
+    std::remove(fname.c_str());
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -288,5 +599,15 @@ int main() {
     tst11();
     tst12();
     tst13();
+    tst14();
+    tst15();
+    tst16();
+    tst17();
+    tst18();
+    tst19();
+    tst20();
+    tst21();
+    tst22();
+    tst23();
     return has_violations() ? 1 : 0;
 }
@@ -6,11 +6,15 @@ Author: Leonardo de Moura
         Soonho Kong
 */
 #include <algorithm>
+#include <unordered_set>
 #include <utility>
 #include <vector>
+#include "util/thread.h"
 #include "util/test.h"
+#include "util/timeit.h"
 #include "kernel/expr.h"
 #include "kernel/expr_sets.h"
+#include "kernel/expr_eq.h"
 #include "kernel/free_vars.h"
 #include "kernel/abstract.h"
 #include "kernel/instantiate.h"
@@ -404,6 +408,222 @@ static void tst21() {
     check_serializer(t);
 }
 
+static void tst22() {
+    expr f = Const("f");
+    expr a = Const("a");
+    {
+        scoped_hash_consing scope;
+        lean_assert(is_hash_consing_enabled());
+        expr g = Const("g");
+        expr b = Const("b");
+        expr t = Const("T");
+        expr e1 = g(Var(0), mk_lambda("x", t, g(Var(0), b)));
+        expr e2 = Const("g")(Var(0), mk_lambda("x", Const("T"), g(Var(0), Const("b"))));
+        lean_assert(is_eqp(e1, e2));
+        lean_assert(e1.raw()->max_shared());
+        // binder names are not ignored
+        expr e3 = g(Var(0), mk_lambda("y", t, g(Var(0), b)));
+        lean_assert(!is_eqp(e1, e3));
+        lean_assert(e1 == e3);
+        // children created before hash-consing was enabled are not maximally shared
+        expr e5 = mk_app(f, a);
+        lean_assert(!e5.raw()->max_shared());
+        lean_assert(is_eqp(e5, mk_app(f, a)));
+        lean_assert(is_eqp(max_sharing(e1), e1));
+        {
+            scoped_hash_consing disable(false);
+            lean_assert(!is_hash_consing_enabled());
+            lean_assert(!is_eqp(mk_var(1), mk_var(1)));
+        }
+        lean_assert(is_eqp(mk_var(1), mk_var(1)));
+        lean_assert(get_hash_consing_table_size() > 0);
+    }
+    lean_assert(!is_hash_consing_enabled());
+    lean_assert(get_hash_consing_table_size() == 0);
+    lean_assert(!is_eqp(mk_var(1), mk_var(1)));
+}
+
+static void tst27() {
+    expr f = Const("f");
+    scoped_hash_consing scope;
+    expr a = f(Const("a"));
+    // expressions that are not referenced anymore are eventually removed from the intern table
+    for (unsigned i = 0; i < 100000; i++) {
+        expr t = f(Const("a"), mk_var(i));
+        lean_assert(get_hash_consing_table_size() < 10000);
+    }
+    lean_assert(is_eqp(a, f(Const("a"))));
+}
+
+static void tst28() {
+    // the intern table is shared by all threads, and the cells are removed from it when they are deleted
+    expr f = Const("f");
+    scoped_hash_consing scope;
+    expr a = mk_big(f, 10, 0);
+    unsigned sz = get_hash_consing_table_size();
+#if !defined(__APPLE__) && defined(LEAN_MULTI_THREAD)
+    std::vector<expr> rs(4);
+    {
+        scoped_shared_rc shared_rc;
+        std::vector<thread> ts;
+        for (unsigned i = 0; i < rs.size(); i++) {
+            ts.push_back(thread([&, i]() {
+                        save_stack_info();
+                        for (unsigned j = 0; j < 100; j++) {
+                            rs[i] = mk_big(f, 10, 0);
+                            expr t = mk_big(f, 10, j + 1);
+                        }
+                    }));
+        }
+        for (thread & t : ts)
+            t.join();
+    }
+    for (expr const & r : rs)
+        lean_assert(is_eqp(r, a));
+#endif
+    lean_assert_eq(get_hash_consing_table_size(), sz);
+}
+
+static unsigned count_cells(expr const & e, std::unordered_set<expr_cell*> & visited) {
+    if (!visited.insert(e.raw()).second)
+        return 0;
+    unsigned r = 1;
+    if (is_app(e)) {
+        for (expr const & a : args(e))
+            r += count_cells(a, visited);
+    }
+    return r;
+}
+
+static unsigned count_cells(expr const & e) {
+    std::unordered_set<expr_cell*> visited;
+    return count_cells(e, visited);
+}
+
+static void tst23() {
+    expr f = Const("f");
+    unsigned cells = 0;
+    {
+        timeit timer(std::cout, "mk_redundant_dag without hash-consing");
+        for (unsigned i = 0; i < 10; i++) {
+            expr r = mk_redundant_dag(f, 16);
+            cells  = count_cells(r);
+        }
+    }
+    std::cout << "number of cells: " << cells << "\n";
+    {
+        timeit timer(std::cout, "mk_redundant_dag with hash-consing");
+        for (unsigned i = 0; i < 10; i++) {
+            scoped_hash_consing scope;
+            expr r = mk_redundant_dag(f, 16);
+            cells  = count_cells(r);
+            lean_assert(get_hash_consing_table_size() == 17);
+        }
+    }
+    std::cout << "number of cells: " << cells << "\n";
+    lean_assert(cells == 18);
+}
+
+static void copy_expr(expr const & a, unsigned n) {
+    std::vector<expr> v(16);
+    for (unsigned i = 0; i < n; i++) {
+        expr c(a);
+        v[i % 16] = c;
+    }
+    lean_assert(a.raw()->get_rc() == 17);
+}
+
+static void tst24() {
+    expr a = Const("f")(Const("a"), Const("b"));
+    unsigned N = 10000000;
+    lean_assert(!is_shared_rc());
+    {
+        timeit timer(std::cout, "copy 10000000 times using non-atomic reference counting");
+        copy_expr(a, N);
+    }
+    {
+        scoped_shared_rc shared_rc;
+#if defined(LEAN_MULTI_THREAD)
+        lean_assert(is_shared_rc());
+#endif
+        timeit timer(std::cout, "copy 10000000 times using atomic reference counting");
+        copy_expr(a, N);
+    }
+    lean_assert(!is_shared_rc());
+}
+
+static void tst25() {
+    expr f  = Const("f");
+    expr r1 = mk_big(f, 16, 0);
+    expr r2 = mk_big(f, 16, 0);
+    // the type of a let-expression is not used to compute its hash code
+    expr r3 = mk_let("x", Const("A"), mk_big(f, 16, 0), Var(0));
+    expr r4 = mk_let("x", Const("B"), mk_big(f, 16, 0), Var(0));
+    lean_assert(r3.hash() == r4.hash());
+    unsigned N = 100;
+    {
+        timeit timer(std::cout, "compare big unshared terms 100 times without memo");
+        for (unsigned i = 0; i < N; i++) {
+            lean_assert(r1 == r2);
+        }
+    }
+    expr_eq_memo memo;
+    scoped_expr_eq_memo set_memo(memo);
+    lean_assert(get_expr_eq_memo() == &memo);
+    {
+        timeit timer(std::cout, "compare big unshared terms 100 times using memo");
+        for (unsigned i = 0; i < N; i++) {
+            lean_assert(r1 == r2);
+            lean_assert(r2 == r1);
+            lean_assert(r3 != r4);
+        }
+    }
+    std::cout << "eq hits: " << memo.get_num_eq_hits() << ", diff hits: " << memo.get_num_diff_hits()
+              << ", misses: " << memo.get_num_misses() << "\n";
+    lean_assert_eq(memo.get_num_eq_hits(), 2*N - 1);
+    lean_assert_eq(memo.get_num_diff_hits(), N - 1);
+}
+
+static void tst26() {
+    expr f = Const("f");
+    expr a = Const("a");
+    expr b = Const("b");
+    expr_eq_memo memo(7);
+    lean_assert(!memo.check(f(a), f(a)));
+    memo.add(f(a), f(a), true);
+    lean_assert(memo.size() == 2);
+    expr t1 = f(a, b);
+    expr t2 = f(a, b);
+    expr t3 = f(a, b);
+    memo.add(t1, t2, true);
+    memo.add(t2, t3, true);
+    // equality is transitive
+    lean_assert(*memo.check(t1, t3));
+    lean_assert(*memo.check(t3, t1));
+    expr t4 = f(b, a);
+    memo.add(t4, t1, false);
+    lean_assert(!*memo.check(t1, t4));
+    lean_assert(memo.size() == 6);
+    // the memo is reset when it is full
+    memo.add(f(b), f(b), true);
+    lean_assert(memo.size() == 2);
+    lean_assert(!memo.check(t1, t3));
+    // the pairs of different expressions are also bounded
+    expr_eq_memo memo2(8);
+    expr cs[6] = { a, b, f(a), f(b), f(a, a), f(b, b) };
+    for (unsigned i = 0; i < 6; i++)
+        for (unsigned j = i + 1; j < 6; j++)
+            memo2.add(cs[i], cs[j], false);
+    lean_assert(memo2.get_num_different() < 8);
+    {
+        scoped_expr_eq_memo set_memo(memo);
+        lean_assert(get_expr_eq_memo() == &memo);
+        lean_assert(t1 == t3);
+        lean_assert(*memo.check(t1, t3));
+    }
+    lean_assert(get_expr_eq_memo() == nullptr);
+}
+
 int main() {
     save_stack_info();
     lean_assert(sizeof(expr) == sizeof(optional<expr>));
@@ -428,6 +648,13 @@ int main() {
     tst19();
     tst20();
     tst21();
+    tst22();
+    tst23();
+    tst24();
+    tst25();
+    tst26();
+    tst27();
+    tst28();
     std::cout << "sizeof(expr):            " << sizeof(expr) << "\n";
     std::cout << "sizeof(expr_app):        " << sizeof(expr_app) << "\n";
     std::cout << "sizeof(expr_cell):       " << sizeof(expr_cell) << "\n";
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <limits>
 #include "util/test.h"
 #include "kernel/free_vars.h"
 #include "kernel/abstract.h"
@@ -147,6 +148,40 @@ static void tst6() {
     lean_assert(lift_free_vars(f(m2), 0, 1, menv) == f(add_lift(m2, 0, 1)));
 }
 
+static void tst7() {
+    metavar_env menv;
+    expr f = Const("f");
+    expr t = Const("t");
+    lean_assert(get_free_var_range(f) == 0);
+    lean_assert(get_free_var_range(Var(3)) == 4);
+    lean_assert(get_free_var_range(f(Var(0), Var(2))) == 3);
+    lean_assert(get_free_var_range(mk_lambda("x", t, f(Var(0), Var(2)))) == 2);
+    lean_assert(get_free_var_range(mk_lambda("x", Var(4), f(Var(0)))) == 5);
+    lean_assert(get_free_var_range(mk_pi("x", t, mk_lambda("y", t, f(Var(0), Var(1))))) == 0);
+    lean_assert(get_free_var_range(mk_let("x", f(Var(1)), f(Var(0)))) == 2);
+    lean_assert(get_free_var_range(mk_let("x", Var(5), f(Var(0)), f(Var(1)))) == 6);
+    lean_assert(get_free_var_range(mk_constant("c", Var(1))) == 2);
+    // big de Bruijn indices
+    lean_assert(get_free_var_range(f(Var(70000))) >= 70001);
+    lean_assert(get_free_var_range(mk_lambda("x", t, f(Var(70000)))) >= 70000);
+    lean_assert(has_free_var(mk_lambda("x", t, f(Var(70000))), 69999));
+    lean_assert(get_free_var_range(mk_lambda("x", t, f(Var(65533)))) == 65533);
+    expr m = menv->mk_metavar(context({{"x", t}, {"y", t}}));
+    lean_assert(closed(mk_lambda("x", t, Var(0))));
+    lean_assert(!closed(mk_lambda("x", t, m)));
+    lean_assert(free_var_range(f(m, Var(0)), menv) == 2);
+    lean_assert(free_var_range(f(m, Var(0))) == std::numeric_limits<unsigned>::max());
+    // subterms that do not contain the affected variables are not visited, and are preserved
+    expr big = f(Var(0), Var(1));
+    for (unsigned i = 0; i < 10; i++)
+        big = f(big, big);
+    expr F = f(Var(3), big);
+    lean_assert(is_eqp(arg(lift_free_vars(F, 2, 1), 2), big));
+    lean_assert(lift_free_vars(F, 2, 1) == f(Var(4), big));
+    lean_assert(is_eqp(arg(lower_free_vars(F, 3, 1), 2), big));
+    lean_assert(lower_free_vars(F, 3, 1) == f(Var(2), big));
+}
+
 int main() {
     save_stack_info();
     tst1();
@@ -155,5 +190,6 @@ int main() {
     tst4();
     tst5();
     tst6();
+    tst7();
     return has_violations() ? 1 : 0;
 }
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include "util/test.h"
+#include "util/timeit.h"
 #include "kernel/abstract.h"
 #include "kernel/instantiate.h"
 #include "kernel/metavar.h"
@@ -88,11 +89,88 @@ static void tst4() {
     lean_assert_eq(head_beta_reduce(F2, menv), g(a, add_inst(m2, 0, a)));
 }
 
+static expr mk_big(expr const & f, unsigned depth, unsigned val) {
+    if (depth == 1)
+        return Const(name(name("foo"), val));
+    else
+        return f(mk_big(f, depth - 1, val << 1), mk_big(f, depth - 1, (val << 1) + 1));
+}
+
+static void tst5() {
+    expr f = Const("f");
+    expr T = Const("T");
+    expr a = Const("a");
+    // big does not contain free variables, and it does not have shared subterms
+    expr big = mk_big(f, 16, 0);
+    expr F = Fun({{Const("x"), T}, {Const("y"), T}}, f(Const("x"), mk_lambda("z", T, f(Var(2), big))));
+    expr body = abst_body(abst_body(F));
+    {
+        timeit timer(std::cout, "instantiate 10000 times");
+        for (unsigned i = 0; i < 10000; i++) {
+            expr r = instantiate(body, a);
+            lean_assert(is_eqp(arg(abst_body(arg(r, 2)), 2), big));
+        }
+    }
+    expr r = head_beta_reduce(F(a, a));
+    lean_assert_eq(r, f(a, mk_lambda("z", T, f(a, big))));
+}
+
+static void tst6() {
+    expr f = Const("f");
+    expr g = Const("g");
+    expr T = Const("T");
+    expr a = Const("a");
+    expr b = Const("b");
+    expr x = Const("x");
+    // the body contains many occurrences of x, and does not have shared subterms
+    expr body = x;
+    for (unsigned i = 0; i < 2000; i++)
+        body = f(body, g(x, Const(name("c", i))));
+    expr F = Fun({x, T}, body);
+    {
+        timeit timer(std::cout, "apply_beta 100 times without memo");
+        for (unsigned i = 0; i < 100; i++)
+            apply_beta(F, 1, &a);
+    }
+    unsigned N = 1000;
+    instantiate_memo memo(2);
+    scoped_instantiate_memo set_memo(memo);
+    lean_assert(get_instantiate_memo() == &memo);
+    expr r1 = apply_beta(F, 1, &a);
+    {
+        timeit timer(std::cout, "apply_beta 1000 times using memo");
+        for (unsigned i = 0; i < N; i++)
+            lean_assert(is_eqp(apply_beta(F, 1, &a), r1));
+    }
+    lean_assert_eq(memo.get_num_hits(), N);
+    lean_assert_eq(memo.get_num_misses(), 1u);
+    lean_assert(r1 == instantiate_with_closed(abst_body(F), a));
+    // the memo is keyed on the cells of the arguments
+    expr r2 = apply_beta(F, 1, &b);
+    lean_assert(!is_eqp(r1, r2));
+    lean_assert(memo.size() == 2);
+    // cheap instantiations are not stored
+    lean_assert(instantiate(f(g(Var(0))), a) == f(g(a)));
+    lean_assert(instantiate(f(a), b) == f(a));
+    lean_assert(memo.size() == 2);
+    // the least recently used entry is evicted
+    lean_assert(is_eqp(apply_beta(F, 1, &a), r1));
+    apply_beta(F, 1, &f);
+    lean_assert(memo.size() == 2);
+    lean_assert_eq(memo.get_num_evictions(), 1u);
+    lean_assert(is_eqp(apply_beta(F, 1, &a), r1));
+    unsigned misses = memo.get_num_misses();
+    apply_beta(F, 1, &b);
+    lean_assert_eq(memo.get_num_misses(), misses + 1);
+}
+
 int main() {
     save_stack_info();
     tst1();
     tst2();
     tst3();
     tst4();
+    tst5();
+    tst6();
     return has_violations() ? 1 : 0;
 }
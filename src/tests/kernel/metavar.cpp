@@ -630,6 +630,44 @@ static void tst28() {
     lean_assert(add_lift(m2, 2, 2, menv) != add_lift(m2, 2, 2));
 }
 
+static void tst29() {
+    // copies share the metavariable data, and updating one of them does not affect the others
+    metavar_env menv;
+    expr f = Const("f");
+    expr a = Const("a");
+    expr b = Const("b");
+    std::vector<expr> ms;
+    for (unsigned i = 0; i < 100; i++)
+        ms.push_back(menv->mk_metavar());
+    metavar_env menv2 = menv.copy();
+    for (unsigned i = 0; i < 100; i += 2)
+        menv->assign(ms[i], f(a));
+    lean_assert(!menv->has_type(ms[1]));
+    expr t1 = menv->get_type(ms[1]);
+    lean_assert(menv->has_type(ms[1]));
+    lean_assert(!menv2->has_type(ms[1]));
+    metavar_env menv3 = menv.copy();
+    menv3->assign(ms[1], f(ms[0]));
+    menv3->assign(ms[3], b);
+    for (unsigned i = 0; i < 100; i++) {
+        lean_assert(!menv2->is_assigned(ms[i]));
+        lean_assert(menv->is_assigned(ms[i]) == (i % 2 == 0));
+        lean_assert(menv3->is_assigned(ms[i]) == (i % 2 == 0 || i == 1 || i == 3));
+    }
+    lean_assert(is_eqp(menv3->get_type(ms[1]), t1));
+    // the normalized substitution is cached in menv3 only
+    lean_assert(*(menv3->get_subst(ms[1])) == f(f(a)));
+    lean_assert(*(menv3->get_subst(ms[1])) == f(f(a)));
+    lean_assert(!menv->is_assigned(ms[1]));
+    // substitutions are visited in a deterministic order
+    std::vector<name> ns1, ns2;
+    menv->for_each_subst([&](name const & n, expr const &) { ns1.push_back(n); });
+    menv.copy()->for_each_subst([&](name const & n, expr const &) { ns2.push_back(n); });
+    lean_assert(ns1.size() == 50);
+    lean_assert(ns1 == ns2);
+    lean_assert(std::is_sorted(ns1.begin(), ns1.end(), [](name const & n1, name const & n2) { return quick_cmp(n1, n2) < 0; }));
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -661,5 +699,6 @@ int main() {
     tst26();
     tst27();
     tst28();
+    tst29();
     return has_violations() ? 1 : 0;
 }
@@ -10,6 +10,7 @@ Author: Leonardo de Moura
 #include "util/trace.h"
 #include "util/exception.h"
 #include "util/interrupt.h"
+#include "util/timeit.h"
 #include "kernel/normalizer.h"
 #include "kernel/kernel.h"
 #include "kernel/expr_sets.h"
@@ -21,6 +22,7 @@ Author: Leonardo de Moura
 #include "library/io_state_stream.h"
 #include "library/deep_copy.h"
 #include "library/arith/int.h"
+#include "library/arith/nat.h"
 #include "frontends/lean/frontend.h"
 #include "frontends/lua/register_modules.h"
 using namespace lean;
@@ -343,6 +345,175 @@ static void tst11() {
                    menv->instantiate_metavars(N));
 }
 
+static void check_machine(environment const & env, expr const & e, context const & ctx = context()) {
+    expr r1 = normalizer(env, std::numeric_limits<unsigned>::max(), false)(e, ctx);
+    expr r2 = normalizer(env, std::numeric_limits<unsigned>::max(), true)(e, ctx);
+    std::cout << e << " --> " << r2 << "\n";
+    lean_assert_eq(r1, r2);
+}
+
+static void tst12() {
+    environment env;
+    init_test_frontend(env);
+    env->add_var("N", Type());
+    env->add_var("z", Const("N"));
+    env->add_var("s", Const("N"));
+    env->add_var("f", Int >> (Int >> Int));
+    env->add_var("P", Int >> (Int >> Bool));
+    expr N = Const("N");
+    expr z = Const("z");
+    expr s = Const("s");
+    expr f = Const("f");
+    expr P = Const("P");
+    expr x = Const("x");
+    expr y = Const("y");
+    check_machine(env, mk_app(four(), N, s, z));
+    check_machine(env, mk_app(mk_app(power(), two(), four()), N, s, z));
+    check_machine(env, mk_app(mk_app(times(), four(), mk_app(power(), two(), four())), N, s, z));
+    check_machine(env, lam(lam(mk_app(mk_app(times(), four(), four()), N, Var(0), z))));
+    check_machine(env, power());
+    // semantic attachments
+    check_machine(env, mk_Int_add(iVal(1), mk_Int_mul(iVal(2), iVal(3))));
+    check_machine(env, Fun({x, Int}, mk_Int_add(iVal(1), mk_Int_add(iVal(2), x))));
+    check_machine(env, Fun({x, Int}, f(Fun({y, Int}, mk_Int_add(y, iVal(1)))(iVal(2)), x)));
+    // arrows between Boolean values
+    check_machine(env, mk_arrow(mk_arrow(True, False), False));
+    check_machine(env, Fun({x, Bool}, mk_arrow(x, True)));
+    check_machine(env, mk_pi("x", Int, Not(mk_lambda("x", Int, mk_exists(Int, mk_lambda("y", Int, P(Var(1), Var(0)))))(Var(0)))));
+    // let-expressions and definitions
+    env->add_definition("g", Int >> Int, Fun({x, Int}, mk_Int_add(x, iVal(1))));
+    expr g = Const("g");
+    check_machine(env, Let({{x, g(iVal(2))}, {y, f(x, x)}}, f(y, g(y))));
+    check_machine(env, Fun({x, Int}, Let({y, g(x)}, f(y, Var(1)))));
+    // context
+    context ctx = extend(extend(context(), "a", Int), "b", Int, mk_Int_add(iVal(1), iVal(2)));
+    check_machine(env, f(Var(0), Var(1)), ctx);
+    check_machine(env, Fun({x, Int}, f(Var(1), Var(2))), ctx);
+    // metavariables
+    metavar_env menv;
+    expr m = menv->mk_metavar(ctx);
+    check_machine(env, Fun({x, Int}, f(m, Fun({y, Int}, m)(x))), ctx);
+    check_machine(env, Fun({x, Int}, m(x, Var(1))), ctx);
+}
+
+static void tst13() {
+    environment env;
+    env->add_var("N", Type());
+    env->add_var("z", Const("N"));
+    env->add_var("s", Const("N"));
+    expr N = Const("N");
+    expr z = Const("z");
+    expr s = Const("s");
+    expr e = mk_app(mk_app(power(), two(), mk_app(power(), two(), three())), N, s, z);
+    expr r1, r2;
+    {
+        timeit timer(std::cout, "normalize 2^(2^3) using the recursive engine");
+        r1 = normalizer(env, std::numeric_limits<unsigned>::max(), false)(e);
+    }
+    {
+        timeit timer(std::cout, "normalize 2^(2^3) using the abstract machine");
+        r2 = normalizer(env, std::numeric_limits<unsigned>::max(), true)(e);
+    }
+    lean_assert_eq(r1, r2);
+    // the abstract machine does not use the C++ stack for long chains of beta-reductions
+    expr id = lam(N, Var(0));
+    expr a  = z;
+    for (unsigned i = 0; i < 100000; i++)
+        a = id(a);
+    lean_assert_eq(normalizer(env, std::numeric_limits<unsigned>::max(), true)(a), z);
+    options opts({"kernel", "normalizer", "machine"}, true);
+    lean_assert_eq(normalizer(env, opts)(a), z);
+}
+
+static void tst14(bool use_machine) {
+    environment env;
+    init_test_frontend(env);
+    auto nf = [&](expr const & e, environment const & env, bool unfold_opaque) {
+        return normalizer(env, std::numeric_limits<unsigned>::max(), use_machine)(e, context(), unfold_opaque);
+    };
+    expr x = Const("x");
+    expr h = Const("h");
+    expr g = Const("g");
+    env->add_definition("h", Int, mk_Int_add(iVal(1), iVal(2)));
+    env->add_definition("g", Int >> Int, Fun({x, Int}, mk_Int_mul(h, x)));
+    lean_assert(!env->get_cached_normal_form("h", false));
+    lean_assert_eq(nf(g(h), env, false), iVal(9));
+    // the normal forms are stored in the environment, and shared by other normalizers
+    lean_assert_eq(*env->get_cached_normal_form("h", false), iVal(3));
+    // the body of g is not normalized eagerly
+    lean_assert(!env->get_cached_normal_form("g", false));
+    lean_assert(!env->get_cached_normal_form("h", true));
+    lean_assert_eq(nf(g(iVal(2)), env, false), iVal(6));
+    {
+        environment child = env->mk_child();
+        child->add_definition("h2", Int, mk_Int_add(h, h));
+        lean_assert_eq(nf(Const("h2"), child, false), iVal(6));
+        lean_assert_eq(*child->get_cached_normal_form("h", false), iVal(3));
+        lean_assert_eq(*child->get_cached_normal_form("h2", false), iVal(6));
+        lean_assert(!env->get_cached_normal_form("h2", false));
+    }
+    // set_opaque discards the cached values
+    env->set_opaque("h", true);
+    lean_assert(!env->get_cached_normal_form("h", false));
+    lean_assert_eq(nf(g(iVal(2)), env, false), mk_Int_mul(h, iVal(2)));
+    lean_assert_eq(nf(g(iVal(2)), env, true), iVal(6));
+    env->set_opaque("h", false);
+    lean_assert_eq(nf(g(iVal(2)), env, false), iVal(6));
+    // the cached normal forms are used instead of the values of the definitions
+    env->add_definition("h3", Int, mk_Int_add(iVal(1), iVal(1)));
+    env->set_cached_normal_form("h3", false, iVal(5));
+    lean_assert_eq(nf(mk_Int_add(Const("h3"), iVal(1)), env, false), iVal(6));
+}
+
+static void tst15() {
+    environment env;
+    init_test_frontend(env);
+    env->add_var("f", Int >> (Int >> (Int >> (Int >> Int))));
+    expr f  = Const("f");
+    expr x  = Const("x");
+    expr id = Fun({x, Int}, x);
+    // many beta reductions, but they are not nested
+    expr e  = f(id(id(iVal(1))), id(id(iVal(2))), id(id(iVal(3))), id(id(iVal(4))));
+    expr r  = f(iVal(1), iVal(2), iVal(3), iVal(4));
+    lean_assert_eq(normalizer(env, 8, false)(e), r);
+    lean_assert_eq(normalizer(env, 8, true)(e), r);
+    // nested beta reductions
+    expr a  = iVal(0);
+    for (unsigned i = 0; i < 20; i++)
+        a = id(a);
+    for (bool use_machine : {false, true}) {
+        try {
+            normalizer(env, 8, use_machine)(a);
+            lean_unreachable();
+        } catch (kernel_exception & ex) {
+            std::cout << ex.what() << "\n";
+        }
+    }
+}
+
+static void tst16() {
+    environment env;
+    init_test_frontend(env);
+    // semantic attachments nested 20000 times, the machine does not use the C++ stack for them
+    expr e = nVal(0);
+    for (unsigned i = 0; i < 20000; i++)
+        e = mk_Nat_add(e, nVal(1));
+    lean_assert_eq(normalizer(env, std::numeric_limits<unsigned>::max(), true)(e), nVal(20000));
+    try {
+        normalizer(env, 1000, true)(e);
+        lean_unreachable();
+    } catch (kernel_exception & ex) {
+        std::cout << ex.what() << "\n";
+    }
+    // the depth is the nesting depth, not the number of pending tasks
+    buffer<expr> args;
+    args.push_back(Const("f"));
+    for (unsigned i = 0; i < 2000; i++)
+        args.push_back(mk_Nat_add(nVal(i), nVal(1)));
+    lean_assert_eq(normalizer(env, 16, true)(mk_app(args.size(), args.data())),
+                   normalizer(env, 16, false)(mk_app(args.size(), args.data())));
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -358,5 +529,11 @@ int main() {
     tst9();
     tst10();
     tst11();
+    tst12();
+    tst13();
+    tst14(false);
+    tst14(true);
+    tst15();
+    tst16();
     return has_violations() ? 1 : 0;
 }
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include "util/test.h"
+#include "util/timeit.h"
 #include "kernel/occurs.h"
 #include "kernel/abstract.h"
 #include "library/printer.h"
@@ -54,9 +55,62 @@ static void tst2() {
     lean_assert(p.second.size() == 0);
 }
 
+static expr mk_big(expr const & f, unsigned depth, unsigned val, unsigned num_consts) {
+    if (depth == 1)
+        return Const(name(name("c"), val % num_consts));
+    else
+        return f(mk_big(f, depth - 1, val << 1, num_consts), mk_big(f, depth - 1, (val << 1) + 1, num_consts));
+}
+
+static void tst3() {
+    expr f = Const("f");
+    expr a = Const("a");
+    expr T = Const("T");
+    lean_assert(get_const_signature(Var(0)) == 0);
+    lean_assert(get_const_signature(Type()) == 0);
+    lean_assert(get_const_signature(f) == get_name_signature("f"));
+    lean_assert(get_const_signature(f(a)) == (get_name_signature("f") | get_name_signature("a")));
+    lean_assert(get_const_signature(Fun({a, T}, f(a))) == (get_name_signature("f") | get_name_signature("T")));
+    lean_assert(may_contain_const(mk_let("x", T, a, f(Var(0))), "T"));
+    lean_assert(may_contain_const(mk_constant("a", T), "T"));
+    // every constant in a term is in its signature
+    expr big = mk_big(f, 12, 0, 100);
+    for (unsigned i = 0; i < 100; i++) {
+        lean_assert(may_contain_const(big, name(name("c"), i)));
+        lean_assert(occurs(name(name("c"), i), big));
+    }
+    lean_assert(!occurs(name(name("c"), 100), big));
+}
+
+static void tst5() {
+    // the signature of a term containing a few constants rejects most of the other names
+    expr f   = Const("f");
+    expr big = mk_big(f, 8, 0, 10);
+    unsigned num_rejected = 0;
+    for (unsigned i = 0; i < 100; i++) {
+        if (!may_contain_const(big, name(name("d"), i)))
+            num_rejected++;
+    }
+    lean_assert(num_rejected >= 80);
+}
+
+static void tst4() {
+    expr f   = Const("f");
+    expr big = mk_big(f, 16, 0, 4);
+    unsigned N = 1000;
+    timeit timer(std::cout, "negative occurs queries");
+    for (unsigned i = 0; i < N; i++) {
+        lean_assert(!occurs("g", big));
+        lean_assert(!occurs(name(name("d"), i), big));
+    }
+}
+
 int main() {
     save_stack_info();
     tst1();
     tst2();
+    tst3();
+    tst4();
+    tst5();
     return has_violations() ? 1 : 0;
 }
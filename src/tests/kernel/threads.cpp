@@ -52,6 +52,7 @@ static void tst1() {
     std::vector<thread> ts;
 
     #if !defined(__APPLE__) && defined(LEAN_MULTI_THREAD)
+    scoped_shared_rc shared_rc;
     for (unsigned i = 0; i < 8; i++) {
         ts.push_back(thread([&](){ save_stack_info(); mk(a); }));
     }
@@ -497,6 +497,149 @@ static void tst22() {
     lean_assert(!tc.is_convertible(b, a));
 }
 
+static options lazy_delta_options(bool flag) {
+    return options(name{"kernel", "type_checker", "lazy_delta"}, flag);
+}
+
+static void tst23() {
+    environment env;
+    init_test_frontend(env);
+    expr f  = Const("f");
+    expr a  = Const("a");
+    expr b  = Const("b");
+    expr x  = Const("x");
+    expr T  = Const("T");
+    expr g  = Const("g");
+    expr h  = Const("h");
+    expr op = Const("op");
+    env->add_var("f", Int >> Int);
+    env->add_var("a", Int);
+    env->add_var("b", Int);
+    env->add_definition("T", Type(), Int >> Int);
+    env->add_definition("g", Int >> Int, Fun({x, Int}, f(f(x))));
+    env->add_definition("h", Int >> Int, Fun({x, Int}, g(x)));
+    env->add_opaque_definition("op", Int >> Int, Fun({x, Int}, f(x)));
+    type_checker lazy(env, lazy_delta_options(true));
+    type_checker eager(env, lazy_delta_options(false));
+    auto check = [&](expr const & t1, expr const & t2, context const & ctx) {
+        bool r = lazy.is_convertible(t1, t2, ctx);
+        lean_assert_eq(r, eager.is_convertible(t1, t2, ctx));
+        lean_assert_eq(lazy.is_definitionally_equal(t1, t2, ctx), eager.is_definitionally_equal(t1, t2, ctx));
+        return r;
+    };
+    context ctx;
+    lean_assert(check(h(a), f(f(a)), ctx));
+    lean_assert(check(g(a), h(a), ctx));
+    lean_assert(!check(g(a), h(b), ctx));
+    lean_assert(!check(g(a), f(a), ctx));
+    lean_assert(check(op(a), f(a), ctx));
+    lean_assert(!check(op(a), f(b), ctx));
+    lean_assert(check(T, Int >> Int, ctx));
+    lean_assert(!check(T, Int >> Bool, ctx));
+    lean_assert(check((Int >> Int) >> Type(), T >> Type(level() + 1), ctx));
+    lean_assert(!check((Int >> Int) >> Type(level() + 1), T >> Type(), ctx));
+    lean_assert(check(Fun({x, Int}, h(x)), g, ctx));
+    lean_assert(check(Fun({x, T}, g(x)), Fun({x, Int >> Int}, f(f(x))), ctx));
+    lean_assert(!check(Fun({x, T}, g(x)), Fun({x, Int}, f(f(x))), ctx));
+    lean_assert(check(Let({x, a}, g(x)), f(f(a)), ctx));
+    lean_assert(check(mk_Int_add(iVal(1), iVal(2)), iVal(3), ctx));
+    lean_assert(check(False >> False, True, ctx));
+    lean_assert(!check(False >> True, False, ctx));
+    ctx = extend(ctx, "y", Int, h(a));
+    lean_assert(check(Var(0), f(f(a)), ctx));
+    lean_assert(!check(Var(0), f(a), ctx));
+}
+
+static expr mk_tower(environment & env, char const * prefix, unsigned n) {
+    expr t = Int;
+    for (unsigned i = 0; i < n; i++) {
+        name n(prefix, i);
+        env->add_definition(n, Type(), t >> t);
+        t = Const(n);
+    }
+    return t;
+}
+
+static void tst24() {
+    environment env;
+    init_test_frontend(env);
+    expr t1 = mk_tower(env, "T", 8);
+    expr t2 = mk_tower(env, "U", 8);
+    {
+        type_checker tc(env, lazy_delta_options(false));
+        timeit timer(std::cout, "convertibility using normalization 10 calls");
+        for (unsigned i = 0; i < 10; i++) {
+            lean_assert(tc.is_convertible(t1, t2));
+            tc.clear();
+        }
+    }
+    {
+        type_checker tc(env, lazy_delta_options(true));
+        timeit timer(std::cout, "convertibility using lazy delta-reduction 10 calls");
+        for (unsigned i = 0; i < 10; i++) {
+            lean_assert(tc.is_convertible(t1, t2));
+            tc.clear();
+        }
+    }
+}
+
+static void tst25() {
+    environment env;
+    init_test_frontend(env);
+    expr c  = mk_Int_add(iVal(1), iVal(2));
+    expr x  = Const("x");
+    expr y  = Const("y");
+    expr e  = Fun({{x, Int}, {y, Int}}, mk_Int_add(mk_Int_add(x, c), mk_Int_add(y, c)));
+    type_checker tc(env);
+    lean_assert(tc.check(e) == Int >> (Int >> Int));
+    unsigned hits   = tc.get_num_cache_hits();
+    unsigned misses = tc.get_num_cache_misses();
+    lean_assert(hits > 0);
+    // closed terms survive context switches
+    context ctx({{"z", Int}});
+    lean_assert(tc.check(c, ctx) == Int);
+    lean_assert(tc.get_num_cache_hits() == hits + 1);
+    lean_assert(tc.get_num_cache_misses() == misses);
+    // terms that only had their type inferred are type checked again
+    expr bad  = mk_Int_add(iVal(1), True);
+    expr bad2 = bad;
+    lean_assert(tc.infer_type(bad2) == Int);
+    try {
+        tc.check(bad2);
+        lean_unreachable();
+    } catch (exception &) {
+    }
+    tc.clear();
+    lean_assert(tc.check(c, ctx) == Int);
+    lean_assert(tc.get_num_cache_misses() == misses + 3);
+}
+
+static void tst26() {
+    environment env;
+    init_test_frontend(env);
+    expr f = Const("f");
+    env->add_var("f", Int >> Int);
+    expr e = iVal(0);
+    for (unsigned i = 0; i < 100000; i++)
+        e = f(e);
+    expr x = Const("x");
+    expr l = x;
+    for (unsigned i = 0; i < 1000; i++)
+        l = Let(x, Int, l, f(x));
+    expr t = Int;
+    for (unsigned i = 0; i < 1000; i++)
+        t = Int >> t;
+    expr b = Var(0);
+    for (unsigned i = 0; i < 1000; i++)
+        b = mk_lambda("x", Int, b);
+    type_checker tc(env);
+    timeit timer(std::cout, "deep terms");
+    lean_assert(tc.check(e) == Int);
+    lean_assert(tc.infer_type(f(e)) == Int);
+    lean_assert(tc.check(Fun({x, Int}, l)) == Int >> Int);
+    lean_assert(tc.check(b) == t);
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -522,5 +665,9 @@ int main() {
     tst20();
     tst21();
     tst22();
+    tst23();
+    tst24();
+    tst25();
+    tst26();
     return has_violations() ? 1 : 0;
 }
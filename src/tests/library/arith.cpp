@@ -131,6 +131,32 @@ static void tst6() {
     std::cout << mk_Int_add_fn().raw() << "\n";
 }
 
+static void tst7() {
+    environment env;
+    init_test_frontend(env);
+    normalizer norm(env);
+    // numerals are promoted to GMP numbers when they do not fit in a machine word
+    expr big = nVal(1);
+    mpz  v(1);
+    for (unsigned i = 0; i < 10; i++) {
+        big = norm(mk_Nat_mul(big, nVal(1000000000)));
+        v   = v * mpz(1000000000);
+    }
+    lean_assert_eq(big, mk_nat_value(v));
+    lean_assert_eq(nat_value_numeral(big).to_mpz(), v);
+    lean_assert_eq(norm(mk_Nat_le(big, nVal(3))), False);
+    lean_assert_eq(norm(mk_Int_div(mk_int_value(v), iVal(-1000000000))), mk_int_value(v / mpz(-1000000000)));
+    lean_assert_eq(norm(mk_Int_mul(mk_int_value(v), iVal(0))), iVal(0));
+    lean_assert(nat_value_numeral(norm(mk_Nat_add(big, nVal(1)))).to_mpz() == v + mpz(1));
+    // integral and non integral reals
+    lean_assert_eq(norm(mk_Real_div(rVal(6), rVal(3))), rVal(2));
+    lean_assert_eq(norm(mk_Real_div(rVal(1), rVal(3))), mk_real_value(mpq(1, 3)));
+    lean_assert_eq(norm(mk_Real_mul(mk_Real_div(rVal(1), rVal(3)), rVal(3))), rVal(1));
+    lean_assert_eq(mk_real_value(mpq(4, 2)), rVal(2));
+    lean_assert_eq(norm(mk_Real_le(mk_real_value(mpq(1, 3)), rVal(1))), True);
+    lean_assert_eq(real_value_numeral(mk_real_value(mpq(1, 3))), mpq(1, 3));
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -141,5 +167,6 @@ int main() {
     tst4();
     tst5();
     tst6();
+    tst7();
     return has_violations() ? 1 : 0;
 }
@@ -4,6 +4,9 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <algorithm>
+#include <utility>
+#include <vector>
 #include "util/test.h"
 #include "kernel/environment.h"
 #include "kernel/type_checker.h"
@@ -866,6 +869,199 @@ void tst27() {
                    Fun({f, Type() >> Type()}, eq(Type(), g(Type() >> Type(), f)(a), a)));
 }
 
+static void tst28(options const & opts = options()) {
+    /*
+      Learned nogoods. The constraints
+
+          ?y == c OR ?y == d
+          ?x == a OR ?x == b
+          ?x == b
+          h ?x ?y == h b d
+
+      are processed in this order. The choice ?x == a fails independently of ?y, then it is
+      skipped when the choice for ?x is performed again after backtracking to the choice for ?y.
+    */
+    std::cout << "\nTST 28\n";
+    environment env;
+    init_test_frontend(env);
+    metavar_env menv;
+    expr a = Const("a");
+    expr b = Const("b");
+    expr c = Const("c");
+    expr d = Const("d");
+    expr h = Const("h");
+    env->add_var("a", Int);
+    env->add_var("b", Int);
+    env->add_var("c", Int);
+    env->add_var("d", Int);
+    env->add_var("h", Int >> (Int >> Int));
+    expr x = menv->mk_metavar();
+    expr y = menv->mk_metavar();
+    buffer<unification_constraint> ucs;
+    ucs.push_back(mk_choice_constraint(context(), y, { c, d }, justification()));
+    ucs.push_back(mk_choice_constraint(context(), x, { a, b }, justification()));
+    ucs.push_back(mk_eq_constraint(context(), x, b, justification()));
+    ucs.push_back(mk_eq_constraint(context(), h(x, y), h(b, d), justification()));
+    elaborator elb(env, menv, ucs.size(), ucs.data(), opts);
+    metavar_env s = elb.next();
+    lean_assert_eq(s->instantiate_metavars(h(x, y)), h(b, d));
+    try {
+        elb.next();
+        lean_unreachable();
+    } catch (elaborator_exception & ex) {
+    }
+}
+
+static void tst29(options const & opts = options()) {
+    // all combinations of independent choices are produced exactly once
+    std::cout << "\nTST 29\n";
+    environment env;
+    init_test_frontend(env);
+    metavar_env menv;
+    expr a = Const("a");
+    expr b = Const("b");
+    expr c = Const("c");
+    env->add_var("a", Int);
+    env->add_var("b", Int);
+    env->add_var("c", Int);
+    expr x = menv->mk_metavar();
+    expr y = menv->mk_metavar();
+    buffer<unification_constraint> ucs;
+    ucs.push_back(mk_choice_constraint(context(), x, { a, b, c }, justification()));
+    ucs.push_back(mk_choice_constraint(context(), y, { a, b }, justification()));
+    elaborator elb(env, menv, ucs.size(), ucs.data(), opts);
+    std::vector<std::pair<expr, expr>> sols;
+    try {
+        while (true) {
+            metavar_env s = elb.next();
+            std::pair<expr, expr> sol(s->instantiate_metavars(x), s->instantiate_metavars(y));
+            lean_assert(std::find(sols.begin(), sols.end(), sol) == sols.end());
+            sols.push_back(sol);
+        }
+    } catch (elaborator_exception & ex) {
+    }
+    lean_assert_eq(sols.size(), 6);
+}
+
+static void tst30(bool deterministic) {
+    // the alternatives of a case split are explored in parallel
+    std::cout << "\nTST 30\n";
+    options opts = options().update(name{"elaborator", "parallel_case_splits"}, 4u);
+    opts = opts.update(name{"elaborator", "deterministic"}, deterministic);
+    tst28(opts);
+    tst29(opts);
+    environment env;
+    init_test_frontend(env);
+    metavar_env menv;
+    expr h = Const("h");
+    env->add_var("h", Int >> Int);
+    buffer<expr> alts;
+    for (unsigned i = 0; i < 10; i++)
+        alts.push_back(iVal(i));
+    expr x = menv->mk_metavar();
+    buffer<unification_constraint> ucs;
+    ucs.push_back(mk_choice_constraint(context(), x, alts.size(), alts.data(), justification()));
+    ucs.push_back(mk_eq_constraint(context(), h(x), h(iVal(7)), justification()));
+    elaborator elb(env, menv, ucs.size(), ucs.data(), opts);
+    metavar_env s = elb.next();
+    lean_assert_eq(s->instantiate_metavars(x), iVal(7));
+    try {
+        elb.next();
+        lean_unreachable();
+    } catch (elaborator_exception & ex) {
+    }
+}
+
+static void tst31() {
+    // statistics
+    std::cout << "\nTST 31\n";
+    environment env;
+    init_test_frontend(env);
+    metavar_env menv;
+    expr a = Const("a");
+    expr b = Const("b");
+    expr c = Const("c");
+    env->add_var("a", Int);
+    env->add_var("b", Int);
+    env->add_var("c", Int);
+    expr x = menv->mk_metavar();
+    expr y = menv->mk_metavar();
+    buffer<unification_constraint> ucs;
+    ucs.push_back(mk_choice_constraint(context(), x, { a, b, c }, justification()));
+    ucs.push_back(mk_choice_constraint(context(), y, { a, b }, justification()));
+    ucs.push_back(mk_convertible_constraint(context(), Int, Int, justification()));
+    elaborator elb(env, menv, ucs.size(), ucs.data());
+    lean_assert_eq(elb.get_stats().get_num_constraints(), 0);
+    elb.next();
+    elaborator_stats const & s = elb.get_stats();
+    lean_assert_eq(s.m_num_choice, 2);
+    lean_assert_eq(s.m_num_case_splits, 2);
+    lean_assert_eq(s.m_num_convertible, 1);
+    lean_assert_eq(s.m_num_eq, 2);
+    lean_assert_eq(s.m_num_backtracks, 0);
+    unsigned num_sols = 1;
+    try {
+        while (true) {
+            elb.next();
+            num_sols++;
+        }
+    } catch (elaborator_exception & ex) {
+    }
+    lean_assert_eq(num_sols, 6);
+    lean_assert_eq(s.m_num_backtracks, 6);
+    lean_assert_eq(s.m_num_eq, 9); // the choice for ?y is processed again for each value of ?x
+    lean_assert(s.m_time >= 0.0);
+    display(std::cout, name("tst31"), s);
+    display_json(std::cout, name("tst31"), s);
+}
+
+static void tst32() {
+    /*
+      Choice constraints whose target is not a metavariable. They are created by process_lower for
+      constraints such as <tt>Type << ?m a</tt>, and they may be in learned nogoods.
+    */
+    std::cout << "\nTST 32\n";
+    environment env;
+    init_test_frontend(env);
+    metavar_env menv;
+    expr a = Const("a");
+    expr b = Const("b");
+    expr c = Const("c");
+    expr d = Const("d");
+    expr g = Const("g");
+    expr h = Const("h");
+    env->add_var("a", Int);
+    env->add_var("b", Int);
+    env->add_var("c", Int);
+    env->add_var("d", Int);
+    env->add_var("g", Int >> Int);
+    env->add_var("h", Int >> (Int >> Int));
+    expr m = menv->mk_metavar();
+    {
+        buffer<unification_constraint> ucs;
+        ucs.push_back(mk_convertible_constraint(context(), Type(), m(a), justification()));
+        elaborator elb(env, menv, ucs.size(), ucs.data());
+        metavar_env s = elb.next();
+        std::cout << s->instantiate_metavars(m(a)) << "\n";
+    }
+    // same as tst28, but the choice is on g ?x
+    expr x = menv->mk_metavar();
+    expr y = menv->mk_metavar();
+    buffer<unification_constraint> ucs;
+    ucs.push_back(mk_choice_constraint(context(), y, { c, d }, justification()));
+    ucs.push_back(mk_choice_constraint(context(), g(x), { g(a), g(b) }, justification()));
+    ucs.push_back(mk_eq_constraint(context(), x, b, justification()));
+    ucs.push_back(mk_eq_constraint(context(), h(x, y), h(b, d), justification()));
+    elaborator elb(env, menv, ucs.size(), ucs.data());
+    metavar_env s = elb.next();
+    lean_assert_eq(s->instantiate_metavars(h(x, y)), h(b, d));
+    try {
+        elb.next();
+        lean_unreachable();
+    } catch (elaborator_exception & ex) {
+    }
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -896,5 +1092,11 @@ int main() {
     tst25();
     tst26();
     tst27();
+    tst28();
+    tst29();
+    tst30(true);
+    tst30(false);
+    tst31();
+    tst32();
     return has_violations() ? 1 : 0;
 }
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iostream>
+#include "util/test.h"
+#include "util/stackinfo.h"
+#include "kernel/abstract.h"
+#include "library/io_state_stream.h"
+#include "library/expr_census.h"
+#include "frontends/lean/frontend.h"
+#include "frontends/lua/register_modules.h"
+using namespace lean;
+
+static void tst1() {
+    expr f = Const("f");
+    expr a = Const("a");
+    expr T = Const("T");
+    expr x = Const("x");
+    expr t = f(a, a);
+    expr F = Fun({x, T}, f(x, t));
+    expr_census c;
+    c.add(F);
+    c.display(std::cout);
+    lean_assert_eq(c.get_num_cells(expr_kind::Constant), 3u);
+    lean_assert_eq(c.get_num_cells(expr_kind::App), 2u);
+    lean_assert_eq(c.get_num_cells(expr_kind::Lambda), 1u);
+    lean_assert_eq(c.get_num_cells(expr_kind::Var), 1u);
+    lean_assert_eq(c.get_num_cells(), 7u);
+    lean_assert_eq(c.get_num_bytes(expr_kind::App), get_cell_size(t) + get_cell_size(abst_body(F)));
+    lean_assert_eq(get_cell_size(t), sizeof(expr_app) + 3 * sizeof(expr));
+    // cells are only counted once
+    c.add(t);
+    c.add(mk_pi("x", T, T));
+    lean_assert_eq(c.get_num_cells(), 8u);
+    lean_assert_eq(c.get_num_bytes(expr_kind::Pi), sizeof(expr_pi));
+}
+
+static void tst2() {
+    // kind, flags and depth are packed in the header, and binder names are interned
+    lean_assert_eq(sizeof(expr_cell), 4 * sizeof(unsigned));
+    lean_assert_eq(sizeof(expr_app), sizeof(expr_cell) + 2 * sizeof(unsigned) + sizeof(uint64));
+    lean_assert_eq(sizeof(expr_abstraction), sizeof(expr_cell) + 2 * sizeof(unsigned) + sizeof(uint64) + 2 * sizeof(expr));
+    lean_assert_eq(sizeof(expr_let), sizeof(expr_cell) + 2 * sizeof(unsigned) + sizeof(uint64) + 3 * sizeof(expr));
+    expr T = Const("T");
+    expr l = mk_lambda("x", T, mk_lambda("y", T, Var(1)));
+    lean_assert(abst_name(l) == name("x"));
+    lean_assert(abst_name(abst_body(l)) == name("y"));
+    lean_assert(let_name(mk_let("z", T, Var(0))) == name("z"));
+    lean_assert(abst_name(mk_lambda(name(), T, Var(0))) == name());
+    unsigned x1 = intern_binder_name(name("x"));
+    unsigned x2 = intern_binder_name(name("x"));
+    lean_assert(x1 == x2);
+    release_binder_name(x1);
+    release_binder_name(x2);
+    unsigned ab = intern_binder_name(name({"a", "b"}));
+    lean_assert(get_binder_name(ab) == name({"a", "b"}));
+    release_binder_name(ab);
+}
+
+static void tst4() {
+    // the binder names that are not used anymore are eventually removed from the table
+    expr T = Const("T");
+    expr l = mk_lambda(name("keep"), T, Var(0));
+    for (unsigned i = 0; i < 100000; i++) {
+        expr t = mk_lambda(name(name("fresh"), i), T, Var(0));
+        lean_assert(abst_name(t) == name(name("fresh"), i));
+        lean_assert(get_binder_name_table_size() < 10000);
+    }
+    lean_assert(abst_name(l) == name("keep"));
+}
+
+static void tst3() {
+    environment env;
+    init_test_frontend(env);
+    expr_census c;
+    c.add(env);
+    std::cout << "builtin libraries:\n";
+    c.display(std::cout);
+    lean_assert(c.get_num_cells() > 0);
+}
+
+int main() {
+    save_stack_info();
+    register_modules();
+    tst1();
+    tst2();
+    tst3();
+    tst4();
+    return has_violations() ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include "util/test.h"
+#include "util/hamt.h"
+#include "util/timeit.h"
+using namespace lean;
+
+struct int_hash { unsigned operator()(int v) const { return v; } };
+struct int_eq { bool operator()(int v1, int v2) const { return v1 == v2; } };
+/** \brief Bad hash function for testing collision nodes. */
+struct int_bad_hash { unsigned operator()(int v) const { return v % 3; } };
+
+typedef hamt<int, int, int_hash, int_eq>     int_map;
+typedef hamt<int, int, int_bad_hash, int_eq> int_bad_map;
+typedef std::unordered_map<int, int>         int_umap;
+
+template<typename M>
+static void check(M const & m, int_umap const & u) {
+    lean_assert_eq(m.size(), u.size());
+    for (auto const & p : u) {
+        lean_assert(m.find(p.first));
+        lean_assert_eq(*m.find(p.first), p.second);
+    }
+    unsigned n = 0;
+    m.for_each([&](int k, int v) {
+            lean_assert(u.find(k) != u.end());
+            lean_assert_eq(u.find(k)->second, v);
+            n++;
+        });
+    lean_assert_eq(n, u.size());
+}
+
+static void tst1() {
+    int_map m;
+    lean_assert(m.empty());
+    m.insert(10, 1);
+    m.insert(20, 2);
+    m.insert(10, 3);
+    lean_assert_eq(m.size(), 2u);
+    lean_assert_eq(*m.find(10), 3);
+    lean_assert_eq(*m.find(20), 2);
+    lean_assert(!m.contains(30));
+    // copies share the structure, and updates do not affect each other
+    int_map m2 = m;
+    lean_assert(is_eqp(m, m2));
+    m2.insert(30, 4);
+    m2.erase(10);
+    lean_assert(!is_eqp(m, m2));
+    lean_assert(m.contains(10));
+    lean_assert(!m.contains(30));
+    lean_assert(!m2.contains(10));
+    lean_assert(m2.contains(30));
+    m.erase(100);
+    lean_assert_eq(m.size(), 2u);
+}
+
+template<typename M>
+static void tst2(unsigned n, int max_key) {
+    std::mt19937 rng;
+    std::uniform_int_distribution<int> key(0, max_key);
+    std::vector<M> ms;
+    std::vector<int_umap> us;
+    M m;
+    int_umap u;
+    for (unsigned i = 0; i < n; i++) {
+        int k = key(rng);
+        if (rng() % 3 == 0) {
+            m.erase(k);
+            u.erase(k);
+        } else {
+            m.insert(k, i);
+            u[k] = i;
+        }
+        if (i % 100 == 0) {
+            ms.push_back(m);
+            us.push_back(u);
+        }
+    }
+    check(m, u);
+    // the snapshots were not modified
+    for (unsigned i = 0; i < ms.size(); i++)
+        check(ms[i], us[i]);
+}
+
+static void tst3() {
+    int_map m;
+    for (int i = 0; i < 100000; i++)
+        m.insert(i, i);
+    timeit timer(std::cout, "1000000 hamt lookups");
+    unsigned found = 0;
+    for (int i = 0; i < 1000000; i++)
+        if (m.contains(i % 200000))
+            found++;
+    lean_assert_eq(found, 500000u);
+}
+
+int main() {
+    tst1();
+    tst2<int_map>(10000, 1000);
+    tst2<int_map>(10000, 1000000);
+    tst2<int_bad_map>(2000, 200);
+    tst3();
+    return has_violations() ? 1 : 0;
+}
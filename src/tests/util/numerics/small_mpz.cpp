@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "util/test.h"
+#include "util/serializer.h"
+#include "util/numerics/small_mpz.h"
+using namespace lean;
+
+static void check(small_mpz const & a, mpz const & b) {
+    lean_assert_eq(a.to_mpz(), b);
+    bool small = b.is_long_int() && is_small_int(b.get_long_int());
+    lean_assert_eq(a.is_small(), small);
+    lean_assert(a == small_mpz(b));
+    lean_assert_eq(a.hash(), small_mpz(b).hash());
+}
+
+static void tst1() {
+    small_mpz a(10);
+    small_mpz b(-3);
+    lean_assert(a.is_small() && b.is_small());
+    check(a + b, mpz(7));
+    check(a - b, mpz(13));
+    check(a * b, mpz(-30));
+    check(a / b, mpz(10) / mpz(-3));
+    check(b / a, mpz(-3) / mpz(10));
+    lean_assert(b < a);
+    lean_assert(b <= b);
+    lean_assert(!(a <= b));
+    lean_assert(small_mpz(0).is_zero());
+    std::ostringstream out;
+    out << b;
+    lean_assert_eq(out.str(), "-3");
+}
+
+static void tst2() {
+    // values are promoted to mpz when they do not fit in 62 bits, and demoted when they fit again
+    small_mpz max(LEAN_SMALL_INT_MAX);
+    lean_assert(max.is_small());
+    small_mpz a = max + small_mpz(1);
+    lean_assert(!a.is_small());
+    check(a, int64_to_mpz(LEAN_SMALL_INT_MAX) + mpz(1));
+    check(a - small_mpz(1), int64_to_mpz(LEAN_SMALL_INT_MAX));
+    small_mpz c(static_cast<int64>(1) << 40);
+    lean_assert(c.is_small());
+    small_mpz c2 = c * c;
+    check(c2, int64_to_mpz(static_cast<int64>(1) << 40) * int64_to_mpz(static_cast<int64>(1) << 40));
+    check(c2 / c, int64_to_mpz(static_cast<int64>(1) << 40));
+    check(small_mpz(-1) * max - max, mpz(-2) * int64_to_mpz(LEAN_SMALL_INT_MAX));
+    small_mpz p(1);
+    mpz q(1);
+    for (unsigned i = 0; i < 100; i++) {
+        p = p * small_mpz(3);
+        q = q * mpz(3);
+        check(p, q);
+    }
+    for (unsigned i = 0; i < 100; i++) {
+        p = p / small_mpz(-3);
+        q = q / mpz(-3);
+        check(p, q);
+    }
+    lean_assert(p == small_mpz(1));
+    lean_assert(max < a);
+    lean_assert(small_mpz(-1) * a < max);
+}
+
+static void tst3() {
+    std::ostringstream out;
+    serializer s(out);
+    small_mpz n1(mpz("-100000000000000000000000000000000000"));
+    small_mpz n2(0);
+    small_mpz n3(1200);
+    s << n1 << n2 << n3 << small_mpz(321);
+    std::istringstream in(out.str());
+    deserializer d(in);
+    small_mpz m1, m2, m3;
+    mpz m4;
+    d >> m1 >> m2 >> m3;
+    // the format is the one used for mpz
+    d >> m4;
+    lean_assert(n1 == m1);
+    lean_assert(n2 == m2);
+    lean_assert(n3 == m3);
+    lean_assert(m4 == mpz(321));
+}
+
+int main() {
+    tst1();
+    tst2();
+    tst3();
+    return has_violations() ? 1 : 0;
+}
@@ -11,9 +11,11 @@ Author: Leonardo de Moura
 #include <vector>
 #include <functional>
 #include <cmath>
+#include <limits>
 #include "util/test.h"
 #include "util/object_serializer.h"
 #include "util/debug.h"
+#include "util/exception.h"
 #include "util/list.h"
 #include "util/name.h"
 using namespace lean;
@@ -170,10 +172,89 @@ static void tst4() {
     lean_assert_eq(d5, o5);
 }
 
+static void tst5() {
+    // the children of a serializer reuse the objects written by it
+    std::ostringstream out1, out2, out3;
+    serializer s(out1);
+    list<int> l1{1, 2, 3, 4};
+    list<int> l2 = cons(10, l1);
+    s << l1;
+    serializer c1(out2);
+    c1.set_parent(s);
+    c1 << l2 << l1;
+    serializer c2(out3);
+    c2.set_parent(s);
+    c2 << l2;
+    lean_assert(out2.str().size() < out1.str().size());
+
+    std::istringstream in1(out1.str()), in2(out2.str()), in3(out3.str());
+    deserializer d(in1);
+    list<int> new_l1;
+    d >> new_l1;
+    // the children can be read in any order
+    deserializer dc2(in3);
+    dc2.set_parent(d);
+    list<int> new_l2;
+    dc2 >> new_l2;
+    deserializer dc1(in2);
+    dc1.set_parent(d);
+    list<int> new_l3, new_l4;
+    dc1 >> new_l3 >> new_l4;
+    lean_assert_eq(l1, new_l1);
+    lean_assert_eq(l2, new_l2);
+    lean_assert_eq(l2, new_l3);
+    lean_assert(is_eqp(tail(new_l2), new_l1));
+    lean_assert(is_eqp(tail(new_l3), new_l1));
+    lean_assert(is_eqp(new_l4, new_l1));
+    lean_assert(!is_eqp(new_l2, new_l3));
+}
+
+static void tst6() {
+    std::ostringstream out;
+    serializer s(out);
+    unsigned us[] = {0, 1, 127, 128, 300, 16383, 16384, std::numeric_limits<unsigned>::max()};
+    int is[]      = {0, -1, 1, 63, -64, 64, std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+    double ds[]   = {0.1, -0.0, 1e-310, std::numeric_limits<double>::max(), std::numeric_limits<double>::infinity()};
+    for (unsigned u : us) s << u;
+    for (int i : is) s << i;
+    for (double d : ds) s << d;
+    std::string str("hello\0world", 11);
+    s << str << "";
+    // small unsigned integers and integers use a single byte
+    std::ostringstream out2;
+    serializer s2(out2);
+    s2 << 127u << 63 << -64;
+    lean_assert_eq(out2.str().size(), 3u);
+
+    std::string data = out.str();
+    deserializer d(data.data(), data.data() + data.size());
+    for (unsigned u : us) lean_assert_eq(d.read_unsigned(), u);
+    for (int i : is) lean_assert_eq(d.read_int(), i);
+    for (double v : ds) {
+        double r = d.read_double();
+        lean_assert(memcmp(&r, &v, sizeof(v)) == 0);
+    }
+    lean_assert(d.read_string() == str);
+    lean_assert(d.read_string() == "");
+    lean_assert_eq(d.get_position(), data.size());
+    try {
+        d.read_char();
+        lean_unreachable();
+    } catch (exception &) {}
+    // truncated data
+    deserializer d2(data.data(), data.data() + 3);
+    try {
+        d2.read_unsigned(); d2.read_unsigned(); d2.read_unsigned(); d2.read_unsigned();
+        lean_unreachable();
+    } catch (exception &) {}
+}
+
 int main() {
     tst1();
     tst2();
     tst3();
     tst4();
+    tst5();
+    tst6();
     return has_violations() ? 1 : 0;
 }
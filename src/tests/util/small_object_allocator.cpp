@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "util/test.h"
+#include "util/thread.h"
+#include "util/timeit.h"
+#include "util/memory.h"
+#include "util/small_object_allocator.h"
+using namespace lean;
+
+static void tst1() {
+    std::vector<std::pair<char*, size_t>> blocks;
+    for (size_t sz = 1; sz <= LEAN_SMALL_OBJECT_MAX_SIZE + 64; sz++) {
+        for (unsigned i = 0; i < 10; i++) {
+            char * b = static_cast<char*>(alloc_small_object(sz));
+            lean_assert(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+            memset(b, static_cast<int>(sz % 128), sz);
+            blocks.emplace_back(b, sz);
+        }
+    }
+    for (auto const & p : blocks) {
+        for (size_t i = 0; i < p.second; i++)
+            lean_assert(p.first[i] == static_cast<char>(p.second % 128));
+    }
+    for (auto const & p : blocks)
+        dealloc_small_object(p.first, p.second);
+    // released blocks are reused
+    void * b1 = alloc_small_object(24);
+    dealloc_small_object(b1, 24);
+    void * b2 = alloc_small_object(24);
+    lean_assert(b1 == b2);
+    dealloc_small_object(b2, 24);
+}
+
+static void tst2() {
+    // blocks allocated by a thread and released by another one are returned to the owner
+    unsigned N = 10000;
+    size_t reserved = 0;
+    for (unsigned round = 0; round < 10; round++) {
+        std::vector<void*> blocks;
+        thread t([&]() {
+                for (unsigned i = 0; i < N; i++) {
+                    void * b = alloc_small_object(48);
+                    memset(b, 0, 48);
+                    blocks.push_back(b);
+                }
+            });
+        t.join();
+        for (void * b : blocks)
+            dealloc_small_object(b, 48);
+        if (round == 1)
+            reserved = get_small_object_reserved_memory();
+        else if (round > 1)
+            lean_assert_eq(reserved, get_small_object_reserved_memory());
+    }
+}
+
+static void tst3() {
+    size_t old_reserved = get_small_object_reserved_memory();
+    size_t old_mem      = get_allocated_memory();
+    unsigned N = 100000;
+    std::vector<void*> blocks;
+    for (unsigned i = 0; i < N; i++)
+        blocks.push_back(alloc_small_object(64));
+    std::cout << "reserved: " << get_small_object_reserved_memory() << "\n";
+    lean_assert(get_small_object_reserved_memory() >= old_reserved + N * 64);
+#if defined(LEAN_TRACK_MEMORY)
+    lean_assert(get_allocated_memory() >= old_mem + N * 64);
+#endif
+    static_cast<void>(old_mem);
+    for (void * b : blocks)
+        dealloc_small_object(b, 64);
+}
+
+static void tst4() {
+    unsigned N = 1000;
+    unsigned R = 1000;
+    std::vector<void*> blocks(N);
+    {
+        timeit timer(std::cout, "malloc/free");
+        for (unsigned r = 0; r < R; r++) {
+            for (unsigned i = 0; i < N; i++)
+                blocks[i] = lean::malloc(16 + 8 * (i % 8));
+            for (unsigned i = 0; i < N; i++)
+                lean::free(blocks[i]);
+        }
+    }
+    {
+        timeit timer(std::cout, "alloc_small_object/dealloc_small_object");
+        for (unsigned r = 0; r < R; r++) {
+            for (unsigned i = 0; i < N; i++)
+                blocks[i] = alloc_small_object(16 + 8 * (i % 8));
+            for (unsigned i = 0; i < N; i++)
+                dealloc_small_object(blocks[i], 16 + 8 * (i % 8));
+        }
+    }
+}
+
+int main() {
+    tst1();
+    tst2();
+    tst3();
+    tst4();
+    return has_violations() ? 1 : 0;
+}
@@ -9,4 +9,14 @@ Author: Leonardo de Moura
 namespace lean {
 inline bool is_power_of_two(unsigned v) { return !(v & (v - 1)) && v; }
 unsigned log2(unsigned v);
+/** \brief Return the number of bits set in \c v. */
+inline unsigned popcount(unsigned v) {
+#if defined(__GNUC__)
+    return __builtin_popcount(v);
+#else
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif
+}
 }
@@ -23,6 +23,11 @@ public:
         extension():m_owner(nullptr) {}
         virtual ~extension() {}
         extensible_object & get_owner() { return *m_owner; }
+        /**
+           \brief Initialize this extension using the corresponding extension of the parent object (see \c extensible_object::set_parent).
+           The default implementation ignores the parent.
+        */
+        virtual void set_parent(extension const & ) {}
     };
 private:
     std::vector<std::unique_ptr<extension>> m_extensions;
@@ -72,6 +77,21 @@ public:
         return *(m_extensions[extid].get());
     }
 
+    /**
+       \brief Make the extensions of this object children of the extensions of \c p.
+       For example, a deserializer may reuse the objects already read by \c p.
+
+       \pre No extension has been created for this object.
+       \remark \c p must outlive this object, and its extensions must not be modified while this object is alive.
+    */
+    void set_parent(extensible_object const & p) {
+        lean_assert(m_extensions.empty());
+        for (unsigned extid = 0; extid < p.m_extensions.size(); extid++) {
+            if (p.m_extensions[extid])
+                get_extension_core(extid).set_parent(*(p.m_extensions[extid]));
+        }
+    }
+
     template<typename Ext> Ext & get_extension(unsigned extid) {
         extension & ext = get_extension_core(extid);
         lean_assert(dynamic_cast<Ext*>(&ext) != nullptr);
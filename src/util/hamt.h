@@ -0,0 +1,319 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "util/rc.h"
+#include "util/debug.h"
+#include "util/bit_tricks.h"
+
+namespace lean {
+/**
+   \brief Persistent hash array mapped trie (see http://en.wikipedia.org/wiki/Hash_array_mapped_trie)
+
+   It maps keys of type \c K to values of type \c T. It uses a O(1) copy operation,
+   and different maps share nodes. Each level of the trie consumes 5 bits of the hash code,
+   so a lookup visits at most 8 nodes. Keys with the same hash code are stored in collision nodes.
+
+   \c H is a functional object for computing the hash code of keys (<tt>unsigned operator()(K const &) const</tt>),
+   and \c E for checking whether two keys are equal (<tt>bool operator()(K const &, K const &) const</tt>).
+
+   \remark Nodes are updated in place when they are not shared, otherwise they are copied.
+*/
+template<typename K, typename T, typename H, typename E>
+class hamt : private H, private E {
+    static constexpr unsigned g_bits      = 5;
+    static constexpr unsigned g_mask      = (1u << g_bits) - 1;
+    static constexpr unsigned g_max_shift = sizeof(unsigned) * 8;
+
+    struct cell {
+        bool m_leaf;
+        MK_LEAN_RC();
+        explicit cell(bool leaf):m_leaf(leaf), m_rc(0) {}
+        bool is_shared() const { return get_rc() > 1; }
+        void dealloc();
+    };
+
+    struct leaf : public cell {
+        unsigned m_hash;
+        K        m_key;
+        T        m_value;
+        leaf(unsigned h, K const & k, T const & v):cell(true), m_hash(h), m_key(k), m_value(v) {}
+    };
+
+    /**
+        \brief Internal node. The bit \c i of \c m_bitmap is set iff there is a child for the hash codes
+        whose current 5 bits are \c i. The children are stored in the order of their bits.
+        In collision nodes (the ones below the last level), \c m_bitmap is not used, and the children are leaves.
+    */
+    struct branch : public cell {
+        unsigned           m_bitmap;
+        std::vector<cell*> m_children;
+        branch():cell(false), m_bitmap(0) {}
+        branch(branch const & b):cell(false), m_bitmap(b.m_bitmap), m_children(b.m_children) {
+            for (cell * c : m_children)
+                c->inc_ref();
+        }
+        ~branch() {
+            for (cell * c : m_children)
+                c->dec_ref();
+        }
+    };
+
+    cell *   m_root;
+    unsigned m_size;
+
+    static leaf * to_leaf(cell * c) { lean_assert(c->m_leaf); return static_cast<leaf*>(c); }
+    static leaf const * to_leaf(cell const * c) { lean_assert(c->m_leaf); return static_cast<leaf const*>(c); }
+    static branch * to_branch(cell * c) { lean_assert(!c->m_leaf); return static_cast<branch*>(c); }
+    static branch const * to_branch(cell const * c) { lean_assert(!c->m_leaf); return static_cast<branch const*>(c); }
+    static unsigned idx(unsigned h, unsigned shift) { return (h >> shift) & g_mask; }
+    static unsigned pos(unsigned bitmap, unsigned bit) { return popcount(bitmap & (bit - 1)); }
+
+    unsigned hash(K const & k) const { return H::operator()(k); }
+    bool eq(K const & k1, K const & k2) const { return E::operator()(k1, k2); }
+    bool match(leaf const * l, unsigned h, K const & k) const { return l->m_hash == h && eq(l->m_key, k); }
+
+    static cell * mk_leaf(unsigned h, K const & k, T const & v) {
+        cell * r = new leaf(h, k, v);
+        r->inc_ref();
+        return r;
+    }
+
+    /** \brief Return a branch that is not shared. The caller owns a reference to \c b, and it is consumed. */
+    static branch * ensure_unshared(branch * b) {
+        if (!b->is_shared())
+            return b;
+        branch * r = new branch(*b);
+        r->inc_ref();
+        b->dec_ref();
+        return r;
+    }
+
+    /** \brief Create a node containing the leaves \c l1 and \c l2 with different keys. The references to \c l1 and \c l2 are consumed. */
+    static cell * merge(leaf * l1, leaf * l2, unsigned shift) {
+        branch * b = new branch();
+        b->inc_ref();
+        if (shift >= g_max_shift) {
+            b->m_children.push_back(l1);
+            b->m_children.push_back(l2);
+            return b;
+        }
+        unsigned i1 = idx(l1->m_hash, shift);
+        unsigned i2 = idx(l2->m_hash, shift);
+        if (i1 == i2) {
+            b->m_bitmap = 1u << i1;
+            b->m_children.push_back(merge(l1, l2, shift + g_bits));
+        } else {
+            b->m_bitmap = (1u << i1) | (1u << i2);
+            if (i1 < i2) {
+                b->m_children.push_back(l1);
+                b->m_children.push_back(l2);
+            } else {
+                b->m_children.push_back(l2);
+                b->m_children.push_back(l1);
+            }
+        }
+        return b;
+    }
+
+    /**
+        \brief Return the result of inserting <tt>k -> v</tt> in \c c.
+        The caller owns a reference to \c c, and it is consumed. The caller owns a reference to the result.
+    */
+    cell * insert(cell * c, unsigned shift, unsigned h, K const & k, T const & v, bool & added) {
+        if (c == nullptr) {
+            added = true;
+            return mk_leaf(h, k, v);
+        } else if (c->m_leaf) {
+            leaf * l = to_leaf(c);
+            if (match(l, h, k)) {
+                if (!l->is_shared()) {
+                    l->m_value = v;
+                    return c;
+                }
+                c->dec_ref();
+                return mk_leaf(h, k, v);
+            }
+            added = true;
+            return merge(l, to_leaf(mk_leaf(h, k, v)), shift);
+        }
+        branch * b = ensure_unshared(to_branch(c));
+        if (shift >= g_max_shift) {
+            for (cell * & child : b->m_children) {
+                if (match(to_leaf(child), h, k)) {
+                    if (!child->is_shared()) {
+                        to_leaf(child)->m_value = v;
+                        return b;
+                    }
+                    child->dec_ref();
+                    child = mk_leaf(h, k, v);
+                    return b;
+                }
+            }
+            added = true;
+            b->m_children.push_back(mk_leaf(h, k, v));
+            return b;
+        }
+        unsigned bit = 1u << idx(h, shift);
+        unsigned i   = pos(b->m_bitmap, bit);
+        if (b->m_bitmap & bit) {
+            b->m_children[i] = insert(b->m_children[i], shift + g_bits, h, k, v, added);
+        } else {
+            added = true;
+            b->m_bitmap |= bit;
+            b->m_children.insert(b->m_children.begin() + i, mk_leaf(h, k, v));
+        }
+        return b;
+    }
+
+    /**
+        \brief Return the result of removing \c k from \c c.
+        The caller owns a reference to \c c, and it is consumed. The caller owns a reference to the result.
+        \pre \c k is in \c c
+    */
+    cell * erase(cell * c, unsigned shift, unsigned h, K const & k) {
+        if (c->m_leaf) {
+            lean_assert(match(to_leaf(c), h, k));
+            c->dec_ref();
+            return nullptr;
+        }
+        branch * b = ensure_unshared(to_branch(c));
+        if (shift >= g_max_shift) {
+            for (unsigned i = 0; i < b->m_children.size(); i++) {
+                if (match(to_leaf(b->m_children[i]), h, k)) {
+                    b->m_children[i]->dec_ref();
+                    b->m_children.erase(b->m_children.begin() + i);
+                    break;
+                }
+            }
+        } else {
+            unsigned bit = 1u << idx(h, shift);
+            unsigned i   = pos(b->m_bitmap, bit);
+            lean_assert(b->m_bitmap & bit);
+            if (cell * new_child = erase(b->m_children[i], shift + g_bits, h, k)) {
+                b->m_children[i] = new_child;
+            } else {
+                b->m_bitmap &= ~bit;
+                b->m_children.erase(b->m_children.begin() + i);
+            }
+        }
+        if (b->m_children.empty()) {
+            b->dec_ref();
+            return nullptr;
+        } else if (b->m_children.size() == 1 && b->m_children[0]->m_leaf) {
+            // a single leaf does not need a branch
+            cell * r = b->m_children[0];
+            r->inc_ref();
+            b->dec_ref();
+            return r;
+        } else {
+            return b;
+        }
+    }
+
+    template<typename F>
+    static void for_each(cell const * c, F & f) {
+        if (c == nullptr) {
+            return;
+        } else if (c->m_leaf) {
+            f(to_leaf(c)->m_key, to_leaf(c)->m_value);
+        } else {
+            for (cell const * child : to_branch(c)->m_children)
+                for_each(child, f);
+        }
+    }
+
+public:
+    hamt():m_root(nullptr), m_size(0) {}
+    hamt(hamt const & s):H(s), E(s), m_root(s.m_root), m_size(s.m_size) { if (m_root) m_root->inc_ref(); }
+    hamt(hamt && s):H(s), E(s), m_root(s.m_root), m_size(s.m_size) { s.m_root = nullptr; s.m_size = 0; }
+    ~hamt() { if (m_root) m_root->dec_ref(); }
+
+    hamt & operator=(hamt const & s) {
+        if (s.m_root)
+            s.m_root->inc_ref();
+        if (m_root)
+            m_root->dec_ref();
+        m_root = s.m_root;
+        m_size = s.m_size;
+        return *this;
+    }
+    hamt & operator=(hamt && s) {
+        std::swap(m_root, s.m_root);
+        std::swap(m_size, s.m_size);
+        return *this;
+    }
+
+    /** \brief Return the number of keys in the map. */
+    unsigned size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /** \brief Return a pointer to the value associated with \c k, and nullptr if there is none. */
+    T const * find(K const & k) const {
+        unsigned h = hash(k);
+        cell const * c = m_root;
+        unsigned shift = 0;
+        while (c != nullptr) {
+            if (c->m_leaf) {
+                leaf const * l = to_leaf(c);
+                return match(l, h, k) ? &(l->m_value) : nullptr;
+            }
+            branch const * b = to_branch(c);
+            if (shift >= g_max_shift) {
+                for (cell const * child : b->m_children) {
+                    if (match(to_leaf(child), h, k))
+                        return &(to_leaf(child)->m_value);
+                }
+                return nullptr;
+            }
+            unsigned bit = 1u << idx(h, shift);
+            if ((b->m_bitmap & bit) == 0)
+                return nullptr;
+            c      = b->m_children[pos(b->m_bitmap, bit)];
+            shift += g_bits;
+        }
+        return nullptr;
+    }
+
+    bool contains(K const & k) const { return find(k) != nullptr; }
+
+    /** \brief Associate \c v with \c k. The previous value associated with \c k (if any) is replaced. */
+    void insert(K const & k, T const & v) {
+        bool added = false;
+        m_root = insert(m_root, 0, hash(k), k, v, added);
+        if (added)
+            m_size++;
+    }
+
+    /** \brief Remove \c k from the map (if it is there). */
+    void erase(K const & k) {
+        if (!contains(k))
+            return;
+        m_root = erase(m_root, 0, hash(k), k);
+        m_size--;
+    }
+
+    /** \brief Invoke <tt>f(k, v)</tt> for each entry <tt>k -> v</tt> in the map. The order is unspecified. */
+    template<typename F>
+    void for_each(F f) const {
+        for_each(m_root, f);
+    }
+
+    /** \brief Return true iff the two maps are pointer equal (the converse is not true). */
+    friend bool is_eqp(hamt const & m1, hamt const & m2) { return m1.m_root == m2.m_root; }
+};
+
+template<typename K, typename T, typename H, typename E>
+void hamt<K, T, H, E>::cell::dealloc() {
+    if (m_leaf)
+        delete static_cast<leaf*>(this);
+    else
+        delete static_cast<branch*>(this);
+}
+}
@@ -69,6 +69,7 @@ void interruptible_thread::request_interrupt(unsigned try_ms) {
 
 void interruptible_thread::join() {
     m_thread.join();
+    m_shared_rc.release();
 }
 
 bool interruptible_thread::joinable() {
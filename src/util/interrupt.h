@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #pragma once
 #include <utility>
 #include "util/thread.h"
+#include "util/rc.h"
 #include "util/stackinfo.h"
 #include "util/exception.h"
 
@@ -109,6 +110,8 @@ private:
       thread.
     */
     atomic_bool           m_dummy_addr;
+    // Objects may be shared with the new thread, so atomic reference counting is used until it is joined.
+    shared_rc_token       m_shared_rc;
     thread                m_thread;
     static atomic_bool *  get_flag_addr();
 };
@@ -20,7 +20,7 @@ namespace lean {
 static char g_path_sep     = ';';
 static char g_sep          = '\\';
 static char g_bad_sep      = '/';
-static std::string get_exe_location() {
+std::string get_exe_location() {
     HMODULE hModule = GetModuleHandleW(NULL);
     WCHAR path[MAX_PATH];
     GetModuleFileNameW(hModule, path, MAX_PATH);
@@ -34,7 +34,7 @@ static std::string get_exe_location() {
 static char g_path_sep     = ':';
 static char g_sep          = '/';
 static char g_bad_sep      = '\\';
-static std::string get_exe_location() {
+std::string get_exe_location() {
     char buf[PATH_MAX];
     uint32_t bufsize = PATH_MAX;
     if (_NSGetExecutablePath(buf, &bufsize) != 0)
@@ -52,7 +52,7 @@ static std::string get_exe_location() {
 static char g_path_sep     = ':';
 static char g_sep          = '/';
 static char g_bad_sep      = '\\';
-static std::string get_exe_location() {
+std::string get_exe_location() {
     char path[PATH_MAX];
     char dest[PATH_MAX];
     memset(dest, 0, PATH_MAX);
@@ -219,4 +219,15 @@ std::string find_file(std::string fname) {
 char const * get_lean_path() {
     return g_lean_path.c_str();
 }
+
+void add_lean_path(std::string const & dir) {
+    std::string d = normalize_path(dir);
+    g_lean_path_vector.insert(g_lean_path_vector.begin(), d);
+    g_lean_path = d + g_path_sep + g_lean_path;
+#if defined(LEAN_WINDOWS)
+    _putenv_s("LEAN_PATH", g_lean_path.c_str());
+#else
+    setenv("LEAN_PATH", g_lean_path.c_str(), 1);
+#endif
+}
 }
@@ -12,6 +12,13 @@ namespace lean {
    \brief Return the LEAN_PATH string
 */
 char const * get_lean_path();
+/**
+   \brief Add the directory \c dir to the beginning of the LEAN_PATH.
+   The LEAN_PATH of the processes created after this call is also updated.
+*/
+void add_lean_path(std::string const & dir);
+/** \brief Return the location of the Lean executable. */
+std::string get_exe_location();
 /**
    \brief Search the file \c fname in the LEAN_PATH. Throw an
    exception if the file was not found.
@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <string>
+#include <fstream>
+#include <iterator>
+#include "util/exception.h"
+#include "util/sstream.h"
+#include "util/mapped_file.h"
+#if !defined(LEAN_WINDOWS)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace lean {
+[[ noreturn ]] static void throw_open_failed(std::string const & fname) {
+    throw exception(sstream() << "failed to open file '" << fname << "'");
+}
+
+mapped_file::mapped_file(std::string const & fname):m_data(nullptr), m_size(0), m_mapped(false) {
+#if !defined(LEAN_WINDOWS)
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw_open_failed(fname);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            m_data   = static_cast<char const *>(p);
+            m_size   = st.st_size;
+            m_mapped = true;
+        }
+    }
+    close(fd);
+    if (m_mapped)
+        return;
+#endif
+    // the file could not be mapped in memory
+    std::ifstream in(fname, std::ifstream::binary);
+    if (!in.good())
+        throw_open_failed(fname);
+    m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+mapped_file::~mapped_file() {
+#if !defined(LEAN_WINDOWS)
+    if (m_mapped)
+        munmap(const_cast<char *>(m_data), m_size);
+#endif
+}
+}
@@ -0,0 +1,33 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lean {
+/**
+   \brief Read-only view of the contents of a file.
+   The file is mapped in memory (using \c mmap) when the platform supports it,
+   otherwise its contents are read into a buffer.
+*/
+class mapped_file {
+    char const *      m_data;
+    size_t            m_size;
+    bool              m_mapped;
+    std::vector<char> m_buffer; // contents of the file when it is not mapped in memory
+public:
+    /** \brief Map the given file in memory. Throw an exception if the file cannot be opened. */
+    mapped_file(std::string const & fname);
+    mapped_file(mapped_file const &) = delete;
+    mapped_file & operator=(mapped_file const &) = delete;
+    ~mapped_file();
+
+    char const * data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include "util/numerics/small_mpz.h"
+
+namespace lean {
+mpz int64_to_mpz(int64 v) {
+    if (sizeof(long int) >= sizeof(int64)) // NOLINT
+        return mpz(static_cast<long int>(v));
+    // long int has only 32 bits, v is hi * 2^31 + lo
+    int64 const k = static_cast<int64>(1) << 31;
+    mpz r(static_cast<long int>(v / k));
+    mul2k(r, r, 31);
+    r += mpz(static_cast<long int>(v % k));
+    return r;
+}
+
+static mpz const & small_int_max() {
+    static mpz r(int64_to_mpz(LEAN_SMALL_INT_MAX));
+    return r;
+}
+
+void small_mpz::set(mpz const & v) {
+    if (v.is_long_int()) {
+        int64 r = v.get_long_int();
+        if (is_small_int(r)) {
+            m_small = r;
+            return;
+        }
+    } else if (sizeof(long int) < sizeof(int64) && abs(v) <= small_int_max()) { // NOLINT
+        // long int has only 32 bits, v is hi * 2^31 + lo
+        mpz k(1);
+        mul2k(k, k, 31);
+        mpz hi = v / k;
+        mpz lo = v - hi * k;
+        m_small = static_cast<int64>(hi.get_long_int()) * (static_cast<int64>(1) << 31) + lo.get_long_int();
+        return;
+    }
+    m_big = new mpz(v);
+}
+
+small_mpz small_mpz::add_core(small_mpz const & a, small_mpz const & b) { return small_mpz(a.to_mpz() + b.to_mpz()); }
+small_mpz small_mpz::sub_core(small_mpz const & a, small_mpz const & b) { return small_mpz(a.to_mpz() - b.to_mpz()); }
+small_mpz small_mpz::mul_core(small_mpz const & a, small_mpz const & b) { return small_mpz(a.to_mpz() * b.to_mpz()); }
+small_mpz small_mpz::div_core(small_mpz const & a, small_mpz const & b) { return small_mpz(a.to_mpz() / b.to_mpz()); }
+int small_mpz::cmp_core(small_mpz const & a, small_mpz const & b) {
+    if (a.is_small() && b.is_small())
+        return (a.m_small > b.m_small) - (a.m_small < b.m_small);
+    else if (!a.is_small() && !b.is_small())
+        return cmp(*a.m_big, *b.m_big);
+    else
+        return cmp(a.to_mpz(), b.to_mpz());
+}
+
+std::ostream & operator<<(std::ostream & out, small_mpz const & v) {
+    if (v.is_small())
+        return out << v.get_small();
+    else
+        return out << v.get_big();
+}
+
+serializer & operator<<(serializer & s, small_mpz const & n) {
+    return s << n.to_mpz();
+}
+
+small_mpz read_small_mpz(deserializer & d) {
+    return small_mpz(read_mpz(d));
+}
+}
@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include "util/int64.h"
+#include "util/serializer.h"
+#include "util/numerics/mpz.h"
+
+namespace lean {
+/** \brief Small integers are the ones in the range <tt>[-LEAN_SMALL_INT_MAX, LEAN_SMALL_INT_MAX]</tt>, i.e., they fit in 62 bits. */
+#define LEAN_SMALL_INT_MAX ((static_cast<int64>(1) << 62) - 1)
+
+inline bool is_small_int(int64 v) { return -LEAN_SMALL_INT_MAX <= v && v <= LEAN_SMALL_INT_MAX; }
+/**
+    \brief Store <tt>a + b</tt> in \c r, and return true if it is a small integer.
+    \pre is_small_int(a) && is_small_int(b)
+    \remark The sum of two small integers cannot overflow an int64.
+*/
+inline bool small_add(int64 a, int64 b, int64 & r) { r = a + b; return is_small_int(r); }
+/** \brief Store <tt>a - b</tt> in \c r, and return true if it is a small integer. \pre is_small_int(a) && is_small_int(b) */
+inline bool small_sub(int64 a, int64 b, int64 & r) { r = a - b; return is_small_int(r); }
+/** \brief Store <tt>a * b</tt> in \c r, and return true if it is a small integer. \pre is_small_int(a) && is_small_int(b) */
+inline bool small_mul(int64 a, int64 b, int64 & r) {
+    uint64 ua = a < 0 ? -a : a;
+    uint64 ub = b < 0 ? -b : b;
+    if ((ua >> 31) == 0 && (ub >> 31) == 0) {
+        // both fit in 31 bits, then the product fits in 62 bits
+        r = a * b;
+        return true;
+    }
+    if (ub != 0 && ua > static_cast<uint64>(LEAN_SMALL_INT_MAX) / ub)
+        return false;
+    r = a * b;
+    return true;
+}
+/** \brief Convert \c v into a GMP integer. */
+mpz int64_to_mpz(int64 v);
+
+/**
+   \brief Integer that does not use GMP when the value is a small integer.
+   Large integers are promoted to \c mpz.
+
+   The representation is canonical: a value is stored in a \c mpz only if it is not a small integer.
+*/
+class small_mpz {
+    int64 m_small; // value when m_big == nullptr
+    mpz * m_big;
+
+    void set(mpz const & v);
+    static small_mpz add_core(small_mpz const & a, small_mpz const & b);
+    static small_mpz sub_core(small_mpz const & a, small_mpz const & b);
+    static small_mpz mul_core(small_mpz const & a, small_mpz const & b);
+    static small_mpz div_core(small_mpz const & a, small_mpz const & b);
+    static int cmp_core(small_mpz const & a, small_mpz const & b);
+public:
+    small_mpz():m_small(0), m_big(nullptr) {}
+    small_mpz(int v):m_small(v), m_big(nullptr) {}
+    small_mpz(unsigned v):m_small(v), m_big(nullptr) {}
+    explicit small_mpz(int64 v):m_small(v), m_big(nullptr) { if (!is_small_int(v)) m_big = new mpz(int64_to_mpz(v)); }
+    explicit small_mpz(mpz const & v):m_small(0), m_big(nullptr) { set(v); }
+    small_mpz(small_mpz const & s):m_small(s.m_small), m_big(s.m_big ? new mpz(*s.m_big) : nullptr) {}
+    small_mpz(small_mpz && s):m_small(s.m_small), m_big(s.m_big) { s.m_big = nullptr; }
+    ~small_mpz() { delete m_big; }
+
+    friend void swap(small_mpz & a, small_mpz & b) { std::swap(a.m_small, b.m_small); std::swap(a.m_big, b.m_big); }
+    small_mpz & operator=(small_mpz const & s) { small_mpz tmp(s); swap(*this, tmp); return *this; }
+    small_mpz & operator=(small_mpz && s) { swap(*this, s); return *this; }
+
+    bool is_small() const { return m_big == nullptr; }
+    int64 get_small() const { lean_assert(is_small()); return m_small; }
+    mpz const & get_big() const { lean_assert(!is_small()); return *m_big; }
+    mpz to_mpz() const { return is_small() ? int64_to_mpz(m_small) : *m_big; }
+
+    unsigned hash() const { return is_small() ? static_cast<unsigned>(m_small) : m_big->hash(); }
+    int sgn() const { return is_small() ? (m_small > 0) - (m_small < 0) : m_big->sgn(); }
+    bool is_zero() const { return is_small() && m_small == 0; }
+    bool is_neg() const { return sgn() < 0; }
+
+    friend int cmp(small_mpz const & a, small_mpz const & b) {
+        if (a.is_small() && b.is_small())
+            return (a.m_small > b.m_small) - (a.m_small < b.m_small);
+        return cmp_core(a, b);
+    }
+    friend bool operator==(small_mpz const & a, small_mpz const & b) {
+        if (a.is_small() && b.is_small())
+            return a.m_small == b.m_small;
+        return cmp_core(a, b) == 0;
+    }
+    friend bool operator!=(small_mpz const & a, small_mpz const & b) { return !(a == b); }
+    friend bool operator<(small_mpz const & a, small_mpz const & b) { return cmp(a, b) < 0; }
+    friend bool operator<=(small_mpz const & a, small_mpz const & b) { return cmp(a, b) <= 0; }
+    friend bool operator>(small_mpz const & a, small_mpz const & b) { return cmp(a, b) > 0; }
+    friend bool operator>=(small_mpz const & a, small_mpz const & b) { return cmp(a, b) >= 0; }
+
+    friend small_mpz operator+(small_mpz const & a, small_mpz const & b) {
+        int64 r;
+        if (a.is_small() && b.is_small() && small_add(a.m_small, b.m_small, r))
+            return small_mpz(r);
+        return add_core(a, b);
+    }
+    friend small_mpz operator-(small_mpz const & a, small_mpz const & b) {
+        int64 r;
+        if (a.is_small() && b.is_small() && small_sub(a.m_small, b.m_small, r))
+            return small_mpz(r);
+        return sub_core(a, b);
+    }
+    friend small_mpz operator*(small_mpz const & a, small_mpz const & b) {
+        int64 r;
+        if (a.is_small() && b.is_small() && small_mul(a.m_small, b.m_small, r))
+            return small_mpz(r);
+        return mul_core(a, b);
+    }
+    /** \brief Truncated division (the same as the one for \c mpz). \pre !b.is_zero() */
+    friend small_mpz operator/(small_mpz const & a, small_mpz const & b) {
+        lean_assert(!b.is_zero());
+        if (a.is_small() && b.is_small())
+            return small_mpz(a.m_small / b.m_small);
+        return div_core(a, b);
+    }
+
+    friend std::ostream & operator<<(std::ostream & out, small_mpz const & v);
+};
+
+/** \brief Small integers are serialized as \c mpz, so the format does not depend on the representation. */
+serializer & operator<<(serializer & s, small_mpz const & n);
+small_mpz read_small_mpz(deserializer & d);
+inline deserializer & operator>>(deserializer & d, small_mpz & n) { n = read_small_mpz(d); return d; }
+}
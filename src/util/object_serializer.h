@@ -16,24 +16,77 @@ Author: Leonardo de Moura
 namespace lean {
 /**
    \brief Helper class for serializing objects.
+
+   Objects already written are stored in a table, and they are written again as an index into this table.
+   When the serializer has a parent (see \c extensible_object::set_parent), the objects written by the parent
+   are also reused. Their indices are the first ones, i.e., the indices of the objects of a child start at
+   the number of objects of its ancestors.
+
+   Objects can also be added to the table without being written (see \c add_external). This is used to
+   reference objects written to a different file. The deserializer must contain the same objects in the same order.
+   References to them are tagged, and they are numbered separately. Thus, the indices of the other objects
+   do not depend on the number of external ones.
 */
 template<class T, class HashFn, class EqFn>
 class object_serializer : public serializer::extension {
     std::unordered_map<T, unsigned, HashFn, EqFn> m_table;
+    unsigned                                      m_size;   // number of objects stored in this table
+    object_serializer const *                     m_parent;
+    unsigned                                      m_offset; // number of objects stored in the ancestors
+    unsigned                                      m_num_external; // the external objects are the first ones in the table
+
+    bool find(T const & v, unsigned & idx) const {
+        auto it = m_table.find(v);
+        if (it != m_table.end()) {
+            idx = it->second;
+            return true;
+        }
+        return m_parent && m_parent->find(v, idx);
+    }
+
+    void insert(T const & v) {
+        m_table.insert(std::make_pair(v, size()));
+        m_size++;
+    }
 public:
-    object_serializer(HashFn const & h = HashFn(), EqFn const & e = EqFn()):m_table(LEAN_OBJECT_SERIALIZER_BUCKET_SIZE, h, e) {}
+    object_serializer(HashFn const & h = HashFn(), EqFn const & e = EqFn()):
+        m_table(LEAN_OBJECT_SERIALIZER_BUCKET_SIZE, h, e), m_size(0), m_parent(nullptr), m_offset(0), m_num_external(0) {}
+
+    virtual void set_parent(serializer::extension const & p) {
+        lean_assert(m_table.empty());
+        lean_assert(dynamic_cast<object_serializer const *>(&p));
+        m_parent = static_cast<object_serializer const *>(&p);
+        m_offset = m_parent->size();
+        m_num_external = m_parent->m_num_external;
+    }
+
+    /** \brief Return the number of objects in the table (including the ones of the ancestors). */
+    unsigned size() const { return m_offset + m_size; }
+
+    /**
+        \brief Add \c v to the table without writing it. If \c v is already in the table, then only its first index is used.
+        \pre No object was written, and the serializer does not have a parent.
+    */
+    void add_external(T const & v) {
+        lean_assert(!m_parent && size() == m_num_external);
+        insert(v);
+        m_num_external++;
+    }
 
     template<typename F>
     void write_core(T const & v, char k, F && f) {
-        auto it = m_table.find(v);
+        unsigned idx;
         serializer & s = get_owner();
-        if (it == m_table.end()) {
-            s.write_char(k + 1);
+        if (!find(v, idx)) {
+            s.write_char(k + 2);
             f();
-            m_table.insert(std::make_pair(v, m_table.size()));
+            insert(v);
+        } else if (idx < m_num_external) {
+            s.write_char(1);
+            s.write_unsigned(idx);
         } else {
             s.write_char(0);
-            s.write_unsigned(it->second);
+            s.write_unsigned(idx - m_num_external);
         }
     }
 
@@ -45,24 +98,57 @@ public:
 
 /**
    \brief Helper class for deserializing objects.
+   It is the counterpart of \c object_serializer, and the parent objects must match.
 */
 template<class T>
 class object_deserializer : public deserializer::extension {
-    std::vector<T> m_table;
+    std::vector<T>              m_table;
+    object_deserializer const * m_parent;
+    unsigned                    m_offset; // number of objects stored in the ancestors
+    unsigned                    m_num_external;
+
 public:
+    object_deserializer():m_parent(nullptr), m_offset(0), m_num_external(0) {}
+
+    virtual void set_parent(deserializer::extension const & p) {
+        lean_assert(m_table.empty());
+        lean_assert(dynamic_cast<object_deserializer const *>(&p));
+        m_parent = static_cast<object_deserializer const *>(&p);
+        m_offset = m_parent->size();
+        m_num_external = m_parent->m_num_external;
+    }
+
+    /** \brief Return the number of objects in the table (including the ones of the ancestors). */
+    unsigned size() const { return m_offset + m_table.size(); }
+
+    /** \brief Return the object with index \c i. \pre i < size() */
+    T const & get(unsigned i) const { return i < m_offset ? m_parent->get(i) : m_table[i - m_offset]; }
+
+    /** \brief Add \c v to the table. It is the counterpart of \c object_serializer::add_external. */
+    void add_external(T const & v) {
+        lean_assert(!m_parent && size() == m_num_external);
+        m_table.push_back(v);
+        m_num_external++;
+    }
+
     template<typename F>
     T read_core(F && f) {
         deserializer & d = get_owner();
         char c = d.read_char();
-        if (c > 0) {
-            T r = f(c-1);
+        if (c > 1) {
+            T r = f(c-2);
             m_table.push_back(r);
             return r;
+        } else if (c == 1) {
+            unsigned i = d.read_unsigned();
+            if (i >= m_num_external)
+                throw_corrupted_file();
+            return get(i);
         } else {
             unsigned i = d.read_unsigned();
-            if (i >= m_table.size())
+            if (i >= size() - m_num_external)
                 throw_corrupted_file();
-            return m_table[i];
+            return get(i + m_num_external);
         }
     }
 
@@ -0,0 +1,25 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include "util/rc.h"
+
+namespace lean {
+#if defined(LEAN_MULTI_THREAD)
+atomic<unsigned> g_shared_rc(0);
+
+void enable_shared_rc() {
+    g_shared_rc++;
+}
+
+void disable_shared_rc() {
+    lean_assert(g_shared_rc > 0);
+    g_shared_rc--;
+}
+#else
+void enable_shared_rc() {}
+void disable_shared_rc() {}
+#endif
+}
@@ -10,13 +10,76 @@ Author: Leonardo de Moura
 #include "util/thread.h"
 #include "util/debug.h"
 
+namespace lean {
+#if defined(LEAN_MULTI_THREAD)
+extern atomic<unsigned> g_shared_rc;
+/**
+   \brief Return true if reference counters must be updated using atomic operations.
+
+   Most terms are created and deleted by a single thread. So, we only use atomic operations
+   while there are threads that may share objects with each other. Otherwise, the counters
+   are updated using plain loads and stores.
+*/
+inline bool is_shared_rc() { return g_shared_rc.load(memory_order_relaxed) != 0; }
+inline void inc_rc(atomic<unsigned> & rc) {
+    if (is_shared_rc())
+        atomic_fetch_add_explicit(&rc, 1u, memory_order_relaxed);
+    else
+        rc.store(rc.load(memory_order_relaxed) + 1u, memory_order_relaxed);
+}
+/** \brief Decrement the given reference counter, and return true if it reached zero. */
+inline bool dec_rc(atomic<unsigned> & rc) {
+    if (is_shared_rc()) {
+        return atomic_fetch_sub_explicit(&rc, 1u, memory_order_relaxed) == 1u;
+    } else {
+        unsigned r = rc.load(memory_order_relaxed) - 1u;
+        rc.store(r, memory_order_relaxed);
+        return r == 0;
+    }
+}
+#else
+inline bool is_shared_rc() { return false; }
+inline void inc_rc(atomic<unsigned> & rc) { rc++; }
+inline bool dec_rc(atomic<unsigned> & rc) { return --rc == 0u; }
+#endif
+/**
+   \brief Switch to atomic reference counting. It must be invoked before
+   creating a thread that may share objects with the current one.
+*/
+void enable_shared_rc();
+/**
+   \brief Undo one call to enable_shared_rc. It must only be invoked after the
+   thread that may share objects with the current one has been joined.
+*/
+void disable_shared_rc();
+
+/** \brief Use atomic reference counting in the scope of this object. */
+class scoped_shared_rc {
+public:
+    scoped_shared_rc() { enable_shared_rc(); }
+    ~scoped_shared_rc() { disable_shared_rc(); }
+};
+
+/**
+   \brief Auxiliary object for threads. It enables atomic reference counting
+   when it is created, and disables it when \c release is invoked (after the thread is joined).
+   If the thread is never joined, then atomic reference counting remains enabled.
+*/
+class shared_rc_token {
+    bool m_active;
+public:
+    shared_rc_token():m_active(true) { enable_shared_rc(); }
+    void release() { if (m_active) { m_active = false; disable_shared_rc(); } }
+};
+}
+
 #define MK_LEAN_RC()                                                    \
 private:                                                                \
 atomic<unsigned> m_rc;                                                  \
 public:                                                                 \
 unsigned get_rc() const { return atomic_load(&m_rc); }                  \
-void inc_ref() { atomic_fetch_add_explicit(&m_rc, 1u, memory_order_relaxed); } \
-bool dec_ref_core() { lean_assert(get_rc() > 0); return atomic_fetch_sub_explicit(&m_rc, 1u, memory_order_relaxed) == 1u; } \
+void inc_ref() { ::lean::inc_rc(m_rc); }                                \
+bool dec_ref_core() { lean_assert(get_rc() > 0); return ::lean::dec_rc(m_rc); } \
 void dec_ref() { if (dec_ref_core()) dealloc(); }
 
 #define LEAN_COPY_REF(Arg)                      \
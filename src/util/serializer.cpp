@@ -5,75 +5,56 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <string>
-#include <limits>
-#include <stdio.h>
-#include <ios>
+#include <cstring>
+#include <iterator>
+#include "util/int64.h"
 #include "util/serializer.h"
 #include "util/exception.h"
 
 namespace lean {
-void serializer_core::write_unsigned(unsigned i) {
-    static_assert(sizeof(i) == 4, "unexpected unsigned size");
-    m_out.put((i >> 24) & 0xff);
-    m_out.put((i >> 16) & 0xff);
-    m_out.put((i >> 8) & 0xff);
-    m_out.put(i & 0xff);
-}
-
-void serializer_core::write_int(int i) {
-    static_assert(sizeof(i) == 4, "unexpected int size");
-    write_unsigned(i);
-}
-
-#define BIG_BUFFER 1024
-
 void throw_corrupted_file() {
     throw exception("corrupted binary file");
 }
 
 void serializer_core::write_double(double d) {
-    std::ostringstream out;
-    // TODO(Leo): the following code may miss precision.
-    // We should use std::ios::hexfloat, but it is not supported by
-    // g++ yet.
-    out.flags (std::ios::scientific);
-    out.precision(std::numeric_limits<double>::digits10 + 1);
-    out << std::hex << d;
-    write_string(out.str());
+    uint64 bits;
+    static_assert(sizeof(d) == sizeof(bits), "unexpected double size");
+    memcpy(&bits, &d, sizeof(d));
+    for (unsigned i = 0; i < sizeof(bits); i++)
+        write_char(static_cast<char>((bits >> (8*i)) & 0xff));
 }
 
-std::string deserializer_core::read_string() {
-    std::string r;
-    while (true) {
-        char c = m_in.get();
-        if (c == 0)
-            break;
-        if (c == EOF)
-            throw_corrupted_file();
-        r += c;
-    }
-    return r;
-}
+deserializer_core::deserializer_core(std::istream & in):
+    m_buffer(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()),
+    m_begin(m_buffer.data()), m_curr(m_begin), m_end(m_begin + m_buffer.size()) {}
 
-unsigned deserializer_core::read_unsigned() {
-    unsigned r;
-    static_assert(sizeof(r) == 4, "unexpected unsigned size");
-    r  = static_cast<unsigned>(m_in.get()) << 24;
-    r |= static_cast<unsigned>(m_in.get()) << 16;
-    r |= static_cast<unsigned>(m_in.get()) << 8;
-    r |= static_cast<unsigned>(m_in.get());
+std::string deserializer_core::read_string() {
+    unsigned len = read_unsigned();
+    if (len > static_cast<size_t>(m_end - m_curr))
+        throw_corrupted_file();
+    std::string r(m_curr, len);
+    m_curr += len;
     return r;
 }
 
-int deserializer_core::read_int() {
-    return read_unsigned();
+/** \brief Read the remaining bytes of an unsigned integer, \c r is the first one. */
+unsigned deserializer_core::read_unsigned_core(unsigned r) {
+    r &= 0x7f;
+    for (unsigned shift = 7; shift < 35; shift += 7) {
+        unsigned b = static_cast<unsigned char>(read_char());
+        r |= (b & 0x7f) << shift;
+        if (b < 0x80)
+            return r;
+    }
+    throw_corrupted_file();
 }
 
 double deserializer_core::read_double() {
-    // TODO(Leo): use std::hexfloat as soon as it is supported by g++
-    std::istringstream in(read_string());
+    uint64 bits = 0;
+    for (unsigned i = 0; i < sizeof(bits); i++)
+        bits |= static_cast<uint64>(static_cast<unsigned char>(read_char())) << (8*i);
     double r;
-    in >> r;
+    memcpy(&r, &bits, sizeof(r));
     return r;
 }
 }
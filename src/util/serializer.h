@@ -12,20 +12,33 @@ Author: Leonardo de Moura
 #include "util/extensible_object.h"
 
 namespace lean {
+[[ noreturn ]] void throw_corrupted_file();
+
 /**
    \brief Low-tech serializer.
    The actual functionality is implemented using extensions.
+
+   Unsigned integers are encoded using LEB128 (7 bits per byte), integers are zigzag encoded before that,
+   strings are prefixed with their length, and doubles are stored using their exact binary representation.
+   The data is written directly into the buffer of the output stream.
 */
 class serializer_core {
-    std::ostream & m_out;
+    std::streambuf * m_out;
 public:
-    serializer_core(std::ostream & out):m_out(out) {}
-    void write_string(char const * str) { m_out.write(str, strlen(str) + 1); }
-    void write_string(std::string const & str) { m_out.write(str.c_str(), str.size() + 1); }
-    void write_unsigned(unsigned i);
-    void write_int(int i);
-    void write_char(char c) { m_out.put(c); }
-    void write_bool(bool b) { m_out.put(b ? 1 : 0); }
+    serializer_core(std::ostream & out):m_out(out.rdbuf()) {}
+    void write_char(char c) { m_out->sputc(c); }
+    void write_bool(bool b) { write_char(b ? 1 : 0); }
+    void write_unsigned(unsigned i) {
+        while (i >= 0x80) {
+            write_char(static_cast<char>((i & 0x7f) | 0x80));
+            i >>= 7;
+        }
+        write_char(static_cast<char>(i));
+    }
+    void write_int(int i) { write_unsigned((static_cast<unsigned>(i) << 1) ^ static_cast<unsigned>(i >> 31)); }
+    void write_string(char const * str) { write_string(str, strlen(str)); }
+    void write_string(std::string const & str) { write_string(str.c_str(), str.size()); }
+    void write_string(char const * str, size_t len) { write_unsigned(len); m_out->sputn(str, len); }
     void write_double(double b);
 };
 
@@ -40,19 +53,39 @@ inline serializer & operator<<(serializer & s, bool b) { s.write_bool(b); return
 inline serializer & operator<<(serializer & s, double b) { s.write_double(b); return s; }
 
 /**
-   \brief Low-tech serializer.
+   \brief Low-tech deserializer.
    The actual functionality is implemented using extensions.
+
+   It reads from a sequence of characters in memory. When it is created for an input stream,
+   the (remaining) contents of the stream are read into a buffer.
 */
 class deserializer_core {
-    std::istream & m_in;
+    std::string  m_buffer; // contents of the input stream
+    char const * m_begin;
+    char const * m_curr;
+    char const * m_end;
+    unsigned read_unsigned_core(unsigned r);
 public:
-    deserializer_core(std::istream & in):m_in(in) {}
+    deserializer_core(std::istream & in);
+    deserializer_core(char const * begin, char const * end):m_begin(begin), m_curr(begin), m_end(end) {}
+    deserializer_core(deserializer_core const &) = delete;
+    deserializer_core & operator=(deserializer_core const &) = delete;
+
     std::string read_string();
-    unsigned read_unsigned();
-    int read_int();
-    char read_char() { return m_in.get(); }
-    bool read_bool() { return m_in.get() != 0; }
+    unsigned read_unsigned() {
+        unsigned r = static_cast<unsigned char>(read_char());
+        return r < 0x80 ? r : read_unsigned_core(r);
+    }
+    int read_int() { unsigned r = read_unsigned(); return static_cast<int>(r >> 1) ^ -static_cast<int>(r & 1); }
+    char read_char() {
+        if (m_curr == m_end)
+            throw_corrupted_file();
+        return *(m_curr++);
+    }
+    bool read_bool() { return read_char() != 0; }
     double read_double();
+    /** \brief Return the number of characters read so far. */
+    size_t get_position() const { return m_curr - m_begin; }
 };
 
 typedef extensible_object<deserializer_core> deserializer;
@@ -63,6 +96,4 @@ inline deserializer & operator>>(deserializer & d, int & i) { i = d.read_int();
 inline deserializer & operator>>(deserializer & d, char & c) { c = d.read_char(); return d; }
 inline deserializer & operator>>(deserializer & d, bool & b) { b = d.read_bool(); return d; }
 inline deserializer & operator>>(deserializer & d, double & b) { b = d.read_double(); return d; }
-
-[[ noreturn ]] void throw_corrupted_file();
 }
@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <cstdint>
+#include "util/thread.h"
+#include "util/debug.h"
+#include "util/memory.h"
+#include "util/small_object_allocator.h"
+
+#ifndef LEAN_SMALL_OBJECT_CHUNK_SIZE
+#define LEAN_SMALL_OBJECT_CHUNK_SIZE 16384
+#endif
+
+#ifndef LEAN_SMALL_OBJECT_CHUNKS_PER_SEGMENT
+#define LEAN_SMALL_OBJECT_CHUNKS_PER_SEGMENT 16
+#endif
+
+namespace lean {
+constexpr size_t g_granularity   = 8;
+constexpr size_t g_num_classes   = LEAN_SMALL_OBJECT_MAX_SIZE / g_granularity;
+constexpr size_t g_chunk_size    = LEAN_SMALL_OBJECT_CHUNK_SIZE;
+constexpr size_t g_segment_size  = g_chunk_size * LEAN_SMALL_OBJECT_CHUNKS_PER_SEGMENT;
+static_assert((g_chunk_size & (g_chunk_size - 1)) == 0, "the chunk size must be a power of two");
+static_assert(LEAN_SMALL_OBJECT_MAX_SIZE % g_granularity == 0, "the maximal size must be a multiple of the granularity");
+
+inline unsigned get_size_class(size_t sz) { return sz == 0 ? 0 : (sz - 1) / g_granularity; }
+inline size_t get_class_size(unsigned c) { return (c + 1) * g_granularity; }
+
+struct free_block {
+    free_block * m_next;
+};
+
+class object_pool;
+
+/**
+   \brief Header stored at the beginning of every chunk.
+   A chunk is aligned at a multiple of g_chunk_size, and all its blocks belong to the same size class.
+*/
+struct chunk_header {
+    object_pool * m_owner;
+    unsigned      m_class;
+};
+
+constexpr size_t g_chunk_header_size = (sizeof(chunk_header) + 15) & ~static_cast<size_t>(15);
+
+inline chunk_header * get_chunk(void * ptr) {
+    return reinterpret_cast<chunk_header*>(reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(g_chunk_size - 1));
+}
+
+static atomic<size_t> & get_reserved_memory() {
+    static atomic<size_t> r(0);
+    return r;
+}
+
+/**
+   \brief Collection of free lists (one per size class) owned by a thread.
+   Blocks released by other threads are stored in \c m_remote, and are moved
+   to the free lists when the owner runs out of blocks.
+*/
+class object_pool {
+    free_block *        m_free[g_num_classes];
+    char *              m_next_chunk;
+    char *              m_segment_end;
+#if defined(LEAN_MULTI_THREAD)
+    atomic<free_block*> m_remote;
+#endif
+    object_pool *       m_next_orphan;
+
+    void add_segment() {
+        char * mem    = static_cast<char*>(lean::malloc(g_segment_size + g_chunk_size));
+        uintptr_t a   = (reinterpret_cast<uintptr_t>(mem) + g_chunk_size - 1) & ~static_cast<uintptr_t>(g_chunk_size - 1);
+        m_next_chunk  = reinterpret_cast<char*>(a);
+        m_segment_end = m_next_chunk + g_segment_size;
+        get_reserved_memory() += g_segment_size + g_chunk_size;
+    }
+
+    void add_chunk(unsigned c) {
+        if (m_next_chunk == m_segment_end)
+            add_segment();
+        char * chunk  = m_next_chunk;
+        m_next_chunk += g_chunk_size;
+        chunk_header * h = reinterpret_cast<chunk_header*>(chunk);
+        h->m_owner = this;
+        h->m_class = c;
+        size_t sz  = get_class_size(c);
+        char * it  = chunk + g_chunk_header_size;
+        char * end = chunk + g_chunk_size;
+        for (; it + sz <= end; it += sz)
+            release(it, c);
+    }
+
+    void drain_remote() {
+#if defined(LEAN_MULTI_THREAD)
+        free_block * b = m_remote.exchange(nullptr);
+        while (b) {
+            free_block * next = b->m_next;
+            release(b, get_chunk(b)->m_class);
+            b = next;
+        }
+#endif
+    }
+
+public:
+    object_pool():m_next_chunk(nullptr), m_segment_end(nullptr), m_next_orphan(nullptr) {
+        for (unsigned i = 0; i < g_num_classes; i++)
+            m_free[i] = nullptr;
+#if defined(LEAN_MULTI_THREAD)
+        m_remote = nullptr;
+#endif
+    }
+
+    void * alloc(unsigned c) {
+        free_block * r = m_free[c];
+        if (!r) {
+            drain_remote();
+            if (!m_free[c])
+                add_chunk(c);
+            r = m_free[c];
+        }
+        m_free[c] = r->m_next;
+        return r;
+    }
+
+    /** \brief Return a block to this pool. It must be invoked by the thread that owns the pool. */
+    void release(void * ptr, unsigned c) {
+        free_block * b = static_cast<free_block*>(ptr);
+        b->m_next = m_free[c];
+        m_free[c] = b;
+    }
+
+    /** \brief Return a block to this pool. It may be invoked by any thread. */
+    void release_remote(void * ptr) {
+#if defined(LEAN_MULTI_THREAD)
+        free_block * b    = static_cast<free_block*>(ptr);
+        free_block * head = m_remote.load();
+        do {
+            b->m_next = head;
+        } while (!m_remote.compare_exchange_weak(head, b));
+#else
+        release(ptr, get_chunk(ptr)->m_class);
+#endif
+    }
+
+    friend object_pool * acquire_pool();
+    friend void release_pool(object_pool * p);
+};
+
+static mutex & get_orphans_mutex() {
+    static mutex * m = new mutex();
+    return *m;
+}
+/** \brief Pools of finished threads. They are reused by new threads. */
+static object_pool * g_orphans = nullptr;
+
+object_pool * acquire_pool() {
+    lock_guard<mutex> lock(get_orphans_mutex());
+    if (g_orphans) {
+        object_pool * r = g_orphans;
+        g_orphans = r->m_next_orphan;
+        r->m_next_orphan = nullptr;
+        return r;
+    } else {
+        return new object_pool();
+    }
+}
+
+void release_pool(object_pool * p) {
+    lock_guard<mutex> lock(get_orphans_mutex());
+    p->m_next_orphan = g_orphans;
+    g_orphans = p;
+}
+
+static LEAN_THREAD_LOCAL object_pool * g_pool          = nullptr;
+static LEAN_THREAD_LOCAL bool          g_pool_released = false;
+
+/** \brief Return the pool of the current thread to the orphan list when the thread finishes. */
+struct pool_releaser {
+    ~pool_releaser() {
+        if (g_pool) {
+            release_pool(g_pool);
+            g_pool = nullptr;
+        }
+        g_pool_released = true;
+    }
+};
+
+static object_pool * init_pool() {
+    // Remark: if the thread is already finishing, we do not register a new releaser.
+    // A thread that needs a pool after its releaser was executed keeps it.
+    if (!g_pool_released) {
+        static LEAN_THREAD_LOCAL pool_releaser releaser;
+        (void)releaser;
+    }
+    g_pool = acquire_pool();
+    return g_pool;
+}
+
+void * alloc_small_object(size_t sz) {
+    if (sz > LEAN_SMALL_OBJECT_MAX_SIZE)
+        return lean::malloc(sz);
+    object_pool * p = g_pool;
+    if (!p)
+        p = init_pool();
+    return p->alloc(get_size_class(sz));
+}
+
+void dealloc_small_object(void * ptr, size_t sz) {
+    if (sz > LEAN_SMALL_OBJECT_MAX_SIZE) {
+        lean::free(ptr);
+        return;
+    }
+    chunk_header * h = get_chunk(ptr);
+    lean_assert(h->m_class == get_size_class(sz));
+    if (h->m_owner == g_pool)
+        g_pool->release(ptr, h->m_class);
+    else
+        h->m_owner->release_remote(ptr);
+}
+
+size_t get_small_object_reserved_memory() {
+    return get_reserved_memory();
+}
+}
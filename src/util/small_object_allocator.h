@@ -0,0 +1,35 @@
+/*
+Copyright (c) 2013 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <cstddef>
+
+#ifndef LEAN_SMALL_OBJECT_MAX_SIZE
+#define LEAN_SMALL_OBJECT_MAX_SIZE 256
+#endif
+
+namespace lean {
+/**
+   \brief Allocate a block of \c sz bytes using a thread-caching small object allocator.
+
+   Blocks are grouped in size classes (multiples of 8 bytes up to LEAN_SMALL_OBJECT_MAX_SIZE).
+   Each thread owns a pool with one free list per size class, so no synchronization is needed
+   to allocate or release blocks owned by the current thread. Bigger blocks are allocated
+   using lean::malloc.
+
+   \remark The memory used by the pools is obtained using lean::malloc. Thus, it is
+   reported by get_allocated_memory. It is never returned to the system, but the pool
+   of a finished thread is reused by the next thread that needs one.
+*/
+void * alloc_small_object(size_t sz);
+/**
+   \brief Release a block of \c sz bytes allocated using alloc_small_object.
+   If the block was allocated by a different thread, then it is returned to the pool of that thread.
+*/
+void dealloc_small_object(void * ptr, size_t sz);
+/** \brief Return the amount of memory (in bytes) reserved by the small object pools. */
+size_t get_small_object_reserved_memory();
+}
@@ -30,6 +30,8 @@ using std::atomic_fetch_sub_explicit;
 using std::memory_order_relaxed;
 namespace chrono      = std::chrono;
 namespace this_thread = std::this_thread;
+/** \brief Return the number of hardware threads (at least 1). */
+inline unsigned hardware_concurrency() { unsigned r = thread::hardware_concurrency(); return r == 0 ? 1 : r; }
 }
 #else
 // MULTI THREADING SUPPORT BASED ON THE BOOST LIBRARY
@@ -52,6 +54,7 @@ typedef atomic<unsigned short> atomic_ushort;
 template<typename T> T atomic_load(atomic<T> const * a) { return a->load(); }
 template<typename T> T atomic_fetch_add_explicit(atomic<T> * a, T v, boost::memory_order mo) { return a->fetch_add(v, mo); }
 template<typename T> T atomic_fetch_sub_explicit(atomic<T> * a, T v, boost::memory_order mo) { return a->fetch_sub(v, mo); }
+inline unsigned hardware_concurrency() { unsigned r = thread::hardware_concurrency(); return r == 0 ? 1 : r; }
 }
 #endif
 #else
@@ -61,6 +64,7 @@ template<typename T> T atomic_fetch_sub_explicit(atomic<T> * a, T v, boost::memo
 #define LEAN_THREAD_LOCAL
 namespace lean {
 inline void set_thread_stack_size(size_t ) {}
+inline unsigned hardware_concurrency() { return 1; }
 namespace chrono {
 typedef unsigned milliseconds;
 }
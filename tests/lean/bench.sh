@@ -0,0 +1,32 @@
+#!/bin/bash
+if [ $# -ne 2 -a $# -ne 1 ]; then
+    echo "Usage: bench.sh [lean-executable-path] [baseline-lean-executable-path]?"
+    exit 1
+fi
+ulimit -s 8192
+# Report the time spent by the given Lean executables on each test in this directory.
+# When a baseline executable is provided, it also reports the speedup.
+function run {
+    local START=$(date +%s.%N)
+    $1 -t config.lean $2 &> /dev/null
+    local END=$(date +%s.%N)
+    echo "$END - $START" | bc
+}
+TOTAL=0
+BASE_TOTAL=0
+for f in `ls *.lean`; do
+    T=$(run $1 $f)
+    TOTAL=$(echo "$TOTAL + $T" | bc)
+    if [ $# -ne 2 ]; then
+        echo "$f $T"
+    else
+        B=$(run $2 $f)
+        BASE_TOTAL=$(echo "$BASE_TOTAL + $B" | bc)
+        echo "$f $T $B"
+    fi
+done
+echo "-- total: $TOTAL secs"
+if [ $# -eq 2 ]; then
+    echo "-- baseline total: $BASE_TOTAL secs"
+    echo "-- speedup: $(echo "scale=2; $BASE_TOTAL / $TOTAL" | bc)"
+fi
@@ -0,0 +1,4 @@
+import cast specialfn heq.
+import Int Real.
+check exp
+check @cast
@@ -0,0 +1,6 @@
+import specialfn.
+set_option elaborator::parallel_case_splits 4
+definition f x y := x + y
+definition g x y := sin x + y
+definition h x y := x * sin (x + y)
+print environment 3